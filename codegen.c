@@ -14,9 +14,19 @@
  * - a schedule
  * - a context
  * - a relation describing AST generation options
+ *
+ * If the --stats option is specified, then some statistics about
+ * the AST generation are printed on standard error in the form
+ * of a single line of "key=value" pairs.
  */
 
 #include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <isl_config.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 #include <isl/ast.h>
 #include <isl/ast_build.h>
 #include <isl/options.h>
@@ -26,6 +36,7 @@ struct options {
 	struct isl_options	*isl;
 	unsigned		 atomic;
 	unsigned		 separate;
+	unsigned		 stats;
 };
 
 ISL_ARGS_START(struct options, options_args)
@@ -34,6 +45,8 @@ ISL_ARG_BOOL(struct options, atomic, 0, "atomic", 0,
 	"globally set the atomic option")
 ISL_ARG_BOOL(struct options, separate, 0, "separate", 0,
 	"globally set the separate option")
+ISL_ARG_BOOL(struct options, stats, 0, "stats", 0,
+	"print AST generation statistics on standard error")
 ISL_ARGS_END
 
 ISL_ARG_DEF(options, struct options, options_args)
@@ -100,6 +113,120 @@ static __isl_give isl_ast_build *set_options(__isl_take isl_ast_build *build,
 	return build;
 }
 
+/* Statistics about an AST.
+ * "n" contains the number of nodes of each type.
+ * "depth" is the maximal depth of (nested) for nodes.
+ */
+struct ast_stats {
+	int n[isl_ast_node_user + 1];
+	int depth;
+};
+
+static void collect_stats(__isl_keep isl_ast_node *node,
+	struct ast_stats *stats, int depth);
+
+/* Update "stats" with the nodes in "list" at for node depth "depth".
+ */
+static void collect_list_stats(__isl_take isl_ast_node_list *list,
+	struct ast_stats *stats, int depth)
+{
+	int i, n;
+
+	n = isl_ast_node_list_n_ast_node(list);
+	for (i = 0; i < n; ++i) {
+		isl_ast_node *child;
+
+		child = isl_ast_node_list_get_ast_node(list, i);
+		collect_stats(child, stats, depth);
+		isl_ast_node_free(child);
+	}
+	isl_ast_node_list_free(list);
+}
+
+/* Update "stats" with "node" and its descendants,
+ * where "node" appears inside "depth" for nodes.
+ */
+static void collect_stats(__isl_keep isl_ast_node *node,
+	struct ast_stats *stats, int depth)
+{
+	enum isl_ast_node_type type;
+	isl_ast_node *child;
+
+	type = isl_ast_node_get_type(node);
+	if (type < 0 || type > isl_ast_node_user)
+		return;
+	stats->n[type]++;
+
+	switch (type) {
+	case isl_ast_node_for:
+		if (depth + 1 > stats->depth)
+			stats->depth = depth + 1;
+		child = isl_ast_node_for_get_body(node);
+		collect_stats(child, stats, depth + 1);
+		isl_ast_node_free(child);
+		break;
+	case isl_ast_node_if:
+		child = isl_ast_node_if_get_then(node);
+		collect_stats(child, stats, depth);
+		isl_ast_node_free(child);
+		if (isl_ast_node_if_has_else(node)) {
+			child = isl_ast_node_if_get_else(node);
+			collect_stats(child, stats, depth);
+			isl_ast_node_free(child);
+		}
+		break;
+	case isl_ast_node_block:
+		collect_list_stats(isl_ast_node_block_get_children(node),
+				    stats, depth);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Return the peak memory usage of this process in kilobytes,
+ * or -1 if this information is not available.
+ */
+static long peak_memory(void)
+{
+#ifdef HAVE_SYS_RESOURCE_H
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return usage.ru_maxrss;
+#endif
+	return -1;
+}
+
+/* Print statistics about the generation of "tree" on standard error.
+ * "time" is the CPU time (in seconds) spent on constructing "tree".
+ * Besides the statistics about "tree" itself, we also print
+ * the number of separation classes that were handled, along with
+ * the total and the maximal CPU time spent on computing
+ * the domains of a single class.
+ */
+static void print_stats(isl_ctx *ctx, __isl_keep isl_ast_node *tree,
+	double time)
+{
+	struct ast_stats stats = { { 0 }, 0 };
+	const struct isl_stats *ctx_stats;
+	int n;
+
+	if (tree)
+		collect_stats(tree, &stats, 0);
+	n = stats.n[isl_ast_node_for] + stats.n[isl_ast_node_if] +
+	    stats.n[isl_ast_node_block] + stats.n[isl_ast_node_user];
+	ctx_stats = isl_ctx_get_stats(ctx);
+	fprintf(stderr, "time=%.4f memory=%ld nodes=%d for=%d if=%d "
+		"block=%d user=%d depth=%d classes=%ld class_time=%.4f "
+		"class_time_max=%.4f\n", time, peak_memory(), n,
+		stats.n[isl_ast_node_for], stats.n[isl_ast_node_if],
+		stats.n[isl_ast_node_block], stats.n[isl_ast_node_user],
+		stats.depth, ctx_stats->ast_build_n_class,
+		ctx_stats->ast_build_class_time,
+		ctx_stats->ast_build_class_time_max);
+}
+
 int main(int argc, char **argv)
 {
 	isl_ctx *ctx;
@@ -110,6 +237,7 @@ int main(int argc, char **argv)
 	isl_ast_node *tree;
 	struct options *options;
 	isl_printer *p;
+	clock_t start;
 
 	options = options_new_with_defaults();
 	assert(options);
@@ -121,17 +249,21 @@ int main(int argc, char **argv)
 	context = isl_set_read_from_file(ctx, stdin);
 	options_map = isl_union_map_read_from_file(ctx, stdin);
 
+	start = clock();
 	build = isl_ast_build_from_context(context);
 	build = set_options(build, options_map, options, schedule);
 	tree = isl_ast_build_ast_from_schedule(build, schedule);
 	isl_ast_build_free(build);
+	if (options->stats)
+		print_stats(ctx, tree,
+			    (double) (clock() - start) / CLOCKS_PER_SEC);
 
 	p = isl_printer_to_file(ctx, stdout);
 	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
 	p = isl_printer_print_ast_node(p, tree);
 	isl_printer_free(p);
 
-	isl_ast_node_free(tree);
+	isl_ast_node_free_tree(tree);
 
 	isl_ctx_free(ctx);
 	return 0;
@@ -279,6 +279,7 @@ struct isl_args {
 
 void isl_args_set_defaults(struct isl_args *args, void *opt);
 void isl_args_free(struct isl_args *args, void *opt);
+void *isl_args_copy(struct isl_args *args, void *opt);
 int isl_args_parse(struct isl_args *args, int argc, char **argv, void *opt,
 	unsigned flags);
 
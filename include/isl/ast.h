@@ -61,12 +61,18 @@ enum isl_ast_node_type {
 struct isl_ast_print_options;
 typedef struct isl_ast_print_options isl_ast_print_options;
 
+struct isl_ast_exec;
+typedef struct isl_ast_exec isl_ast_exec;
+
 ISL_DECLARE_LIST(ast_expr)
 ISL_DECLARE_LIST(ast_node)
 
 int isl_options_set_ast_iterator_type(isl_ctx *ctx, const char *val);
 const char *isl_options_get_ast_iterator_type(isl_ctx *ctx);
 
+int isl_options_set_ast_print_omp_pragmas(isl_ctx *ctx, int val);
+int isl_options_get_ast_print_omp_pragmas(isl_ctx *ctx);
+
 __isl_give isl_ast_expr *isl_ast_expr_from_val(__isl_take isl_val *v);
 __isl_give isl_ast_expr *isl_ast_expr_from_id(__isl_take isl_id *id);
 __isl_give isl_ast_expr *isl_ast_expr_neg(__isl_take isl_ast_expr *expr);
@@ -104,6 +110,7 @@ __isl_give char *isl_ast_expr_to_str(__isl_keep isl_ast_expr *expr);
 __isl_give isl_ast_node *isl_ast_node_alloc_user(__isl_take isl_ast_expr *expr);
 __isl_give isl_ast_node *isl_ast_node_copy(__isl_keep isl_ast_node *node);
 void *isl_ast_node_free(__isl_take isl_ast_node *node);
+void *isl_ast_node_free_tree(__isl_take isl_ast_node *node);
 
 isl_ctx *isl_ast_node_get_ctx(__isl_keep isl_ast_node *node);
 enum isl_ast_node_type isl_ast_node_get_type(__isl_keep isl_ast_node *node);
@@ -123,6 +130,10 @@ __isl_give isl_ast_expr *isl_ast_node_for_get_inc(
 __isl_give isl_ast_node *isl_ast_node_for_get_body(
 	__isl_keep isl_ast_node *node);
 int isl_ast_node_for_is_degenerate(__isl_keep isl_ast_node *node);
+int isl_ast_node_for_is_unrolled(__isl_keep isl_ast_node *node);
+int isl_ast_node_for_get_n_unrolled(__isl_keep isl_ast_node *node);
+int isl_ast_node_for_is_parallel(__isl_keep isl_ast_node *node);
+int isl_ast_node_for_is_vectorizable(__isl_keep isl_ast_node *node);
 
 __isl_give isl_ast_expr *isl_ast_node_if_get_cond(
 	__isl_keep isl_ast_node *node);
@@ -178,6 +189,15 @@ __isl_give isl_printer *isl_ast_node_if_print(__isl_keep isl_ast_node *node,
 	__isl_take isl_printer *p,
 	__isl_take isl_ast_print_options *options);
 
+__isl_give isl_ast_exec *isl_ast_node_compile(__isl_keep isl_ast_node *node);
+isl_ctx *isl_ast_exec_get_ctx(__isl_keep isl_ast_exec *exec);
+void *isl_ast_exec_free(__isl_take isl_ast_exec *exec);
+__isl_give isl_ast_exec *isl_ast_exec_set_param(__isl_take isl_ast_exec *exec,
+	__isl_take isl_id *id, long val);
+int isl_ast_exec_run(__isl_keep isl_ast_exec *exec,
+	int (*fn)(__isl_keep isl_ast_node *node, int n_arg, const long *arg,
+		void *user), void *user);
+
 #if defined(__cplusplus)
 }
 #endif
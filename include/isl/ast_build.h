@@ -39,6 +39,21 @@ int isl_options_get_ast_build_allow_else(isl_ctx *ctx);
 int isl_options_set_ast_build_allow_or(isl_ctx *ctx, int val);
 int isl_options_get_ast_build_allow_or(isl_ctx *ctx);
 
+int isl_options_set_ast_build_lazy_unroll(isl_ctx *ctx, int val);
+int isl_options_get_ast_build_lazy_unroll(isl_ctx *ctx);
+
+int isl_options_set_ast_build_arena(isl_ctx *ctx, int val);
+int isl_options_get_ast_build_arena(isl_ctx *ctx);
+
+int isl_options_set_ast_build_hoist_invariants(isl_ctx *ctx, int val);
+int isl_options_get_ast_build_hoist_invariants(isl_ctx *ctx);
+
+int isl_options_set_ast_build_gist_cache(isl_ctx *ctx, int val);
+int isl_options_get_ast_build_gist_cache(isl_ctx *ctx);
+
+int isl_options_set_ast_build_parallel_components(isl_ctx *ctx, int val);
+int isl_options_get_ast_build_parallel_components(isl_ctx *ctx);
+
 isl_ctx *isl_ast_build_get_ctx(__isl_keep isl_ast_build *build);
 
 __isl_give isl_ast_build *isl_ast_build_from_context(__isl_take isl_set *set);
@@ -58,6 +73,9 @@ void *isl_ast_build_free(__isl_take isl_ast_build *build);
 __isl_give isl_ast_build *isl_ast_build_set_options(
 	__isl_take isl_ast_build *build,
 	__isl_take isl_union_map *options);
+__isl_give isl_ast_build *isl_ast_build_set_dependences(
+	__isl_take isl_ast_build *build,
+	__isl_take isl_union_map *dependences);
 __isl_give isl_ast_build *isl_ast_build_set_iterators(
 	__isl_take isl_ast_build *build,
 	__isl_take isl_id_list *iterators);
@@ -85,6 +103,9 @@ __isl_give isl_ast_expr *isl_ast_build_call_from_pw_multi_aff(
 
 __isl_give isl_ast_node *isl_ast_build_ast_from_schedule(
 	__isl_keep isl_ast_build *build, __isl_take isl_union_map *schedule);
+int isl_ast_build_foreach_ast_from_schedule(__isl_keep isl_ast_build *build,
+	__isl_take isl_union_map *schedule,
+	int (*fn)(__isl_take isl_ast_node *node, void *user), void *user);
 
 #if defined(__cplusplus)
 }
@@ -72,6 +72,18 @@ extern "C" {
  */
 struct isl_stats {
 	long	gbr_solved_lps;
+	long	ast_build_n_class;
+	double	ast_build_class_time;
+	double	ast_build_class_time_max;
+	long	bernstein_n_chamber;
+	double	bernstein_chamber_time;
+	double	bernstein_chamber_time_max;
+	long	vertices_n_cache_hit;
+	long	vertices_n_cache_miss;
+	long	qpolynomial_n_div_merge_hit;
+	long	qpolynomial_n_div_merge_miss;
+	long	flow_n_array_computed;
+	long	flow_n_array_reused;
 };
 enum isl_error {
 	isl_error_none = 0,
@@ -234,6 +246,9 @@ enum isl_error isl_ctx_last_error(isl_ctx *ctx);
 void isl_ctx_reset_error(isl_ctx *ctx);
 void isl_ctx_set_error(isl_ctx *ctx, enum isl_error error);
 
+const struct isl_stats *isl_ctx_get_stats(isl_ctx *ctx);
+void isl_ctx_reset_stats(isl_ctx *ctx);
+
 #if defined(__cplusplus)
 }
 #endif
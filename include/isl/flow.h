@@ -68,6 +68,33 @@ int isl_union_map_compute_flow(__isl_take isl_union_map *sink,
 	__isl_give isl_union_map **must_no_source,
 	__isl_give isl_union_map **may_no_source);
 
+int isl_union_map_schedule_is_legal(__isl_keep isl_union_map *reads,
+	__isl_keep isl_union_map *writes, __isl_keep isl_union_map *old_schedule,
+	__isl_keep isl_union_map *new_schedule, __isl_give isl_map **witness);
+
+struct isl_incremental_flow;
+typedef struct isl_incremental_flow isl_incremental_flow;
+
+__isl_give isl_incremental_flow *isl_incremental_flow_alloc(isl_ctx *ctx);
+void *isl_incremental_flow_free(__isl_take isl_incremental_flow *flow);
+
+isl_ctx *isl_incremental_flow_get_ctx(__isl_keep isl_incremental_flow *flow);
+
+__isl_give isl_incremental_flow *isl_incremental_flow_compute(
+	__isl_take isl_incremental_flow *flow, __isl_take isl_union_map *sink,
+	__isl_take isl_union_map *must_source,
+	__isl_take isl_union_map *may_source,
+	__isl_take isl_union_map *schedule);
+
+__isl_give isl_union_map *isl_incremental_flow_get_must_dependence(
+	__isl_keep isl_incremental_flow *flow);
+__isl_give isl_union_map *isl_incremental_flow_get_may_dependence(
+	__isl_keep isl_incremental_flow *flow);
+__isl_give isl_union_map *isl_incremental_flow_get_must_no_source(
+	__isl_keep isl_incremental_flow *flow);
+__isl_give isl_union_map *isl_incremental_flow_get_may_no_source(
+	__isl_keep isl_incremental_flow *flow);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -11,11 +11,16 @@
 #include <isl/aff_type.h>
 #include <isl/polynomial_type.h>
 #include <isl/val.h>
+#include <isl/stdint.h>
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+int isl_options_set_qpolynomial_div_cache_size(isl_ctx *ctx, int val);
+int isl_options_get_qpolynomial_div_cache_size(isl_ctx *ctx);
+void isl_ctx_clear_qpolynomial_div_cache(isl_ctx *ctx);
+
 isl_ctx *isl_qpolynomial_get_ctx(__isl_keep isl_qpolynomial *qp);
 __isl_give isl_space *isl_qpolynomial_get_domain_space(
 	__isl_keep isl_qpolynomial *qp);
@@ -418,6 +423,16 @@ __isl_give isl_pw_qpolynomial_fold *isl_map_apply_pw_qpolynomial_fold(
 __isl_give isl_pw_qpolynomial *isl_pw_qpolynomial_to_polynomial(
 	__isl_take isl_pw_qpolynomial *pwqp, int sign);
 
+__isl_give isl_pw_qpolynomial_exec *isl_pw_qpolynomial_compile(
+	__isl_keep isl_pw_qpolynomial *pwqp);
+__isl_give isl_pw_qpolynomial_exec *isl_pw_qpolynomial_fold_compile(
+	__isl_keep isl_pw_qpolynomial_fold *pwf);
+isl_ctx *isl_pw_qpolynomial_exec_get_ctx(
+	__isl_keep isl_pw_qpolynomial_exec *exec);
+void *isl_pw_qpolynomial_exec_free(__isl_take isl_pw_qpolynomial_exec *exec);
+int isl_pw_qpolynomial_exec_eval(__isl_keep isl_pw_qpolynomial_exec *exec,
+	int n, const int64_t *point, int64_t *num, int64_t *den);
+
 isl_ctx *isl_union_pw_qpolynomial_get_ctx(
 	__isl_keep isl_union_pw_qpolynomial *upwqp);
 
@@ -22,6 +22,9 @@ typedef struct isl_qpolynomial_fold isl_qpolynomial_fold;
 struct isl_pw_qpolynomial_fold;
 typedef struct isl_pw_qpolynomial_fold isl_pw_qpolynomial_fold;
 
+struct isl_pw_qpolynomial_exec;
+typedef struct isl_pw_qpolynomial_exec isl_pw_qpolynomial_exec;
+
 struct __isl_export isl_union_pw_qpolynomial;
 typedef struct isl_union_pw_qpolynomial isl_union_pw_qpolynomial;
 
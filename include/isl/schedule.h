@@ -36,6 +36,14 @@ int isl_options_get_schedule_separate_components(isl_ctx *ctx);
 int isl_options_set_schedule_fuse(isl_ctx *ctx, int val);
 int isl_options_get_schedule_fuse(isl_ctx *ctx);
 
+int isl_options_set_schedule_cache_dir(isl_ctx *ctx, const char *val);
+const char *isl_options_get_schedule_cache_dir(isl_ctx *ctx);
+
+int isl_ctx_set_schedule_cache(isl_ctx *ctx,
+	char *(*lookup)(const char *key, void *user),
+	int (*store)(const char *key, const char *value, void *user),
+	void *user);
+
 __isl_give isl_schedule *isl_union_set_compute_schedule(
 	__isl_take isl_union_set *domain,
 	__isl_take isl_union_map *validity,
@@ -17,6 +17,7 @@
 #include <isl/point.h>
 #include <isl/local_space.h>
 #include <isl/val.h>
+#include <isl/stdint.h>
 
 #if defined(__cplusplus)
 extern "C" {
@@ -460,6 +461,13 @@ int isl_set_foreach_basic_set(__isl_keep isl_set *set,
 
 int isl_set_foreach_point(__isl_keep isl_set *set,
 	int (*fn)(__isl_take isl_point *pnt, void *user), void *user);
+int isl_set_foreach_point_batch(__isl_keep isl_set *set, int max_batch,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	int (*fallback)(__isl_take isl_point *pnt, void *user), void *user);
+int isl_set_foreach_point_batch_parallel(__isl_keep isl_set *set,
+	int max_batch,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	void *user);
 __isl_give isl_val *isl_set_count_val(__isl_keep isl_set *set);
 
 __isl_give isl_basic_set *isl_basic_set_from_point(__isl_take isl_point *pnt);
@@ -22,6 +22,10 @@ __isl_give isl_basic_set *isl_vertex_get_domain(__isl_keep isl_vertex *vertex);
 __isl_give isl_basic_set *isl_vertex_get_expr(__isl_keep isl_vertex *vertex);
 void isl_vertex_free(__isl_take isl_vertex *vertex);
 
+int isl_options_set_vertices_cache_size(isl_ctx *ctx, int val);
+int isl_options_get_vertices_cache_size(isl_ctx *ctx);
+void isl_ctx_clear_vertices_cache(isl_ctx *ctx);
+
 __isl_give isl_vertices *isl_basic_set_compute_vertices(
 	__isl_keep isl_basic_set *bset);
 isl_ctx *isl_vertices_get_ctx(__isl_keep isl_vertices *vertices);
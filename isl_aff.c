@@ -175,6 +175,42 @@ __isl_give isl_aff *isl_aff_dup(__isl_keep isl_aff *aff)
 				 isl_vec_copy(aff->v));
 }
 
+/* Construct a copy of "aff" in "ctx", which may be different
+ * from the context of "aff".  "aff" itself is only read.
+ */
+__isl_give isl_aff *isl_aff_transfer(isl_ctx *ctx, __isl_keep isl_aff *aff)
+{
+	if (!aff)
+		return NULL;
+
+	return isl_aff_alloc_vec(isl_local_space_transfer(ctx, aff->ls),
+				 isl_vec_transfer(ctx, aff->v));
+}
+
+/* Construct a copy of "ma" in "ctx", with a copy of each of
+ * the affine expressions of "ma".  "ma" itself is only read.
+ */
+__isl_give isl_multi_aff *isl_multi_aff_transfer(isl_ctx *ctx,
+	__isl_keep isl_multi_aff *ma)
+{
+	int i;
+	isl_multi_aff *res;
+
+	if (!ma)
+		return NULL;
+
+	res = isl_multi_aff_alloc(isl_space_transfer(ctx, ma->space));
+	if (!res)
+		return NULL;
+	for (i = 0; i < ma->n; ++i) {
+		res->p[i] = isl_aff_transfer(ctx, ma->p[i]);
+		if (!res->p[i])
+			return isl_multi_aff_free(res);
+	}
+
+	return res;
+}
+
 __isl_give isl_aff *isl_aff_cow(__isl_take isl_aff *aff)
 {
 	if (!aff)
@@ -2118,6 +2154,27 @@ __isl_give isl_pw_aff *isl_pw_aff_from_aff(__isl_take isl_aff *aff)
 
 #include <isl_pw_templ.c>
 
+/* Construct a copy of "pa" in "ctx", with the same pieces
+ * in the same order.  "pa" itself is only read.
+ */
+__isl_give isl_pw_aff *isl_pw_aff_transfer(isl_ctx *ctx,
+	__isl_keep isl_pw_aff *pa)
+{
+	int i;
+	isl_pw_aff *res;
+
+	if (!pa)
+		return NULL;
+
+	res = isl_pw_aff_alloc_size(isl_space_transfer(ctx, pa->dim), pa->n);
+	for (i = 0; i < pa->n; ++i)
+		res = isl_pw_aff_add_piece(res,
+				isl_set_transfer(ctx, pa->p[i].set),
+				isl_aff_transfer(ctx, pa->p[i].aff));
+
+	return res;
+}
+
 static __isl_give isl_set *align_params_pw_pw_set_and(
 	__isl_take isl_pw_aff *pwaff1, __isl_take isl_pw_aff *pwaff2,
 	__isl_give isl_set *(*fn)(__isl_take isl_pw_aff *pwaff1,
@@ -2147,16 +2204,21 @@ error:
  * of those of pwaff1 and pwaff2.  If only one of pwaff1 or pwaff2
  * is defined on a given cell, then the associated expression
  * is the defined one.
+ *
+ * The piece indices of pwaff1 and pwaff2 are used to only compare
+ * pairs of pieces with overlapping bounding boxes.
  */
 static __isl_give isl_pw_aff *pw_aff_union_opt(__isl_take isl_pw_aff *pwaff1,
 	__isl_take isl_pw_aff *pwaff2,
 	__isl_give isl_basic_set *(*cmp)(__isl_take isl_aff *aff1,
 					__isl_take isl_aff *aff2))
 {
-	int i, j, n;
-	isl_pw_aff *res;
+	int i, j, k, n, n_cand;
+	isl_pw_aff *res = NULL;
 	isl_ctx *ctx;
 	isl_set *set;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pwaff1 || !pwaff2)
 		goto error;
@@ -2176,15 +2238,27 @@ static __isl_give isl_pw_aff *pw_aff_union_opt(__isl_take isl_pw_aff *pwaff1,
 		return pwaff1;
 	}
 
+	index1 = isl_pw_aff_get_index(pwaff1);
+	index2 = isl_pw_aff_get_index(pwaff2);
+	n = pwaff1->n > pwaff2->n ? pwaff1->n : pwaff2->n;
+	cand = isl_alloc_array(ctx, int, n);
+	if (!index1 || !index2 || !cand)
+		goto error;
+
 	n = 2 * (pwaff1->n + 1) * (pwaff2->n + 1);
 	res = isl_pw_aff_alloc_size(isl_space_copy(pwaff1->dim), n);
 
 	for (i = 0; i < pwaff1->n; ++i) {
 		set = isl_set_copy(pwaff1->p[i].set);
-		for (j = 0; j < pwaff2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k) {
 			struct isl_set *common;
 			isl_set *better;
 
+			j = cand[k];
+
 			common = isl_set_intersect(
 					isl_set_copy(pwaff1->p[i].set),
 					isl_set_copy(pwaff2->p[j].set));
@@ -2207,21 +2281,26 @@ static __isl_give isl_pw_aff *pw_aff_union_opt(__isl_take isl_pw_aff *pwaff1,
 
 	for (j = 0; j < pwaff2->n; ++j) {
 		set = isl_set_copy(pwaff2->p[j].set);
-		for (i = 0; i < pwaff1->n; ++i)
+		n_cand = isl_box_index_find_overlap(index1, index2, j, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k)
 			set = isl_set_subtract(set,
-					isl_set_copy(pwaff1->p[i].set));
+					isl_set_copy(pwaff1->p[cand[k]].set));
 		res = isl_pw_aff_add_piece(res, set,
 						isl_aff_copy(pwaff2->p[j].aff));
 	}
 
+	free(cand);
 	isl_pw_aff_free(pwaff1);
 	isl_pw_aff_free(pwaff2);
 
 	return res;
 error:
+	free(cand);
 	isl_pw_aff_free(pwaff1);
 	isl_pw_aff_free(pwaff2);
-	return NULL;
+	return isl_pw_aff_free(res);
 }
 
 /* Compute a piecewise quasi-affine expression with a domain that
@@ -3399,10 +3478,12 @@ static __isl_give isl_pw_multi_aff *pw_multi_aff_union_opt(
 	__isl_give isl_set *(*cmp)(__isl_take isl_multi_aff *ma1,
 				    __isl_take isl_multi_aff *ma2))
 {
-	int i, j, n;
+	int i, j, k, n, n_cand;
 	isl_pw_multi_aff *res = NULL;
 	isl_ctx *ctx;
 	isl_set *set = NULL;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pma1 || !pma2)
 		goto error;
@@ -3422,15 +3503,27 @@ static __isl_give isl_pw_multi_aff *pw_multi_aff_union_opt(
 		return pma1;
 	}
 
+	index1 = isl_pw_multi_aff_get_index(pma1);
+	index2 = isl_pw_multi_aff_get_index(pma2);
+	n = pma1->n > pma2->n ? pma1->n : pma2->n;
+	cand = isl_alloc_array(ctx, int, n);
+	if (!index1 || !index2 || !cand)
+		goto error;
+
 	n = 2 * (pma1->n + 1) * (pma2->n + 1);
 	res = isl_pw_multi_aff_alloc_size(isl_space_copy(pma1->dim), n);
 
 	for (i = 0; i < pma1->n; ++i) {
 		set = isl_set_copy(pma1->p[i].set);
-		for (j = 0; j < pma2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			goto error;
+		for (k = 0; k < n_cand; ++k) {
 			isl_set *better;
 			int is_empty;
 
+			j = cand[k];
+
 			better = shared_and_better(pma2->p[j].set,
 					pma1->p[i].set, pma2->p[j].maff,
 					pma1->p[i].maff, cmp);
@@ -3452,18 +3545,23 @@ static __isl_give isl_pw_multi_aff *pw_multi_aff_union_opt(
 
 	for (j = 0; j < pma2->n; ++j) {
 		set = isl_set_copy(pma2->p[j].set);
-		for (i = 0; i < pma1->n; ++i)
+		n_cand = isl_box_index_find_overlap(index1, index2, j, cand);
+		if (n_cand < 0)
+			goto error;
+		for (k = 0; k < n_cand; ++k)
 			set = isl_set_subtract(set,
-					isl_set_copy(pma1->p[i].set));
+					isl_set_copy(pma1->p[cand[k]].set));
 		res = isl_pw_multi_aff_add_piece(res, set,
 					isl_multi_aff_copy(pma2->p[j].maff));
 	}
 
+	free(cand);
 	isl_pw_multi_aff_free(pma1);
 	isl_pw_multi_aff_free(pma2);
 
 	return res;
 error:
+	free(cand);
 	isl_pw_multi_aff_free(pma1);
 	isl_pw_multi_aff_free(pma2);
 	isl_set_free(set);
@@ -5183,6 +5281,37 @@ error:
 	return -1;
 }
 
+/* Are "pa1" and "pa2" represented in exactly the same way?
+ * That is, do they have the same pieces in the same order,
+ * with identically represented domains and affine expressions?
+ *
+ * In contrast to isl_pw_aff_plain_is_equal, the inputs are not normalized.
+ */
+int isl_pw_aff_plain_is_identical(__isl_keep isl_pw_aff *pa1,
+	__isl_keep isl_pw_aff *pa2)
+{
+	int i;
+	int equal;
+
+	if (!pa1 || !pa2)
+		return -1;
+
+	if (pa1 == pa2)
+		return 1;
+	if (pa1->n != pa2->n)
+		return 0;
+	equal = isl_space_is_equal(pa1->dim, pa2->dim);
+	for (i = 0; equal > 0 && i < pa1->n; ++i) {
+		equal = isl_set_plain_is_identical(pa1->p[i].set,
+						   pa2->p[i].set);
+		if (equal > 0)
+			equal = isl_aff_plain_is_equal(pa1->p[i].aff,
+						       pa2->p[i].aff);
+	}
+
+	return equal;
+}
+
 #undef BASE
 #define BASE pw_aff
 
@@ -6,6 +6,7 @@
 #include <isl/mat.h>
 #include <isl/local_space.h>
 #include <isl_reordering.h>
+#include <isl_box_index.h>
 
 /* ls represents the domain space.
  */
@@ -32,6 +33,7 @@ struct isl_pw_aff {
 	isl_space *dim;
 
 	int n;
+	struct isl_box_index *index;
 
 	size_t size;
 	struct isl_pw_aff_piece p[1];
@@ -53,12 +55,14 @@ struct isl_pw_multi_aff {
 	isl_space *dim;
 
 	int n;
+	struct isl_box_index *index;
 
 	size_t size;
 	struct isl_pw_multi_aff_piece p[1];
 };
 
 __isl_give isl_aff *isl_aff_alloc(__isl_take isl_local_space *ls);
+__isl_give isl_aff *isl_aff_transfer(isl_ctx *ctx, __isl_keep isl_aff *aff);
 
 __isl_give isl_aff *isl_aff_reset_space_and_domain(__isl_take isl_aff *aff,
 	__isl_take isl_space *space, __isl_take isl_space *domain);
@@ -108,6 +112,8 @@ int isl_aff_check_match_domain_space(__isl_keep isl_aff *aff,
 #include <isl_multi_templ.h>
 
 __isl_give isl_multi_aff *isl_multi_aff_dup(__isl_keep isl_multi_aff *multi);
+__isl_give isl_multi_aff *isl_multi_aff_transfer(isl_ctx *ctx,
+	__isl_keep isl_multi_aff *ma);
 
 __isl_give isl_multi_aff *isl_multi_aff_align_divs(
 	__isl_take isl_multi_aff *maff);
@@ -137,6 +143,12 @@ __isl_give isl_pw_multi_aff *isl_pw_multi_aff_substitute(
 int isl_pw_aff_check_match_domain_space(__isl_keep isl_pw_aff *pa,
 	__isl_keep isl_space *space);
 
+__isl_give isl_pw_aff *isl_pw_aff_dup(__isl_keep isl_pw_aff *pa);
+__isl_give isl_pw_aff *isl_pw_aff_transfer(isl_ctx *ctx,
+	__isl_keep isl_pw_aff *pa);
+int isl_pw_aff_plain_is_identical(__isl_keep isl_pw_aff *pa1,
+	__isl_keep isl_pw_aff *pa2);
+
 #undef BASE
 #define BASE pw_aff
 
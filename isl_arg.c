@@ -202,6 +202,124 @@ void isl_args_free(struct isl_args *args, void *opt)
 	free(opt);
 }
 
+static int copy_args(struct isl_arg *arg, void *dst, void *src);
+
+static int copy_child(struct isl_arg *arg, void *dst, void *src)
+{
+	void *child;
+
+	if (arg->offset == (size_t) -1)
+		return copy_args(arg->u.child.child->args, dst, src);
+
+	child = isl_args_copy(arg->u.child.child,
+			    *(void **)(((char *)src) + arg->offset));
+	*(void **)(((char *)dst) + arg->offset) = child;
+	return child ? 0 : -1;
+}
+
+static int copy_str(struct isl_arg *arg, void *dst, void *src)
+{
+	char *str = *(char **)(((char *)src) + arg->offset);
+	char *copy = str ? strdup(str) : NULL;
+
+	*(char **)(((char *)dst) + arg->offset) = copy;
+	return str && !copy ? -1 : 0;
+}
+
+static int copy_str_list(struct isl_arg *arg, void *dst, void *src)
+{
+	int i;
+	int n = *(int *)(((char *) src) + arg->u.str_list.offset_n);
+	char **list = *(char ***)(((char *) src) + arg->offset);
+	char **copy = NULL;
+
+	if (n > 0) {
+		copy = calloc(n, sizeof(char *));
+		if (!copy)
+			goto error;
+	}
+	*(char ***)(((char *) dst) + arg->offset) = copy;
+	for (i = 0; i < n; ++i) {
+		copy[i] = strdup(list[i]);
+		if (!copy[i])
+			return -1;
+	}
+	return 0;
+error:
+	*(char ***)(((char *) dst) + arg->offset) = NULL;
+	*(int *)(((char *) dst) + arg->u.str_list.offset_n) = 0;
+	return -1;
+}
+
+/* Replace the fields of "dst" that refer to memory owned by "src",
+ * after "dst" has been initialized as a shallow copy of "src",
+ * by deep copies.
+ * All fields are replaced, even if some copy fails,
+ * such that "dst" can always be freed independently of "src".
+ * User arguments cannot be copied in general and are therefore
+ * reset to their default values.
+ */
+static int copy_args(struct isl_arg *arg, void *dst, void *src)
+{
+	int i;
+	int r = 0;
+
+	for (i = 0; arg[i].type != isl_arg_end; ++i) {
+		switch (arg[i].type) {
+		case isl_arg_child:
+			if (copy_child(&arg[i], dst, src) < 0)
+				r = -1;
+			break;
+		case isl_arg_arg:
+		case isl_arg_str:
+			if (copy_str(&arg[i], dst, src) < 0)
+				r = -1;
+			break;
+		case isl_arg_str_list:
+			if (copy_str_list(&arg[i], dst, src) < 0)
+				r = -1;
+			break;
+		case isl_arg_user:
+			set_default_user(&arg[i], dst);
+			break;
+		case isl_arg_alias:
+		case isl_arg_bool:
+		case isl_arg_choice:
+		case isl_arg_flags:
+		case isl_arg_int:
+		case isl_arg_long:
+		case isl_arg_ulong:
+		case isl_arg_version:
+		case isl_arg_footer:
+		case isl_arg_end:
+			break;
+		}
+	}
+
+	return r;
+}
+
+/* Return a deep copy of the options "opt" described by "args".
+ */
+void *isl_args_copy(struct isl_args *args, void *opt)
+{
+	void *copy;
+
+	if (!opt)
+		return NULL;
+
+	copy = malloc(args->options_size);
+	if (!copy)
+		return NULL;
+	memcpy(copy, opt, args->options_size);
+	if (copy_args(args->args, copy, opt) < 0) {
+		isl_args_free(args, copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
 static int print_arg_help(struct isl_arg *decl, const char *prefix, int no)
 {
 	int len = 0;
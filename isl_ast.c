@@ -1,3 +1,7 @@
+#include <string.h>
+#include <isl_ctx_private.h>
+#include <isl_id_private.h>
+#include <isl_val_private.h>
 #include <isl_ast_private.h>
 
 #undef BASE
@@ -10,6 +14,327 @@
 
 #include <isl_list_templ.c>
 
+/* The number of objects in each chunk of an AST arena and
+ * the maximal number of arguments of an operation for which
+ * the argument array is allocated from the arena.
+ */
+#define ISL_AST_ARENA_CHUNK	256
+#define ISL_AST_ARENA_MAX_ARG	4
+
+struct isl_ast_expr_chunk {
+	struct isl_ast_expr_chunk *next;
+	int n;
+	struct isl_ast_expr expr[ISL_AST_ARENA_CHUNK];
+};
+
+struct isl_ast_node_chunk {
+	struct isl_ast_node_chunk *next;
+	int n;
+	struct isl_ast_node node[ISL_AST_ARENA_CHUNK];
+};
+
+struct isl_ast_args_chunk {
+	struct isl_ast_args_chunk *next;
+	int n;
+	isl_ast_expr *args[ISL_AST_ARENA_CHUNK * ISL_AST_ARENA_MAX_ARG];
+};
+
+/* A stack of pointers to objects in an arena that have been freed
+ * and that can be reused.
+ */
+struct isl_ast_arena_stack {
+	int n;
+	int size;
+	void **p;
+};
+
+/* An arena from which the AST expressions and nodes are allocated
+ * while it is the current arena of "ctx".
+ *
+ * "ref" is the number of live objects allocated from the arena,
+ * plus one while the arena is the current arena of "ctx".
+ * "n_ref" is the total number of references to these live objects.
+ * "prev" is the arena that was the current arena of "ctx"
+ * before this arena became the current arena.
+ *
+ * "expr", "node" and "args" are the chunks from which
+ * expressions, nodes and argument arrays are allocated.
+ * Only the first chunk of each list can have free space.
+ * "free_expr", "free_node" and "free_args" contain the objects
+ * that have been freed and that can be reused.
+ * In particular, "free_args[n - 1]" contains the argument arrays
+ * of size "n".
+ */
+struct isl_ast_arena {
+	int ref;
+	isl_ctx *ctx;
+	int n_ref;
+	struct isl_ast_arena *prev;
+
+	struct isl_ast_expr_chunk *expr;
+	struct isl_ast_node_chunk *node;
+	struct isl_ast_args_chunk *args;
+
+	struct isl_ast_arena_stack free_expr;
+	struct isl_ast_arena_stack free_node;
+	struct isl_ast_arena_stack free_args[ISL_AST_ARENA_MAX_ARG];
+};
+
+/* Create a new arena and make it the current arena of "ctx".
+ * The AST expressions and nodes that are created from now on
+ * are allocated from this arena, until isl_ast_arena_leave is called.
+ * The arena itself is only freed when all these objects have been freed.
+ */
+struct isl_ast_arena *isl_ast_arena_enter(isl_ctx *ctx)
+{
+	struct isl_ast_arena *arena;
+
+	arena = isl_calloc_type(ctx, struct isl_ast_arena);
+	if (!arena)
+		return NULL;
+
+	arena->ref = 1;
+	arena->ctx = ctx;
+	arena->prev = ctx->ast_arena;
+	ctx->ast_arena = arena;
+
+	return arena;
+}
+
+static void isl_ast_arena_free(struct isl_ast_arena *arena)
+{
+	int i;
+
+	if (!arena)
+		return;
+	if (--arena->ref > 0)
+		return;
+
+	while (arena->expr) {
+		struct isl_ast_expr_chunk *next = arena->expr->next;
+		free(arena->expr);
+		arena->expr = next;
+	}
+	while (arena->node) {
+		struct isl_ast_node_chunk *next = arena->node->next;
+		free(arena->node);
+		arena->node = next;
+	}
+	while (arena->args) {
+		struct isl_ast_args_chunk *next = arena->args->next;
+		free(arena->args);
+		arena->args = next;
+	}
+	free(arena->free_expr.p);
+	free(arena->free_node.p);
+	for (i = 0; i < ISL_AST_ARENA_MAX_ARG; ++i)
+		free(arena->free_args[i].p);
+	free(arena);
+}
+
+/* Stop allocating AST expressions and nodes from "arena",
+ * reinstating the arena that was current when "arena" was created.
+ */
+void isl_ast_arena_leave(struct isl_ast_arena *arena)
+{
+	if (!arena)
+		return;
+
+	arena->ctx->ast_arena = arena->prev;
+	arena->prev = NULL;
+	isl_ast_arena_free(arena);
+}
+
+/* Push "p" onto "stack".
+ * If this fails, then the object is simply not reused.
+ */
+static void isl_ast_arena_stack_push(isl_ctx *ctx,
+	struct isl_ast_arena_stack *stack, void *p)
+{
+	if (stack->n >= stack->size) {
+		int size = 2 * stack->size + 16;
+		void **q;
+
+		q = isl_realloc_array(ctx, stack->p, void *, size);
+		if (!q)
+			return;
+		stack->p = q;
+		stack->size = size;
+	}
+	stack->p[stack->n++] = p;
+}
+
+static void *isl_ast_arena_stack_pop(struct isl_ast_arena_stack *stack)
+{
+	if (stack->n == 0)
+		return NULL;
+	return stack->p[--stack->n];
+}
+
+/* Allocate an expression from "arena".
+ */
+static isl_ast_expr *isl_ast_arena_alloc_expr(struct isl_ast_arena *arena)
+{
+	isl_ast_expr *expr;
+
+	expr = isl_ast_arena_stack_pop(&arena->free_expr);
+	if (!expr) {
+		struct isl_ast_expr_chunk *chunk = arena->expr;
+
+		if (!chunk || chunk->n >= ISL_AST_ARENA_CHUNK) {
+			chunk = isl_alloc_type(arena->ctx,
+						struct isl_ast_expr_chunk);
+			if (!chunk)
+				return NULL;
+			chunk->next = arena->expr;
+			chunk->n = 0;
+			arena->expr = chunk;
+		}
+		expr = &chunk->expr[chunk->n++];
+	}
+
+	memset(expr, 0, sizeof(*expr));
+	expr->arena = arena;
+	arena->ref++;
+	arena->n_ref++;
+
+	return expr;
+}
+
+/* Allocate a node from "arena".
+ */
+static isl_ast_node *isl_ast_arena_alloc_node(struct isl_ast_arena *arena)
+{
+	isl_ast_node *node;
+
+	node = isl_ast_arena_stack_pop(&arena->free_node);
+	if (!node) {
+		struct isl_ast_node_chunk *chunk = arena->node;
+
+		if (!chunk || chunk->n >= ISL_AST_ARENA_CHUNK) {
+			chunk = isl_alloc_type(arena->ctx,
+						struct isl_ast_node_chunk);
+			if (!chunk)
+				return NULL;
+			chunk->next = arena->node;
+			chunk->n = 0;
+			arena->node = chunk;
+		}
+		node = &chunk->node[chunk->n++];
+	}
+
+	memset(node, 0, sizeof(*node));
+	node->arena = arena;
+	arena->ref++;
+	arena->n_ref++;
+
+	return node;
+}
+
+/* Allocate an argument array of size "n" from "arena",
+ * where "n" is at least one and at most ISL_AST_ARENA_MAX_ARG.
+ */
+static isl_ast_expr **isl_ast_arena_alloc_args(struct isl_ast_arena *arena,
+	int n)
+{
+	isl_ast_expr **args;
+
+	args = isl_ast_arena_stack_pop(&arena->free_args[n - 1]);
+	if (!args) {
+		struct isl_ast_args_chunk *chunk = arena->args;
+
+		if (!chunk ||
+		    chunk->n + n > ISL_AST_ARENA_CHUNK * ISL_AST_ARENA_MAX_ARG) {
+			chunk = isl_alloc_type(arena->ctx,
+						struct isl_ast_args_chunk);
+			if (!chunk)
+				return NULL;
+			chunk->next = arena->args;
+			chunk->n = 0;
+			arena->args = chunk;
+		}
+		args = &chunk->args[chunk->n];
+		chunk->n += n;
+	}
+
+	memset(args, 0, n * sizeof(*args));
+
+	return args;
+}
+
+/* Is the argument array of "expr" allocated from the arena of "expr"?
+ */
+static int isl_ast_expr_args_in_arena(__isl_keep isl_ast_expr *expr)
+{
+	return expr->arena && expr->u.op.n_arg >= 1 &&
+		expr->u.op.n_arg <= ISL_AST_ARENA_MAX_ARG;
+}
+
+/* Allocate the memory for a new expression, from the current arena
+ * of "ctx" if there is one.
+ */
+static isl_ast_expr *isl_ast_expr_alloc_struct(isl_ctx *ctx)
+{
+	if (ctx->ast_arena)
+		return isl_ast_arena_alloc_expr(ctx->ast_arena);
+	return isl_calloc_type(ctx, isl_ast_expr);
+}
+
+/* Allocate the memory for a new node, from the current arena
+ * of "ctx" if there is one.
+ */
+static isl_ast_node *isl_ast_node_alloc_struct(isl_ctx *ctx)
+{
+	if (ctx->ast_arena)
+		return isl_ast_arena_alloc_node(ctx->ast_arena);
+	return isl_calloc_type(ctx, isl_ast_node);
+}
+
+/* Release the memory of the argument array of the operation "expr".
+ */
+static void isl_ast_expr_free_args(__isl_keep isl_ast_expr *expr)
+{
+	if (!isl_ast_expr_args_in_arena(expr)) {
+		free(expr->u.op.args);
+		return;
+	}
+	if (!expr->u.op.args)
+		return;
+	isl_ast_arena_stack_push(expr->ctx,
+		&expr->arena->free_args[expr->u.op.n_arg - 1],
+		expr->u.op.args);
+}
+
+/* Release the memory of "expr", the reference count of which
+ * has dropped to zero.
+ */
+static void isl_ast_expr_free_struct(__isl_take isl_ast_expr *expr)
+{
+	struct isl_ast_arena *arena = expr->arena;
+
+	if (!arena) {
+		free(expr);
+		return;
+	}
+	isl_ast_arena_stack_push(expr->ctx, &arena->free_expr, expr);
+	isl_ast_arena_free(arena);
+}
+
+/* Release the memory of "node", the reference count of which
+ * has dropped to zero.
+ */
+static void isl_ast_node_free_struct(__isl_take isl_ast_node *node)
+{
+	struct isl_ast_arena *arena = node->arena;
+
+	if (!arena) {
+		free(node);
+		return;
+	}
+	isl_ast_arena_stack_push(node->ctx, &arena->free_node, node);
+	isl_ast_arena_free(arena);
+}
+
 isl_ctx *isl_ast_print_options_get_ctx(
 	__isl_keep isl_ast_print_options *options)
 {
@@ -49,6 +374,7 @@ __isl_give isl_ast_print_options *isl_ast_print_options_dup(
 	dup->print_for_user = options->print_for_user;
 	dup->print_user = options->print_user;
 	dup->print_user_user = options->print_user_user;
+	dup->in_parallel = options->in_parallel;
 
 	return dup;
 }
@@ -138,6 +464,8 @@ __isl_give isl_ast_expr *isl_ast_expr_copy(__isl_keep isl_ast_expr *expr)
 		return NULL;
 
 	expr->ref++;
+	if (expr->arena)
+		expr->arena->n_ref++;
 	return expr;
 }
 
@@ -195,6 +523,8 @@ void *isl_ast_expr_free(__isl_take isl_ast_expr *expr)
 	if (!expr)
 		return NULL;
 
+	if (expr->arena)
+		expr->arena->n_ref--;
 	if (--expr->ref > 0)
 		return NULL;
 
@@ -210,13 +540,13 @@ void *isl_ast_expr_free(__isl_take isl_ast_expr *expr)
 	case isl_ast_expr_op:
 		for (i = 0; i < expr->u.op.n_arg; ++i)
 			isl_ast_expr_free(expr->u.op.args[i]);
-		free(expr->u.op.args);
+		isl_ast_expr_free_args(expr);
 		break;
 	case isl_ast_expr_error:
 		break;
 	}
 
-	free(expr);
+	isl_ast_expr_free_struct(expr);
 	return NULL;
 }
 
@@ -320,7 +650,7 @@ __isl_give isl_ast_expr *isl_ast_expr_alloc_op(isl_ctx *ctx,
 {
 	isl_ast_expr *expr;
 
-	expr = isl_calloc_type(ctx, isl_ast_expr);
+	expr = isl_ast_expr_alloc_struct(ctx);
 	if (!expr)
 		return NULL;
 
@@ -330,7 +660,10 @@ __isl_give isl_ast_expr *isl_ast_expr_alloc_op(isl_ctx *ctx,
 	expr->type = isl_ast_expr_op;
 	expr->u.op.op = op;
 	expr->u.op.n_arg = n_arg;
-	expr->u.op.args = isl_calloc_array(ctx, isl_ast_expr *, n_arg);
+	if (expr->arena && n_arg >= 1 && n_arg <= ISL_AST_ARENA_MAX_ARG)
+		expr->u.op.args = isl_ast_arena_alloc_args(expr->arena, n_arg);
+	else
+		expr->u.op.args = isl_calloc_array(ctx, isl_ast_expr *, n_arg);
 
 	if (!expr->u.op.args)
 		return isl_ast_expr_free(expr);
@@ -349,7 +682,7 @@ __isl_give isl_ast_expr *isl_ast_expr_from_id(__isl_take isl_id *id)
 		return NULL;
 
 	ctx = isl_id_get_ctx(id);
-	expr = isl_calloc_type(ctx, isl_ast_expr);
+	expr = isl_ast_expr_alloc_struct(ctx);
 	if (!expr)
 		return isl_id_free(id);
 
@@ -368,7 +701,7 @@ __isl_give isl_ast_expr *isl_ast_expr_alloc_int_si(isl_ctx *ctx, int i)
 {
 	isl_ast_expr *expr;
 
-	expr = isl_calloc_type(ctx, isl_ast_expr);
+	expr = isl_ast_expr_alloc_struct(ctx);
 	if (!expr)
 		return NULL;
 
@@ -397,7 +730,7 @@ __isl_give isl_ast_expr *isl_ast_expr_from_val(__isl_take isl_val *v)
 			"expecting integer value", return isl_val_free(v));
 
 	ctx = isl_val_get_ctx(v);
-	expr = isl_calloc_type(ctx, isl_ast_expr);
+	expr = isl_ast_expr_alloc_struct(ctx);
 	if (!expr)
 		return isl_val_free(v);
 
@@ -523,7 +856,7 @@ __isl_give isl_ast_node *isl_ast_node_alloc(isl_ctx *ctx,
 {
 	isl_ast_node *node;
 
-	node = isl_calloc_type(ctx, isl_ast_node);
+	node = isl_ast_node_alloc_struct(ctx);
 	if (!node)
 		return NULL;
 
@@ -652,6 +985,8 @@ __isl_give isl_ast_node *isl_ast_node_copy(__isl_keep isl_ast_node *node)
 		return NULL;
 
 	node->ref++;
+	if (node->arena)
+		node->arena->n_ref++;
 	return node;
 }
 
@@ -681,8 +1016,13 @@ __isl_give isl_ast_node *isl_ast_node_dup(__isl_keep isl_ast_node *node)
 		dup->u.f.cond = isl_ast_expr_copy(node->u.f.cond);
 		dup->u.f.inc = isl_ast_expr_copy(node->u.f.inc);
 		dup->u.f.body = isl_ast_node_copy(node->u.f.body);
-		if (!dup->u.f.iterator || !dup->u.f.init || !dup->u.f.cond ||
-		    !dup->u.f.inc || !dup->u.f.body)
+		dup->u.f.degenerate = node->u.f.degenerate;
+		dup->u.f.n_unrolled = node->u.f.n_unrolled;
+		dup->u.f.parallel = node->u.f.parallel;
+		dup->u.f.vectorizable = node->u.f.vectorizable;
+		if (!dup->u.f.iterator || !dup->u.f.init || !dup->u.f.body)
+			return isl_ast_node_free(dup);
+		if (!node->u.f.degenerate && (!dup->u.f.cond || !dup->u.f.inc))
 			return isl_ast_node_free(dup);
 		break;
 	case isl_ast_node_block:
@@ -713,11 +1053,136 @@ __isl_give isl_ast_node *isl_ast_node_cow(__isl_take isl_ast_node *node)
 	return isl_ast_node_dup(node);
 }
 
+/* Construct a copy of "expr" in "ctx".
+ * This function only reads "expr".
+ */
+static __isl_give isl_ast_expr *expr_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_expr *expr)
+{
+	int i;
+	isl_ast_expr *res;
+
+	if (!expr)
+		return NULL;
+
+	switch (expr->type) {
+	case isl_ast_expr_int:
+		return isl_ast_expr_from_val(isl_val_transfer(ctx, expr->u.v));
+	case isl_ast_expr_id:
+		return isl_ast_expr_from_id(isl_id_transfer(ctx, expr->u.id));
+	case isl_ast_expr_op:
+		break;
+	case isl_ast_expr_error:
+		return NULL;
+	}
+
+	res = isl_ast_expr_alloc_op(ctx, expr->u.op.op, expr->u.op.n_arg);
+	if (!res)
+		return NULL;
+	for (i = 0; i < expr->u.op.n_arg; ++i) {
+		res->u.op.args[i] = expr_transfer(ctx, expr->u.op.args[i]);
+		if (!res->u.op.args[i])
+			return isl_ast_expr_free(res);
+	}
+
+	return res;
+}
+
+/* Construct a copy of "list" in "ctx".
+ * This function only reads "list".
+ */
+static __isl_give isl_ast_node_list *node_list_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_node_list *list)
+{
+	int i;
+	isl_ast_node_list *res;
+
+	if (!list)
+		return NULL;
+
+	res = isl_ast_node_list_alloc(ctx, list->n);
+	for (i = 0; i < list->n; ++i)
+		res = isl_ast_node_list_add(res,
+					isl_ast_node_transfer(ctx, list->p[i]));
+
+	return res;
+}
+
+/* Construct a copy of "node" in "ctx", which may be different
+ * from the context of "node", including copies of all its
+ * descendants and of the identifiers and values they refer to.
+ * The copy is allocated from the current arena of "ctx", if any.
+ * This function only reads "node".
+ */
+__isl_give isl_ast_node *isl_ast_node_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_node *node)
+{
+	isl_ast_node *res;
+
+	if (!node)
+		return NULL;
+
+	res = isl_ast_node_alloc(ctx, node->type);
+	if (!res)
+		return NULL;
+
+	switch (node->type) {
+	case isl_ast_node_if:
+		res->u.i.guard = expr_transfer(ctx, node->u.i.guard);
+		res->u.i.then = isl_ast_node_transfer(ctx, node->u.i.then);
+		res->u.i.else_node = isl_ast_node_transfer(ctx,
+							node->u.i.else_node);
+		if (!res->u.i.guard || !res->u.i.then ||
+		    (node->u.i.else_node && !res->u.i.else_node))
+			return isl_ast_node_free(res);
+		break;
+	case isl_ast_node_for:
+		res->u.f.iterator = expr_transfer(ctx, node->u.f.iterator);
+		res->u.f.init = expr_transfer(ctx, node->u.f.init);
+		res->u.f.cond = expr_transfer(ctx, node->u.f.cond);
+		res->u.f.inc = expr_transfer(ctx, node->u.f.inc);
+		res->u.f.body = isl_ast_node_transfer(ctx, node->u.f.body);
+		res->u.f.degenerate = node->u.f.degenerate;
+		res->u.f.n_unrolled = node->u.f.n_unrolled;
+		res->u.f.parallel = node->u.f.parallel;
+		res->u.f.vectorizable = node->u.f.vectorizable;
+		if (!res->u.f.iterator || !res->u.f.init || !res->u.f.body)
+			return isl_ast_node_free(res);
+		if ((node->u.f.cond && !res->u.f.cond) ||
+		    (node->u.f.inc && !res->u.f.inc))
+			return isl_ast_node_free(res);
+		break;
+	case isl_ast_node_block:
+		res->u.b.children = node_list_transfer(ctx,
+							node->u.b.children);
+		if (!res->u.b.children)
+			return isl_ast_node_free(res);
+		break;
+	case isl_ast_node_user:
+		res->u.e.expr = expr_transfer(ctx, node->u.e.expr);
+		if (!res->u.e.expr)
+			return isl_ast_node_free(res);
+		break;
+	case isl_ast_node_error:
+		break;
+	}
+
+	if (node->annotation) {
+		res->annotation = isl_id_transfer(ctx, node->annotation);
+		if (!res->annotation)
+			return isl_ast_node_free(res);
+	}
+
+	return res;
+}
+
 void *isl_ast_node_free(__isl_take isl_ast_node *node)
 {
 	if (!node)
 		return NULL;
 
+	if (node->arena)
+		node->arena->n_ref--;
 	if (--node->ref > 0)
 		return NULL;
 
@@ -746,7 +1211,224 @@ void *isl_ast_node_free(__isl_take isl_ast_node *node)
 
 	isl_id_free(node->annotation);
 	isl_ctx_deref(node->ctx);
-	free(node);
+	isl_ast_node_free_struct(node);
+
+	return NULL;
+}
+
+/* Is "node" a live node allocated from "arena"?
+ */
+static int isl_ast_node_in_arena(__isl_keep isl_ast_node *node,
+	struct isl_ast_arena *arena)
+{
+	return node && node->arena == arena;
+}
+
+static int isl_ast_expr_in_arena(__isl_keep isl_ast_expr *expr,
+	struct isl_ast_arena *arena)
+{
+	return expr && expr->arena == arena;
+}
+
+/* Count the number of references from live objects in "arena"
+ * to other objects in "arena" and the number of live objects in "arena".
+ * Return -1 if some live node refers to a list of children
+ * that is shared, since the references through such a list
+ * cannot be accounted for.
+ */
+static int isl_ast_arena_count_internal(struct isl_ast_arena *arena,
+	int *n_live)
+{
+	int i, j, n = 0;
+	struct isl_ast_expr_chunk *ec;
+	struct isl_ast_node_chunk *nc;
+
+	*n_live = 0;
+	for (ec = arena->expr; ec; ec = ec->next)
+		for (i = 0; i < ec->n; ++i) {
+			isl_ast_expr *expr = &ec->expr[i];
+
+			if (expr->ref <= 0)
+				continue;
+			(*n_live)++;
+			if (expr->type != isl_ast_expr_op)
+				continue;
+			for (j = 0; j < expr->u.op.n_arg; ++j)
+				n += isl_ast_expr_in_arena(expr->u.op.args[j],
+							    arena);
+		}
+	for (nc = arena->node; nc; nc = nc->next)
+		for (i = 0; i < nc->n; ++i) {
+			isl_ast_node *node = &nc->node[i];
+			isl_ast_node_list *list;
+
+			if (node->ref <= 0)
+				continue;
+			(*n_live)++;
+			switch (node->type) {
+			case isl_ast_node_if:
+				n += isl_ast_expr_in_arena(node->u.i.guard,
+							    arena);
+				n += isl_ast_node_in_arena(node->u.i.then,
+							    arena);
+				n += isl_ast_node_in_arena(node->u.i.else_node,
+							    arena);
+				break;
+			case isl_ast_node_for:
+				n += isl_ast_expr_in_arena(node->u.f.iterator,
+							    arena);
+				n += isl_ast_expr_in_arena(node->u.f.init,
+							    arena);
+				n += isl_ast_expr_in_arena(node->u.f.cond,
+							    arena);
+				n += isl_ast_expr_in_arena(node->u.f.inc,
+							    arena);
+				n += isl_ast_node_in_arena(node->u.f.body,
+							    arena);
+				break;
+			case isl_ast_node_block:
+				list = node->u.b.children;
+				if (!list)
+					break;
+				if (list->ref != 1)
+					return -1;
+				for (j = 0; j < list->n; ++j)
+					n += isl_ast_node_in_arena(list->p[j],
+								    arena);
+				break;
+			case isl_ast_node_user:
+				n += isl_ast_expr_in_arena(node->u.e.expr,
+							    arena);
+				break;
+			case isl_ast_node_error:
+				break;
+			}
+		}
+
+	return n;
+}
+
+/* Release the objects held by the live expression "expr" in "arena"
+ * that have not been allocated from "arena".
+ */
+static void isl_ast_arena_release_expr(struct isl_ast_arena *arena,
+	__isl_keep isl_ast_expr *expr)
+{
+	int i;
+
+	switch (expr->type) {
+	case isl_ast_expr_int:
+		isl_val_free(expr->u.v);
+		break;
+	case isl_ast_expr_id:
+		isl_id_free(expr->u.id);
+		break;
+	case isl_ast_expr_op:
+		for (i = 0; i < expr->u.op.n_arg; ++i)
+			if (!isl_ast_expr_in_arena(expr->u.op.args[i], arena))
+				isl_ast_expr_free(expr->u.op.args[i]);
+		if (!isl_ast_expr_args_in_arena(expr))
+			free(expr->u.op.args);
+		break;
+	case isl_ast_expr_error:
+		break;
+	}
+	isl_ctx_deref(expr->ctx);
+}
+
+/* Release the objects held by the live node "node" in "arena"
+ * that have not been allocated from "arena".
+ * The list of children of a block node is not shared,
+ * so it can be freed after removing the children from "arena".
+ */
+static void isl_ast_arena_release_node(struct isl_ast_arena *arena,
+	__isl_keep isl_ast_node *node)
+{
+	int i;
+	isl_ast_node_list *list;
+
+	switch (node->type) {
+	case isl_ast_node_if:
+		if (!isl_ast_expr_in_arena(node->u.i.guard, arena))
+			isl_ast_expr_free(node->u.i.guard);
+		if (!isl_ast_node_in_arena(node->u.i.then, arena))
+			isl_ast_node_free(node->u.i.then);
+		if (!isl_ast_node_in_arena(node->u.i.else_node, arena))
+			isl_ast_node_free(node->u.i.else_node);
+		break;
+	case isl_ast_node_for:
+		if (!isl_ast_expr_in_arena(node->u.f.iterator, arena))
+			isl_ast_expr_free(node->u.f.iterator);
+		if (!isl_ast_expr_in_arena(node->u.f.init, arena))
+			isl_ast_expr_free(node->u.f.init);
+		if (!isl_ast_expr_in_arena(node->u.f.cond, arena))
+			isl_ast_expr_free(node->u.f.cond);
+		if (!isl_ast_expr_in_arena(node->u.f.inc, arena))
+			isl_ast_expr_free(node->u.f.inc);
+		if (!isl_ast_node_in_arena(node->u.f.body, arena))
+			isl_ast_node_free(node->u.f.body);
+		break;
+	case isl_ast_node_block:
+		list = node->u.b.children;
+		if (!list)
+			break;
+		for (i = 0; i < list->n; ++i)
+			if (isl_ast_node_in_arena(list->p[i], arena))
+				list->p[i] = NULL;
+		isl_ast_node_list_free(list);
+		break;
+	case isl_ast_node_user:
+		if (!isl_ast_expr_in_arena(node->u.e.expr, arena))
+			isl_ast_expr_free(node->u.e.expr);
+		break;
+	case isl_ast_node_error:
+		break;
+	}
+	isl_id_free(node->annotation);
+	isl_ctx_deref(node->ctx);
+}
+
+/* Free "node" along with all its descendants.
+ *
+ * If "node" was allocated from an arena that is no longer
+ * the current arena of its context and if the only reference
+ * to any of the objects in this arena (other than the references
+ * between these objects) is the reference to "node" that is being
+ * released, then all objects in the arena belong to the tree
+ * rooted at "node".  The objects are then released by sweeping
+ * over the arena, after which the arena is freed in one go.
+ * Otherwise, "node" is freed in the same way as by isl_ast_node_free.
+ */
+void *isl_ast_node_free_tree(__isl_take isl_ast_node *node)
+{
+	int i;
+	int n_internal, n_live;
+	struct isl_ast_arena *arena;
+	struct isl_ast_expr_chunk *ec;
+	struct isl_ast_node_chunk *nc;
+
+	if (!node)
+		return NULL;
+
+	arena = node->arena;
+	if (!arena || node->ref != 1 || arena == node->ctx->ast_arena)
+		return isl_ast_node_free(node);
+	n_internal = isl_ast_arena_count_internal(arena, &n_live);
+	if (n_internal < 0 || arena->n_ref != n_internal + 1 ||
+	    arena->ref != n_live)
+		return isl_ast_node_free(node);
+
+	for (ec = arena->expr; ec; ec = ec->next)
+		for (i = 0; i < ec->n; ++i)
+			if (ec->expr[i].ref > 0)
+				isl_ast_arena_release_expr(arena, &ec->expr[i]);
+	for (nc = arena->node; nc; nc = nc->next)
+		for (i = 0; i < nc->n; ++i)
+			if (nc->node[i].ref > 0)
+				isl_ast_arena_release_node(arena, &nc->node[i]);
+
+	arena->ref = 1;
+	isl_ast_arena_free(arena);
 
 	return NULL;
 }
@@ -806,25 +1488,131 @@ int isl_ast_node_for_is_degenerate(__isl_keep isl_ast_node *node)
 	return node->u.f.degenerate;
 }
 
-__isl_give isl_ast_expr *isl_ast_node_for_get_iterator(
-	__isl_keep isl_ast_node *node)
+/* Mark the given for node as being unrolled, with "n" iterations.
+ * The caller is responsible for ensuring that the for node
+ * performs exactly "n" iterations.
+ */
+__isl_give isl_ast_node *isl_ast_node_for_mark_unrolled(
+	__isl_take isl_ast_node *node, int n)
 {
+	node = isl_ast_node_cow(node);
 	if (!node)
 		return NULL;
-	if (node->type != isl_ast_node_for)
-		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
-			"not a for node", return NULL);
-	return isl_ast_expr_copy(node->u.f.iterator);
+	node->u.f.n_unrolled = n;
+	return node;
 }
 
-__isl_give isl_ast_expr *isl_ast_node_for_get_init(
-	__isl_keep isl_ast_node *node)
+int isl_ast_node_for_is_unrolled(__isl_keep isl_ast_node *node)
 {
 	if (!node)
-		return NULL;
+		return -1;
 	if (node->type != isl_ast_node_for)
 		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
-			"not a for node", return NULL);
+			"not a for node", return -1);
+	return node->u.f.n_unrolled > 0;
+}
+
+/* Mark the for node "node" as being parallel, i.e., as not carrying
+ * any dependences.  If "vectorizable" is set, then "node" is also
+ * marked vectorizable, meaning that it does not contain any other loops
+ * and that it has unit increment.
+ */
+__isl_give isl_ast_node *isl_ast_node_for_mark_parallel(
+	__isl_take isl_ast_node *node, int vectorizable)
+{
+	node = isl_ast_node_cow(node);
+	if (!node)
+		return NULL;
+	node->u.f.parallel = 1;
+	node->u.f.vectorizable = vectorizable;
+	return node;
+}
+
+int isl_ast_node_for_is_parallel(__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return -1;
+	if (node->type != isl_ast_node_for)
+		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
+			"not a for node", return -1);
+	return node->u.f.parallel;
+}
+
+int isl_ast_node_for_is_vectorizable(__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return -1;
+	if (node->type != isl_ast_node_for)
+		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
+			"not a for node", return -1);
+	return node->u.f.vectorizable;
+}
+
+/* Does "node" contain any for node that is printed as a loop,
+ * i.e., one that is neither degenerate nor unrolled?
+ */
+int isl_ast_node_contains_loop(__isl_keep isl_ast_node *node)
+{
+	int i, n;
+
+	if (!node)
+		return -1;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		if (!node->u.f.degenerate && node->u.f.n_unrolled == 0)
+			return 1;
+		return isl_ast_node_contains_loop(node->u.f.body);
+	case isl_ast_node_if:
+		if (isl_ast_node_contains_loop(node->u.i.then))
+			return 1;
+		if (!node->u.i.else_node)
+			return 0;
+		return isl_ast_node_contains_loop(node->u.i.else_node);
+	case isl_ast_node_block:
+		n = isl_ast_node_list_n_ast_node(node->u.b.children);
+		for (i = 0; i < n; ++i)
+			if (isl_ast_node_contains_loop(
+					node->u.b.children->p[i]))
+				return 1;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+/* Return the number of iterations of the unrolled for node "node",
+ * or 0 if "node" is not unrolled.
+ */
+int isl_ast_node_for_get_n_unrolled(__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return -1;
+	if (node->type != isl_ast_node_for)
+		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
+			"not a for node", return -1);
+	return node->u.f.n_unrolled;
+}
+
+__isl_give isl_ast_expr *isl_ast_node_for_get_iterator(
+	__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return NULL;
+	if (node->type != isl_ast_node_for)
+		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
+			"not a for node", return NULL);
+	return isl_ast_expr_copy(node->u.f.iterator);
+}
+
+__isl_give isl_ast_expr *isl_ast_node_for_get_init(
+	__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return NULL;
+	if (node->type != isl_ast_node_for)
+		isl_die(isl_ast_node_get_ctx(node), isl_error_invalid,
+			"not a for node", return NULL);
 	return isl_ast_expr_copy(node->u.f.init);
 }
 
@@ -1303,138 +2091,1469 @@ static __isl_give isl_printer *print_ast_node_isl(__isl_take isl_printer *p,
 	return p;
 }
 
-/* Do we need to print a block around the body "node" of a for or if node?
- *
- * If the node is a block, then we need to print a block.
- * Also if the node is a degenerate for then we will print it as
- * an assignment followed by the body of the for loop, so we need a block
- * as well.
+/* A linear combination of expressions with integer coefficients
+ * plus an integer constant.
+ * The expressions in "term" are identifiers or operations
+ * that are not themselves (integer multiples of) sums.
+ * "n" is the number of terms and "size" the size of the "term" and "coef"
+ * arrays.  The expressions are not owned by this structure.
  */
-static int need_block(__isl_keep isl_ast_node *node)
+struct isl_ast_lin {
+	int n;
+	int size;
+	isl_ast_expr **term;
+	isl_val **coef;
+	isl_val *cst;
+};
+
+/* Return the number of subexpressions of "expr", including "expr" itself.
+ * This is an upper bound on the number of terms in a linear combination
+ * constructed from "expr".
+ */
+static int ast_expr_size(__isl_keep isl_ast_expr *expr)
 {
-	if (node->type == isl_ast_node_block)
+	int i, n = 1;
+
+	if (expr->type != isl_ast_expr_op)
 		return 1;
-	if (node->type == isl_ast_node_for && node->u.f.degenerate)
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		n += ast_expr_size(expr->u.op.args[i]);
+	return n;
+}
+
+/* Are "expr1" and "expr2" structurally identical?
+ */
+static int ast_expr_equal(__isl_keep isl_ast_expr *expr1,
+	__isl_keep isl_ast_expr *expr2)
+{
+	int i;
+
+	if (expr1 == expr2)
 		return 1;
-	return 0;
+	if (expr1->type != expr2->type)
+		return 0;
+	switch (expr1->type) {
+	case isl_ast_expr_int:
+		return isl_val_eq(expr1->u.v, expr2->u.v);
+	case isl_ast_expr_id:
+		return expr1->u.id == expr2->u.id;
+	case isl_ast_expr_op:
+		if (expr1->u.op.op != expr2->u.op.op)
+			return 0;
+		if (expr1->u.op.n_arg != expr2->u.op.n_arg)
+			return 0;
+		for (i = 0; i < expr1->u.op.n_arg; ++i)
+			if (!ast_expr_equal(expr1->u.op.args[i],
+					    expr2->u.op.args[i]))
+				return 0;
+		return 1;
+	default:
+		return 0;
+	}
 }
 
-static __isl_give isl_printer *print_ast_node_c(__isl_take isl_printer *p,
-	__isl_keep isl_ast_node *node,
-	__isl_keep isl_ast_print_options *options, int in_block, int in_list);
-static __isl_give isl_printer *print_if_c(__isl_take isl_printer *p,
-	__isl_keep isl_ast_node *node,
-	__isl_keep isl_ast_print_options *options, int new_line);
+static void ast_lin_free(struct isl_ast_lin *lin)
+{
+	int i;
 
-/* Print the body "node" of a for or if node.
- * If "else_node" is set, then it is printed as well.
- *
- * We first check if we need to print out a block.
- * We always print out a block if there is an else node to make
- * sure that the else node is matched to the correct if node.
- *
- * If the else node is itself an if, then we print it as
- *
- *	} else if (..)
- *
- * Otherwise the else node is printed as
- *
- *	} else
- *	  node
+	for (i = 0; i < lin->n; ++i)
+		isl_val_free(lin->coef[i]);
+	free(lin->term);
+	free(lin->coef);
+	isl_val_free(lin->cst);
+}
+
+/* Initialize "lin" to the zero expression with room for "size" terms.
  */
-static __isl_give isl_printer *print_body_c(__isl_take isl_printer *p,
-	__isl_keep isl_ast_node *node, __isl_keep isl_ast_node *else_node,
-	__isl_keep isl_ast_print_options *options)
+static int ast_lin_init(struct isl_ast_lin *lin, isl_ctx *ctx, int size)
+{
+	lin->n = 0;
+	lin->size = size;
+	lin->term = isl_calloc_array(ctx, isl_ast_expr *, size);
+	lin->coef = isl_calloc_array(ctx, isl_val *, size);
+	lin->cst = isl_val_zero(ctx);
+	if ((size && (!lin->term || !lin->coef)) || !lin->cst) {
+		ast_lin_free(lin);
+		return -1;
+	}
+	return 0;
+}
+
+/* Add "f" times the term "expr" to "lin".
+ */
+static int ast_lin_add_term(struct isl_ast_lin *lin,
+	__isl_keep isl_ast_expr *expr, __isl_keep isl_val *f)
 {
-	if (!node)
-		return isl_printer_free(p);
+	int i;
 
-	if (!else_node && !need_block(node)) {
-		p = isl_printer_end_line(p);
-		p = isl_printer_indent(p, 2);
-		p = isl_ast_node_print(node, p,
-					isl_ast_print_options_copy(options));
-		p = isl_printer_indent(p, -2);
-		return p;
+	for (i = 0; i < lin->n; ++i)
+		if (ast_expr_equal(lin->term[i], expr))
+			break;
+	if (i == lin->n) {
+		if (lin->n >= lin->size)
+			isl_die(isl_ast_expr_get_ctx(expr), isl_error_internal,
+				"too many terms", return -1);
+		lin->term[lin->n] = expr;
+		lin->coef[lin->n] = isl_val_zero(isl_val_get_ctx(f));
+		lin->n++;
 	}
+	lin->coef[i] = isl_val_add(lin->coef[i], isl_val_copy(f));
+	return lin->coef[i] ? 0 : -1;
+}
 
-	p = isl_printer_print_str(p, " {");
-	p = isl_printer_end_line(p);
-	p = isl_printer_indent(p, 2);
-	p = print_ast_node_c(p, node, options, 1, 0);
-	p = isl_printer_indent(p, -2);
-	p = isl_printer_start_line(p);
-	p = isl_printer_print_str(p, "}");
-	if (else_node) {
-		if (else_node->type == isl_ast_node_if) {
-			p = isl_printer_print_str(p, " else ");
-			p = print_if_c(p, else_node, options, 0);
-		} else {
-			p = isl_printer_print_str(p, " else");
-			p = print_body_c(p, else_node, NULL, options);
+/* Add "expr" multiplied by "f" to "lin".
+ * Subexpressions that are not sums, differences, negations or
+ * multiplications by an integer are treated as opaque terms.
+ */
+static int ast_lin_add(struct isl_ast_lin *lin, __isl_keep isl_ast_expr *expr,
+	__isl_keep isl_val *f)
+{
+	int r;
+	isl_val *v;
+	isl_ast_expr *arg0, *arg1;
+
+	if (expr->type == isl_ast_expr_int) {
+		v = isl_val_mul(isl_val_copy(expr->u.v), isl_val_copy(f));
+		lin->cst = isl_val_add(lin->cst, v);
+		return lin->cst ? 0 : -1;
+	}
+	if (expr->type != isl_ast_expr_op)
+		return ast_lin_add_term(lin, expr, f);
+
+	arg0 = expr->u.op.args[0];
+	arg1 = expr->u.op.n_arg > 1 ? expr->u.op.args[1] : NULL;
+	switch (expr->u.op.op) {
+	case isl_ast_op_add:
+		if (ast_lin_add(lin, arg0, f) < 0)
+			return -1;
+		return ast_lin_add(lin, arg1, f);
+	case isl_ast_op_sub:
+		if (ast_lin_add(lin, arg0, f) < 0)
+			return -1;
+		v = isl_val_neg(isl_val_copy(f));
+		r = ast_lin_add(lin, arg1, v);
+		isl_val_free(v);
+		return r;
+	case isl_ast_op_minus:
+		v = isl_val_neg(isl_val_copy(f));
+		r = ast_lin_add(lin, arg0, v);
+		isl_val_free(v);
+		return r;
+	case isl_ast_op_mul:
+		if (arg1->type == isl_ast_expr_int) {
+			isl_ast_expr *tmp = arg0;
+			arg0 = arg1;
+			arg1 = tmp;
 		}
-	} else
-		p = isl_printer_end_line(p);
+		if (arg0->type != isl_ast_expr_int)
+			break;
+		v = isl_val_mul(isl_val_copy(arg0->u.v), isl_val_copy(f));
+		r = ast_lin_add(lin, arg1, v);
+		isl_val_free(v);
+		return r;
+	default:
+		break;
+	}
 
-	return p;
+	return ast_lin_add_term(lin, expr, f);
 }
 
-/* Print the start of a compound statement.
+/* Divide all coefficients and the constant of "lin" by "d",
+ * provided they are all divisible by "d".
+ * Return 1 if they are, 0 if they are not and -1 on error.
  */
-static __isl_give isl_printer *start_block(__isl_take isl_printer *p)
+static int ast_lin_div(struct isl_ast_lin *lin, __isl_keep isl_val *d)
 {
-	p = isl_printer_start_line(p);
-	p = isl_printer_print_str(p, "{");
-	p = isl_printer_end_line(p);
-	p = isl_printer_indent(p, 2);
+	int i;
 
-	return p;
+	if (isl_val_is_zero(d))
+		return 0;
+	for (i = 0; i < lin->n; ++i)
+		if (!isl_val_is_divisible_by(lin->coef[i], d))
+			return 0;
+	if (!isl_val_is_divisible_by(lin->cst, d))
+		return 0;
+	for (i = 0; i < lin->n; ++i) {
+		lin->coef[i] = isl_val_div(lin->coef[i], isl_val_copy(d));
+		if (!lin->coef[i])
+			return -1;
+	}
+	lin->cst = isl_val_div(lin->cst, isl_val_copy(d));
+	return lin->cst ? 1 : -1;
 }
 
-/* Print the end of a compound statement.
+/* Divide all coefficients and the constant of "lin" by their
+ * greatest common divisor, if it is greater than one.
+ * Return 0 on success and -1 on error.
  */
-static __isl_give isl_printer *end_block(__isl_take isl_printer *p)
+static int ast_lin_normalize(struct isl_ast_lin *lin)
 {
-	p = isl_printer_indent(p, -2);
-	p = isl_printer_start_line(p);
-	p = isl_printer_print_str(p, "}");
-	p = isl_printer_end_line(p);
+	int i;
+	isl_val *gcd;
 
-	return p;
+	gcd = isl_val_copy(lin->cst);
+	for (i = 0; i < lin->n; ++i)
+		gcd = isl_val_gcd(gcd, isl_val_copy(lin->coef[i]));
+	if (!gcd)
+		return -1;
+	if (!isl_val_is_zero(gcd) && !isl_val_is_one(gcd) &&
+	    ast_lin_div(lin, gcd) < 0) {
+		isl_val_free(gcd);
+		return -1;
+	}
+	isl_val_free(gcd);
+	return 0;
 }
 
-/* Print the for node "node".
- *
- * If the for node is degenerate, it is printed as
- *
- *	type iterator = init;
- *	body
- *
- * Otherwise, it is printed as
- *
- *	for (type iterator = init; cond; iterator += inc)
- *		body
- *
- * "in_block" is set if we are currently inside a block.
- * "in_list" is set if the current node is not alone in the block.
- * If we are not in a block or if the current not is not alone in the block
- * then we print a block around a degenerate for loop such that the variable
- * declaration will not conflict with any potential other declaration
- * of the same variable.
+/* Is "lin" an affine expression, i.e., are all its terms identifiers?
  */
-static __isl_give isl_printer *print_for_c(__isl_take isl_printer *p,
-	__isl_keep isl_ast_node *node,
-	__isl_keep isl_ast_print_options *options, int in_block, int in_list)
+static int ast_lin_is_affine(struct isl_ast_lin *lin)
 {
-	isl_id *id;
-	const char *name;
-	const char *type;
+	int i;
+
+	for (i = 0; i < lin->n; ++i)
+		if (lin->term[i]->type != isl_ast_expr_id)
+			return 0;
+	return 1;
+}
+
+/* Return an expression for "term" multiplied by "c".
+ */
+static __isl_give isl_ast_expr *ast_lin_term(__isl_keep isl_ast_expr *term,
+	__isl_take isl_val *c)
+{
+	isl_ast_expr *expr;
+
+	expr = isl_ast_expr_copy(term);
+	if (isl_val_is_one(c)) {
+		isl_val_free(c);
+		return expr;
+	}
+	return isl_ast_expr_mul(isl_ast_expr_from_val(c), expr);
+}
+
+/* Return an expression for the sum of the terms in "lin" with
+ * a coefficient of sign "sgn" (including the constant term),
+ * with the signs of these coefficients dropped.
+ * If there are no such terms, then return 0.
+ */
+static __isl_give isl_ast_expr *ast_lin_part_to_expr(isl_ctx *ctx,
+	struct isl_ast_lin *lin, int sgn)
+{
+	int i;
+	isl_ast_expr *expr = NULL, *term;
+
+	for (i = 0; i < lin->n; ++i) {
+		if (isl_val_sgn(lin->coef[i]) != sgn)
+			continue;
+		term = ast_lin_term(lin->term[i],
+				    isl_val_abs(isl_val_copy(lin->coef[i])));
+		expr = expr ? isl_ast_expr_add(expr, term) : term;
+	}
+	if (isl_val_sgn(lin->cst) == sgn) {
+		term = isl_ast_expr_from_val(isl_val_abs(isl_val_copy(lin->cst)));
+		expr = expr ? isl_ast_expr_add(expr, term) : term;
+	}
+
+	return expr ? expr : isl_ast_expr_alloc_int_si(ctx, 0);
+}
+
+/* Return an expression for "lin".
+ * The terms with a positive coefficient are printed first.
+ */
+static __isl_give isl_ast_expr *ast_lin_to_expr(isl_ctx *ctx,
+	struct isl_ast_lin *lin)
+{
+	int i;
+	isl_ast_expr *expr = NULL, *term;
+
+	for (i = 0; i < lin->n; ++i) {
+		if (!isl_val_is_pos(lin->coef[i]))
+			continue;
+		term = ast_lin_term(lin->term[i], isl_val_copy(lin->coef[i]));
+		expr = expr ? isl_ast_expr_add(expr, term) : term;
+	}
+	for (i = 0; i < lin->n; ++i) {
+		if (!isl_val_is_neg(lin->coef[i]))
+			continue;
+		term = ast_lin_term(lin->term[i],
+				    isl_val_abs(isl_val_copy(lin->coef[i])));
+		expr = expr ? isl_ast_expr_sub(expr, term) :
+			      isl_ast_expr_neg(term);
+	}
+	if (!expr)
+		return isl_ast_expr_from_val(isl_val_copy(lin->cst));
+	if (isl_val_is_pos(lin->cst))
+		expr = isl_ast_expr_add(expr,
+				isl_ast_expr_from_val(isl_val_copy(lin->cst)));
+	else if (isl_val_is_neg(lin->cst))
+		expr = isl_ast_expr_sub(expr, isl_ast_expr_from_val(
+				isl_val_abs(isl_val_copy(lin->cst))));
+
+	return expr;
+}
+
+/* Return the truth value of the comparison "op" of the constant "cst"
+ * with zero.
+ */
+static int ast_op_cmp_zero(enum isl_ast_op_type op, __isl_keep isl_val *cst)
+{
+	int sgn = isl_val_sgn(cst);
+
+	switch (op) {
+	case isl_ast_op_eq:	return sgn == 0;
+	case isl_ast_op_le:	return sgn <= 0;
+	case isl_ast_op_lt:	return sgn < 0;
+	case isl_ast_op_ge:	return sgn >= 0;
+	case isl_ast_op_gt:	return sgn > 0;
+	default:		return -1;
+	}
+}
+
+/* Simplify the boolean or selection operation "expr",
+ * the argument at position "pos" of which is the integer constant "cond".
+ * Since the arguments do not have any side effects, the other argument
+ * of a boolean operation can be dropped if it does not affect the result.
+ */
+static __isl_give isl_ast_expr *ast_expr_simplify_const_cond(
+	__isl_take isl_ast_expr *expr, int pos, __isl_keep isl_val *cond)
+{
+	isl_ast_expr *res;
+
+	if (pos == 1) {
+		if (expr->u.op.op == isl_ast_op_and ||
+		    expr->u.op.op == isl_ast_op_and_then)
+			pos = isl_val_is_zero(cond) ? 1 : 0;
+		else if (expr->u.op.op == isl_ast_op_or ||
+		    expr->u.op.op == isl_ast_op_or_else)
+			pos = isl_val_is_zero(cond) ? 0 : 1;
+		else
+			return expr;
+		res = isl_ast_expr_copy(expr->u.op.args[pos]);
+		isl_ast_expr_free(expr);
+		return res;
+	}
+
+	switch (expr->u.op.op) {
+	case isl_ast_op_and:
+	case isl_ast_op_and_then:
+		pos = isl_val_is_zero(cond) ? 0 : 1;
+		break;
+	case isl_ast_op_or:
+	case isl_ast_op_or_else:
+		pos = isl_val_is_zero(cond) ? 1 : 0;
+		break;
+	case isl_ast_op_select:
+	case isl_ast_op_cond:
+		pos = isl_val_is_zero(cond) ? 2 : 1;
+		break;
+	default:
+		return expr;
+	}
+
+	res = isl_ast_expr_copy(expr->u.op.args[pos]);
+	isl_ast_expr_free(expr);
+	return res;
+}
+
+/* Simplify the operation "expr", the arguments of which
+ * have already been simplified.
+ *
+ * Sums are collected into a linear combination
+ * such that terms that appear several times are combined.
+ * Comparisons of two such sums are rewritten into
+ * a comparison of the positive and the negative terms of
+ * their difference, or into a constant if this difference is constant.
+ * Integer divisions of affine expressions by an integer are performed
+ * if all coefficients are divisible by the integer.
+ * Boolean and selection operations with a constant condition
+ * are replaced by the selected argument.
+ */
+static __isl_give isl_ast_expr *ast_expr_simplify_op(
+	__isl_take isl_ast_expr *expr)
+{
+	isl_ctx *ctx;
+	struct isl_ast_lin lin;
+	enum isl_ast_op_type op;
+	isl_val *one, *d;
+	isl_ast_expr *res = NULL;
+	int r = 0;
+
+	if (!expr || expr->type != isl_ast_expr_op)
+		return expr;
+
+	ctx = isl_ast_expr_get_ctx(expr);
+	op = expr->u.op.op;
+	if (expr->u.op.args[0]->type == isl_ast_expr_int)
+		expr = ast_expr_simplify_const_cond(expr, 0,
+						    expr->u.op.args[0]->u.v);
+	else if (expr->u.op.n_arg == 2 &&
+		 expr->u.op.args[1]->type == isl_ast_expr_int)
+		expr = ast_expr_simplify_const_cond(expr, 1,
+						    expr->u.op.args[1]->u.v);
+	if (!expr || expr->type != isl_ast_expr_op || expr->u.op.op != op)
+		return expr;
+	if (ast_lin_init(&lin, ctx, ast_expr_size(expr)) < 0)
+		return isl_ast_expr_free(expr);
+	one = isl_val_one(ctx);
+
+	switch (op) {
+	case isl_ast_op_add:
+	case isl_ast_op_sub:
+	case isl_ast_op_minus:
+	case isl_ast_op_mul:
+		r = ast_lin_add(&lin, expr, one);
+		if (r >= 0)
+			res = ast_lin_to_expr(ctx, &lin);
+		break;
+	case isl_ast_op_eq:
+	case isl_ast_op_le:
+	case isl_ast_op_lt:
+	case isl_ast_op_ge:
+	case isl_ast_op_gt:
+		r = ast_lin_add(&lin, expr->u.op.args[0], one);
+		one = isl_val_neg(one);
+		if (r >= 0)
+			r = ast_lin_add(&lin, expr->u.op.args[1], one);
+		if (r >= 0)
+			r = ast_lin_normalize(&lin);
+		if (r >= 0 && lin.n == 0)
+			res = isl_ast_expr_alloc_int_si(ctx,
+					    ast_op_cmp_zero(op, lin.cst));
+		else if (r >= 0)
+			res = isl_ast_expr_alloc_binary(op,
+					ast_lin_part_to_expr(ctx, &lin, 1),
+					ast_lin_part_to_expr(ctx, &lin, -1));
+		break;
+	case isl_ast_op_div:
+	case isl_ast_op_fdiv_q:
+	case isl_ast_op_pdiv_q:
+	case isl_ast_op_pdiv_r:
+		if (expr->u.op.args[1]->type != isl_ast_expr_int)
+			break;
+		d = expr->u.op.args[1]->u.v;
+		if (isl_val_is_zero(d))
+			break;
+		r = ast_lin_add(&lin, expr->u.op.args[0], one);
+		if (r >= 0 && lin.n == 0) {
+			isl_val *v = isl_val_copy(lin.cst);
+			if (op == isl_ast_op_pdiv_r)
+				v = isl_val_mod(v, isl_val_copy(d));
+			else
+				v = isl_val_floor(isl_val_div(v,
+							isl_val_copy(d)));
+			res = isl_ast_expr_from_val(v);
+			break;
+		}
+		if (r < 0 || !ast_lin_is_affine(&lin))
+			break;
+		r = ast_lin_div(&lin, d);
+		if (r > 0 && op == isl_ast_op_pdiv_r)
+			res = isl_ast_expr_alloc_int_si(ctx, 0);
+		else if (r > 0)
+			res = ast_lin_to_expr(ctx, &lin);
+		break;
+	default:
+		break;
+	}
+
+	isl_val_free(one);
+	ast_lin_free(&lin);
+
+	if (r < 0)
+		return isl_ast_expr_free(expr);
+	if (!res)
+		return expr;
+	isl_ast_expr_free(expr);
+	return res;
+}
+
+/* Does "expr" involve the identifier "id"?
+ */
+static int ast_expr_involves_id(__isl_keep isl_ast_expr *expr,
+	__isl_keep isl_id *id)
+{
+	int i;
+
+	if (expr->type == isl_ast_expr_id)
+		return expr->u.id == id;
+	if (expr->type != isl_ast_expr_op)
+		return 0;
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		if (ast_expr_involves_id(expr->u.op.args[i], id))
+			return 1;
+	return 0;
+}
+
+/* Replace each occurrence of the identifier "id" in "expr" by "value".
+ * The operations involving "id" are simplified after the substitution.
+ */
+static __isl_give isl_ast_expr *ast_expr_substitute(
+	__isl_take isl_ast_expr *expr, __isl_keep isl_id *id,
+	__isl_keep isl_ast_expr *value)
+{
+	int i;
+
+	if (!expr)
+		return NULL;
+	if (!ast_expr_involves_id(expr, id))
+		return expr;
+
+	switch (expr->type) {
+	case isl_ast_expr_id:
+		if (expr->u.id != id)
+			return expr;
+		isl_ast_expr_free(expr);
+		return isl_ast_expr_copy(value);
+	case isl_ast_expr_op:
+		expr = isl_ast_expr_cow(expr);
+		if (!expr)
+			return NULL;
+		for (i = 0; i < expr->u.op.n_arg; ++i) {
+			expr->u.op.args[i] = ast_expr_substitute(
+					    expr->u.op.args[i], id, value);
+			if (!expr->u.op.args[i])
+				return isl_ast_expr_free(expr);
+		}
+		return ast_expr_simplify_op(expr);
+	default:
+		return expr;
+	}
+}
+
+/* Add "node" to "list".  If "node" is a block, then add its children
+ * instead.
+ */
+static __isl_give isl_ast_node_list *ast_node_list_add_flat(
+	__isl_take isl_ast_node_list *list, __isl_take isl_ast_node *node)
+{
+	isl_ast_node_list *children;
+
+	if (!node || node->type != isl_ast_node_block)
+		return isl_ast_node_list_add(list, node);
+
+	children = isl_ast_node_list_copy(node->u.b.children);
+	isl_ast_node_free(node);
+	return isl_ast_node_list_concat(list, children);
+}
+
+/* Replace the if node "node" with a constant guard by the branch
+ * selected by this guard.  If the guard is false and there is
+ * no else branch, then "node" is replaced by an empty block.
+ */
+static __isl_give isl_ast_node *ast_node_if_select(
+	__isl_take isl_ast_node *node)
+{
+	isl_ast_node *branch;
+
+	if (!isl_val_is_zero(node->u.i.guard->u.v))
+		branch = isl_ast_node_copy(node->u.i.then);
+	else if (node->u.i.else_node)
+		branch = isl_ast_node_copy(node->u.i.else_node);
+	else
+		branch = isl_ast_node_alloc_block(
+				isl_ast_node_list_alloc(node->ctx, 0));
+	isl_ast_node_free(node);
+	return branch;
+}
+
+/* Replace each occurrence of the identifier "id" in the expressions
+ * of "node" and its descendants by "value".
+ * If conditions become constant as a result, then the corresponding
+ * if nodes are replaced by the selected branch.
+ * Blocks that appear as children of blocks are flattened.
+ */
+static __isl_give isl_ast_node *ast_node_substitute(
+	__isl_take isl_ast_node *node, __isl_keep isl_id *id,
+	__isl_keep isl_ast_expr *value)
+{
+	int i, n;
+	isl_ast_node_list *list;
+
+	node = isl_ast_node_cow(node);
+	if (!node)
+		return NULL;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		node->u.f.init = ast_expr_substitute(node->u.f.init, id, value);
+		node->u.f.body = ast_node_substitute(node->u.f.body, id, value);
+		if (!node->u.f.init || !node->u.f.body)
+			return isl_ast_node_free(node);
+		if (node->u.f.degenerate)
+			break;
+		node->u.f.cond = ast_expr_substitute(node->u.f.cond, id, value);
+		node->u.f.inc = ast_expr_substitute(node->u.f.inc, id, value);
+		if (!node->u.f.cond || !node->u.f.inc)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_if:
+		node->u.i.guard = ast_expr_substitute(node->u.i.guard,
+							id, value);
+		node->u.i.then = ast_node_substitute(node->u.i.then, id, value);
+		if (node->u.i.else_node)
+			node->u.i.else_node = ast_node_substitute(
+					    node->u.i.else_node, id, value);
+		if (!node->u.i.guard || !node->u.i.then)
+			return isl_ast_node_free(node);
+		if (node->u.i.guard->type == isl_ast_expr_int)
+			return ast_node_if_select(node);
+		break;
+	case isl_ast_node_block:
+		list = node->u.b.children;
+		n = isl_ast_node_list_n_ast_node(list);
+		node->u.b.children = isl_ast_node_list_alloc(node->ctx, n);
+		for (i = 0; i < n; ++i) {
+			isl_ast_node *child;
+
+			child = isl_ast_node_list_get_ast_node(list, i);
+			child = ast_node_substitute(child, id, value);
+			node->u.b.children = ast_node_list_add_flat(
+						node->u.b.children, child);
+		}
+		isl_ast_node_list_free(list);
+		if (!node->u.b.children)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_user:
+		node->u.e.expr = ast_expr_substitute(node->u.e.expr, id, value);
+		if (!node->u.e.expr)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_error:
+		break;
+	}
+
+	return node;
+}
+
+/* Is "expr" an operation that is relatively expensive to evaluate and
+ * that is therefore worth hoisting out of a loop?
+ */
+static int is_expensive_op(__isl_keep isl_ast_expr *expr)
+{
+	if (expr->type != isl_ast_expr_op)
+		return 0;
+
+	switch (expr->u.op.op) {
+	case isl_ast_op_max:
+	case isl_ast_op_min:
+	case isl_ast_op_div:
+	case isl_ast_op_fdiv_q:
+	case isl_ast_op_pdiv_q:
+	case isl_ast_op_pdiv_r:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Does "list" contain the identifier "id"?
+ */
+static int id_list_contains(__isl_keep isl_id_list *list, __isl_keep isl_id *id)
+{
+	int i, n;
+
+	n = isl_id_list_n_id(list);
+	for (i = 0; i < n; ++i) {
+		isl_id *id_i = isl_id_list_get_id(list, i);
+		isl_id_free(id_i);
+		if (id_i == id)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Does "expr" involve any of the identifiers in "list"?
+ */
+static int ast_expr_involves_any_id(__isl_keep isl_ast_expr *expr,
+	__isl_keep isl_id_list *list)
+{
+	int i;
+
+	if (expr->type == isl_ast_expr_id)
+		return id_list_contains(list, expr->u.id);
+	if (expr->type != isl_ast_expr_op)
+		return 0;
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		if (ast_expr_involves_any_id(expr->u.op.args[i], list))
+			return 1;
+	return 0;
+}
+
+/* Add the identifiers in "expr" to "list".
+ */
+static __isl_give isl_id_list *ast_expr_collect_ids(
+	__isl_keep isl_ast_expr *expr, __isl_take isl_id_list *list)
+{
+	int i;
+
+	if (!expr)
+		return list;
+	if (expr->type == isl_ast_expr_id)
+		return isl_id_list_add(list, isl_id_copy(expr->u.id));
+	if (expr->type != isl_ast_expr_op)
+		return list;
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		list = ast_expr_collect_ids(expr->u.op.args[i], list);
+	return list;
+}
+
+/* Add the identifiers in the expressions of "node" and its descendants
+ * to "list".  If "iterators" is set, then only add the iterators
+ * of the for nodes.
+ */
+static __isl_give isl_id_list *ast_node_collect_ids(
+	__isl_keep isl_ast_node *node, __isl_take isl_id_list *list,
+	int iterators)
+{
+	int i, n;
+
+	if (!node)
+		return list;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		list = ast_expr_collect_ids(node->u.f.iterator, list);
+		if (!iterators) {
+			list = ast_expr_collect_ids(node->u.f.init, list);
+			list = ast_expr_collect_ids(node->u.f.cond, list);
+			list = ast_expr_collect_ids(node->u.f.inc, list);
+		}
+		return ast_node_collect_ids(node->u.f.body, list, iterators);
+	case isl_ast_node_if:
+		if (!iterators)
+			list = ast_expr_collect_ids(node->u.i.guard, list);
+		list = ast_node_collect_ids(node->u.i.then, list, iterators);
+		return ast_node_collect_ids(node->u.i.else_node, list,
+						iterators);
+	case isl_ast_node_block:
+		n = isl_ast_node_list_n_ast_node(node->u.b.children);
+		for (i = 0; i < n; ++i)
+			list = ast_node_collect_ids(node->u.b.children->p[i],
+							list, iterators);
+		return list;
+	case isl_ast_node_user:
+		if (!iterators)
+			list = ast_expr_collect_ids(node->u.e.expr, list);
+		return list;
+	default:
+		return list;
+	}
+}
+
+/* Add the maximal expensive subexpressions of "expr" that do not
+ * involve any of the identifiers in "bound" to "list",
+ * provided they do not appear in "list" already.
+ */
+static __isl_give isl_ast_expr_list *ast_expr_collect_invariant(
+	__isl_keep isl_ast_expr *expr, __isl_keep isl_id_list *bound,
+	__isl_take isl_ast_expr_list *list)
+{
+	int i, n;
+
+	if (!expr || !list || expr->type != isl_ast_expr_op)
+		return list;
+
+	if (is_expensive_op(expr) && !ast_expr_involves_any_id(expr, bound)) {
+		n = isl_ast_expr_list_n_ast_expr(list);
+		for (i = 0; i < n; ++i)
+			if (ast_expr_equal(list->p[i], expr))
+				return list;
+		return isl_ast_expr_list_add(list, isl_ast_expr_copy(expr));
+	}
+
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		list = ast_expr_collect_invariant(expr->u.op.args[i],
+							bound, list);
+	return list;
+}
+
+/* Add the maximal expensive subexpressions of the expressions
+ * in "node" and its descendants that do not involve any of
+ * the identifiers in "bound" to "list".
+ */
+static __isl_give isl_ast_expr_list *ast_node_collect_invariant(
+	__isl_keep isl_ast_node *node, __isl_keep isl_id_list *bound,
+	__isl_take isl_ast_expr_list *list)
+{
+	int i, n;
+
+	if (!node)
+		return list;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		list = ast_expr_collect_invariant(node->u.f.init, bound, list);
+		list = ast_expr_collect_invariant(node->u.f.cond, bound, list);
+		list = ast_expr_collect_invariant(node->u.f.inc, bound, list);
+		return ast_node_collect_invariant(node->u.f.body, bound, list);
+	case isl_ast_node_if:
+		list = ast_expr_collect_invariant(node->u.i.guard, bound, list);
+		list = ast_node_collect_invariant(node->u.i.then, bound, list);
+		return ast_node_collect_invariant(node->u.i.else_node,
+						    bound, list);
+	case isl_ast_node_block:
+		n = isl_ast_node_list_n_ast_node(node->u.b.children);
+		for (i = 0; i < n; ++i)
+			list = ast_node_collect_invariant(
+				    node->u.b.children->p[i], bound, list);
+		return list;
+	case isl_ast_node_user:
+		return ast_expr_collect_invariant(node->u.e.expr, bound, list);
+	default:
+		return list;
+	}
+}
+
+/* Is "expr" a minimum or maximum with more arguments than "pattern"
+ * such that "pattern" is the same operation on the initial
+ * arguments of "expr"?
+ * Since a minimum or maximum with more than two arguments is printed
+ * as a nested sequence of binary operations, "pattern" then appears
+ * as a subexpression in the printed form of "expr".
+ */
+static int ast_expr_has_prefix(__isl_keep isl_ast_expr *expr,
+	__isl_keep isl_ast_expr *pattern)
+{
+	int i;
+
+	if (expr->type != isl_ast_expr_op || pattern->type != isl_ast_expr_op)
+		return 0;
+	if (expr->u.op.op != pattern->u.op.op)
+		return 0;
+	if (expr->u.op.op != isl_ast_op_min && expr->u.op.op != isl_ast_op_max)
+		return 0;
+	if (expr->u.op.n_arg <= pattern->u.op.n_arg)
+		return 0;
+	for (i = 0; i < pattern->u.op.n_arg; ++i)
+		if (!ast_expr_equal(expr->u.op.args[i], pattern->u.op.args[i]))
+			return 0;
+	return 1;
+}
+
+/* Replace the initial arguments of "expr" that form "pattern"
+ * by "id", given that ast_expr_has_prefix(expr, pattern) holds.
+ */
+static __isl_give isl_ast_expr *ast_expr_replace_prefix(
+	__isl_take isl_ast_expr *expr, __isl_keep isl_ast_expr *pattern,
+	__isl_keep isl_id *id)
+{
+	int i, n;
+	isl_ctx *ctx;
+	isl_ast_expr *res;
+
+	ctx = isl_ast_expr_get_ctx(expr);
+	n = expr->u.op.n_arg - pattern->u.op.n_arg;
+	res = isl_ast_expr_alloc_op(ctx, expr->u.op.op, 1 + n);
+	if (!res)
+		return isl_ast_expr_free(expr);
+	res->u.op.args[0] = isl_ast_expr_from_id(isl_id_copy(id));
+	for (i = 0; i < n; ++i)
+		res->u.op.args[1 + i] = isl_ast_expr_copy(
+			    expr->u.op.args[pattern->u.op.n_arg + i]);
+	isl_ast_expr_free(expr);
+	for (i = 0; i < 1 + n; ++i)
+		if (!res->u.op.args[i])
+			return isl_ast_expr_free(res);
+
+	return res;
+}
+
+/* Does "expr" contain a subexpression that is equal to "pattern"?
+ */
+static int ast_expr_contains(__isl_keep isl_ast_expr *expr,
+	__isl_keep isl_ast_expr *pattern)
+{
+	int i;
+
+	if (ast_expr_equal(expr, pattern) || ast_expr_has_prefix(expr, pattern))
+		return 1;
+	if (expr->type != isl_ast_expr_op)
+		return 0;
+	for (i = 0; i < expr->u.op.n_arg; ++i)
+		if (ast_expr_contains(expr->u.op.args[i], pattern))
+			return 1;
+	return 0;
+}
+
+/* Replace each subexpression of "expr" that is equal to "pattern"
+ * by "id", including those that are formed by the initial arguments
+ * of a minimum or maximum.
+ */
+static __isl_give isl_ast_expr *ast_expr_replace(__isl_take isl_ast_expr *expr,
+	__isl_keep isl_ast_expr *pattern, __isl_keep isl_id *id)
+{
+	int i;
+
+	if (!expr)
+		return NULL;
+	if (!ast_expr_contains(expr, pattern))
+		return expr;
+	if (ast_expr_equal(expr, pattern)) {
+		isl_ast_expr_free(expr);
+		return isl_ast_expr_from_id(isl_id_copy(id));
+	}
+	if (ast_expr_has_prefix(expr, pattern))
+		expr = ast_expr_replace_prefix(expr, pattern, id);
+
+	expr = isl_ast_expr_cow(expr);
+	if (!expr)
+		return NULL;
+	for (i = 0; i < expr->u.op.n_arg; ++i) {
+		expr->u.op.args[i] = ast_expr_replace(expr->u.op.args[i],
+							pattern, id);
+		if (!expr->u.op.args[i])
+			return isl_ast_expr_free(expr);
+	}
+
+	return expr;
+}
+
+/* Replace each subexpression of the expressions in "node"
+ * and its descendants that is equal to "pattern" by "id".
+ */
+static __isl_give isl_ast_node *ast_node_replace(__isl_take isl_ast_node *node,
+	__isl_keep isl_ast_expr *pattern, __isl_keep isl_id *id)
+{
+	int i, n;
+
+	node = isl_ast_node_cow(node);
+	if (!node)
+		return NULL;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		node->u.f.init = ast_expr_replace(node->u.f.init, pattern, id);
+		node->u.f.body = ast_node_replace(node->u.f.body, pattern, id);
+		if (!node->u.f.init || !node->u.f.body)
+			return isl_ast_node_free(node);
+		if (node->u.f.degenerate)
+			break;
+		node->u.f.cond = ast_expr_replace(node->u.f.cond, pattern, id);
+		node->u.f.inc = ast_expr_replace(node->u.f.inc, pattern, id);
+		if (!node->u.f.cond || !node->u.f.inc)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_if:
+		node->u.i.guard = ast_expr_replace(node->u.i.guard, pattern, id);
+		node->u.i.then = ast_node_replace(node->u.i.then, pattern, id);
+		if (node->u.i.else_node)
+			node->u.i.else_node = ast_node_replace(
+					    node->u.i.else_node, pattern, id);
+		if (!node->u.i.guard || !node->u.i.then)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_block:
+		n = isl_ast_node_list_n_ast_node(node->u.b.children);
+		for (i = 0; i < n; ++i) {
+			isl_ast_node *child;
+
+			child = isl_ast_node_list_get_ast_node(
+						node->u.b.children, i);
+			child = ast_node_replace(child, pattern, id);
+			node->u.b.children = isl_ast_node_list_set_ast_node(
+						node->u.b.children, i, child);
+		}
+		if (!node->u.b.children)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_user:
+		node->u.e.expr = ast_expr_replace(node->u.e.expr, pattern, id);
+		if (!node->u.e.expr)
+			return isl_ast_node_free(node);
+		break;
+	case isl_ast_node_error:
+		break;
+	}
+
+	return node;
+}
+
+/* Internal data structure for isl_ast_node_hoist_invariants.
+ *
+ * "used" contains the identifiers that appear in the AST,
+ * including the temporaries that have been introduced.
+ * "next" is the sequence number of the next temporary.
+ */
+struct isl_ast_hoist_data {
+	isl_id_list *used;
+	int next;
+};
+
+/* Create a fresh identifier for a temporary, the name of which
+ * does not clash with that of any of the identifiers in data->used.
+ */
+static __isl_give isl_id *hoist_fresh_id(isl_ctx *ctx,
+	struct isl_ast_hoist_data *data)
+{
+	int i, n;
+	char name[20];
+	isl_id *id;
+
+	n = isl_id_list_n_id(data->used);
+	do {
+		snprintf(name, sizeof(name), "t%d", data->next++);
+		for (i = 0; i < n; ++i) {
+			const char *used;
+
+			id = isl_id_list_get_id(data->used, i);
+			used = isl_id_get_name(id);
+			isl_id_free(id);
+			if (used && !strcmp(used, name))
+				break;
+		}
+	} while (i < n);
+
+	id = isl_id_alloc(ctx, name, NULL);
+	data->used = isl_id_list_add(data->used, isl_id_copy(id));
+	if (!data->used)
+		return isl_id_free(id);
+	return id;
+}
+
+static __isl_give isl_ast_node *hoist_invariants(__isl_take isl_ast_node *node,
+	struct isl_ast_hoist_data *data);
+
+/* Hoist the invariants out of each of the children of the block "node".
+ */
+static __isl_give isl_ast_node *hoist_invariants_block(
+	__isl_take isl_ast_node *node, struct isl_ast_hoist_data *data)
+{
+	int i, n;
+
+	n = isl_ast_node_list_n_ast_node(node->u.b.children);
+	for (i = 0; i < n; ++i) {
+		isl_ast_node *child;
+
+		child = isl_ast_node_list_get_ast_node(node->u.b.children, i);
+		child = hoist_invariants(child, data);
+		node->u.b.children = isl_ast_node_list_set_ast_node(
+					node->u.b.children, i, child);
+	}
+	if (!node->u.b.children)
+		return isl_ast_node_free(node);
+
+	return node;
+}
+
+/* Hoist the expensive subexpressions of the condition and increment
+ * of the for loop "node" and of the expressions inside "node"
+ * that do not depend on the iterator of "node" or any inner iterator
+ * out of "node".
+ * Each such subexpression is evaluated once in a temporary that
+ * is introduced by a degenerate for node around "node" and
+ * its occurrences inside "node" are replaced by this temporary.
+ *
+ * If one subexpression appears inside another, then the temporary
+ * for the first is also substituted in the remaining subexpressions
+ * and it is defined in a surrounding degenerate for node.
+ * After the hoisting, the body of "node" is handled recursively.
+ */
+static __isl_give isl_ast_node *hoist_invariants_for(
+	__isl_take isl_ast_node *node, struct isl_ast_hoist_data *data)
+{
+	int i, j, n;
+	isl_ctx *ctx;
+	isl_id_list *bound, *temps;
+	isl_ast_expr_list *invariants;
+
+	ctx = isl_ast_node_get_ctx(node);
+	bound = isl_id_list_alloc(ctx, 0);
+	bound = ast_node_collect_ids(node, bound, 1);
+	invariants = isl_ast_expr_list_alloc(ctx, 0);
+	invariants = ast_expr_collect_invariant(node->u.f.cond, bound,
+						invariants);
+	invariants = ast_expr_collect_invariant(node->u.f.inc, bound,
+						invariants);
+	invariants = ast_node_collect_invariant(node->u.f.body, bound,
+						invariants);
+	isl_id_list_free(bound);
+	if (!invariants)
+		return isl_ast_node_free(node);
+
+	n = isl_ast_expr_list_n_ast_expr(invariants);
+	temps = isl_id_list_alloc(ctx, n);
+	for (i = 0; i < n; ++i) {
+		isl_ast_expr *expr;
+		isl_id *id;
+
+		id = hoist_fresh_id(ctx, data);
+		expr = isl_ast_expr_list_get_ast_expr(invariants, i);
+		node->u.f.cond = ast_expr_replace(node->u.f.cond, expr, id);
+		node->u.f.inc = ast_expr_replace(node->u.f.inc, expr, id);
+		node->u.f.body = ast_node_replace(node->u.f.body, expr, id);
+		for (j = i + 1; j < n; ++j) {
+			isl_ast_expr *expr_j;
+
+			expr_j = isl_ast_expr_list_get_ast_expr(invariants, j);
+			expr_j = ast_expr_replace(expr_j, expr, id);
+			invariants = isl_ast_expr_list_set_ast_expr(invariants,
+								j, expr_j);
+		}
+		isl_ast_expr_free(expr);
+		temps = isl_id_list_add(temps, id);
+	}
+
+	node->u.f.body = hoist_invariants(node->u.f.body, data);
+	if (!node->u.f.cond || !node->u.f.inc || !node->u.f.body ||
+	    !temps || !invariants)
+		node = isl_ast_node_free(node);
+
+	for (i = n - 1; i >= 0; --i) {
+		isl_ast_node *temp;
+
+		temp = isl_ast_node_alloc_for(isl_id_list_get_id(temps, i));
+		temp = isl_ast_node_for_mark_degenerate(temp);
+		if (temp) {
+			temp->u.f.init = isl_ast_expr_list_get_ast_expr(
+							invariants, i);
+			if (!temp->u.f.init)
+				temp = isl_ast_node_free(temp);
+		}
+		node = isl_ast_node_for_set_body(temp, node);
+	}
+
+	isl_id_list_free(temps);
+	isl_ast_expr_list_free(invariants);
+
+	return node;
+}
+
+/* Hoist expensive loop invariant subexpressions out of the loops
+ * in "node" (see hoist_invariants_for).
+ * The bodies of degenerate for nodes are handled recursively,
+ * but since they are only executed once, no subexpressions
+ * are hoisted out of them.
+ */
+static __isl_give isl_ast_node *hoist_invariants(__isl_take isl_ast_node *node,
+	struct isl_ast_hoist_data *data)
+{
+	node = isl_ast_node_cow(node);
+	if (!node)
+		return NULL;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		if (!node->u.f.degenerate)
+			return hoist_invariants_for(node, data);
+		node->u.f.body = hoist_invariants(node->u.f.body, data);
+		if (!node->u.f.body)
+			return isl_ast_node_free(node);
+		return node;
+	case isl_ast_node_if:
+		node->u.i.then = hoist_invariants(node->u.i.then, data);
+		if (node->u.i.else_node)
+			node->u.i.else_node = hoist_invariants(
+						node->u.i.else_node, data);
+		if (!node->u.i.then)
+			return isl_ast_node_free(node);
+		return node;
+	case isl_ast_node_block:
+		return hoist_invariants_block(node, data);
+	default:
+		return node;
+	}
+}
+
+/* Hoist expensive subexpressions, i.e., minima, maxima and
+ * integer divisions, that are invariant in a loop out of that loop.
+ * The values of these subexpressions are assigned to temporaries
+ * in degenerate for nodes surrounding the loop.
+ * The names of the temporaries are of the form "t<n>" and are chosen
+ * to be different from the names of the identifiers in "node".
+ */
+__isl_give isl_ast_node *isl_ast_node_hoist_invariants(
+	__isl_take isl_ast_node *node)
+{
+	struct isl_ast_hoist_data data;
+
+	if (!node)
+		return NULL;
+
+	data.next = 0;
+	data.used = isl_id_list_alloc(isl_ast_node_get_ctx(node), 0);
+	data.used = ast_node_collect_ids(node, data.used, 0);
+	if (!data.used)
+		return isl_ast_node_free(node);
+
+	node = hoist_invariants(node, &data);
+
+	isl_id_list_free(data.used);
+
+	return node;
+}
+
+/* Return the value of the iterator of the unrolled for node "node"
+ * in iteration "i", i.e., init + i * inc.
+ */
+static __isl_give isl_ast_expr *unrolled_value(__isl_keep isl_ast_node *node,
+	int i)
+{
+	isl_val *v;
+
+	if (i == 0)
+		return isl_ast_expr_copy(node->u.f.init);
+
+	v = isl_ast_expr_get_val(node->u.f.inc);
+	v = isl_val_mul_ui(v, i);
+	if (node->u.f.init->type == isl_ast_expr_int) {
+		v = isl_val_add(v, isl_ast_expr_get_val(node->u.f.init));
+		return isl_ast_expr_from_val(v);
+	}
+	return isl_ast_expr_add(isl_ast_expr_copy(node->u.f.init),
+				isl_ast_expr_from_val(v));
+}
+
+/* Construct a block containing one copy of the body of the unrolled
+ * for node "node" for each of its iterations, with the iterator
+ * replaced by its value in that iteration.
+ * If the body is itself a block, then its children are added
+ * to the result directly.
+ */
+static __isl_give isl_ast_node *expand_unrolled_for(
+	__isl_keep isl_ast_node *node)
+{
+	int i;
+	isl_ctx *ctx;
+	isl_id *id;
+	isl_ast_node_list *list;
+
+	ctx = isl_ast_node_get_ctx(node);
+	if (node->u.f.inc->type != isl_ast_expr_int)
+		isl_die(ctx, isl_error_internal,
+			"unrolled for node should have constant increment",
+			return NULL);
+
+	id = isl_ast_expr_get_id(node->u.f.iterator);
+	list = isl_ast_node_list_alloc(ctx, node->u.f.n_unrolled);
+	for (i = 0; i < node->u.f.n_unrolled; ++i) {
+		isl_ast_expr *value;
+		isl_ast_node *copy;
+
+		value = unrolled_value(node, i);
+		copy = isl_ast_node_copy(node->u.f.body);
+		copy = ast_node_substitute(copy, id, value);
+		isl_ast_expr_free(value);
+		list = ast_node_list_add_flat(list, copy);
+	}
+	isl_id_free(id);
+
+	return isl_ast_node_alloc_block(list);
+}
+
+/* Is an OpenMP pragma printed in front of the for node "node"?
+ * That is, is the ast_print_omp_pragmas option set and
+ * is "node" either a parallel loop that does not appear inside
+ * another parallel loop or a vectorizable loop?
+ * Degenerate and unrolled for nodes are not printed as loops.
+ */
+static int has_omp_pragma(__isl_keep isl_ast_node *node,
+	__isl_keep isl_ast_print_options *options)
+{
+	if (!isl_options_get_ast_print_omp_pragmas(node->ctx))
+		return 0;
+	if (node->u.f.degenerate || node->u.f.n_unrolled > 0)
+		return 0;
+	if (node->u.f.parallel && !options->in_parallel)
+		return 1;
+	return node->u.f.vectorizable;
+}
+
+/* Do we need to print a block around the body "node" of a for or if node?
+ *
+ * If the node is a block, then we need to print a block.
+ * Also if the node is a degenerate for then we will print it as
+ * an assignment followed by the body of the for loop, so we need a block
+ * as well.  Similarly, an unrolled for node is printed as a sequence
+ * of copies of its body.  Finally, an OpenMP pragma cannot appear
+ * as the body of a for or if statement.
+ */
+static int need_block(__isl_keep isl_ast_node *node,
+	__isl_keep isl_ast_print_options *options)
+{
+	if (node->type == isl_ast_node_block)
+		return 1;
+	if (node->type == isl_ast_node_for && node->u.f.degenerate)
+		return 1;
+	if (node->type == isl_ast_node_for && node->u.f.n_unrolled > 0)
+		return 1;
+	if (node->type == isl_ast_node_for && has_omp_pragma(node, options))
+		return 1;
+	return 0;
+}
+
+static __isl_give isl_printer *print_ast_node_c(__isl_take isl_printer *p,
+	__isl_keep isl_ast_node *node,
+	__isl_keep isl_ast_print_options *options, int in_block, int in_list);
+static __isl_give isl_printer *print_if_c(__isl_take isl_printer *p,
+	__isl_keep isl_ast_node *node,
+	__isl_keep isl_ast_print_options *options, int new_line);
+
+/* Print the body "node" of a for or if node.
+ * If "else_node" is set, then it is printed as well.
+ *
+ * We first check if we need to print out a block.
+ * We always print out a block if there is an else node to make
+ * sure that the else node is matched to the correct if node.
+ *
+ * If the else node is itself an if, then we print it as
+ *
+ *	} else if (..)
+ *
+ * Otherwise the else node is printed as
+ *
+ *	} else
+ *	  node
+ */
+static __isl_give isl_printer *print_body_c(__isl_take isl_printer *p,
+	__isl_keep isl_ast_node *node, __isl_keep isl_ast_node *else_node,
+	__isl_keep isl_ast_print_options *options)
+{
+	if (!node)
+		return isl_printer_free(p);
+
+	if (!else_node && !need_block(node, options)) {
+		p = isl_printer_end_line(p);
+		p = isl_printer_indent(p, 2);
+		p = isl_ast_node_print(node, p,
+					isl_ast_print_options_copy(options));
+		p = isl_printer_indent(p, -2);
+		return p;
+	}
+
+	p = isl_printer_print_str(p, " {");
+	p = isl_printer_end_line(p);
+	p = isl_printer_indent(p, 2);
+	p = print_ast_node_c(p, node, options, 1, 0);
+	p = isl_printer_indent(p, -2);
+	p = isl_printer_start_line(p);
+	p = isl_printer_print_str(p, "}");
+	if (else_node) {
+		if (else_node->type == isl_ast_node_if) {
+			p = isl_printer_print_str(p, " else ");
+			p = print_if_c(p, else_node, options, 0);
+		} else {
+			p = isl_printer_print_str(p, " else");
+			p = print_body_c(p, else_node, NULL, options);
+		}
+	} else
+		p = isl_printer_end_line(p);
+
+	return p;
+}
+
+/* Print the start of a compound statement.
+ */
+static __isl_give isl_printer *start_block(__isl_take isl_printer *p)
+{
+	p = isl_printer_start_line(p);
+	p = isl_printer_print_str(p, "{");
+	p = isl_printer_end_line(p);
+	p = isl_printer_indent(p, 2);
+
+	return p;
+}
+
+/* Print the end of a compound statement.
+ */
+static __isl_give isl_printer *end_block(__isl_take isl_printer *p)
+{
+	p = isl_printer_indent(p, -2);
+	p = isl_printer_start_line(p);
+	p = isl_printer_print_str(p, "}");
+	p = isl_printer_end_line(p);
+
+	return p;
+}
+
+/* Print an OpenMP pragma for the for node "node" if the
+ * ast_print_omp_pragmas option is set and if "node" is parallel
+ * or vectorizable.
+ * Since nested parallel regions are rarely useful, a parallel pragma
+ * is only printed for the outermost parallel loop.  "options" is
+ * therefore updated to reflect that the body of this loop is printed
+ * inside a parallel loop.
+ */
+static __isl_give isl_printer *print_omp_pragma(__isl_take isl_printer *p,
+	__isl_keep isl_ast_node *node, isl_ast_print_options **options)
+{
+	int parallel, simd;
+
+	if (!has_omp_pragma(node, *options))
+		return p;
+
+	parallel = node->u.f.parallel && !(*options)->in_parallel;
+	simd = node->u.f.vectorizable;
+
+	p = isl_printer_start_line(p);
+	p = isl_printer_print_str(p, "#pragma omp");
+	if (parallel)
+		p = isl_printer_print_str(p, " parallel for");
+	if (simd)
+		p = isl_printer_print_str(p, " simd");
+	p = isl_printer_end_line(p);
+
+	if (parallel) {
+		*options = isl_ast_print_options_cow(*options);
+		if (!*options)
+			return isl_printer_free(p);
+		(*options)->in_parallel = 1;
+	}
+
+	return p;
+}
+
+/* Print the for node "node".
+ *
+ * If the for node is degenerate, it is printed as
+ *
+ *	type iterator = init;
+ *	body
+ *
+ * If the for node is unrolled, then it is printed as a sequence
+ * of copies of the body, one for each iteration.
+ *
+ * Otherwise, it is printed as
+ *
+ *	for (type iterator = init; cond; iterator += inc)
+ *		body
+ *
+ * "in_block" is set if we are currently inside a block.
+ * "in_list" is set if the current node is not alone in the block.
+ * If we are not in a block or if the current not is not alone in the block
+ * then we print a block around a degenerate for loop such that the variable
+ * declaration will not conflict with any potential other declaration
+ * of the same variable.
+ */
+static __isl_give isl_printer *print_for_c(__isl_take isl_printer *p,
+	__isl_keep isl_ast_node *node,
+	__isl_keep isl_ast_print_options *options, int in_block, int in_list)
+{
+	isl_id *id;
+	const char *name;
+	const char *type;
+	isl_ast_print_options *body_options;
+
+	if (node->u.f.n_unrolled > 0) {
+		isl_ast_node *block;
+
+		block = expand_unrolled_for(node);
+		if (!block)
+			return isl_printer_free(p);
+		p = print_ast_node_c(p, block, options, in_block, in_list);
+		isl_ast_node_free(block);
+		return p;
+	}
 
 	type = isl_options_get_ast_iterator_type(isl_printer_get_ctx(p));
 	if (!node->u.f.degenerate) {
 		id = isl_ast_expr_get_id(node->u.f.iterator);
 		name = isl_id_get_name(id);
 		isl_id_free(id);
+		body_options = isl_ast_print_options_copy(options);
+		p = print_omp_pragma(p, node, &body_options);
 		p = isl_printer_start_line(p);
 		p = isl_printer_print_str(p, "for (");
 		p = isl_printer_print_str(p, type);
@@ -1449,7 +3568,9 @@ static __isl_give isl_printer *print_for_c(__isl_take isl_printer *p,
 		p = isl_printer_print_str(p, " += ");
 		p = isl_printer_print_ast_expr(p, node->u.f.inc);
 		p = isl_printer_print_str(p, ")");
-		p = print_body_c(p, node->u.f.body, NULL, options);
+		if (body_options)
+			p = print_body_c(p, node->u.f.body, NULL, body_options);
+		isl_ast_print_options_free(body_options);
 	} else {
 		id = isl_ast_expr_get_id(node->u.f.iterator);
 		name = isl_id_get_name(id);
@@ -7,6 +7,11 @@
  * Ecole Normale Superieure, 45 rue d’Ulm, 75230 Paris, France
  */
 
+#include <isl_map_private.h>
+#include <isl_aff_private.h>
+#include <isl_id_private.h>
+#include <isl_union_map_private.h>
+#include <isl_vec_private.h>
 #include <isl/map.h>
 #include <isl/aff.h>
 #include <isl/map.h>
@@ -36,6 +41,36 @@ __isl_give isl_map *isl_ast_build_map_to_iterator(
 	return map;
 }
 
+/* Remove all entries from the gist cache of "build".
+ *
+ * The cached results depend on build->domain and build->values,
+ * so this function needs to be called whenever any of these is modified,
+ * even after a call to isl_ast_build_cow, since the cache may have been
+ * filled in between.  For simplicity, it is also called whenever
+ * build->pending or build->generated is modified.
+ */
+static void clear_gist_cache(__isl_keep isl_ast_build *build)
+{
+	int i;
+	struct isl_ast_build_gist_cache *cache = &build->gist_cache;
+
+	for (i = 0; i < cache->n_set; ++i) {
+		isl_set_free(cache->set_in[i]);
+		isl_set_free(cache->set_out[i]);
+	}
+	for (i = 0; i < cache->n_aff; ++i) {
+		isl_aff_free(cache->aff_in[i]);
+		isl_aff_free(cache->aff_out[i]);
+	}
+	for (i = 0; i < cache->n_pw_aff; ++i) {
+		isl_pw_aff_free(cache->pw_aff_in[i]);
+		isl_pw_aff_free(cache->pw_aff_out[i]);
+	}
+	cache->n_set = cache->next_set = 0;
+	cache->n_aff = cache->next_aff = 0;
+	cache->n_pw_aff = cache->next_pw_aff = 0;
+}
+
 /* Initialize the information derived during the AST generation to default
  * values for a schedule domain in "space".
  *
@@ -64,6 +99,7 @@ static __isl_give isl_ast_build *isl_ast_build_init_derived(
 	build->offsets = isl_multi_aff_zero(isl_space_copy(space));
 	isl_multi_aff_free(build->values);
 	build->values = isl_multi_aff_identity(space);
+	clear_gist_cache(build);
 
 	if (!build->iterators || !build->domain || !build->generated ||
 	    !build->pending || !build->values ||
@@ -178,6 +214,7 @@ __isl_give isl_ast_build *isl_ast_build_dup(__isl_keep isl_ast_build *build)
 	dup->offsets = isl_multi_aff_copy(build->offsets);
 	dup->executed = isl_union_map_copy(build->executed);
 	dup->single_valued = build->single_valued;
+	dup->dependences = isl_union_map_copy(build->dependences);
 	dup->options = isl_union_map_copy(build->options);
 	dup->at_each_domain = build->at_each_domain;
 	dup->at_each_domain_user = build->at_each_domain_user;
@@ -192,12 +229,80 @@ __isl_give isl_ast_build *isl_ast_build_dup(__isl_keep isl_ast_build *build)
 	    !dup->pending || !dup->values ||
 	    !dup->strides || !dup->offsets || !dup->options ||
 	    (build->executed && !dup->executed) ||
+	    (build->dependences && !dup->dependences) ||
 	    (build->value && !dup->value))
 		return isl_ast_build_free(dup);
 
 	return dup;
 }
 
+/* Construct a copy of "list" in "ctx".
+ * This function only reads "list".
+ */
+static __isl_give isl_id_list *id_list_transfer(isl_ctx *ctx,
+	__isl_keep isl_id_list *list)
+{
+	int i;
+	isl_id_list *res;
+
+	if (!list)
+		return NULL;
+
+	res = isl_id_list_alloc(ctx, list->n);
+	for (i = 0; i < list->n; ++i)
+		res = isl_id_list_add(res, isl_id_transfer(ctx, list->p[i]));
+
+	return res;
+}
+
+/* Construct a copy of "build" in "ctx", which may be different
+ * from the context of "build".  This function only reads "build".
+ *
+ * The callbacks and their user pointers are not copied
+ * since they may not be prepared to be called from a different
+ * context.  It is up to the caller to only transfer builds
+ * without any callbacks.
+ * The cached schedule map and gist results are not copied either.
+ */
+__isl_give isl_ast_build *isl_ast_build_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_build *build)
+{
+	isl_ast_build *res;
+
+	if (!build)
+		return NULL;
+
+	res = isl_calloc_type(ctx, isl_ast_build);
+	if (!res)
+		return NULL;
+
+	res->ref = 1;
+	res->outer_pos = build->outer_pos;
+	res->depth = build->depth;
+	res->iterators = id_list_transfer(ctx, build->iterators);
+	res->domain = isl_set_transfer(ctx, build->domain);
+	res->generated = isl_set_transfer(ctx, build->generated);
+	res->pending = isl_set_transfer(ctx, build->pending);
+	res->values = isl_multi_aff_transfer(ctx, build->values);
+	res->value = isl_pw_aff_transfer(ctx, build->value);
+	res->strides = isl_vec_transfer(ctx, build->strides);
+	res->offsets = isl_multi_aff_transfer(ctx, build->offsets);
+	res->executed = isl_union_map_transfer(ctx, build->executed);
+	res->single_valued = build->single_valued;
+	res->dependences = isl_union_map_transfer(ctx, build->dependences);
+	res->options = isl_union_map_transfer(ctx, build->options);
+
+	if (!res->iterators || !res->domain || !res->generated ||
+	    !res->pending || !res->values ||
+	    !res->strides || !res->offsets || !res->options ||
+	    (build->executed && !res->executed) ||
+	    (build->dependences && !res->dependences) ||
+	    (build->value && !res->value))
+		return isl_ast_build_free(res);
+
+	return res;
+}
+
 /* Align the parameters of "build" to those of "model", introducing
  * additional parameters if needed.
  */
@@ -216,10 +321,14 @@ __isl_give isl_ast_build *isl_ast_build_align_params(
 						isl_space_copy(model));
 	build->values = isl_multi_aff_align_params(build->values,
 						isl_space_copy(model));
+	clear_gist_cache(build);
 	build->offsets = isl_multi_aff_align_params(build->offsets,
 						isl_space_copy(model));
 	build->options = isl_union_map_align_params(build->options,
 						isl_space_copy(model));
+	if (build->dependences)
+		build->dependences = isl_union_map_align_params(
+				    build->dependences, isl_space_copy(model));
 	isl_space_free(model);
 
 	if (!build->domain || !build->values || !build->offsets ||
@@ -232,13 +341,20 @@ error:
 	return NULL;
 }
 
+/* Return a version of "build" that can be modified.
+ *
+ * Since the caller is going to modify "build", any cached
+ * gist results may become invalid and are therefore removed.
+ */
 __isl_give isl_ast_build *isl_ast_build_cow(__isl_take isl_ast_build *build)
 {
 	if (!build)
 		return NULL;
 
-	if (build->ref == 1)
+	if (build->ref == 1) {
+		clear_gist_cache(build);
 		return build;
+	}
 	build->ref--;
 	return isl_ast_build_dup(build);
 }
@@ -262,6 +378,8 @@ void *isl_ast_build_free(__isl_take isl_ast_build *build)
 	isl_multi_aff_free(build->schedule_map);
 	isl_union_map_free(build->executed);
 	isl_union_map_free(build->options);
+	isl_union_map_free(build->dependences);
+	clear_gist_cache(build);
 
 	free(build);
 
@@ -292,6 +410,40 @@ error:
 	return isl_ast_build_free(build);
 }
 
+/* Replace build->dependences by "dependences".
+ * The dependences relate elements in the range of the inverse schedule,
+ * i.e., the domain elements of the schedule passed to
+ * isl_ast_build_ast_from_schedule.  They are used to determine
+ * which of the generated for loops are parallel.
+ */
+__isl_give isl_ast_build *isl_ast_build_set_dependences(
+	__isl_take isl_ast_build *build, __isl_take isl_union_map *dependences)
+{
+	build = isl_ast_build_cow(build);
+
+	if (!build || !dependences)
+		goto error;
+
+	isl_union_map_free(build->dependences);
+	build->dependences = dependences;
+
+	return build;
+error:
+	isl_union_map_free(dependences);
+	return isl_ast_build_free(build);
+}
+
+/* Return a copy of the dependences set by isl_ast_build_set_dependences,
+ * or NULL if no dependences have been set.
+ */
+__isl_give isl_union_map *isl_ast_build_get_dependences(
+	__isl_keep isl_ast_build *build)
+{
+	if (!build)
+		return NULL;
+	return isl_union_map_copy(build->dependences);
+}
+
 /* Set the iterators for the next code generation.
  *
  * If we still have some iterators left from the previous code generation
@@ -604,6 +756,7 @@ static __isl_give isl_ast_build *isl_ast_build_init(
 	build->pending = isl_set_intersect_params(isl_set_copy(set),
 						    build->pending);
 	build->generated = isl_set_intersect_params(set, build->generated);
+	clear_gist_cache(build);
 
 	return isl_ast_build_init_derived(build, space);
 error:
@@ -679,6 +832,7 @@ static __isl_give isl_ast_build *update_values(
 	isl_pw_aff_foreach_piece(build->value, &extract_single_piece, &aff);
 
 	build->values = isl_multi_aff_set_aff(build->values, build->depth, aff);
+	clear_gist_cache(build);
 	if (!build->values)
 		return isl_ast_build_free(build);
 	isl_ast_build_reset_schedule_map(build);
@@ -755,6 +909,7 @@ __isl_give isl_ast_build *isl_ast_build_set_loop_bounds(
 	isl_basic_set_free(bounds);
 
 	build->domain = isl_set_intersect(build->domain, set);
+	clear_gist_cache(build);
 	if (!build->domain || !build->pending || !build->generated)
 		return isl_ast_build_free(build);
 
@@ -787,6 +942,7 @@ __isl_give isl_ast_build *isl_ast_build_set_enforced(
 
 	isl_set_free(build->domain);
 	build->domain = set;
+	clear_gist_cache(build);
 
 	if (!build->domain)
 		return isl_ast_build_free(build);
@@ -810,6 +966,7 @@ static __isl_give isl_ast_build *isl_ast_build_restrict_internal(
 	set = isl_set_compute_divs(set);
 	build->domain = isl_set_intersect(build->domain, set);
 	build->domain = isl_set_coalesce(build->domain);
+	clear_gist_cache(build);
 
 	if (!build->domain)
 		return isl_ast_build_free(build);
@@ -835,6 +992,7 @@ __isl_give isl_ast_build *isl_ast_build_restrict_generated(
 
 	build->generated = isl_set_intersect(build->generated, set);
 	build->generated = isl_set_coalesce(build->generated);
+	clear_gist_cache(build);
 
 	if (!build->generated)
 		return isl_ast_build_free(build);
@@ -860,6 +1018,7 @@ __isl_give isl_ast_build *isl_ast_build_restrict_pending(
 
 	build->pending = isl_set_intersect(build->pending, set);
 	build->pending = isl_set_coalesce(build->pending);
+	clear_gist_cache(build);
 
 	if (!build->pending)
 		return isl_ast_build_free(build);
@@ -1181,6 +1340,7 @@ __isl_give isl_ast_build *isl_ast_build_include_stride(
 
 	build->domain = isl_set_intersect(build->domain, isl_set_copy(set));
 	build->generated = isl_set_intersect(build->generated, set);
+	clear_gist_cache(build);
 	if (!build->domain || !build->generated)
 		return isl_ast_build_free(build);
 
@@ -1498,6 +1658,7 @@ __isl_give isl_ast_build *isl_ast_build_insert_dim(
 	build->offsets = isl_multi_aff_splice(build->offsets, pos, pos, ma);
 	ma = isl_multi_aff_identity(ma_space);
 	build->values = isl_multi_aff_splice(build->values, pos, pos, ma);
+	clear_gist_cache(build);
 	build->options = options_insert_dim(build->options, space, pos);
 
 	if (!build->iterators || !build->domain || !build->generated ||
@@ -1678,6 +1839,7 @@ __isl_give isl_ast_build *isl_ast_build_product(
 						    isl_space_copy(space));
 	embedding = isl_multi_aff_identity(space);
 	build->values = isl_multi_aff_product(build->values, embedding);
+	clear_gist_cache(build);
 
 	space = isl_ast_build_get_space(build, 1);
 	build->options = embed_options(build->options, space);
@@ -1844,20 +2006,116 @@ error:
 	return NULL;
 }
 
+/* Return a copy of "set" that does not share any basic sets with "set".
+ *
+ * Some operations modify the representation of their (shared) inputs
+ * in place, e.g., by sorting the constraints.  The sets in the gist cache
+ * should not be affected by such modifications since the representation
+ * of the result of isl_ast_build_compute_gist depends on that of the input.
+ */
+static __isl_give isl_set *deep_dup(__isl_keep isl_set *set)
+{
+	int i;
+	isl_set *dup;
+
+	if (!set)
+		return NULL;
+	dup = isl_set_alloc_space(isl_set_get_space(set), set->n, set->flags);
+	for (i = 0; i < set->n; ++i)
+		dup = isl_set_add_basic_set(dup, isl_basic_set_dup(set->p[i]));
+	return dup;
+}
+
+/* Return a copy of "pa" that does not share any basic sets with "pa".
+ * See deep_dup.
+ */
+static __isl_give isl_pw_aff *pw_aff_deep_dup(__isl_keep isl_pw_aff *pa)
+{
+	int i;
+
+	pa = isl_pw_aff_dup(pa);
+	if (!pa)
+		return NULL;
+	for (i = 0; i < pa->n; ++i) {
+		isl_set *set = deep_dup(pa->p[i].set);
+		isl_set_free(pa->p[i].set);
+		pa->p[i].set = set;
+		if (!set)
+			return isl_pw_aff_free(pa);
+	}
+
+	return pa;
+}
+
+/* Should the results of simplifications with respect to "build"
+ * be cached in "build"?
+ */
+static int use_gist_cache(__isl_keep isl_ast_build *build)
+{
+	return isl_options_get_ast_build_gist_cache(
+						isl_ast_build_get_ctx(build));
+}
+
 /* Simplify the set "set" based on what we know about
  * the iterators of already generated loops.
  *
  * "set" is assumed to live in the (internal) schedule domain.
+ *
+ * Since the same set is frequently simplified several times
+ * in the same context, we first check whether the result
+ * has been computed before, unless the ast_build_gist_cache
+ * option has been turned off.
+ * Only sets that are represented in exactly the same way are
+ * considered to be the same since the representation of the result
+ * depends on that of the input.
+ * For the same reason, the cache only contains private copies.
  */
 __isl_give isl_set *isl_ast_build_compute_gist(
 	__isl_keep isl_ast_build *build, __isl_take isl_set *set)
 {
-	if (!build)
+	int i, pos;
+	struct isl_ast_build_gist_cache *cache;
+	isl_set *in;
+
+	if (!build || !set)
 		goto error;
 
+	if (!use_gist_cache(build)) {
+		set = isl_set_preimage_multi_aff(set,
+					isl_multi_aff_copy(build->values));
+		return isl_set_gist(set, isl_set_copy(build->domain));
+	}
+
+	cache = &build->gist_cache;
+	for (i = 0; i < cache->n_set; ++i) {
+		int equal = isl_set_plain_is_identical(cache->set_in[i], set);
+		if (equal < 0)
+			goto error;
+		if (equal) {
+			isl_set_free(set);
+			return deep_dup(cache->set_out[i]);
+		}
+	}
+
+	in = deep_dup(set);
 	set = isl_set_preimage_multi_aff(set,
 					isl_multi_aff_copy(build->values));
 	set = isl_set_gist(set, isl_set_copy(build->domain));
+	if (!set) {
+		isl_set_free(in);
+		return NULL;
+	}
+
+	if (cache->n_set < ISL_AST_BUILD_GIST_CACHE_SIZE) {
+		pos = cache->n_set++;
+	} else {
+		pos = cache->next_set;
+		cache->next_set = (pos + 1) % ISL_AST_BUILD_GIST_CACHE_SIZE;
+		isl_set_free(cache->set_in[pos]);
+		isl_set_free(cache->set_out[pos]);
+	}
+	cache->set_in[pos] = in;
+	cache->set_out[pos] = deep_dup(set);
 
 	return set;
 error:
@@ -1888,14 +2146,50 @@ error:
  * the iterators of already generated loops.
  *
  * The domain of "aff" is assumed to live in the (internal) schedule domain.
+ *
+ * We first check whether the result has been computed before.
  */
 __isl_give isl_aff *isl_ast_build_compute_gist_aff(
 	__isl_keep isl_ast_build *build, __isl_take isl_aff *aff)
 {
-	if (!build)
+	int i, pos;
+	struct isl_ast_build_gist_cache *cache;
+	isl_aff *in;
+
+	if (!build || !aff)
 		goto error;
 
+	if (!use_gist_cache(build))
+		return isl_aff_gist(aff, isl_set_copy(build->domain));
+
+	cache = &build->gist_cache;
+	for (i = 0; i < cache->n_aff; ++i) {
+		int equal = isl_aff_plain_is_equal(cache->aff_in[i], aff);
+		if (equal < 0)
+			goto error;
+		if (equal) {
+			isl_aff_free(aff);
+			return isl_aff_copy(cache->aff_out[i]);
+		}
+	}
+
+	in = isl_aff_copy(aff);
 	aff = isl_aff_gist(aff, isl_set_copy(build->domain));
+	if (!aff) {
+		isl_aff_free(in);
+		return NULL;
+	}
+
+	if (cache->n_aff < ISL_AST_BUILD_GIST_CACHE_SIZE) {
+		pos = cache->n_aff++;
+	} else {
+		pos = cache->next_aff;
+		cache->next_aff = (pos + 1) % ISL_AST_BUILD_GIST_CACHE_SIZE;
+		isl_aff_free(cache->aff_in[pos]);
+		isl_aff_free(cache->aff_out[pos]);
+	}
+	cache->aff_in[pos] = in;
+	cache->aff_out[pos] = isl_aff_copy(aff);
 
 	return aff;
 error:
@@ -1907,16 +2201,58 @@ error:
  * the iterators of already generated loops.
  *
  * The domain of "pa" is assumed to live in the (internal) schedule domain.
+ *
+ * We first check whether the result has been computed before.
+ * As in isl_ast_build_compute_gist, the cache only contains private copies
+ * of identically represented inputs.
  */
 __isl_give isl_pw_aff *isl_ast_build_compute_gist_pw_aff(
 	__isl_keep isl_ast_build *build, __isl_take isl_pw_aff *pa)
 {
-	if (!build)
+	int i, pos;
+	struct isl_ast_build_gist_cache *cache;
+	isl_pw_aff *in;
+
+	if (!build || !pa)
 		goto error;
 
+	if (!use_gist_cache(build)) {
+		pa = isl_pw_aff_pullback_multi_aff(pa,
+					isl_multi_aff_copy(build->values));
+		return isl_pw_aff_gist(pa, isl_set_copy(build->domain));
+	}
+
+	cache = &build->gist_cache;
+	for (i = 0; i < cache->n_pw_aff; ++i) {
+		int equal;
+		equal = isl_pw_aff_plain_is_identical(cache->pw_aff_in[i], pa);
+		if (equal < 0)
+			goto error;
+		if (equal) {
+			isl_pw_aff_free(pa);
+			return pw_aff_deep_dup(cache->pw_aff_out[i]);
+		}
+	}
+
+	in = pw_aff_deep_dup(pa);
 	pa = isl_pw_aff_pullback_multi_aff(pa,
 					isl_multi_aff_copy(build->values));
 	pa = isl_pw_aff_gist(pa, isl_set_copy(build->domain));
+	if (!pa) {
+		isl_pw_aff_free(in);
+		return NULL;
+	}
+
+	if (cache->n_pw_aff < ISL_AST_BUILD_GIST_CACHE_SIZE) {
+		pos = cache->n_pw_aff++;
+	} else {
+		pos = cache->next_pw_aff;
+		cache->next_pw_aff = (pos + 1) % ISL_AST_BUILD_GIST_CACHE_SIZE;
+		isl_pw_aff_free(cache->pw_aff_in[pos]);
+		isl_pw_aff_free(cache->pw_aff_out[pos]);
+	}
+	cache->pw_aff_in[pos] = in;
+	cache->pw_aff_out[pos] = pw_aff_deep_dup(pa);
 
 	return pa;
 error:
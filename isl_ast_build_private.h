@@ -13,6 +13,33 @@ enum isl_ast_build_domain_type {
 	separate
 };
 
+#define ISL_AST_BUILD_GIST_CACHE_SIZE	8
+
+/* Previously computed results of isl_ast_build_compute_gist,
+ * isl_ast_build_compute_gist_aff and isl_ast_build_compute_gist_pw_aff.
+ *
+ * For each type, "in" contains the input objects and "out" the
+ * corresponding results.  The number of valid entries is "n_*" and
+ * "next_*" is the position of the entry that will be replaced next
+ * once the cache for that type is full.
+ */
+struct isl_ast_build_gist_cache {
+	int n_set;
+	int next_set;
+	isl_set *set_in[ISL_AST_BUILD_GIST_CACHE_SIZE];
+	isl_set *set_out[ISL_AST_BUILD_GIST_CACHE_SIZE];
+
+	int n_aff;
+	int next_aff;
+	isl_aff *aff_in[ISL_AST_BUILD_GIST_CACHE_SIZE];
+	isl_aff *aff_out[ISL_AST_BUILD_GIST_CACHE_SIZE];
+
+	int n_pw_aff;
+	int next_pw_aff;
+	isl_pw_aff *pw_aff_in[ISL_AST_BUILD_GIST_CACHE_SIZE];
+	isl_pw_aff *pw_aff_out[ISL_AST_BUILD_GIST_CACHE_SIZE];
+};
+
 /* An isl_ast_build represents the context in which AST is being
  * generated.  That is, it (mostly) contains information about outer
  * loops that can be used to simplify inner loops.
@@ -116,6 +143,18 @@ enum isl_ast_build_domain_type {
  * is extended to a single valued inverse schedule.  This is mainly used
  * to avoid an infinite recursion when we fail to detect later on that
  * the extended inverse schedule is single valued.
+ *
+ * "dependences" is the dependence relation set by
+ * isl_ast_build_set_dependences, relating the elements in the range
+ * of the inverse schedule.  It is NULL if no dependences have been set.
+ *
+ * "gist_cache" keeps track of the results of recent calls
+ * to isl_ast_build_compute_gist, isl_ast_build_compute_gist_aff and
+ * isl_ast_build_compute_gist_pw_aff.  These results only depend
+ * on "domain" and "values" and therefore remain valid as long as
+ * these fields (and "pending" and "generated") are not modified.
+ * The cache is cleared whenever any of them is modified,
+ * as well as in isl_ast_build_cow.  It is not copied by isl_ast_build_dup.
  */
 struct isl_ast_build {
 	int ref;
@@ -158,6 +197,10 @@ struct isl_ast_build {
 
 	isl_union_map *executed;
 	int single_valued;
+
+	isl_union_map *dependences;
+
+	struct isl_ast_build_gist_cache gist_cache;
 };
 
 __isl_give isl_ast_build *isl_ast_build_clear_local_info(
@@ -171,6 +214,8 @@ __isl_give isl_ast_build *isl_ast_build_align_params(
 	__isl_take isl_ast_build *build, __isl_take isl_space *model);
 __isl_give isl_ast_build *isl_ast_build_cow(
 	__isl_take isl_ast_build *build);
+__isl_give isl_ast_build *isl_ast_build_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_build *build);
 __isl_give isl_ast_build *isl_ast_build_insert_dim(
 	__isl_take isl_ast_build *build, int pos);
 __isl_give isl_ast_build *isl_ast_build_scale_down(
@@ -191,6 +236,8 @@ __isl_give isl_ast_build *isl_ast_build_set_single_valued(
 	__isl_take isl_ast_build *build, int sv);
 __isl_give isl_set *isl_ast_build_get_domain(
 	__isl_keep isl_ast_build *build);
+__isl_give isl_union_map *isl_ast_build_get_dependences(
+	__isl_keep isl_ast_build *build);
 __isl_give isl_ast_build *isl_ast_build_restrict_generated(
 	__isl_take isl_ast_build *build, __isl_take isl_set *set);
 __isl_give isl_ast_build *isl_ast_build_restrict_pending(
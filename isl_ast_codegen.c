@@ -8,12 +8,17 @@
  */
 
 #include <limits.h>
+#include <time.h>
+#include <isl_map_private.h>
 #include <isl/aff.h>
 #include <isl/set.h>
 #include <isl/ilp.h>
+#include <isl/hash.h>
 #include <isl/union_map.h>
+#include <isl_ctx_private.h>
 #include <isl_sort.h>
 #include <isl_tarjan.h>
+#include <isl_thread.h>
 #include <isl_ast_private.h>
 #include <isl_ast_build_expr.h>
 #include <isl_ast_build_private.h>
@@ -77,6 +82,12 @@ static __isl_give isl_ast_graft_list *generate_next_level(
 static __isl_give isl_ast_graft_list *generate_code(
 	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build,
 	int internal);
+static int is_lazy_unroll_domain(__isl_keep isl_basic_set *bounds,
+	__isl_keep isl_set *domain, __isl_keep isl_ast_build *build);
+static int exact_unroll_count(__isl_keep isl_basic_set *bounds,
+	__isl_keep isl_ast_build *build);
+static __isl_give isl_basic_set_list *do_unroll(__isl_take isl_set *domain,
+	__isl_keep isl_ast_build *build);
 
 /* Generate an AST for a single domain based on
  * the (non single valued) inverse schedule "executed".
@@ -1231,6 +1242,70 @@ static __isl_give isl_ast_graft *refine_generic(
 	return graft;
 }
 
+/* Does the loop at the current depth of "build" carry none of
+ * the dependences set by isl_ast_build_set_dependences?
+ * "executed" is the inverse schedule restricted to the iterations
+ * of this loop.  Return 0 if no dependences have been set.
+ *
+ * The dependences are mapped to the internal schedule space.
+ * The loop is parallel if every pair of dependent iterations that
+ * share the values of the outer schedule dimensions also
+ * share the value of the current dimension.
+ */
+static int is_parallel(__isl_keep isl_union_map *executed,
+	__isl_keep isl_ast_build *build)
+{
+	int i, depth;
+	int empty;
+	isl_space *space;
+	isl_union_map *dep, *schedule;
+	isl_union_set *uset;
+	isl_set *delta, *carried;
+
+	dep = isl_ast_build_get_dependences(build);
+	if (!dep)
+		return build ? 0 : -1;
+
+	schedule = isl_union_map_reverse(isl_union_map_copy(executed));
+	dep = isl_union_map_apply_range(dep, isl_union_map_copy(schedule));
+	dep = isl_union_map_apply_domain(dep, schedule);
+	uset = isl_union_map_deltas(dep);
+	space = isl_ast_build_get_space(build, 1);
+	delta = isl_union_set_extract_set(uset, space);
+	isl_union_set_free(uset);
+
+	depth = isl_ast_build_get_depth(build);
+	for (i = 0; i < depth; ++i)
+		delta = isl_set_fix_si(delta, isl_dim_set, i, 0);
+	carried = isl_set_lower_bound_si(isl_set_copy(delta),
+					isl_dim_set, depth, 1);
+	delta = isl_set_upper_bound_si(delta, isl_dim_set, depth, -1);
+	carried = isl_set_union(carried, delta);
+	empty = isl_set_is_empty(carried);
+	isl_set_free(carried);
+
+	return empty;
+}
+
+/* Mark the for node "node" at the current depth of "build" parallel.
+ * "children" are the grafts generated for the body of "node".
+ * If these do not contain any loops and if the current loop
+ * has unit stride, then "node" is also marked vectorizable.
+ */
+static __isl_give isl_ast_node *mark_parallel(__isl_take isl_ast_node *node,
+	__isl_keep isl_ast_graft_list *children, __isl_keep isl_ast_build *build)
+{
+	int depth, stride, loop;
+
+	depth = isl_ast_build_get_depth(build);
+	stride = isl_ast_build_has_stride(build, depth);
+	loop = isl_ast_graft_list_contains_loop(children);
+	if (stride < 0 || loop < 0)
+		return isl_ast_node_free(node);
+
+	return isl_ast_node_for_mark_parallel(node, !stride && !loop);
+}
+
 /* Create a for node for the current level.
  *
  * Mark the for node degenerate if "degenerate" is set.
@@ -1294,6 +1369,19 @@ static __isl_give isl_ast_node *create_for(__isl_keep isl_ast_build *build,
  * it can be printed as an assignment of the single value to the loop
  * "iterator".
  *
+ * A non-degenerate for node is marked parallel if it does not carry
+ * any of the dependences set by isl_ast_build_set_dependences
+ * (see is_parallel).  It is also marked vectorizable if, moreover,
+ * it has unit stride and the generated children do not contain any loops.
+ *
+ * If "lazy" is set, then "bounds" should be unrolled lazily
+ * (see add_lazy_unrolled_node) and a non-degenerate for node is marked
+ * unrolled if it performs the same number of iterations
+ * for each value of the outer dimensions.  Since the copies of the body
+ * are executed irrespective of the loop condition, the constraints
+ * that are only enforced by the for loop being empty are then
+ * removed from the graft.
+ *
  * If the current level is eliminated, we explicitly plug in the value
  * for the current level found by isl_ast_build_set_loop_bounds in the
  * inverse schedule.  This ensures that if we are working on a slice
@@ -1316,10 +1404,12 @@ static __isl_give isl_ast_node *create_for(__isl_keep isl_ast_build *build,
 static __isl_give isl_ast_graft *create_node_scaled(
 	__isl_take isl_union_map *executed,
 	__isl_take isl_basic_set *bounds, __isl_take isl_set *domain,
-	__isl_take isl_ast_build *build)
+	__isl_take isl_ast_build *build, int lazy)
 {
 	int depth;
 	int degenerate, eliminated;
+	int n_unrolled = 0;
+	int parallel = 0;
 	isl_basic_set *hull;
 	isl_ast_node *node = NULL;
 	isl_ast_graft *graft;
@@ -1342,10 +1432,20 @@ static __isl_give isl_ast_graft *create_node_scaled(
 	eliminated = isl_ast_build_has_affine_value(sub_build, depth);
 	if (degenerate < 0 || eliminated < 0)
 		executed = isl_union_map_free(executed);
+	if (lazy && !degenerate)
+		n_unrolled = exact_unroll_count(bounds, build);
+	if (n_unrolled < 0)
+		executed = isl_union_map_free(executed);
+	if (!degenerate && !n_unrolled)
+		parallel = is_parallel(executed, build);
+	if (parallel < 0)
+		executed = isl_union_map_free(executed);
 	if (eliminated)
 		executed = plug_in_values(executed, sub_build);
 	else
 		node = create_for(build, degenerate);
+	if (n_unrolled > 0)
+		node = isl_ast_node_for_mark_unrolled(node, n_unrolled);
 
 	body_build = isl_ast_build_copy(sub_build);
 	body_build = isl_ast_build_increase_depth(body_build);
@@ -1353,6 +1453,8 @@ static __isl_give isl_ast_graft *create_node_scaled(
 		node = before_each_for(node, body_build);
 	children = generate_next_level(executed,
 				    isl_ast_build_copy(body_build));
+	if (parallel > 0)
+		node = mark_parallel(node, children, build);
 
 	graft = isl_ast_graft_alloc_level(children, build, sub_build);
 	if (!eliminated)
@@ -1363,6 +1465,8 @@ static __isl_give isl_ast_graft *create_node_scaled(
 		graft = refine_degenerate(graft, bounds, build, sub_build);
 	else
 		graft = refine_generic(graft, bounds, domain, build);
+	if (n_unrolled > 0)
+		graft = isl_ast_graft_drop_enforced(graft);
 	if (!eliminated)
 		graft = after_each_for(graft, body_build);
 
@@ -1496,10 +1600,12 @@ static int map_check_scaled(__isl_take isl_map *map, void *user)
  * but this may result in i' taking on larger values than the original i,
  * due to the shift by "f".
  * By constrast, the scaling in (1) can only reduce the (absolute) value "i".
+ *
+ * "lazy" is passed to create_node_scaled.
  */
 static __isl_give isl_ast_graft *create_node(__isl_take isl_union_map *executed,
 	__isl_take isl_basic_set *bounds, __isl_take isl_set *domain,
-	__isl_take isl_ast_build *build)
+	__isl_take isl_ast_build *build, int lazy)
 {
 	struct isl_check_scaled_data data;
 	isl_ctx *ctx;
@@ -1508,11 +1614,11 @@ static __isl_give isl_ast_graft *create_node(__isl_take isl_union_map *executed,
 
 	ctx = isl_ast_build_get_ctx(build);
 	if (!isl_options_get_ast_build_scale_strides(ctx))
-		return create_node_scaled(executed, bounds, domain, build);
+		return create_node_scaled(executed, bounds, domain, build, lazy);
 
 	data.depth = isl_ast_build_get_depth(build);
 	if (!isl_ast_build_has_stride(build, data.depth))
-		return create_node_scaled(executed, bounds, domain, build);
+		return create_node_scaled(executed, bounds, domain, build, lazy);
 
 	offset = isl_ast_build_get_offset(build, data.depth);
 	data.m = isl_ast_build_get_stride(build, data.depth);
@@ -1565,7 +1671,7 @@ static __isl_give isl_ast_graft *create_node(__isl_take isl_union_map *executed,
 	isl_aff_free(offset);
 	isl_val_free(data.m);
 
-	return create_node_scaled(executed, bounds, domain, build);
+	return create_node_scaled(executed, bounds, domain, build, lazy);
 }
 
 /* Add the basic set to the list that "user" points to.
@@ -1602,6 +1708,118 @@ static __isl_give isl_basic_set_list *isl_basic_set_list_from_set(
 	return list;
 }
 
+static __isl_give isl_ast_graft_list *do_add_node(
+	__isl_take isl_ast_graft_list *list, __isl_take isl_union_map *executed,
+	__isl_take isl_basic_set *bounds, __isl_take isl_ast_build *build,
+	int try_lazy);
+
+/* Is "node" a user node or a block of user nodes?
+ */
+static int is_user_sequence(__isl_keep isl_ast_node *node)
+{
+	int i, r;
+
+	if (!node)
+		return -1;
+	if (node->type == isl_ast_node_user)
+		return 1;
+	if (node->type != isl_ast_node_block)
+		return 0;
+	for (i = 0; i < node->u.b.children->n; ++i) {
+		r = is_user_sequence(node->u.b.children->p[i]);
+		if (r < 0 || !r)
+			return r;
+	}
+	return 1;
+}
+
+/* Does "node" produce the same code as unrolling the loop eagerly?
+ *
+ * This is the case if "node" is a for node that has effectively
+ * been marked unrolled, with a constant initial value and a body
+ * that only consists of user statements.
+ * Any guards or inner loops in the body, as well as any non-constant
+ * iterator values, may have been simplified in a different way
+ * if code had been generated for each value separately.
+ */
+static int is_exact_lazy_unroll(__isl_keep isl_ast_node *node)
+{
+	if (!node)
+		return -1;
+	if (node->type != isl_ast_node_for || node->u.f.n_unrolled == 0)
+		return 0;
+	if (node->u.f.init->type != isl_ast_expr_int)
+		return 0;
+	return is_user_sequence(node->u.f.body);
+}
+
+/* Generate code for the schedule domain "bounds", which should be
+ * unrolled lazily, and add the result to "list".
+ * "domain" is the domain of "executed", with inner dimensions
+ * projected out.  "build" does not yet take into account
+ * the strides of "domain".
+ *
+ * We first try to generate a single for node that is marked unrolled,
+ * such that the body only needs to be generated once.
+ * The result is only used if it is equivalent to that of unrolling
+ * the loop eagerly (see is_exact_lazy_unroll).
+ * Otherwise, we fall back to unrolling eagerly, i.e., we split
+ * the domain of "executed" into one basic set per value of the current
+ * dimension, as in compute_unroll_domains, and generate code for each
+ * of them without trying to unroll lazily.
+ * Note that "domain" itself cannot be used for this purpose since
+ * it has been simplified with respect to the build domain and
+ * may therefore no longer have a lower bound on the current dimension.
+ */
+static __isl_give isl_ast_graft_list *add_lazy_unrolled_node(
+	__isl_take isl_ast_graft_list *list, __isl_take isl_union_map *executed,
+	__isl_take isl_basic_set *bounds, __isl_take isl_set *domain,
+	__isl_take isl_ast_build *build)
+{
+	int i, n;
+	int exact;
+	isl_ast_build *sub_build;
+	isl_ast_graft *graft;
+	isl_basic_set_list *slices;
+
+	sub_build = isl_ast_build_copy(build);
+	sub_build = isl_ast_build_detect_strides(sub_build,
+						isl_set_copy(domain));
+	graft = create_node(isl_union_map_copy(executed), bounds,
+				isl_set_copy(domain), sub_build, 1);
+	exact = graft ? is_exact_lazy_unroll(graft->node) : -1;
+	if (exact != 0) {
+		if (exact < 0)
+			graft = isl_ast_graft_free(graft);
+		list = isl_ast_graft_list_add(list, graft);
+		isl_union_map_free(executed);
+		isl_set_free(domain);
+		isl_ast_build_free(build);
+		return list;
+	}
+	isl_ast_graft_free(graft);
+	isl_set_free(domain);
+
+	domain = isl_set_from_union_set(
+				isl_union_map_domain(isl_union_map_copy(executed)));
+	slices = do_unroll(domain, build);
+	if (!slices)
+		list = isl_ast_graft_list_free(list);
+	n = slices ? isl_basic_set_list_n_basic_set(slices) : 0;
+	for (i = 0; i < n; ++i) {
+		isl_basic_set *bset;
+
+		bset = isl_basic_set_list_get_basic_set(slices, i);
+		list = do_add_node(list, isl_union_map_copy(executed), bset,
+				isl_ast_build_copy(build), 0);
+	}
+
+	isl_basic_set_list_free(slices);
+	isl_union_map_free(executed);
+	isl_ast_build_free(build);
+	return list;
+}
+
 /* Generate code for the schedule domain "bounds"
  * and add the result to "list".
  *
@@ -1614,15 +1832,20 @@ static __isl_give isl_basic_set_list *isl_basic_set_list_from_set(
  * so it does not capture any stride constraints.
  * We therefore need to compute that part of the schedule domain that
  * intersects with "bounds" and derive the strides from the result.
+ *
+ * If "try_lazy" is set and "bounds" should be unrolled lazily
+ * (see is_lazy_unroll_domain), then control is passed
+ * to add_lazy_unrolled_node instead.
  */
-static __isl_give isl_ast_graft_list *add_node(
+static __isl_give isl_ast_graft_list *do_add_node(
 	__isl_take isl_ast_graft_list *list, __isl_take isl_union_map *executed,
-	__isl_take isl_basic_set *bounds, __isl_take isl_ast_build *build)
+	__isl_take isl_basic_set *bounds, __isl_take isl_ast_build *build,
+	int try_lazy)
 {
 	isl_ast_graft *graft;
 	isl_set *domain = NULL;
 	isl_union_set *uset;
-	int empty;
+	int empty, lazy = 0;
 
 	uset = isl_union_set_from_basic_set(isl_basic_set_copy(bounds));
 	executed = isl_union_map_intersect_domain(executed, uset);
@@ -1642,10 +1865,17 @@ static __isl_give isl_ast_graft_list *add_node(
 		goto done;
 
 	domain = isl_ast_build_eliminate_inner(build, domain);
+	if (try_lazy)
+		lazy = is_lazy_unroll_domain(bounds, domain, build);
+	if (lazy < 0)
+		goto error;
+	if (lazy)
+		return add_lazy_unrolled_node(list, executed, bounds, domain,
+						build);
 	build = isl_ast_build_detect_strides(build, isl_set_copy(domain));
 
 	graft = create_node(executed, bounds, domain,
-				isl_ast_build_copy(build));
+				isl_ast_build_copy(build), 0);
 	list = isl_ast_graft_list_add(list, graft);
 	isl_ast_build_free(build);
 	return list;
@@ -1659,6 +1889,16 @@ done:
 	return list;
 }
 
+/* Generate code for the schedule domain "bounds"
+ * and add the result to "list".
+ */
+static __isl_give isl_ast_graft_list *add_node(
+	__isl_take isl_ast_graft_list *list, __isl_take isl_union_map *executed,
+	__isl_take isl_basic_set *bounds, __isl_take isl_ast_build *build)
+{
+	return do_add_node(list, executed, bounds, build, 1);
+}
+
 /* Does any element of i follow or coincide with any element of j
  * at the current depth for equal values of the outer dimensions?
  */
@@ -2211,11 +2451,11 @@ static int constraint_find_unroll(__isl_take isl_constraint *c, void *user)
  * upper bound, meaning that "n" would be unbounded) and pick out the
  * best from the remaining ones.
  *
- * If we cannot find a suitable lower bound, then we consider that
- * to be an error.
+ * The lower bound is stored in "lower".  If no suitable lower bound
+ * can be found, then "lower" is set to NULL.
  */
-static __isl_give isl_aff *find_unroll_lower_bound(__isl_keep isl_set *domain,
-	int depth, int *n)
+static int search_unroll_lower_bound(__isl_keep isl_set *domain,
+	int depth, int *n, isl_aff **lower)
 {
 	struct isl_find_unroll_data data = { domain, depth, NULL, n };
 	isl_basic_set *hull;
@@ -2228,14 +2468,150 @@ static __isl_give isl_aff *find_unroll_lower_bound(__isl_keep isl_set *domain,
 
 	isl_basic_set_free(hull);
 
-	if (!data.lower)
+	*lower = data.lower;
+	return 0;
+error:
+	isl_basic_set_free(hull);
+	isl_aff_free(data.lower);
+	*lower = NULL;
+	return -1;
+}
+
+/* Look for a lower bound l(i) on the dimension at "depth"
+ * and a size n such that "domain" is a subset of
+ *
+ *	{ [i] : l(i) <= i_d < l(i) + n }
+ *
+ * as in search_unroll_lower_bound.
+ *
+ * If we cannot find a suitable lower bound, then we consider that
+ * to be an error.
+ */
+static __isl_give isl_aff *find_unroll_lower_bound(__isl_keep isl_set *domain,
+	int depth, int *n)
+{
+	isl_aff *lower;
+
+	if (search_unroll_lower_bound(domain, depth, n, &lower) < 0)
+		return NULL;
+
+	if (!lower)
 		isl_die(isl_set_get_ctx(domain), isl_error_invalid,
 			"cannot find lower bound for unrolling", return NULL);
 
-	return data.lower;
+	return lower;
+}
+
+/* Return the number of iterations of a loop over the current dimension
+ * of "bounds" if this number is the same for all values of the outer
+ * dimensions that satisfy the constraints of "bounds" that do not involve
+ * the current dimension (and the constraints of the build domain).
+ * Otherwise, or if the number of iterations is not greater than one,
+ * return 0.
+ *
+ * The iterations are counted with respect to the stride
+ * at the current depth in "build".
+ * We first look for a lower bound l(i) and a size n such that
+ * (the expansion of) "bounds" is a subset of
+ *
+ *	{ [i] : l(i) <= i_d < l(i) + n }
+ *
+ * and then check that "bounds" also contains all elements of this set
+ * that satisfy the constraints that do not involve i_d.
+ * In this case, a loop over "bounds" performs exactly n iterations
+ * whenever the guard derived from the constraints that do not involve i_d
+ * is satisfied.
+ */
+static int exact_unroll_count(__isl_keep isl_basic_set *bounds,
+	__isl_keep isl_ast_build *build)
+{
+	int depth, n;
+	int exact;
+	isl_aff *lower, *aff;
+	isl_multi_aff *expansion;
+	isl_set *set, *box, *context;
+
+	depth = isl_ast_build_get_depth(build);
+	expansion = isl_ast_build_get_stride_expansion(build);
+	set = isl_set_from_basic_set(isl_basic_set_copy(bounds));
+	set = isl_set_preimage_multi_aff(set, isl_multi_aff_copy(expansion));
+	set = isl_ast_build_eliminate_divs(build, set);
+	context = isl_set_copy(build->domain);
+	context = isl_set_eliminate(context, isl_dim_set, depth, 1);
+	context = isl_set_preimage_multi_aff(context, expansion);
+
+	if (search_unroll_lower_bound(set, depth, &n, &lower) < 0)
+		goto error;
+	if (!lower || n <= 1) {
+		isl_aff_free(lower);
+		isl_set_free(context);
+		isl_set_free(set);
+		return 0;
+	}
+
+	box = isl_set_drop_constraints_involving_dims(isl_set_copy(set),
+							isl_dim_set, depth, 1);
+	box = isl_set_intersect(box, context);
+	aff = isl_aff_neg(isl_aff_copy(lower));
+	aff = isl_aff_add_coefficient_si(aff, isl_dim_in, depth, 1);
+	box = isl_set_add_constraint(box, isl_inequality_from_aff(aff));
+	lower = isl_aff_add_constant_si(lower, n - 1);
+	lower = isl_aff_add_coefficient_si(lower, isl_dim_in, depth, -1);
+	box = isl_set_add_constraint(box, isl_inequality_from_aff(lower));
+
+	exact = isl_set_is_subset(box, set);
+	isl_set_free(box);
+	isl_set_free(set);
+
+	if (exact < 0)
+		return -1;
+	return exact ? n : 0;
 error:
-	isl_basic_set_free(hull);
-	return isl_aff_free(data.lower);
+	isl_set_free(context);
+	isl_set_free(set);
+	return -1;
+}
+
+/* Should the loop over "bounds" at the current depth be unrolled lazily?
+ * "domain" is the corresponding part of the schedule domain,
+ * with inner dimensions projected out.
+ *
+ * A loop is unrolled lazily if the ast_build_lazy_unroll option is set,
+ * if "bounds" lies inside the unroll option domain and if the loop
+ * performs the same number of iterations (greater than one)
+ * for each value of the outer dimensions.
+ * The last condition excludes the individual values produced by do_unroll.
+ * The strides are computed in the same way as in add_lazy_unrolled_node.
+ */
+static int is_lazy_unroll_domain(__isl_keep isl_basic_set *bounds,
+	__isl_keep isl_set *domain, __isl_keep isl_ast_build *build)
+{
+	isl_ctx *ctx;
+	isl_set *option, *set;
+	int subset, n;
+
+	if (!build)
+		return -1;
+	ctx = isl_ast_build_get_ctx(build);
+	if (!isl_options_get_ast_build_lazy_unroll(ctx))
+		return 0;
+
+	option = isl_ast_build_get_option_domain(build, unroll);
+	set = isl_set_from_basic_set(isl_basic_set_copy(bounds));
+	subset = isl_set_is_subset(set, option);
+	isl_set_free(option);
+	isl_set_free(set);
+	if (subset < 0 || !subset)
+		return subset;
+
+	build = isl_ast_build_copy(build);
+	build = isl_ast_build_detect_strides(build, isl_set_copy(domain));
+	n = exact_unroll_count(bounds, build);
+	isl_ast_build_free(build);
+
+	if (n < 0)
+		return -1;
+	return n > 0;
 }
 
 /* Return the constraint
@@ -2340,6 +2716,66 @@ static __isl_give isl_basic_set_list *do_unroll(__isl_take isl_set *domain,
 	return list;
 }
 
+/* Check if the loop over "domain" at the current depth can be unrolled
+ * lazily, i.e., if the ast_build_lazy_unroll option is set and
+ * if "domain" performs the same number of iterations
+ * for each value of the outer dimensions (see exact_unroll_count).
+ * If so, return a list containing a single basic set
+ * representing "domain" with inner dimensions and divs involving
+ * the current dimension eliminated.
+ * Otherwise, return an empty list.
+ *
+ * We only consider domains that can be represented by a single
+ * basic set such that no extra elements need to be considered
+ * when generating code for the whole loop at once.
+ * The strides are computed in the same way as in is_lazy_unroll_domain
+ * such that it will come to the same conclusion.
+ */
+static __isl_give isl_basic_set_list *lazy_unroll_domain(
+	__isl_keep isl_set *domain, __isl_keep isl_ast_build *build)
+{
+	isl_ctx *ctx;
+	isl_basic_set_list *list;
+	isl_basic_set *bset;
+	isl_set *set;
+	int n;
+
+	if (!domain)
+		return NULL;
+
+	ctx = isl_set_get_ctx(domain);
+	list = isl_basic_set_list_alloc(ctx, 1);
+	if (!isl_options_get_ast_build_lazy_unroll(ctx))
+		return list;
+
+	set = isl_ast_build_eliminate(build, isl_set_copy(domain));
+	set = isl_set_coalesce(set);
+	if (!set)
+		return isl_basic_set_list_free(list);
+	if (isl_set_n_basic_set(set) != 1) {
+		isl_set_free(set);
+		return list;
+	}
+	bset = isl_set_simple_hull(set);
+
+	build = isl_ast_build_copy(build);
+	set = isl_ast_build_eliminate_inner(build, isl_set_copy(domain));
+	build = isl_ast_build_detect_strides(build, set);
+	n = exact_unroll_count(bset, build);
+	isl_ast_build_free(build);
+
+	if (n < 0) {
+		isl_basic_set_free(bset);
+		return isl_basic_set_list_free(list);
+	}
+	if (n == 0) {
+		isl_basic_set_free(bset);
+		return list;
+	}
+
+	return isl_basic_set_list_add(list, bset);
+}
+
 /* Data structure for storing the results and the intermediate objects
  * of compute_domains.
  *
@@ -2393,6 +2829,9 @@ struct isl_codegen_domains {
  * We therefore need to break up the unroll option domain before
  * intersecting with class and schedule domain, hoping that the
  * unroll option domain specified by the user is relatively simple.
+ *
+ * If a piece can be unrolled lazily (see lazy_unroll_domain),
+ * then it is not split up into individual values.
  */
 static int compute_unroll_domains(struct isl_codegen_domains *domains,
 	__isl_keep isl_set *domain)
@@ -2427,7 +2866,12 @@ static int compute_unroll_domains(struct isl_codegen_domains *domains,
 			continue;
 		}
 
-		list = do_unroll(unroll_domain, domains->build);
+		list = lazy_unroll_domain(unroll_domain, domains->build);
+		if (list && isl_basic_set_list_n_basic_set(list) == 0) {
+			isl_basic_set_list_free(list);
+			list = do_unroll(unroll_domain, domains->build);
+		} else
+			isl_set_free(unroll_domain);
 		domains->list = isl_basic_set_list_concat(domains->list, list);
 	}
 
@@ -2527,7 +2971,9 @@ static int compute_separate_domain(struct isl_codegen_domains *domains,
  * Otherwise, "class_domain" is the universe domain.
  *
  * We first make sure that the class domain is disjoint from
- * previously considered class domains.
+ * previously considered class domains.  Since the class domains
+ * are usually disjoint already, we only perform the (expensive)
+ * subtraction if this cannot be determined in a cheap way.
  *
  * The separate domains can be computed directly from the "class_domain".
  *
@@ -2557,9 +3003,14 @@ static int compute_partial_domains(struct isl_codegen_domains *domains,
 {
 	isl_basic_set_list *list;
 	isl_set *domain;
+	int disjoint;
 
-	class_domain = isl_set_subtract(class_domain,
-					isl_set_copy(domains->done));
+	disjoint = isl_set_plain_is_disjoint(class_domain, domains->done);
+	if (disjoint < 0)
+		goto error_class;
+	if (!disjoint)
+		class_domain = isl_set_subtract(class_domain,
+						isl_set_copy(domains->done));
 	domains->done = isl_set_union(domains->done,
 					isl_set_copy(class_domain));
 
@@ -2596,39 +3047,229 @@ static int compute_partial_domains(struct isl_codegen_domains *domains,
 	return 0;
 error:
 	isl_set_free(domain);
+error_class:
 	isl_set_free(class_domain);
 	return -1;
 }
 
+/* Split up the domain at the current depth into disjoint
+ * basic sets for which code should be generated separately
+ * for the separation class with (schedule) domain "domain".
+ *
+ * We eliminate inner dimensions from the class domain and
+ * pass control to compute_partial_domains.
+ * The time spent on this class is recorded in the statistics
+ * of the isl_ctx.
+ */
+static int compute_class_domain(struct isl_codegen_domains *domains,
+	__isl_take isl_set *domain)
+{
+	isl_ctx *ctx;
+	clock_t start;
+	double time;
+	int disjoint;
+	int r;
+
+	ctx = isl_ast_build_get_ctx(domains->build);
+	start = clock();
+
+	domain = isl_ast_build_compute_gist(domains->build, domain);
+	domain = isl_ast_build_eliminate(domains->build, domain);
+
+	disjoint = isl_set_plain_is_disjoint(domain, domains->schedule_domain);
+	if (disjoint < 0 || disjoint) {
+		isl_set_free(domain);
+		r = disjoint < 0 ? -1 : 0;
+	} else
+		r = compute_partial_domains(domains, domain);
+
+	time = (double) (clock() - start) / CLOCKS_PER_SEC;
+	ctx->stats->ast_build_n_class++;
+	ctx->stats->ast_build_class_time += time;
+	if (time > ctx->stats->ast_build_class_time_max)
+		ctx->stats->ast_build_class_time_max = time;
+
+	return r;
+}
+
 /* Split up the domain at the current depth into disjoint
  * basic sets for which code should be generated separately
  * for the separation class identified by "pnt".
  *
- * We extract the corresponding class domain from domains->sep_class,
- * eliminate inner dimensions and pass control to compute_partial_domains.
+ * We extract the corresponding class domain from domains->sep_class
+ * and pass control to compute_class_domain.
  */
 static int compute_class_domains(__isl_take isl_point *pnt, void *user)
 {
 	struct isl_codegen_domains *domains = user;
 	isl_set *class_set;
 	isl_set *domain;
-	int disjoint;
 
 	class_set = isl_set_from_point(pnt);
 	domain = isl_map_domain(isl_map_intersect_range(
 				isl_map_copy(domains->sep_class), class_set));
-	domain = isl_ast_build_compute_gist(domains->build, domain);
-	domain = isl_ast_build_eliminate(domains->build, domain);
 
-	disjoint = isl_set_plain_is_disjoint(domain, domains->schedule_domain);
-	if (disjoint < 0)
+	return compute_class_domain(domains, domain);
+}
+
+/* A separation class with value "v" and (schedule) domain "domain".
+ */
+struct isl_codegen_class {
+	isl_val *v;
+	isl_set *domain;
+};
+
+/* Internal data structure for collect_classes and collect_class.
+ *
+ * "table" maps class values to elements of "class".
+ * "class" contains the "n" classes found so far, in the order
+ * in which they were first encountered, and has room for "size" classes.
+ * "fixed" is cleared if any of the basic maps in the separation class
+ * relation does not have a fixed class value.
+ */
+struct isl_codegen_collect_class_data {
+	struct isl_hash_table table;
+	int n;
+	int size;
+	struct isl_codegen_class **class;
+	int fixed;
+};
+
+static int class_has_val(const void *entry, const void *val)
+{
+	const struct isl_codegen_class *class = entry;
+
+	return isl_val_eq(class->v, (isl_val *) val);
+}
+
+/* Add the domain of "bmap" to the domain of the separation class
+ * that "bmap" maps to, creating a new class if needed.
+ * If "bmap" does not map to a single (fixed) class value,
+ * then clear data->fixed and abort the traversal.
+ */
+static int collect_class(__isl_take isl_basic_map *bmap, void *user)
+{
+	struct isl_codegen_collect_class_data *data = user;
+	struct isl_hash_table_entry *entry;
+	struct isl_codegen_class *class;
+	isl_ctx *ctx;
+	isl_val *v;
+	isl_set *domain;
+	uint32_t hash;
+	long num;
+	int nan;
+
+	ctx = isl_basic_map_get_ctx(bmap);
+	v = isl_basic_map_plain_get_val_if_fixed(bmap, isl_dim_out, 1);
+	nan = isl_val_is_nan(v);
+	if (nan < 0 || nan) {
+		isl_val_free(v);
+		isl_basic_map_free(bmap);
+		if (nan)
+			data->fixed = 0;
 		return -1;
-	if (disjoint) {
-		isl_set_free(domain);
-		return 0;
 	}
 
-	return compute_partial_domains(domains, domain);
+	num = isl_val_get_num_si(v);
+	hash = isl_hash_init();
+	hash = isl_hash_builtin(hash, num);
+	entry = isl_hash_table_find(ctx, &data->table, hash,
+				    &class_has_val, v, 1);
+	if (!entry)
+		goto error;
+
+	domain = isl_set_from_basic_set(isl_basic_map_domain(bmap));
+	if (entry->data) {
+		class = entry->data;
+		class->domain = isl_set_union(class->domain, domain);
+		isl_val_free(v);
+		return class->domain ? 0 : -1;
+	}
+
+	if (data->n >= data->size) {
+		int size = 2 * data->size + 1;
+		struct isl_codegen_class **c;
+
+		c = isl_realloc_array(ctx, data->class,
+					struct isl_codegen_class *, size);
+		if (!c)
+			goto error_domain;
+		data->class = c;
+		data->size = size;
+	}
+	class = isl_alloc_type(ctx, struct isl_codegen_class);
+	if (!class)
+		goto error_domain;
+	class->v = v;
+	class->domain = domain;
+	data->class[data->n++] = class;
+	entry->data = class;
+
+	return domain ? 0 : -1;
+error_domain:
+	isl_set_free(domain);
+	isl_val_free(v);
+	return -1;
+error:
+	isl_val_free(v);
+	isl_basic_map_free(bmap);
+	return -1;
+}
+
+/* Split up the domain at the current depth into disjoint
+ * basic sets for which code should be generated separately
+ * for each of the separation classes in domains->sep_class.
+ *
+ * If every basic map in domains->sep_class maps to a single class value,
+ * then we collect the domains of all classes in a single sweep over
+ * these basic maps and handle the classes in the order in which
+ * they appear in domains->sep_class.  This is the same order in which
+ * isl_set_foreach_point would visit the elements of "classes",
+ * but it avoids intersecting the entire domains->sep_class with
+ * each of those elements.
+ * Otherwise, we fall back to enumerating the elements of "classes".
+ *
+ * Return 0 on success and -1 on error.
+ */
+static int compute_all_class_domains(struct isl_codegen_domains *domains,
+	__isl_keep isl_set *classes)
+{
+	struct isl_codegen_collect_class_data data;
+	isl_ctx *ctx;
+	int i, r;
+
+	if (!domains->sep_class)
+		return -1;
+
+	ctx = isl_map_get_ctx(domains->sep_class);
+	data.n = 0;
+	data.size = 0;
+	data.class = NULL;
+	data.fixed = 1;
+	if (isl_hash_table_init(ctx, &data.table, 0) < 0)
+		return -1;
+
+	r = isl_map_foreach_basic_map(domains->sep_class,
+					&collect_class, &data);
+	if (r < 0 && !data.fixed)
+		r = isl_set_foreach_point(classes, &compute_class_domains,
+					domains);
+	else
+		for (i = 0; r >= 0 && i < data.n; ++i) {
+			r = compute_class_domain(domains,
+						data.class[i]->domain);
+			data.class[i]->domain = NULL;
+		}
+
+	for (i = 0; i < data.n; ++i) {
+		isl_val_free(data.class[i]->v);
+		isl_set_free(data.class[i]->domain);
+		free(data.class[i]);
+	}
+	isl_hash_table_clear(&data.table);
+	free(data.class);
+
+	return r;
 }
 
 /* Extract the domains at the current depth that should be atomic,
@@ -2709,7 +3350,7 @@ static __isl_give isl_basic_set_list *compute_domains(
 	domains.executed = executed;
 	domains.done = isl_set_empty(space);
 
-	if (isl_set_foreach_point(classes, &compute_class_domains, &domains) < 0)
+	if (compute_all_class_domains(&domains, classes) < 0)
 		domains.list = isl_basic_set_list_free(domains.list);
 	isl_set_free(classes);
 
@@ -3358,6 +3999,284 @@ static int any_scheduled_after(int i, int j, void *user)
 	return data->group_coscheduled;
 }
 
+/* A component of the graph computed in generate_components
+ * for which code is generated by a worker thread.
+ * The component consists of the "n" domains indexed by
+ * the elements of data->order starting at position "first".
+ * "list" contains the generated grafts in the context of the worker
+ * that handled the component.
+ */
+struct isl_ast_component_task {
+	int first;
+	int n;
+
+	isl_ast_graft_list *list;
+};
+
+/* Internal data structure for generate_components_parallel.
+ *
+ * "domain" and "order" are the arrays of set-map pairs and indices
+ * in the main context, as in generate_components.
+ * "build" is the build in the main context.
+ * "task" contains the "n_task" components.
+ * "next" is the next component that should be handled by a worker and
+ * "stop" is set when a worker has encountered an error.
+ * "lock" protects "next" and "stop".
+ */
+struct isl_ast_components_parallel_data {
+	struct isl_set_map_pair *domain;
+	int *order;
+	isl_ast_build *build;
+
+	int n_task;
+	struct isl_ast_component_task *task;
+
+	struct isl_mutex lock;
+	int next;
+	int stop;
+};
+
+/* A worker thread for generate_components_parallel.
+ *
+ * "ctx" is the private context of the worker and "build" is the copy
+ * of par->build in this context, constructed when the worker
+ * handles its first component.
+ * "r" is the result of the worker.
+ */
+struct isl_ast_component_worker {
+	struct isl_ast_components_parallel_data *par;
+	isl_ctx *ctx;
+	isl_ast_build *build;
+	int r;
+};
+
+/* Generate code for the component of "task" in the context of "worker"
+ * and store the result in task->list.
+ * This performs the same computation as the call to generate_component
+ * in generate_components, but on copies of the domains and
+ * of the build in the context of the worker.
+ */
+static int generate_component_task(struct isl_ast_component_worker *worker,
+	struct isl_ast_component_task *task)
+{
+	int i;
+	isl_ctx *ctx = worker->ctx;
+	struct isl_ast_components_parallel_data *par = worker->par;
+	struct isl_set_map_pair *domain;
+	int *order;
+
+	if (!worker->build)
+		worker->build = isl_ast_build_transfer(ctx, par->build);
+	if (!worker->build)
+		return -1;
+
+	domain = isl_calloc_array(ctx, struct isl_set_map_pair, task->n);
+	order = isl_alloc_array(ctx, int, task->n);
+	if (!domain || !order)
+		goto done;
+
+	for (i = 0; i < task->n; ++i) {
+		struct isl_set_map_pair *pair;
+
+		pair = &par->domain[par->order[task->first + i]];
+		domain[i].set = isl_set_transfer(ctx, pair->set);
+		domain[i].map = isl_map_transfer(ctx, pair->map);
+		order[i] = i;
+		if (!domain[i].set || !domain[i].map)
+			goto done;
+	}
+
+	task->list = generate_component(domain, order, task->n,
+					isl_ast_build_copy(worker->build));
+
+done:
+	for (i = 0; domain && i < task->n; ++i) {
+		isl_set_free(domain[i].set);
+		isl_map_free(domain[i].map);
+	}
+	free(domain);
+	free(order);
+
+	return task->list ? 0 : -1;
+}
+
+/* Repeatedly take the next component from the shared list and
+ * generate code for that component in the context of the worker.
+ */
+static void *component_worker(void *user)
+{
+	struct isl_ast_component_worker *worker = user;
+	struct isl_ast_components_parallel_data *par = worker->par;
+	int r = 0, t;
+
+	while (r >= 0) {
+		isl_mutex_lock(&par->lock);
+		t = par->stop || par->next >= par->n_task ? -1 : par->next++;
+		isl_mutex_unlock(&par->lock);
+		if (t < 0)
+			break;
+
+		r = generate_component_task(worker, &par->task[t]);
+	}
+
+	isl_mutex_lock(&par->lock);
+	if (r < 0)
+		par->stop = 1;
+	isl_mutex_unlock(&par->lock);
+	worker->r = r;
+
+	return NULL;
+}
+
+/* Add the statistics about separation classes collected
+ * in the context of "worker" to those of "ctx".
+ */
+static void add_worker_stats(isl_ctx *ctx,
+	struct isl_ast_component_worker *worker)
+{
+	struct isl_stats *stats = worker->ctx->stats;
+
+	ctx->stats->ast_build_n_class += stats->ast_build_n_class;
+	ctx->stats->ast_build_class_time += stats->ast_build_class_time;
+	if (stats->ast_build_class_time_max >
+	    ctx->stats->ast_build_class_time_max)
+		ctx->stats->ast_build_class_time_max =
+			stats->ast_build_class_time_max;
+}
+
+/* Generate code for each of the "n_task" components in the graph "g"
+ * on the domains in "domain" using (at most) "n_thread" threads and
+ * merge the results in the same way as generate_components.
+ *
+ * The components are independent of each other, so each worker
+ * repeatedly takes the next component and generates code for it
+ * in its own isl_ctx, as in compute_flow_parallel, starting from
+ * a copy of "build" in that context.
+ * After all workers have finished, the grafts are transferred
+ * to the main context and merged in the topological order
+ * of the components, such that the final result is the same
+ * as that of generating code for the components one by one.
+ */
+static __isl_give isl_ast_graft_list *generate_components_parallel(
+	struct isl_set_map_pair *domain, struct isl_tarjan_graph *g,
+	int n_task, __isl_keep isl_ast_build *build, int n_thread)
+{
+	int i, r;
+	isl_ctx *ctx = isl_ast_build_get_ctx(build);
+	struct isl_ast_components_parallel_data par;
+	struct isl_ast_component_worker *worker = NULL;
+	isl_ast_graft_list *list = NULL;
+
+	memset(&par, 0, sizeof(par));
+	par.domain = domain;
+	par.order = g->order;
+	par.build = build;
+	par.task = isl_calloc_array(ctx, struct isl_ast_component_task,
+					n_task);
+	if (!par.task)
+		return NULL;
+	for (i = 0; par.n_task < n_task; ++i) {
+		struct isl_ast_component_task *task = &par.task[par.n_task++];
+
+		task->first = i;
+		while (g->order[i] != -1)
+			++i;
+		task->n = i - task->first;
+	}
+	if (n_thread > n_task)
+		n_thread = n_task;
+
+	worker = isl_calloc_array(ctx, struct isl_ast_component_worker,
+					n_thread);
+	if (!worker)
+		goto done;
+	for (i = 0; i < n_thread; ++i) {
+		worker[i].par = &par;
+		worker[i].ctx = isl_thread_ctx_alloc(ctx);
+		if (!worker[i].ctx)
+			goto done;
+	}
+
+	if (isl_mutex_init(ctx, &par.lock) < 0)
+		goto done;
+	r = isl_thread_run(ctx, n_thread, &component_worker, worker,
+			    sizeof(*worker));
+	isl_mutex_destroy(&par.lock);
+	if (r < 0)
+		goto done;
+
+	for (i = 0; i < n_thread; ++i) {
+		add_worker_stats(ctx, &worker[i]);
+		if (worker[i].r < 0 && r == 0) {
+			isl_thread_report_error(ctx, worker[i].ctx,
+				"AST generation failed in worker");
+			r = -1;
+		}
+	}
+	if (r < 0)
+		goto done;
+
+	list = isl_ast_graft_list_alloc(ctx, 0);
+	for (i = 0; list && i < n_task; ++i) {
+		isl_ast_graft_list *list_c;
+
+		list_c = isl_ast_graft_list_transfer(ctx, par.task[i].list);
+		list = isl_ast_graft_list_merge(list, list_c, build);
+	}
+
+done:
+	for (i = 0; i < n_task; ++i)
+		isl_ast_graft_list_free(par.task[i].list);
+	free(par.task);
+	for (i = 0; worker && i < n_thread; ++i) {
+		isl_ast_build_free(worker[i].build);
+		isl_ctx_free(worker[i].ctx);
+	}
+	free(worker);
+
+	return list;
+}
+
+/* Return the number of strongly connected components
+ * of the graph "g" on "n" nodes.
+ * Each component in g->order is terminated by -1.
+ */
+static int n_component(struct isl_tarjan_graph *g, int n)
+{
+	int i = 0, n_comp = 0;
+
+	while (n) {
+		while (g->order[i] != -1) {
+			++i; --n;
+		}
+		++i;
+		++n_comp;
+	}
+
+	return n_comp;
+}
+
+/* Return the number of threads that should be used for generating
+ * code for the independent components at the current level of "build".
+ *
+ * Multiple threads are only used if the ast_build_parallel_components
+ * option is set and if none of the callbacks of "build" have been set
+ * since those operate on objects in the context of "build" and
+ * may not be prepared to be called from different threads.
+ */
+static int components_n_thread(__isl_keep isl_ast_build *build)
+{
+	isl_ctx *ctx = isl_ast_build_get_ctx(build);
+
+	if (!isl_options_get_ast_build_parallel_components(ctx))
+		return 1;
+	if (build->at_each_domain || build->before_each_for ||
+	    build->after_each_for || build->create_leaf)
+		return 1;
+
+	return isl_thread_n_thread(ctx);
+}
+
 /* Look for independent components at the current depth and generate code
  * for each component separately.  The resulting lists of grafts are
  * merged in an attempt to combine grafts with identical guards.
@@ -3377,13 +4296,26 @@ static int any_scheduled_after(int i, int j, void *user)
  * Since the test is performed on the domain of the inverse schedules of
  * the different domains, we precompute these domains and store
  * them in data.domain.
+ *
+ * If "emit" is not NULL, then the grafts of each component are passed
+ * to "emit" as soon as they have been generated instead of being merged
+ * into the result, which is then simply an empty list.
+ * This means that grafts with identical guards in different components
+ * are not combined, but it allows the caller to release the AST
+ * of a component before the next component is generated.
+ * Otherwise, if there are several components and several threads
+ * may be used, then code for the components is generated
+ * in parallel by generate_components_parallel.
  */
 static __isl_give isl_ast_graft_list *generate_components(
-	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build)
+	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build,
+	int (*emit)(__isl_take isl_ast_graft_list *list, void *user),
+	void *user)
 {
 	int i;
 	isl_ctx *ctx = isl_ast_build_get_ctx(build);
 	int n = isl_union_map_n_map(executed);
+	int n_thread, n_task;
 	struct isl_any_scheduled_after_data data;
 	struct isl_set_map_pair *next;
 	struct isl_tarjan_graph *g = NULL;
@@ -3404,8 +4336,17 @@ static __isl_give isl_ast_graft_list *generate_components(
 	data.depth = isl_ast_build_get_depth(build);
 	data.group_coscheduled = isl_options_get_ast_build_group_coscheduled(ctx);
 	g = isl_tarjan_graph_init(ctx, n, &any_scheduled_after, &data);
+	if (!g)
+		goto error;
 
-	list = isl_ast_graft_list_alloc(ctx, 0);
+	n_thread = emit ? 1 : components_n_thread(build);
+	n_task = n_thread > 1 ? n_component(g, n) : 0;
+	if (n_task > 1) {
+		list = generate_components_parallel(data.domain, g, n_task,
+						    build, n_thread);
+		n = 0;
+	} else
+		list = isl_ast_graft_list_alloc(ctx, 0);
 
 	i = 0;
 	while (list && n) {
@@ -3423,7 +4364,11 @@ static __isl_give isl_ast_graft_list *generate_components(
 		list_c = generate_component(data.domain,
 					    g->order + first, i - first,
 					    isl_ast_build_copy(build));
-		list = isl_ast_graft_list_merge(list, list_c, build);
+		if (emit) {
+			if (emit(list_c, user) < 0)
+				goto error;
+		} else
+			list = isl_ast_graft_list_merge(list, list_c, build);
 
 		++i;
 	}
@@ -3478,7 +4423,39 @@ static __isl_give isl_ast_graft_list *generate_next_level(
 	if (isl_union_map_n_map(executed) == 1)
 		return generate_shifted_component(executed, build);
 
-	return generate_components(executed, build);
+	return generate_components(executed, build, NULL, NULL);
+error:
+	isl_union_map_free(executed);
+	isl_ast_build_free(build);
+	return NULL;
+}
+
+/* Generate code for the outermost level (and all inner levels),
+ * passing the grafts of each independent component at this level
+ * to "emit" as soon as they have been generated.
+ * Return the grafts that have not been passed to "emit".
+ *
+ * This is the same as generate_next_level, except that
+ * generate_components is called in streaming mode.
+ * If there is only a single component, then its grafts are simply returned.
+ */
+static __isl_give isl_ast_graft_list *generate_outer_level_streamed(
+	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build,
+	int (*emit)(__isl_take isl_ast_graft_list *list, void *user),
+	void *user)
+{
+	int depth;
+
+	if (!build || !executed)
+		goto error;
+
+	depth = isl_ast_build_get_depth(build);
+	if (depth >= isl_set_dim(build->domain, isl_dim_set) ||
+	    isl_union_map_n_map(executed) <= 1 ||
+	    isl_union_map_is_empty(executed))
+		return generate_next_level(executed, build);
+
+	return generate_components(executed, build, emit, user);
 error:
 	isl_union_map_free(executed);
 	isl_ast_build_free(build);
@@ -3488,6 +4465,11 @@ error:
 /* Internal data structure used by isl_ast_build_ast_from_schedule.
  * internal, executed and build are the inputs to generate_code.
  * list collects the output.
+ *
+ * If "fn" is set, then the output is not collected in "list",
+ * but the AST nodes are passed to "fn" as soon as they are complete.
+ * "embed" is set if the grafts passed to emit_grafts still need
+ * to be reformulated in terms of the product space.
  */
 struct isl_generate_code_data {
 	int internal;
@@ -3495,8 +4477,43 @@ struct isl_generate_code_data {
 	isl_ast_build *build;
 
 	isl_ast_graft_list *list;
+
+	int (*fn)(__isl_take isl_ast_node *node, void *user);
+	void *user;
+	int embed;
 };
 
+/* Convert the outermost grafts in "list" to AST nodes and
+ * pass each of them to data->fn, after which they are released.
+ * Any pending guards are materialized as if nodes.
+ */
+static int emit_grafts(__isl_take isl_ast_graft_list *list, void *user)
+{
+	struct isl_generate_code_data *data = user;
+	isl_ast_node *node;
+	isl_ast_node_list *node_list;
+	int i, n;
+
+	list = isl_ast_graft_list_unembed(list, data->embed);
+	node = isl_ast_node_from_graft_list(list, data->build);
+	if (!node)
+		return -1;
+	if (isl_ast_node_get_type(node) != isl_ast_node_block)
+		return data->fn(node, data->user);
+
+	node_list = isl_ast_node_block_get_children(node);
+	isl_ast_node_free(node);
+	n = isl_ast_node_list_n_ast_node(node_list);
+	for (i = 0; i < n; ++i) {
+		node = isl_ast_node_list_get_ast_node(node_list, i);
+		if (data->fn(node, data->user) < 0)
+			break;
+	}
+	isl_ast_node_list_free(node_list);
+
+	return i < n ? -1 : 0;
+}
+
 /* Given an inverse schedule in terms of the external build schedule, i.e.,
  *
  *	[E -> S] -> D
@@ -3561,6 +4578,10 @@ static __isl_give isl_union_map *internal_executed(
  * If the original build space was not parametric, we undo the embedding
  * on the resulting isl_ast_node_list so that it can be used within
  * the outer AST build.
+ *
+ * If data->fn is set, then the grafts are passed to emit_grafts
+ * (which takes care of undoing the embedding) instead,
+ * one outermost component at a time.
  */
 static int generate_code_in_space(struct isl_generate_code_data *data,
 	__isl_take isl_set *set, __isl_take isl_space *space)
@@ -3581,6 +4602,19 @@ static int generate_code_in_space(struct isl_generate_code_data *data,
 	build = isl_ast_build_copy(data->build);
 	build = isl_ast_build_product(build, space);
 
+	if (data->fn) {
+		data->embed = embed;
+		list = generate_outer_level_streamed(executed, build,
+							&emit_grafts, data);
+		if (!list)
+			return -1;
+		if (isl_ast_graft_list_n_ast_graft(list) == 0) {
+			isl_ast_graft_list_free(list);
+			return 0;
+		}
+		return emit_grafts(list, data);
+	}
+
 	list = generate_next_level(executed, build);
 
 	list = isl_ast_graft_list_unembed(list, embed);
@@ -3659,10 +4693,14 @@ error:
  *
  * We essentially run over all the spaces in the domain of "executed"
  * and call generate_code_set on each of them.
+ *
+ * If "fn" is not NULL, then the outermost AST nodes are passed to "fn"
+ * as soon as they have been generated and the result is an empty list.
  */
-static __isl_give isl_ast_graft_list *generate_code(
+static __isl_give isl_ast_graft_list *generate_code_streamed(
 	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build,
-	int internal)
+	int internal, int (*fn)(__isl_take isl_ast_node *node, void *user),
+	void *user)
 {
 	isl_ctx *ctx;
 	struct isl_generate_code_data data = { 0 };
@@ -3688,6 +4726,8 @@ static __isl_give isl_ast_graft_list *generate_code(
 	data.executed = executed;
 	data.build = build;
 	data.list = isl_ast_graft_list_alloc(ctx, 0);
+	data.fn = fn;
+	data.user = user;
 
 	universe = isl_union_map_universe(isl_union_map_copy(executed));
 	schedule_domain = isl_union_map_domain(universe);
@@ -3706,6 +4746,17 @@ error:
 	return NULL;
 }
 
+/* Generate an AST that visits the elements in the range of "executed"
+ * in the relative order specified by the corresponding domain element(s).
+ * See generate_code_streamed for more details.
+ */
+static __isl_give isl_ast_graft_list *generate_code(
+	__isl_take isl_union_map *executed, __isl_take isl_ast_build *build,
+	int internal)
+{
+	return generate_code_streamed(executed, build, internal, NULL, NULL);
+}
+
 /* Generate an AST that visits the elements in the domain of "schedule"
  * in the relative order specified by the corresponding image element(s).
  *
@@ -3730,13 +4781,28 @@ error:
  * The main computation is performed on an inverse schedule (with
  * the schedule domain in the domain and the elements to be executed
  * in the range) called "executed".
+ *
+ * If the ast_build_arena option is set, then all AST nodes and expressions
+ * constructed during the generation are allocated from a single arena
+ * such that the resulting AST can be freed in one go
+ * by isl_ast_node_free_tree.
+ *
+ * If the ast_build_hoist_invariants option is set, then loop invariant
+ * minima, maxima and integer divisions are evaluated in temporaries
+ * outside of the loops in which they appear.
  */
 __isl_give isl_ast_node *isl_ast_build_ast_from_schedule(
 	__isl_keep isl_ast_build *build, __isl_take isl_union_map *schedule)
 {
+	isl_ctx *ctx;
 	isl_ast_graft_list *list;
 	isl_ast_node *node;
 	isl_union_map *executed;
+	struct isl_ast_arena *arena = NULL;
+
+	ctx = isl_ast_build_get_ctx(build);
+	if (ctx && isl_options_get_ast_build_arena(ctx))
+		arena = isl_ast_arena_enter(ctx);
 
 	build = isl_ast_build_copy(build);
 	build = isl_ast_build_set_single_valued(build, 0);
@@ -3745,5 +4811,51 @@ __isl_give isl_ast_node *isl_ast_build_ast_from_schedule(
 	node = isl_ast_node_from_graft_list(list, build);
 	isl_ast_build_free(build);
 
+	if (ctx && isl_options_get_ast_build_hoist_invariants(ctx))
+		node = isl_ast_node_hoist_invariants(node);
+
+	isl_ast_arena_leave(arena);
+
 	return node;
 }
+
+/* Generate an AST that visits the elements in the domain of "schedule"
+ * in the relative order specified by the corresponding image element(s),
+ * as in isl_ast_build_ast_from_schedule, but instead of constructing
+ * the complete AST, pass each of the outermost AST nodes to "fn"
+ * as soon as it has been generated.
+ * The sequence of these nodes represents the complete AST.
+ * Only the outermost independent components are passed to "fn"
+ * separately, so the AST of a single component, e.g., a single
+ * outer loop nest, is still constructed completely in memory.
+ *
+ * The outermost nodes of independent components are not merged
+ * with each other, so the result may be less compact than
+ * the one returned by isl_ast_build_ast_from_schedule.
+ */
+int isl_ast_build_foreach_ast_from_schedule(__isl_keep isl_ast_build *build,
+	__isl_take isl_union_map *schedule,
+	int (*fn)(__isl_take isl_ast_node *node, void *user), void *user)
+{
+	isl_ast_graft_list *list;
+	isl_union_map *executed;
+
+	if (!build)
+		goto error;
+	if (!fn)
+		isl_die(isl_ast_build_get_ctx(build), isl_error_invalid,
+			"no callback specified", goto error);
+
+	build = isl_ast_build_copy(build);
+	build = isl_ast_build_set_single_valued(build, 0);
+	executed = isl_union_map_reverse(schedule);
+	list = generate_code_streamed(executed, build, 0, fn, user);
+	if (!list)
+		return -1;
+	isl_ast_graft_list_free(list);
+
+	return 0;
+error:
+	isl_union_map_free(schedule);
+	return -1;
+}
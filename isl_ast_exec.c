@@ -0,0 +1,867 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <stdlib.h>
+#include <isl/ast.h>
+#include <isl_ast_private.h>
+
+/* The operations of the bytecode into which the AST expressions
+ * are compiled.
+ *
+ * The bytecode operates on a stack of machine integers.
+ * isl_ast_exec_op_const pushes the constant in the next code word,
+ * isl_ast_exec_op_load pushes the value of the slot with the index
+ * in the next code word.
+ * isl_ast_exec_op_neg replaces the top of the stack by its negation,
+ * while isl_ast_exec_op_select pops three elements and pushes
+ * the second or the third depending on whether the first is non-zero.
+ * The other operations pop two elements and push the result
+ * of applying the operation to them.
+ * isl_ast_exec_op_ret terminates the evaluation of an expression.
+ */
+enum isl_ast_exec_op {
+	isl_ast_exec_op_ret,
+	isl_ast_exec_op_const,
+	isl_ast_exec_op_load,
+	isl_ast_exec_op_neg,
+	isl_ast_exec_op_add,
+	isl_ast_exec_op_sub,
+	isl_ast_exec_op_mul,
+	isl_ast_exec_op_div,
+	isl_ast_exec_op_fdiv_q,
+	isl_ast_exec_op_pdiv_r,
+	isl_ast_exec_op_min,
+	isl_ast_exec_op_max,
+	isl_ast_exec_op_and,
+	isl_ast_exec_op_or,
+	isl_ast_exec_op_eq,
+	isl_ast_exec_op_le,
+	isl_ast_exec_op_lt,
+	isl_ast_exec_op_ge,
+	isl_ast_exec_op_gt,
+	isl_ast_exec_op_select
+};
+
+/* A compiled AST node.
+ *
+ * "type" is the type of the original AST node.
+ *
+ * For a for node, "slot" is the slot of the iterator and
+ * "init", "cond" and "inc" are the offsets of the compiled
+ * initialization, condition and increment in the code.
+ * "cond" is -1 for degenerate and unrolled for nodes.
+ * "n_unrolled" is the number of iterations of an unrolled for node.
+ * "body" is the index of the compiled body.
+ *
+ * For an if node, "cond" is the offset of the compiled guard and
+ * "body" and "else_node" are the indices of the compiled then and
+ * else branches.  "else_node" is -1 if there is no else branch.
+ *
+ * For a block node, "first" and "n" refer to the sequence of
+ * child indices in the "child" array of the isl_ast_exec.
+ *
+ * For a user node, "first" and "n" refer to the sequence of
+ * offsets of the compiled call arguments in the "arg" array
+ * of the isl_ast_exec and "node" is the original node.
+ */
+struct isl_ast_exec_node {
+	enum isl_ast_node_type type;
+
+	int slot;
+	int init;
+	int cond;
+	int inc;
+	int n_unrolled;
+	int body;
+	int else_node;
+
+	int first;
+	int n;
+
+	isl_ast_node *node;
+};
+
+/* An AST node tree compiled for execution by isl_ast_exec_run.
+ *
+ * "code" contains the bytecode of all expressions,
+ * each terminated by isl_ast_exec_op_ret.
+ * "node" contains the compiled nodes, with the root at position "root".
+ * "child" and "arg" contain the children of the compiled block nodes and
+ * the offsets of the compiled arguments of the compiled user nodes.
+ *
+ * "id" contains the identifiers that appear in the tree and
+ * "val" contains their current values.
+ * "iterator" is set for those identifiers that are bound by a for node.
+ * All others are parameters and "set" keeps track of which of them
+ * have been assigned a value.
+ *
+ * "stack" is the evaluation stack, of size "max_depth", and
+ * "args" is the buffer in which the arguments of a call
+ * are passed to the user callback, of size "max_args".
+ */
+struct isl_ast_exec {
+	isl_ctx *ctx;
+
+	int n_code;
+	int size_code;
+	long *code;
+
+	int n_node;
+	int size_node;
+	struct isl_ast_exec_node *node;
+	int root;
+
+	int n_child;
+	int size_child;
+	int *child;
+
+	int n_arg;
+	int size_arg;
+	int *arg;
+
+	int n_slot;
+	int size_slot;
+	isl_id **id;
+	long *val;
+	char *iterator;
+	char *set;
+
+	int max_depth;
+	long *stack;
+	int max_args;
+	long *args;
+};
+
+isl_ctx *isl_ast_exec_get_ctx(__isl_keep isl_ast_exec *exec)
+{
+	return exec ? exec->ctx : NULL;
+}
+
+void *isl_ast_exec_free(__isl_take isl_ast_exec *exec)
+{
+	int i;
+
+	if (!exec)
+		return NULL;
+
+	for (i = 0; i < exec->n_node; ++i)
+		isl_ast_node_free(exec->node[i].node);
+	for (i = 0; i < exec->n_slot; ++i)
+		isl_id_free(exec->id[i]);
+	free(exec->code);
+	free(exec->node);
+	free(exec->child);
+	free(exec->arg);
+	free(exec->id);
+	free(exec->val);
+	free(exec->iterator);
+	free(exec->set);
+	free(exec->stack);
+	free(exec->args);
+	isl_ctx_deref(exec->ctx);
+	free(exec);
+
+	return NULL;
+}
+
+/* Append "word" to the code of "exec".
+ */
+static int add_code(isl_ast_exec *exec, long word)
+{
+	if (exec->n_code >= exec->size_code) {
+		int size = 2 * exec->size_code + 16;
+		long *code;
+
+		code = isl_realloc_array(exec->ctx, exec->code, long, size);
+		if (!code)
+			return -1;
+		exec->code = code;
+		exec->size_code = size;
+	}
+	exec->code[exec->n_code++] = word;
+	return 0;
+}
+
+/* Return the slot of "id" in "exec", creating a new slot if needed.
+ * Return -1 on error.
+ */
+static int get_slot(isl_ast_exec *exec, __isl_keep isl_id *id)
+{
+	int i;
+
+	for (i = 0; i < exec->n_slot; ++i)
+		if (exec->id[i] == id)
+			return i;
+
+	if (exec->n_slot >= exec->size_slot) {
+		int size = 2 * exec->size_slot + 4;
+		isl_id **ids;
+		long *val;
+		char *iterator, *set;
+
+		ids = isl_realloc_array(exec->ctx, exec->id, isl_id *, size);
+		if (!ids)
+			return -1;
+		exec->id = ids;
+		val = isl_realloc_array(exec->ctx, exec->val, long, size);
+		if (!val)
+			return -1;
+		exec->val = val;
+		iterator = isl_realloc_array(exec->ctx, exec->iterator,
+						char, size);
+		if (!iterator)
+			return -1;
+		exec->iterator = iterator;
+		set = isl_realloc_array(exec->ctx, exec->set, char, size);
+		if (!set)
+			return -1;
+		exec->set = set;
+		exec->size_slot = size;
+	}
+
+	exec->id[exec->n_slot] = isl_id_copy(id);
+	exec->val[exec->n_slot] = 0;
+	exec->iterator[exec->n_slot] = 0;
+	exec->set[exec->n_slot] = 0;
+	return exec->n_slot++;
+}
+
+/* Convert the integer value "v" to a long.
+ * Return -1 if "v" does not fit in a long.
+ */
+static int val_get_long(__isl_keep isl_val *v, long *l)
+{
+	isl_val *check;
+	int eq;
+
+	*l = isl_val_get_num_si(v);
+	check = isl_val_int_from_si(isl_val_get_ctx(v), *l);
+	eq = isl_val_eq(v, check);
+	isl_val_free(check);
+	if (eq < 0)
+		return -1;
+	if (!eq)
+		isl_die(isl_val_get_ctx(v), isl_error_unsupported,
+			"value does not fit in a machine integer", return -1);
+	return 0;
+}
+
+static int compile_expr_rec(isl_ast_exec *exec, __isl_keep isl_ast_expr *expr,
+	int depth);
+
+/* Compile the n-ary operation "expr" into a sequence of binary
+ * operations "op" that combine the arguments from left to right.
+ * "depth" is the size of the evaluation stack before evaluating "expr".
+ */
+static int compile_nary(isl_ast_exec *exec, __isl_keep isl_ast_expr *expr,
+	enum isl_ast_exec_op op, int depth)
+{
+	int i;
+
+	if (compile_expr_rec(exec, expr->u.op.args[0], depth) < 0)
+		return -1;
+	for (i = 1; i < expr->u.op.n_arg; ++i) {
+		if (compile_expr_rec(exec, expr->u.op.args[i], depth + 1) < 0)
+			return -1;
+		if (add_code(exec, op) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* Map the operation type of "expr" to the corresponding
+ * bytecode operation.
+ * The short-circuit operations are evaluated in the same way as
+ * the corresponding ordinary operations since the evaluation
+ * of an AST expression does not have any side effects.
+ * Since the dividend of isl_ast_op_pdiv_q is known to be non-negative
+ * and since the result of isl_ast_op_div is exact, both can be
+ * evaluated using the division of the C language.
+ */
+static enum isl_ast_exec_op exec_op(__isl_keep isl_ast_expr *expr)
+{
+	switch (expr->u.op.op) {
+	case isl_ast_op_and:
+	case isl_ast_op_and_then:
+		return isl_ast_exec_op_and;
+	case isl_ast_op_or:
+	case isl_ast_op_or_else:
+		return isl_ast_exec_op_or;
+	case isl_ast_op_max:
+		return isl_ast_exec_op_max;
+	case isl_ast_op_min:
+		return isl_ast_exec_op_min;
+	case isl_ast_op_minus:
+		return isl_ast_exec_op_neg;
+	case isl_ast_op_add:
+		return isl_ast_exec_op_add;
+	case isl_ast_op_sub:
+		return isl_ast_exec_op_sub;
+	case isl_ast_op_mul:
+		return isl_ast_exec_op_mul;
+	case isl_ast_op_div:
+	case isl_ast_op_pdiv_q:
+		return isl_ast_exec_op_div;
+	case isl_ast_op_fdiv_q:
+		return isl_ast_exec_op_fdiv_q;
+	case isl_ast_op_pdiv_r:
+		return isl_ast_exec_op_pdiv_r;
+	case isl_ast_op_cond:
+	case isl_ast_op_select:
+		return isl_ast_exec_op_select;
+	case isl_ast_op_eq:
+		return isl_ast_exec_op_eq;
+	case isl_ast_op_le:
+		return isl_ast_exec_op_le;
+	case isl_ast_op_lt:
+		return isl_ast_exec_op_lt;
+	case isl_ast_op_ge:
+		return isl_ast_exec_op_ge;
+	case isl_ast_op_gt:
+		return isl_ast_exec_op_gt;
+	default:
+		return isl_ast_exec_op_ret;
+	}
+}
+
+/* Append the bytecode for evaluating "expr" to the code of "exec".
+ * "depth" is the size of the evaluation stack before evaluating "expr".
+ * exec->max_depth is updated to the maximal size of the stack
+ * during the evaluation.
+ */
+static int compile_expr_rec(isl_ast_exec *exec, __isl_keep isl_ast_expr *expr,
+	int depth)
+{
+	enum isl_ast_exec_op op;
+	long l;
+	int slot;
+
+	if (!expr)
+		return -1;
+
+	if (depth + 1 > exec->max_depth)
+		exec->max_depth = depth + 1;
+
+	switch (expr->type) {
+	case isl_ast_expr_int:
+		if (val_get_long(expr->u.v, &l) < 0)
+			return -1;
+		if (add_code(exec, isl_ast_exec_op_const) < 0)
+			return -1;
+		return add_code(exec, l);
+	case isl_ast_expr_id:
+		slot = get_slot(exec, expr->u.id);
+		if (slot < 0)
+			return -1;
+		if (add_code(exec, isl_ast_exec_op_load) < 0)
+			return -1;
+		return add_code(exec, slot);
+	case isl_ast_expr_op:
+		break;
+	case isl_ast_expr_error:
+		return -1;
+	}
+
+	op = exec_op(expr);
+	if (op == isl_ast_exec_op_ret)
+		isl_die(exec->ctx, isl_error_unsupported,
+			"operation cannot be executed", return -1);
+	if (op == isl_ast_exec_op_neg || op == isl_ast_exec_op_select) {
+		int i;
+
+		for (i = 0; i < expr->u.op.n_arg; ++i)
+			if (compile_expr_rec(exec, expr->u.op.args[i],
+					    depth + i) < 0)
+				return -1;
+		return add_code(exec, op);
+	}
+	return compile_nary(exec, expr, op, depth);
+}
+
+/* Compile "expr" and return the offset of the result in the code
+ * of "exec", or -1 on error.
+ */
+static int compile_expr(isl_ast_exec *exec, __isl_keep isl_ast_expr *expr)
+{
+	int offset = exec->n_code;
+
+	if (compile_expr_rec(exec, expr, 0) < 0)
+		return -1;
+	if (add_code(exec, isl_ast_exec_op_ret) < 0)
+		return -1;
+	return offset;
+}
+
+/* Add a new (uninitialized) compiled node to "exec" and
+ * return its index, or -1 on error.
+ */
+static int add_node(isl_ast_exec *exec, enum isl_ast_node_type type)
+{
+	struct isl_ast_exec_node *node;
+
+	if (exec->n_node >= exec->size_node) {
+		int size = 2 * exec->size_node + 8;
+
+		node = isl_realloc_array(exec->ctx, exec->node,
+					struct isl_ast_exec_node, size);
+		if (!node)
+			return -1;
+		exec->node = node;
+		exec->size_node = size;
+	}
+	node = &exec->node[exec->n_node];
+	node->type = type;
+	node->slot = -1;
+	node->init = node->cond = node->inc = -1;
+	node->n_unrolled = 0;
+	node->body = node->else_node = -1;
+	node->first = node->n = 0;
+	node->node = NULL;
+	return exec->n_node++;
+}
+
+/* Reserve "n" consecutive elements in the array "list" of size "size"
+ * and with "n_list" elements in use.
+ * Return the position of the first reserved element, or -1 on error.
+ */
+static int reserve(isl_ctx *ctx, int **list, int *n_list, int *size, int n)
+{
+	int first;
+
+	if (*n_list + n > *size) {
+		int new_size = 2 * *size + n;
+		int *l;
+
+		l = isl_realloc_array(ctx, *list, int, new_size);
+		if (!l)
+			return -1;
+		*list = l;
+		*size = new_size;
+	}
+	first = *n_list;
+	*n_list += n;
+	return first;
+}
+
+static int compile_node(isl_ast_exec *exec, __isl_keep isl_ast_node *node);
+
+/* Compile the for node "node" into the compiled node at position "pos".
+ * Note that exec->node may get reallocated by the recursive calls,
+ * so we only access the compiled node through its index.
+ */
+static int compile_for(isl_ast_exec *exec, __isl_keep isl_ast_node *node,
+	int pos)
+{
+	int slot, init, cond = -1, inc = -1, body;
+
+	slot = get_slot(exec, node->u.f.iterator->u.id);
+	if (slot < 0)
+		return -1;
+	exec->iterator[slot] = 1;
+	init = compile_expr(exec, node->u.f.init);
+	if (init < 0)
+		return -1;
+	if (!node->u.f.degenerate) {
+		if (node->u.f.n_unrolled == 0) {
+			cond = compile_expr(exec, node->u.f.cond);
+			if (cond < 0)
+				return -1;
+		}
+		inc = compile_expr(exec, node->u.f.inc);
+		if (inc < 0)
+			return -1;
+	}
+	body = compile_node(exec, node->u.f.body);
+	if (body < 0)
+		return -1;
+
+	exec->node[pos].slot = slot;
+	exec->node[pos].init = init;
+	exec->node[pos].cond = cond;
+	exec->node[pos].inc = inc;
+	exec->node[pos].n_unrolled = node->u.f.degenerate ? 1 :
+						node->u.f.n_unrolled;
+	exec->node[pos].body = body;
+	return 0;
+}
+
+/* Compile the if node "node" into the compiled node at position "pos".
+ */
+static int compile_if(isl_ast_exec *exec, __isl_keep isl_ast_node *node,
+	int pos)
+{
+	int guard, then, else_node = -1;
+
+	guard = compile_expr(exec, node->u.i.guard);
+	if (guard < 0)
+		return -1;
+	then = compile_node(exec, node->u.i.then);
+	if (then < 0)
+		return -1;
+	if (node->u.i.else_node) {
+		else_node = compile_node(exec, node->u.i.else_node);
+		if (else_node < 0)
+			return -1;
+	}
+
+	exec->node[pos].cond = guard;
+	exec->node[pos].body = then;
+	exec->node[pos].else_node = else_node;
+	return 0;
+}
+
+/* Compile the block node "node" into the compiled node at position "pos".
+ */
+static int compile_block(isl_ast_exec *exec, __isl_keep isl_ast_node *node,
+	int pos)
+{
+	int i, n, first;
+
+	n = isl_ast_node_list_n_ast_node(node->u.b.children);
+	first = reserve(exec->ctx, &exec->child, &exec->n_child,
+			&exec->size_child, n);
+	if (first < 0)
+		return -1;
+	for (i = 0; i < n; ++i) {
+		isl_ast_node *child;
+		int c;
+
+		child = isl_ast_node_list_get_ast_node(node->u.b.children, i);
+		c = compile_node(exec, child);
+		isl_ast_node_free(child);
+		if (c < 0)
+			return -1;
+		exec->child[first + i] = c;
+	}
+
+	exec->node[pos].first = first;
+	exec->node[pos].n = n;
+	return 0;
+}
+
+/* Compile the user node "node" into the compiled node at position "pos".
+ * If the expression of "node" is a call, then we compile its arguments
+ * (excluding the function being called).
+ * Otherwise, the user callback is called without arguments.
+ */
+static int compile_user(isl_ast_exec *exec, __isl_keep isl_ast_node *node,
+	int pos)
+{
+	int i, n = 0, first;
+	isl_ast_expr *expr = node->u.e.expr;
+
+	if (expr->type == isl_ast_expr_op && expr->u.op.op == isl_ast_op_call)
+		n = expr->u.op.n_arg - 1;
+	first = reserve(exec->ctx, &exec->arg, &exec->n_arg,
+			&exec->size_arg, n);
+	if (first < 0)
+		return -1;
+	for (i = 0; i < n; ++i) {
+		int arg = compile_expr(exec, expr->u.op.args[1 + i]);
+		if (arg < 0)
+			return -1;
+		exec->arg[first + i] = arg;
+	}
+	if (n > exec->max_args)
+		exec->max_args = n;
+
+	exec->node[pos].first = first;
+	exec->node[pos].n = n;
+	exec->node[pos].node = isl_ast_node_copy(node);
+	return 0;
+}
+
+/* Compile "node" and return the index of the compiled node,
+ * or -1 on error.
+ */
+static int compile_node(isl_ast_exec *exec, __isl_keep isl_ast_node *node)
+{
+	int pos, r = -1;
+
+	if (!node)
+		return -1;
+
+	pos = add_node(exec, node->type);
+	if (pos < 0)
+		return -1;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		r = compile_for(exec, node, pos);
+		break;
+	case isl_ast_node_if:
+		r = compile_if(exec, node, pos);
+		break;
+	case isl_ast_node_block:
+		r = compile_block(exec, node, pos);
+		break;
+	case isl_ast_node_user:
+		r = compile_user(exec, node, pos);
+		break;
+	case isl_ast_node_error:
+		break;
+	}
+
+	return r < 0 ? -1 : pos;
+}
+
+/* Compile "node" into a form that can be executed efficiently
+ * by isl_ast_exec_run.
+ * The iterators of the for nodes and the parameters are represented
+ * by machine integers (of type long) and the expressions in the tree
+ * are compiled into bytecode for a simple stack machine.
+ */
+__isl_give isl_ast_exec *isl_ast_node_compile(__isl_keep isl_ast_node *node)
+{
+	isl_ctx *ctx;
+	isl_ast_exec *exec;
+
+	if (!node)
+		return NULL;
+
+	ctx = isl_ast_node_get_ctx(node);
+	exec = isl_calloc_type(ctx, isl_ast_exec);
+	if (!exec)
+		return NULL;
+	exec->ctx = ctx;
+	isl_ctx_ref(ctx);
+
+	exec->root = compile_node(exec, node);
+	if (exec->root < 0)
+		return isl_ast_exec_free(exec);
+
+	exec->stack = isl_alloc_array(ctx, long, exec->max_depth);
+	exec->args = isl_alloc_array(ctx, long, exec->max_args);
+	if ((exec->max_depth && !exec->stack) ||
+	    (exec->max_args && !exec->args))
+		return isl_ast_exec_free(exec);
+
+	return exec;
+}
+
+/* Set the value of the parameter "id" to "val".
+ * If "id" does not appear in the compiled tree, then this has no effect.
+ */
+__isl_give isl_ast_exec *isl_ast_exec_set_param(__isl_take isl_ast_exec *exec,
+	__isl_take isl_id *id, long val)
+{
+	int i;
+
+	if (!exec || !id)
+		goto error;
+
+	for (i = 0; i < exec->n_slot; ++i)
+		if (exec->id[i] == id)
+			break;
+	if (i < exec->n_slot) {
+		if (exec->iterator[i])
+			isl_die(exec->ctx, isl_error_invalid,
+				"cannot set value of loop iterator",
+				goto error);
+		exec->val[i] = val;
+		exec->set[i] = 1;
+	}
+
+	isl_id_free(id);
+	return exec;
+error:
+	isl_id_free(id);
+	isl_ast_exec_free(exec);
+	return NULL;
+}
+
+/* Return the largest integer that is smaller than or equal to a / b,
+ * with b positive.
+ */
+static long fdiv_q(long a, long b)
+{
+	if (a >= 0)
+		return a / b;
+	return -((-a + b - 1) / b);
+}
+
+/* Evaluate the expression at offset "pc" in the code of "exec".
+ * The caller is responsible for checking that the divisors
+ * of all divisions are positive, which is the case for the expressions
+ * in a generated AST.
+ */
+static long eval(isl_ast_exec *exec, int pc)
+{
+	long *code = exec->code;
+	long *val = exec->val;
+	long *sp = exec->stack;
+
+	for (;;) {
+		switch ((enum isl_ast_exec_op) code[pc++]) {
+		case isl_ast_exec_op_ret:
+			return sp[-1];
+		case isl_ast_exec_op_const:
+			*sp++ = code[pc++];
+			break;
+		case isl_ast_exec_op_load:
+			*sp++ = val[code[pc++]];
+			break;
+		case isl_ast_exec_op_neg:
+			sp[-1] = -sp[-1];
+			break;
+		case isl_ast_exec_op_add:
+			--sp;
+			sp[-1] += sp[0];
+			break;
+		case isl_ast_exec_op_sub:
+			--sp;
+			sp[-1] -= sp[0];
+			break;
+		case isl_ast_exec_op_mul:
+			--sp;
+			sp[-1] *= sp[0];
+			break;
+		case isl_ast_exec_op_div:
+			--sp;
+			sp[-1] /= sp[0];
+			break;
+		case isl_ast_exec_op_fdiv_q:
+			--sp;
+			sp[-1] = fdiv_q(sp[-1], sp[0]);
+			break;
+		case isl_ast_exec_op_pdiv_r:
+			--sp;
+			sp[-1] %= sp[0];
+			break;
+		case isl_ast_exec_op_min:
+			--sp;
+			if (sp[0] < sp[-1])
+				sp[-1] = sp[0];
+			break;
+		case isl_ast_exec_op_max:
+			--sp;
+			if (sp[0] > sp[-1])
+				sp[-1] = sp[0];
+			break;
+		case isl_ast_exec_op_and:
+			--sp;
+			sp[-1] = sp[-1] && sp[0];
+			break;
+		case isl_ast_exec_op_or:
+			--sp;
+			sp[-1] = sp[-1] || sp[0];
+			break;
+		case isl_ast_exec_op_eq:
+			--sp;
+			sp[-1] = sp[-1] == sp[0];
+			break;
+		case isl_ast_exec_op_le:
+			--sp;
+			sp[-1] = sp[-1] <= sp[0];
+			break;
+		case isl_ast_exec_op_lt:
+			--sp;
+			sp[-1] = sp[-1] < sp[0];
+			break;
+		case isl_ast_exec_op_ge:
+			--sp;
+			sp[-1] = sp[-1] >= sp[0];
+			break;
+		case isl_ast_exec_op_gt:
+			--sp;
+			sp[-1] = sp[-1] > sp[0];
+			break;
+		case isl_ast_exec_op_select:
+			sp -= 2;
+			sp[-1] = sp[-1] ? sp[0] : sp[1];
+			break;
+		}
+	}
+}
+
+/* Internal data structure for isl_ast_exec_run.
+ */
+struct isl_ast_exec_run_data {
+	isl_ast_exec *exec;
+	int (*fn)(__isl_keep isl_ast_node *node, int n_arg, const long *arg,
+		void *user);
+	void *user;
+};
+
+/* Execute the compiled node at position "pos".
+ */
+static int run_node(struct isl_ast_exec_run_data *data, int pos)
+{
+	isl_ast_exec *exec = data->exec;
+	struct isl_ast_exec_node *node = &exec->node[pos];
+	long *it;
+	long inc;
+	int i;
+
+	switch (node->type) {
+	case isl_ast_node_for:
+		it = &exec->val[node->slot];
+		*it = eval(exec, node->init);
+		if (node->cond < 0) {
+			inc = node->inc < 0 ? 0 : eval(exec, node->inc);
+			for (i = 0; i < node->n_unrolled; ++i, *it += inc)
+				if (run_node(data, node->body) < 0)
+					return -1;
+			return 0;
+		}
+		inc = eval(exec, node->inc);
+		for (; eval(exec, node->cond); *it += inc)
+			if (run_node(data, node->body) < 0)
+				return -1;
+		return 0;
+	case isl_ast_node_if:
+		if (eval(exec, node->cond))
+			return run_node(data, node->body);
+		if (node->else_node >= 0)
+			return run_node(data, node->else_node);
+		return 0;
+	case isl_ast_node_block:
+		for (i = 0; i < node->n; ++i)
+			if (run_node(data, exec->child[node->first + i]) < 0)
+				return -1;
+		return 0;
+	case isl_ast_node_user:
+		for (i = 0; i < node->n; ++i)
+			exec->args[i] = eval(exec, exec->arg[node->first + i]);
+		return data->fn(node->node, node->n, exec->args, data->user);
+	case isl_ast_node_error:
+		break;
+	}
+
+	return -1;
+}
+
+/* Execute the compiled AST "exec", calling "fn" for each execution
+ * of a user node in the original AST.
+ * "fn" is passed the user node, along with the values of the arguments
+ * of the call in the user node, if it is a call.
+ * If "fn" returns a negative value, then the execution is aborted.
+ *
+ * All parameters that appear in the AST need to have been assigned
+ * a value through isl_ast_exec_set_param.
+ * The iterators are kept in machine integers and
+ * the caller is responsible for avoiding overflows.
+ */
+int isl_ast_exec_run(__isl_keep isl_ast_exec *exec,
+	int (*fn)(__isl_keep isl_ast_node *node, int n_arg, const long *arg,
+		void *user), void *user)
+{
+	struct isl_ast_exec_run_data data = { exec, fn, user };
+	int i;
+
+	if (!exec || !fn)
+		return -1;
+
+	for (i = 0; i < exec->n_slot; ++i)
+		if (!exec->iterator[i] && !exec->set[i])
+			isl_die(exec->ctx, isl_error_invalid,
+				"parameter value not set", return -1);
+
+	return run_node(&data, exec->root);
+}
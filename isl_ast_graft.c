@@ -7,6 +7,7 @@
  * Ecole Normale Superieure, 45 rue d’Ulm, 75230 Paris, France
  */
 
+#include <isl_map_private.h>
 #include <isl_ast_private.h>
 #include <isl_ast_build_expr.h>
 #include <isl_ast_build_private.h>
@@ -907,6 +908,53 @@ void *isl_ast_graft_free(__isl_take isl_ast_graft *graft)
 	return NULL;
 }
 
+/* Construct a copy of "graft" in "ctx".
+ * This function only reads "graft".
+ */
+static __isl_give isl_ast_graft *isl_ast_graft_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_graft *graft)
+{
+	isl_ast_graft *res;
+
+	if (!graft)
+		return NULL;
+
+	res = isl_calloc_type(ctx, isl_ast_graft);
+	if (!res)
+		return NULL;
+
+	res->ref = 1;
+	res->node = isl_ast_node_transfer(ctx, graft->node);
+	res->guard = isl_set_transfer(ctx, graft->guard);
+	res->enforced = isl_basic_set_transfer(ctx, graft->enforced);
+
+	if (!res->node || !res->guard || !res->enforced)
+		return isl_ast_graft_free(res);
+
+	return res;
+}
+
+/* Construct a copy of "list" in "ctx", which may be different
+ * from the context of "list", with copies of the grafts
+ * in the same order.  This function only reads "list".
+ */
+__isl_give isl_ast_graft_list *isl_ast_graft_list_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_graft_list *list)
+{
+	int i;
+	isl_ast_graft_list *res;
+
+	if (!list)
+		return NULL;
+
+	res = isl_ast_graft_list_alloc(ctx, list->n);
+	for (i = 0; i < list->n; ++i)
+		res = isl_ast_graft_list_add(res,
+				isl_ast_graft_transfer(ctx, list->p[i]));
+
+	return res;
+}
+
 /* Record that the grafted tree enforces
  * "enforced" by intersecting graft->enforced with "enforced".
  */
@@ -930,6 +978,47 @@ error:
 	return isl_ast_graft_free(graft);
 }
 
+/* Forget about the constraints that are enforced by the grafted tree.
+ * This is always safe, but it may result in more guards being generated.
+ */
+__isl_give isl_ast_graft *isl_ast_graft_drop_enforced(
+	__isl_take isl_ast_graft *graft)
+{
+	isl_space *space;
+
+	if (!graft)
+		return NULL;
+
+	space = isl_basic_set_get_space(graft->enforced);
+	isl_basic_set_free(graft->enforced);
+	graft->enforced = isl_basic_set_universe(space);
+	if (!graft->enforced)
+		return isl_ast_graft_free(graft);
+
+	return graft;
+}
+
+/* Does any of the nodes in the grafts of "list" contain a loop?
+ */
+int isl_ast_graft_list_contains_loop(__isl_keep isl_ast_graft_list *list)
+{
+	int i, n;
+
+	if (!list)
+		return -1;
+
+	n = isl_ast_graft_list_n_ast_graft(list);
+	for (i = 0; i < n; ++i) {
+		int loop;
+
+		loop = isl_ast_node_contains_loop(list->p[i]->node);
+		if (loop < 0 || loop)
+			return loop;
+	}
+
+	return 0;
+}
+
 __isl_give isl_basic_set *isl_ast_graft_get_enforced(
 	__isl_keep isl_ast_graft *graft)
 {
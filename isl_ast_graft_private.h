@@ -56,6 +56,9 @@ void *isl_ast_graft_free(__isl_take isl_ast_graft *graft);
 __isl_give isl_ast_graft_list *isl_ast_graft_list_sort_guard(
 	__isl_take isl_ast_graft_list *list);
 
+__isl_give isl_ast_graft_list *isl_ast_graft_list_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_graft_list *list);
+
 __isl_give isl_ast_graft_list *isl_ast_graft_list_merge(
 	__isl_take isl_ast_graft_list *list1,
 	__isl_take isl_ast_graft_list *list2,
@@ -74,7 +77,10 @@ __isl_give isl_ast_graft *isl_ast_graft_add_guard(
 	__isl_take isl_set *guard, __isl_keep isl_ast_build *build);
 __isl_give isl_ast_graft *isl_ast_graft_enforce(
 	__isl_take isl_ast_graft *graft, __isl_take isl_basic_set *enforced);
+__isl_give isl_ast_graft *isl_ast_graft_drop_enforced(
+	__isl_take isl_ast_graft *graft);
 
+int isl_ast_graft_list_contains_loop(__isl_keep isl_ast_graft_list *list);
 __isl_give isl_ast_graft_list *isl_ast_graft_list_unembed(
 	__isl_take isl_ast_graft_list *list, int product);
 __isl_give isl_ast_graft_list *isl_ast_graft_list_preimage_multi_aff(
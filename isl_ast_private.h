@@ -8,13 +8,17 @@
 #include <isl/vec.h>
 #include <isl/list.h>
 
+struct isl_ast_arena;
+
 /* An expression is either an integer, an identifier or an operation
  * with zero or more arguments.
+ * "arena" is the arena from which the expression was allocated, if any.
  */
 struct isl_ast_expr {
 	int ref;
 
 	isl_ctx *ctx;
+	struct isl_ast_arena *arena;
 
 	enum isl_ast_expr_type type;
 
@@ -34,6 +38,9 @@ struct isl_ast_expr {
 
 #include <isl_list_templ.h>
 
+struct isl_ast_arena *isl_ast_arena_enter(isl_ctx *ctx);
+void isl_ast_arena_leave(struct isl_ast_arena *arena);
+
 __isl_give isl_ast_expr *isl_ast_expr_alloc_int_si(isl_ctx *ctx, int i);
 __isl_give isl_ast_expr *isl_ast_expr_alloc_op(isl_ctx *ctx,
 	enum isl_ast_op_type op, int n_arg);
@@ -48,11 +55,19 @@ __isl_give isl_ast_expr *isl_ast_expr_alloc_binary(enum isl_ast_op_type type,
 /* A node is either a block, an if, a for or a user node.
  * "else_node" is NULL if the if node does not have an else branch.
  * "cond" and "inc" are NULL for degenerate for nodes.
+ * "n_unrolled" is the number of iterations of a for node that should
+ * be printed as that many copies of its body, or zero if it should
+ * be printed as an ordinary loop.
+ * "parallel" is set if the for node does not carry any dependences and
+ * "vectorizable" is set if, moreover, it is an innermost loop
+ * with unit increment.
+ * "arena" is the arena from which the node was allocated, if any.
  */
 struct isl_ast_node {
 	int ref;
 
 	isl_ctx *ctx;
+	struct isl_ast_arena *arena;
 	enum isl_ast_node_type type;
 
 	union {
@@ -66,6 +81,9 @@ struct isl_ast_node {
 		} i;
 		struct {
 			unsigned degenerate : 1;
+			unsigned parallel : 1;
+			unsigned vectorizable : 1;
+			int n_unrolled;
 			isl_ast_expr *iterator;
 			isl_ast_expr *init;
 			isl_ast_expr *cond;
@@ -81,8 +99,17 @@ struct isl_ast_node {
 };
 
 __isl_give isl_ast_node *isl_ast_node_alloc_for(__isl_take isl_id *id);
+__isl_give isl_ast_node *isl_ast_node_transfer(isl_ctx *ctx,
+	__isl_keep isl_ast_node *node);
 __isl_give isl_ast_node *isl_ast_node_for_mark_degenerate(
 	__isl_take isl_ast_node *node);
+__isl_give isl_ast_node *isl_ast_node_for_mark_unrolled(
+	__isl_take isl_ast_node *node, int n);
+__isl_give isl_ast_node *isl_ast_node_for_mark_parallel(
+	__isl_take isl_ast_node *node, int vectorizable);
+int isl_ast_node_contains_loop(__isl_keep isl_ast_node *node);
+__isl_give isl_ast_node *isl_ast_node_hoist_invariants(
+	__isl_take isl_ast_node *node);
 __isl_give isl_ast_node *isl_ast_node_alloc_if(__isl_take isl_ast_expr *guard);
 __isl_give isl_ast_node *isl_ast_node_alloc_block(
 	__isl_take isl_ast_node_list *list);
@@ -93,10 +120,15 @@ __isl_give isl_ast_node *isl_ast_node_for_set_body(
 __isl_give isl_ast_node *isl_ast_node_if_set_then(
 	__isl_take isl_ast_node *node, __isl_take isl_ast_node *child);
 
+/* "in_parallel" is set while printing the body of a loop
+ * that has been annotated with an OpenMP parallel pragma.
+ */
 struct isl_ast_print_options {
 	int ref;
 	isl_ctx *ctx;
 
+	int in_parallel;
+
 	__isl_give isl_printer *(*print_for)(__isl_take isl_printer *p,
 		__isl_take isl_ast_print_options *options,
 		__isl_keep isl_ast_node *node, void *user);
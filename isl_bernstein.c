@@ -15,6 +15,7 @@
 
 #include <isl_ctx_private.h>
 #include <isl_map_private.h>
+#include <isl_mat_private.h>
 #include <isl/set.h>
 #include <isl_seq.h>
 #include <isl_morph.h>
@@ -23,8 +24,15 @@
 #include <isl_polynomial_private.h>
 #include <isl_options_private.h>
 #include <isl_vec_private.h>
+#include <isl_thread.h>
 #include <isl_bernstein.h>
 
+struct isl_bernstein_task;
+
+/* If "task" is set, then the folds computed on each simplex
+ * are stored in "task" instead of being combined into "pwf"
+ * and "pwf_tight".
+ */
 struct bernstein_data {
 	enum isl_fold type;
 	isl_qpolynomial *poly;
@@ -36,8 +44,68 @@ struct bernstein_data {
 	isl_qpolynomial_fold *fold_tight;
 	isl_pw_qpolynomial_fold *pwf;
 	isl_pw_qpolynomial_fold *pwf_tight;
+
+	struct isl_bernstein_task *task;
 };
 
+/* A chamber on which the Bernstein coefficients are computed
+ * by a worker of bernstein_coefficients_parallel.
+ * "cell" lives in the main context, while the "n" elements
+ * of "fold" and "fold_tight" are the folds computed by the worker
+ * on the successive simplices of the chamber in its own context.
+ * "time" is the time spent on the chamber.
+ */
+struct isl_bernstein_task {
+	isl_cell *cell;
+
+	int n;
+	int size;
+	isl_qpolynomial_fold **fold;
+	isl_qpolynomial_fold **fold_tight;
+
+	double time;
+};
+
+/* Append "fold" and "fold_tight" to the folds of "task".
+ */
+static int add_task_fold(struct isl_bernstein_task *task,
+	__isl_take isl_qpolynomial_fold *fold,
+	__isl_take isl_qpolynomial_fold *fold_tight)
+{
+	isl_ctx *ctx;
+
+	if (!fold || !fold_tight)
+		goto error;
+
+	ctx = isl_qpolynomial_fold_get_ctx(fold);
+	if (task->n >= task->size) {
+		int size = 3 * (task->size + 2) / 2;
+		isl_qpolynomial_fold **list;
+
+		list = isl_realloc_array(ctx, task->fold,
+					isl_qpolynomial_fold *, size);
+		if (!list)
+			goto error;
+		task->fold = list;
+		list = isl_realloc_array(ctx, task->fold_tight,
+					isl_qpolynomial_fold *, size);
+		if (!list)
+			goto error;
+		task->fold_tight = list;
+		task->size = size;
+	}
+
+	task->fold[task->n] = fold;
+	task->fold_tight[task->n] = fold_tight;
+	task->n++;
+
+	return 0;
+error:
+	isl_qpolynomial_fold_free(fold);
+	isl_qpolynomial_fold_free(fold_tight);
+	return -1;
+}
+
 static int vertex_is_integral(__isl_keep isl_basic_set *vertex)
 {
 	unsigned nvar;
@@ -245,6 +313,7 @@ error:
 static int bernstein_coefficients_cell(__isl_take isl_cell *cell, void *user)
 {
 	int i, j;
+	int r = 0;
 	struct bernstein_data *data = (struct bernstein_data *)user;
 	isl_space *dim_param;
 	isl_space *dim_dst;
@@ -308,28 +377,546 @@ static int bernstein_coefficients_cell(__isl_take isl_cell *cell, void *user)
 	data->fold_tight = isl_qpolynomial_fold_empty(data->type, dim_param);
 	extract_coefficients(poly, dom, data);
 
-	pwf = isl_pw_qpolynomial_fold_alloc(data->type, isl_set_copy(dom),
-					    data->fold);
-	data->pwf = isl_pw_qpolynomial_fold_fold(data->pwf, pwf);
-	pwf = isl_pw_qpolynomial_fold_alloc(data->type, dom, data->fold_tight);
-	data->pwf_tight = isl_pw_qpolynomial_fold_fold(data->pwf_tight, pwf);
+	if (data->task) {
+		isl_set_free(dom);
+		r = add_task_fold(data->task, data->fold, data->fold_tight);
+	} else {
+		pwf = isl_pw_qpolynomial_fold_alloc(data->type,
+					    isl_set_copy(dom), data->fold);
+		data->pwf = isl_pw_qpolynomial_fold_fold(data->pwf, pwf);
+		pwf = isl_pw_qpolynomial_fold_alloc(data->type, dom,
+						    data->fold_tight);
+		data->pwf_tight = isl_pw_qpolynomial_fold_fold(data->pwf_tight,
+								pwf);
+	}
 
 	isl_qpolynomial_free(poly);
 	isl_cell_free(cell);
 	for (i = 0; i < 1 + nvar; ++i)
 		isl_qpolynomial_free(subs[i]);
 	free(subs);
-	return 0;
+	return r;
 error:
 	isl_cell_free(cell);
 	return -1;
 }
 
+/* Compute the Bernstein coefficients on the chamber "cell"
+ * and keep track of the time spent on the chamber in the statistics
+ * of the isl_ctx.
+ */
+static int bernstein_coefficients_chamber(__isl_take isl_cell *cell,
+	void *user)
+{
+	isl_ctx *ctx;
+	double start, time;
+	int r;
+
+	if (!cell)
+		return -1;
+
+	ctx = isl_cell_get_ctx(cell);
+	start = isl_thread_cpu_time();
+	r = bernstein_coefficients_cell(cell, user);
+	time = isl_thread_cpu_time() - start;
+	ctx->stats->bernstein_n_chamber++;
+	ctx->stats->bernstein_chamber_time += time;
+	if (time > ctx->stats->bernstein_chamber_time_max)
+		ctx->stats->bernstein_chamber_time_max = time;
+
+	return r;
+}
+
+/* Construct a space in "ctx" of the same kind and with the same
+ * number of parameters and set variables as the set space "space".
+ * The identifiers of "space" are not copied.
+ */
+static __isl_give isl_space *transfer_space(isl_ctx *ctx,
+	__isl_keep isl_space *space)
+{
+	unsigned nparam;
+
+	if (!space)
+		return NULL;
+
+	nparam = isl_space_dim(space, isl_dim_param);
+	if (isl_space_is_params(space))
+		return isl_space_params_alloc(ctx, nparam);
+	return isl_space_set_alloc(ctx, nparam,
+				    isl_space_dim(space, isl_dim_set));
+}
+
+/* Construct a basic set in "space" with the same integer divisions and
+ * constraints as "src".
+ *
+ * "space" may live in a different context than "src",
+ * but this function only reads "src".
+ */
+static __isl_give isl_basic_set *transfer_basic_set(__isl_take isl_space *space,
+	__isl_keep isl_basic_set *src)
+{
+	int i, k;
+	unsigned total;
+	isl_basic_set *bset;
+
+	if (!space || !src)
+		goto error;
+
+	total = isl_basic_set_total_dim(src);
+	bset = isl_basic_set_alloc_space(space, src->n_div,
+					src->n_eq, src->n_ineq);
+	if (!bset)
+		return NULL;
+
+	for (i = 0; i < src->n_div; ++i) {
+		k = isl_basic_set_alloc_div(bset);
+		if (k < 0)
+			goto error_bset;
+		isl_seq_cpy(bset->div[k], src->div[i], 1 + 1 + total);
+	}
+	for (i = 0; i < src->n_eq; ++i) {
+		k = isl_basic_set_alloc_equality(bset);
+		if (k < 0)
+			goto error_bset;
+		isl_seq_cpy(bset->eq[k], src->eq[i], 1 + total);
+	}
+	for (i = 0; i < src->n_ineq; ++i) {
+		k = isl_basic_set_alloc_inequality(bset);
+		if (k < 0)
+			goto error_bset;
+		isl_seq_cpy(bset->ineq[k], src->ineq[i], 1 + total);
+	}
+	bset->flags = src->flags;
+
+	return bset;
+error_bset:
+	isl_basic_set_free(bset);
+	return NULL;
+error:
+	isl_space_free(space);
+	return NULL;
+}
+
+/* Construct a copy of the polynomial "up" in "ctx".
+ */
+static __isl_give struct isl_upoly *transfer_upoly(isl_ctx *ctx,
+	__isl_keep struct isl_upoly *up)
+{
+	int i;
+	struct isl_upoly_rec *rec, *res;
+
+	if (!up)
+		return NULL;
+
+	if (isl_upoly_is_cst(up)) {
+		struct isl_upoly_cst *cst = isl_upoly_as_cst(up);
+		return isl_upoly_rat_cst(ctx, cst->n, cst->d);
+	}
+
+	rec = isl_upoly_as_rec(up);
+	res = isl_upoly_alloc_rec(ctx, up->var, rec->n);
+	if (!res)
+		return NULL;
+	for (i = 0; i < rec->n; ++i) {
+		res->p[i] = transfer_upoly(ctx, rec->p[i]);
+		if (!res->p[i])
+			goto error;
+		res->n++;
+	}
+
+	return &res->up;
+error:
+	isl_upoly_free(&res->up);
+	return NULL;
+}
+
+/* Construct a quasipolynomial with domain "space" that is
+ * a copy of "qp".
+ */
+static __isl_give isl_qpolynomial *transfer_qpolynomial(
+	__isl_take isl_space *space, __isl_keep isl_qpolynomial *qp)
+{
+	int i;
+	struct isl_upoly *up;
+	isl_qpolynomial *res;
+
+	if (!space || !qp)
+		goto error;
+
+	up = transfer_upoly(isl_space_get_ctx(space), qp->upoly);
+	res = isl_qpolynomial_alloc(space, qp->div->n_row, up);
+	if (!res)
+		return NULL;
+	for (i = 0; i < qp->div->n_row; ++i)
+		isl_seq_cpy(res->div->row[i], qp->div->row[i],
+				qp->div->n_col);
+
+	return res;
+error:
+	isl_space_free(space);
+	return NULL;
+}
+
+/* Construct a fold of type "type" with domain "space" that is
+ * a copy of "fold".
+ */
+static __isl_give isl_qpolynomial_fold *transfer_fold(enum isl_fold type,
+	__isl_take isl_space *space, __isl_keep isl_qpolynomial_fold *fold)
+{
+	int i;
+	isl_qpolynomial_fold *res;
+
+	if (!space || !fold)
+		goto error;
+
+	res = isl_qpolynomial_fold_empty(type, isl_space_copy(space));
+	for (i = 0; i < fold->n; ++i) {
+		isl_qpolynomial *qp;
+		qp = transfer_qpolynomial(isl_space_copy(space), fold->qp[i]);
+		res = isl_qpolynomial_fold_fold(res,
+					isl_qpolynomial_fold_alloc(type, qp));
+	}
+	isl_space_free(space);
+
+	return res;
+error:
+	isl_space_free(space);
+	return NULL;
+}
+
+/* Construct a copy of "vertices" in "ctx", without the chambers.
+ * The activity domains of the vertices are not needed
+ * (and have been dropped by the chamber computation),
+ * so they are not copied either.
+ */
+static __isl_give isl_vertices *transfer_vertices(isl_ctx *ctx,
+	__isl_keep isl_vertices *vertices)
+{
+	int i;
+	isl_vertices *res;
+
+	res = isl_calloc_type(ctx, isl_vertices);
+	if (!res)
+		return NULL;
+	res->ref = 1;
+	res->bset = transfer_basic_set(transfer_space(ctx,
+					vertices->bset->dim), vertices->bset);
+	res->v = isl_calloc_array(ctx, struct isl_vertex,
+				    vertices->n_vertices);
+	if (!res->bset || (vertices->n_vertices && !res->v))
+		goto error;
+	res->n_vertices = vertices->n_vertices;
+	for (i = 0; i < vertices->n_vertices; ++i) {
+		struct isl_vertex *v = &vertices->v[i];
+		res->v[i].vertex = transfer_basic_set(transfer_space(ctx,
+						v->vertex->dim), v->vertex);
+		if (!res->v[i].vertex)
+			goto error;
+	}
+
+	return res;
+error:
+	isl_vertices_free(res);
+	return NULL;
+}
+
+/* Construct a copy of "cell" with vertices "vertices",
+ * living in a possibly different context.
+ */
+static __isl_give isl_cell *transfer_cell(__isl_keep isl_vertices *vertices,
+	__isl_keep isl_cell *cell)
+{
+	int i;
+	isl_ctx *ctx;
+	isl_cell *res;
+
+	ctx = isl_vertices_get_ctx(vertices);
+	res = isl_calloc_type(ctx, isl_cell);
+	if (!res)
+		return NULL;
+	res->vertices = isl_vertices_copy(vertices);
+	res->n_vertices = cell->n_vertices;
+	res->ids = isl_alloc_array(ctx, int, cell->n_vertices);
+	res->dom = transfer_basic_set(transfer_space(ctx, cell->dom->dim),
+					cell->dom);
+	if ((cell->n_vertices && !res->ids) || !res->dom) {
+		isl_cell_free(res);
+		return NULL;
+	}
+	for (i = 0; i < cell->n_vertices; ++i)
+		res->ids[i] = cell->ids[i];
+
+	return res;
+}
+
+/* Internal data structure for bernstein_coefficients_parallel.
+ *
+ * "data" contains the polynomial in the main context and
+ * "vertices" are the vertices of the parametric polytope.
+ * "task" is the list of "n_task" chambers.
+ * "next" is the index of the next task that has not been taken
+ * by any worker yet.
+ * "stop" is set as soon as any worker failed.
+ * "lock" protects "next" and "stop".
+ */
+struct isl_bernstein_parallel_data {
+	struct bernstein_data *data;
+	isl_vertices *vertices;
+
+	int n_task;
+	int size;
+	struct isl_bernstein_task *task;
+
+	int next;
+	int stop;
+	struct isl_mutex lock;
+};
+
+/* A worker of bernstein_coefficients_parallel.
+ * "ctx" is the context in which the worker operates and
+ * "r" is negative if the worker failed.
+ */
+struct isl_bernstein_worker {
+	struct isl_bernstein_parallel_data *par;
+	isl_ctx *ctx;
+	int r;
+};
+
+/* Add "cell" to the list of tasks in "user".
+ */
+static int add_bernstein_task(__isl_take isl_cell *cell, void *user)
+{
+	struct isl_bernstein_parallel_data *par = user;
+	struct isl_bernstein_task *task;
+
+	if (!cell)
+		return -1;
+
+	if (par->n_task >= par->size) {
+		int size = 3 * (par->size + 4) / 2;
+		task = isl_realloc_array(isl_cell_get_ctx(cell), par->task,
+					struct isl_bernstein_task, size);
+		if (!task) {
+			isl_cell_free(cell);
+			return -1;
+		}
+		par->task = task;
+		par->size = size;
+	}
+
+	task = &par->task[par->n_task++];
+	task->cell = cell;
+	task->n = 0;
+	task->size = 0;
+	task->fold = NULL;
+	task->fold_tight = NULL;
+	task->time = 0;
+
+	return 0;
+}
+
+/* Repeatedly take the next chamber from the shared list and compute
+ * the Bernstein coefficients on that chamber in the context
+ * of the worker.
+ *
+ * Since the objects in the main context cannot be used
+ * from the worker, the worker first constructs copies of
+ * the polynomial and the vertices in its own context.
+ * In particular, bernstein_coefficients_cell modifies the vertices,
+ * so each worker needs its own copy anyway.
+ * The folds computed on the simplices of the chamber are kept
+ * in the worker context and are only transferred to the main context
+ * after all workers have finished.
+ */
+static void *bernstein_worker(void *user)
+{
+	struct isl_bernstein_worker *worker = user;
+	struct isl_bernstein_parallel_data *par = worker->par;
+	struct bernstein_data data;
+	isl_ctx *ctx = worker->ctx;
+	isl_vertices *vertices;
+	int r = 0, t;
+
+	data.type = par->data->type;
+	data.check_tight = par->data->check_tight;
+	data.poly = transfer_qpolynomial(transfer_space(ctx,
+				par->data->poly->dim), par->data->poly);
+	data.pwf = NULL;
+	data.pwf_tight = NULL;
+	vertices = transfer_vertices(ctx, par->vertices);
+	if (!data.poly || !vertices)
+		r = -1;
+
+	while (r >= 0) {
+		struct isl_bernstein_task *task;
+		isl_cell *cell;
+		double start;
+
+		isl_mutex_lock(&par->lock);
+		t = par->stop || par->next >= par->n_task ? -1 : par->next++;
+		isl_mutex_unlock(&par->lock);
+		if (t < 0)
+			break;
+
+		task = &par->task[t];
+		start = isl_thread_cpu_time();
+		data.task = task;
+		cell = transfer_cell(vertices, task->cell);
+		r = cell ? bernstein_coefficients_cell(cell, &data) : -1;
+		task->time = isl_thread_cpu_time() - start;
+	}
+
+	isl_mutex_lock(&par->lock);
+	if (r < 0)
+		par->stop = 1;
+	isl_mutex_unlock(&par->lock);
+	worker->r = r;
+
+	isl_vertices_free(vertices);
+	isl_qpolynomial_free(data.poly);
+
+	return NULL;
+}
+
+/* Free all tasks in "par".
+ */
+static void free_bernstein_tasks(struct isl_bernstein_parallel_data *par)
+{
+	int i, j;
+
+	for (i = 0; i < par->n_task; ++i) {
+		struct isl_bernstein_task *task = &par->task[i];
+
+		isl_cell_free(task->cell);
+		for (j = 0; j < task->n; ++j) {
+			isl_qpolynomial_fold_free(task->fold[j]);
+			isl_qpolynomial_fold_free(task->fold_tight[j]);
+		}
+		free(task->fold);
+		free(task->fold_tight);
+	}
+	free(par->task);
+}
+
+/* Combine the folds computed by a worker on the simplices
+ * of the chamber of "task" into data->pwf and data->pwf_tight,
+ * as in bernstein_coefficients_cell.
+ */
+static void add_task_result(struct bernstein_data *data,
+	struct isl_bernstein_task *task)
+{
+	int i;
+	isl_space *space;
+	isl_set *dom;
+
+	space = isl_basic_set_get_space(task->cell->dom);
+	dom = isl_set_from_basic_set(isl_basic_set_copy(task->cell->dom));
+	for (i = 0; i < task->n; ++i) {
+		isl_qpolynomial_fold *fold;
+		isl_pw_qpolynomial_fold *pwf;
+
+		fold = transfer_fold(data->type, isl_space_copy(space),
+					task->fold[i]);
+		pwf = isl_pw_qpolynomial_fold_alloc(data->type,
+						isl_set_copy(dom), fold);
+		data->pwf = isl_pw_qpolynomial_fold_fold(data->pwf, pwf);
+		fold = transfer_fold(data->type, isl_space_copy(space),
+					task->fold_tight[i]);
+		pwf = isl_pw_qpolynomial_fold_alloc(data->type,
+						isl_set_copy(dom), fold);
+		data->pwf_tight = isl_pw_qpolynomial_fold_fold(data->pwf_tight,
+								pwf);
+	}
+	isl_set_free(dom);
+	isl_space_free(space);
+}
+
+/* Compute the Bernstein coefficients of data->poly on all chambers
+ * of "vertices" using (at most) "n_thread" threads and
+ * fold the results into data->pwf and data->pwf_tight.
+ *
+ * The chambers are independent of each other, so each worker
+ * repeatedly takes the next chamber and computes the coefficients
+ * on that chamber in its own isl_ctx, as in isl_set_scan_parallel.
+ * The worker contexts inherit the options that affect
+ * bernstein_coefficients_cell.
+ * After all workers have finished, the folds are transferred
+ * to the main context and combined in the same order as
+ * in the sequential computation, such that the final result
+ * does not depend on the number of threads.
+ */
+static int bernstein_coefficients_parallel(__isl_keep isl_vertices *vertices,
+	struct bernstein_data *data, int n_thread)
+{
+	int i, r;
+	isl_ctx *ctx;
+	struct isl_bernstein_parallel_data par = { data, vertices };
+	struct isl_bernstein_worker *worker = NULL;
+
+	ctx = isl_vertices_get_ctx(vertices);
+	if (isl_vertices_foreach_disjoint_cell(vertices,
+					&add_bernstein_task, &par) < 0)
+		goto error;
+	if (n_thread > par.n_task)
+		n_thread = par.n_task;
+
+	worker = isl_calloc_array(ctx, struct isl_bernstein_worker, n_thread);
+	if (n_thread && !worker)
+		goto error;
+	for (i = 0; i < n_thread; ++i) {
+		worker[i].par = &par;
+		worker[i].ctx = isl_thread_ctx_alloc(ctx);
+		if (!worker[i].ctx)
+			goto error;
+	}
+
+	if (isl_mutex_init(ctx, &par.lock) < 0)
+		goto error;
+	r = isl_thread_run(ctx, n_thread, &bernstein_worker, worker,
+			    sizeof(*worker));
+	isl_mutex_destroy(&par.lock);
+	if (r < 0)
+		goto error;
+
+	for (i = 0; i < n_thread; ++i) {
+		if (worker[i].r < 0 && r == 0) {
+			isl_thread_report_error(ctx, worker[i].ctx,
+				"Bernstein expansion failed in worker");
+			r = -1;
+		}
+	}
+
+	for (i = 0; r == 0 && i < par.n_task; ++i) {
+		struct isl_bernstein_task *task = &par.task[i];
+
+		add_task_result(data, task);
+		ctx->stats->bernstein_n_chamber++;
+		ctx->stats->bernstein_chamber_time += task->time;
+		if (task->time > ctx->stats->bernstein_chamber_time_max)
+			ctx->stats->bernstein_chamber_time_max = task->time;
+	}
+
+	free_bernstein_tasks(&par);
+	for (i = 0; i < n_thread; ++i)
+		isl_ctx_free(worker[i].ctx);
+	free(worker);
+	return r;
+error:
+	free_bernstein_tasks(&par);
+	if (worker)
+		for (i = 0; i < n_thread; ++i)
+			isl_ctx_free(worker[i].ctx);
+	free(worker);
+	return -1;
+}
+
 /* Base case of applying bernstein expansion.
  *
  * We compute the chamber decomposition of the parametric polytope "bset"
  * and then perform bernstein expansion on the parametric vertices
  * that are active on each chamber.
+ * If more than one thread may be used and if there are several chambers,
+ * then the chambers are handled in parallel.
  */
 static __isl_give isl_pw_qpolynomial_fold *bernstein_coefficients_base(
 	__isl_take isl_basic_set *bset,
@@ -340,6 +927,7 @@ static __isl_give isl_pw_qpolynomial_fold *bernstein_coefficients_base(
 	isl_pw_qpolynomial_fold *pwf;
 	isl_vertices *vertices;
 	int covers;
+	int n_thread;
 
 	nvar = isl_basic_set_dim(bset, isl_dim_set);
 	if (nvar == 0) {
@@ -373,8 +961,14 @@ static __isl_give isl_pw_qpolynomial_fold *bernstein_coefficients_base(
 	data->pwf_tight = isl_pw_qpolynomial_fold_zero(dim, data->type);
 	data->poly = isl_qpolynomial_homogenize(isl_qpolynomial_copy(poly));
 	vertices = isl_basic_set_compute_vertices(bset);
-	isl_vertices_foreach_disjoint_cell(vertices,
-		&bernstein_coefficients_cell, data);
+	n_thread = isl_thread_n_thread(isl_basic_set_get_ctx(bset));
+	if (n_thread > 1 && vertices && vertices->n_chambers > 1) {
+		if (bernstein_coefficients_parallel(vertices, data,
+						    n_thread) < 0)
+			data->pwf = isl_pw_qpolynomial_fold_free(data->pwf);
+	} else
+		isl_vertices_foreach_disjoint_cell(vertices,
+			&bernstein_coefficients_chamber, data);
 	isl_vertices_free(vertices);
 	isl_qpolynomial_free(data->poly);
 
@@ -531,6 +1125,7 @@ int isl_qpolynomial_bound_on_domain_bernstein(__isl_take isl_basic_set *bset,
 
 	data.type = bound->type;
 	data.check_tight = bound->check_tight;
+	data.task = NULL;
 
 	nvar = isl_basic_set_dim(bset, isl_dim_set);
 
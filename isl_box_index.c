@@ -0,0 +1,580 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <stdlib.h>
+#include <isl_map_private.h>
+#include <isl_mat_private.h>
+#include <isl_point_private.h>
+#include <isl_vec_private.h>
+#include <isl_seq.h>
+#include <isl_sort.h>
+#include <isl_box_index.h>
+
+/* The maximal number of entries in a leaf of the splitting tree.
+ */
+#define ISL_BOX_INDEX_LEAF	4
+
+/* A node in the splitting tree of an isl_box_index.
+ *
+ * The node refers to the "n" entries stored at positions "first"
+ * up to "first + n - 1" in the "entry" array of the index.
+ * If "pos" is -1, then the node is a leaf.
+ * Otherwise, the subtree rooted at "left" (if any) only contains
+ * entries with an upper bound on dimension "pos" that is smaller
+ * than "split", while the subtree rooted at "right" (if any)
+ * only contains entries with a lower bound on dimension "pos"
+ * that is greater than or equal to "split".
+ * The entries stored in the node itself may straddle "split".
+ */
+struct isl_box_index_node {
+	int pos;
+	isl_int split;
+	int first;
+	int n;
+	int left;
+	int right;
+};
+
+/* An index over the bounding boxes of "n" sets of dimension "dim",
+ * where "dim" counts both the parameters and the set dimensions.
+ *
+ * "set" contains references to the sets from which the index was
+ * constructed.  They are only used to check that the index
+ * is still valid.
+ *
+ * The box of set "i" is described by lo[i][k] <= x_k <= hi[i][k],
+ * where a lower bound is only available if has_lo[i * dim + k] is set
+ * and similarly for the upper bound.  The bounds are obtained from
+ * the constraints that involve a single variable and are therefore
+ * not necessarily tight, but every element of the set is guaranteed
+ * to lie inside the box.
+ * empty[i] is set if set "i" is known to be empty.
+ *
+ * The non-empty entries are organized in a splitting tree
+ * with "n_node" nodes, the first of which is the root.
+ */
+struct isl_box_index {
+	isl_ctx *ctx;
+	int dim;
+	int n;
+	isl_set **set;
+
+	isl_mat *lo;
+	isl_mat *hi;
+	char *has_lo;
+	char *has_hi;
+	char *empty;
+
+	int n_node;
+	struct isl_box_index_node *node;
+	int *entry;
+};
+
+void isl_box_index_free(struct isl_box_index *index)
+{
+	int i;
+
+	if (!index)
+		return;
+
+	if (index->set)
+		for (i = 0; i < index->n; ++i)
+			isl_set_free(index->set[i]);
+	free(index->set);
+	isl_mat_free(index->lo);
+	isl_mat_free(index->hi);
+	free(index->has_lo);
+	free(index->has_hi);
+	free(index->empty);
+	if (index->node)
+		for (i = 0; i < index->n_node; ++i)
+			isl_int_clear(index->node[i].split);
+	free(index->node);
+	free(index->entry);
+	free(index);
+}
+
+/* Tighten the bounds "lo", "hi" on the variables of a basic set
+ * using the constraint "c" that only involves variable "pos",
+ * i.e., a x_pos + b >= 0 (or = 0 if "eq" is set).
+ * If "rational" is not set, then x_pos is known to be integer
+ * and the bounds can be rounded towards the interior.
+ */
+static void update_bound(isl_int *c, int pos, int eq, int rational,
+	isl_int *lo, char *has_lo, isl_int *hi, char *has_hi, isl_int *t)
+{
+	int lower = eq || isl_int_is_pos(c[1 + pos]);
+	int upper = eq || isl_int_is_neg(c[1 + pos]);
+
+	if (lower) {
+		isl_int_neg(*t, c[0]);
+		if (rational)
+			isl_int_fdiv_q(*t, *t, c[1 + pos]);
+		else
+			isl_int_cdiv_q(*t, *t, c[1 + pos]);
+		if (!has_lo[pos] || isl_int_gt(*t, lo[pos]))
+			isl_int_set(lo[pos], *t);
+		has_lo[pos] = 1;
+	}
+	if (upper) {
+		isl_int_neg(*t, c[0]);
+		if (rational)
+			isl_int_cdiv_q(*t, *t, c[1 + pos]);
+		else
+			isl_int_fdiv_q(*t, *t, c[1 + pos]);
+		if (!has_hi[pos] || isl_int_lt(*t, hi[pos]))
+			isl_int_set(hi[pos], *t);
+		has_hi[pos] = 1;
+	}
+}
+
+/* Compute the bounding box of "bset" in "lo", "hi", "has_lo" and "has_hi"
+ * based on its constraints that involve a single variable
+ * (and no existentially quantified variables).
+ * Return 1 if the box is obviously empty.
+ */
+static int basic_set_box(__isl_keep isl_basic_set *bset, int dim,
+	isl_int *lo, char *has_lo, isl_int *hi, char *has_hi, isl_int *t)
+{
+	int i, k;
+	unsigned total;
+	int rational;
+
+	for (k = 0; k < dim; ++k)
+		has_lo[k] = has_hi[k] = 0;
+
+	total = isl_basic_set_total_dim(bset);
+	rational = ISL_F_ISSET(bset, ISL_BASIC_SET_RATIONAL);
+	for (i = 0; i < bset->n_eq + bset->n_ineq; ++i) {
+		int eq = i < bset->n_eq;
+		isl_int *c = eq ? bset->eq[i] : bset->ineq[i - bset->n_eq];
+		int pos = isl_seq_first_non_zero(c + 1, total);
+
+		if (pos < 0 || pos >= dim)
+			continue;
+		if (isl_seq_first_non_zero(c + 1 + pos + 1,
+					    total - pos - 1) != -1)
+			continue;
+		update_bound(c, pos, eq, rational, lo, has_lo, hi, has_hi, t);
+	}
+
+	for (k = 0; k < dim; ++k)
+		if (has_lo[k] && has_hi[k] && isl_int_gt(lo[k], hi[k]))
+			return 1;
+
+	return 0;
+}
+
+/* Compute the bounding box of entry "i" of "index" as the smallest
+ * box containing the boxes of the basic sets of "set".
+ * "box" is a 2 x dim matrix of scratch space.
+ */
+static int set_box(struct isl_box_index *index, int i,
+	__isl_keep isl_set *set, __isl_keep isl_mat *box, isl_int *t)
+{
+	int j, k;
+	int dim = index->dim;
+	char *has_lo = index->has_lo + i * dim;
+	char *has_hi = index->has_hi + i * dim;
+	char *box_has_lo, *box_has_hi;
+	int first = 1;
+
+	box_has_lo = isl_alloc_array(index->ctx, char, 2 * dim);
+	if (dim && !box_has_lo)
+		return -1;
+	box_has_hi = box_has_lo + dim;
+
+	index->empty[i] = 1;
+	for (j = 0; j < set->n; ++j) {
+		if (ISL_F_ISSET(set->p[j], ISL_BASIC_SET_EMPTY))
+			continue;
+		if (basic_set_box(set->p[j], dim, box->row[0], box_has_lo,
+				    box->row[1], box_has_hi, t))
+			continue;
+		index->empty[i] = 0;
+		for (k = 0; k < dim; ++k) {
+			if (box_has_lo[k] && (first || (has_lo[k] &&
+			    isl_int_lt(box->row[0][k], index->lo->row[i][k]))))
+				isl_int_set(index->lo->row[i][k],
+					    box->row[0][k]);
+			has_lo[k] = box_has_lo[k] && (first || has_lo[k]);
+			if (box_has_hi[k] && (first || (has_hi[k] &&
+			    isl_int_gt(box->row[1][k], index->hi->row[i][k]))))
+				isl_int_set(index->hi->row[i][k],
+					    box->row[1][k]);
+			has_hi[k] = box_has_hi[k] && (first || has_hi[k]);
+		}
+		first = 0;
+	}
+
+	free(box_has_lo);
+	return 0;
+}
+
+/* Data used for sorting the entries of an index according to
+ * their lower bounds on dimension "pos".
+ */
+struct isl_box_index_sort_data {
+	struct isl_box_index *index;
+	int pos;
+};
+
+/* Compare the lower bounds of the entries "p1" and "p2"
+ * on dimension data->pos, where a missing lower bound
+ * is considered to be smaller than any other lower bound.
+ */
+static int cmp_lo(const void *p1, const void *p2, void *user)
+{
+	struct isl_box_index_sort_data *data = user;
+	struct isl_box_index *index = data->index;
+	int pos = data->pos;
+	int i1 = *(const int *) p1;
+	int i2 = *(const int *) p2;
+	int has1 = index->has_lo[i1 * index->dim + pos];
+	int has2 = index->has_lo[i2 * index->dim + pos];
+
+	if (!has1 || !has2)
+		return has1 - has2;
+	return isl_int_cmp(index->lo->row[i1][pos], index->lo->row[i2][pos]);
+}
+
+/* Which group does entry "e" belong to when splitting on dimension "pos"
+ * at "split"?  Return -1 if the entry lies entirely before the split,
+ * 1 if it lies entirely after the split and 0 if it may straddle the split.
+ */
+static int split_side(struct isl_box_index *index, int e, int pos,
+	isl_int split)
+{
+	int dim = index->dim;
+
+	if (index->has_hi[e * dim + pos] &&
+	    isl_int_lt(index->hi->row[e][pos], split))
+		return -1;
+	if (index->has_lo[e * dim + pos] &&
+	    isl_int_ge(index->lo->row[e][pos], split))
+		return 1;
+	return 0;
+}
+
+/* Try and split the "n" entries starting at position "first"
+ * of index->entry on dimension "pos" at the median of their lower bounds.
+ * If successful, reorder the entries such that those that may straddle
+ * the split come first, followed by those that lie entirely before
+ * the split and then those that lie entirely after the split,
+ * set the "split" of "node" and return the sizes of the three groups
+ * in "n_mid", "n_left" and "n_right".
+ * Return 1 if the split was successful, 0 if it would not make
+ * any progress and -1 on error.
+ */
+static int try_split(struct isl_box_index *index,
+	struct isl_box_index_node *node, int pos, int first, int n,
+	int *n_mid, int *n_left, int *n_right)
+{
+	int i, m;
+	int *entry = index->entry + first;
+	int *tmp;
+	int i_mid, i_left, i_right;
+	struct isl_box_index_sort_data data = { index, pos };
+
+	if (isl_sort(entry, n, sizeof(int), &cmp_lo, &data) < 0)
+		return -1;
+	m = entry[n / 2];
+	if (!index->has_lo[m * index->dim + pos])
+		return 0;
+	isl_int_set(node->split, index->lo->row[m][pos]);
+
+	*n_mid = *n_left = *n_right = 0;
+	for (i = 0; i < n; ++i) {
+		int side = split_side(index, entry[i], pos, node->split);
+		if (side < 0)
+			(*n_left)++;
+		else if (side > 0)
+			(*n_right)++;
+		else
+			(*n_mid)++;
+	}
+	if (*n_right == n)
+		return 0;
+
+	tmp = isl_alloc_array(index->ctx, int, n);
+	if (!tmp)
+		return -1;
+	i_mid = 0;
+	i_left = *n_mid;
+	i_right = *n_mid + *n_left;
+	for (i = 0; i < n; ++i) {
+		int side = split_side(index, entry[i], pos, node->split);
+		if (side < 0)
+			tmp[i_left++] = entry[i];
+		else if (side > 0)
+			tmp[i_right++] = entry[i];
+		else
+			tmp[i_mid++] = entry[i];
+	}
+	for (i = 0; i < n; ++i)
+		entry[i] = tmp[i];
+	free(tmp);
+
+	return 1;
+}
+
+/* Construct a subtree of the splitting tree for the "n" entries
+ * starting at position "first" of index->entry and return the position
+ * of its root in index->node, or -1 on error.
+ * The splitting dimension cycles through the dimensions according
+ * to the depth in the tree, skipping dimensions that do not allow
+ * the entries to be split.  If none of the dimensions allows
+ * the entries to be split or if there are only a few entries,
+ * then a leaf is constructed.
+ */
+static int build(struct isl_box_index *index, int first, int n, int depth)
+{
+	int t;
+	int node = index->n_node++;
+	struct isl_box_index_node *nd = &index->node[node];
+
+	isl_int_init(nd->split);
+	nd->pos = -1;
+	nd->first = first;
+	nd->n = n;
+	nd->left = nd->right = -1;
+
+	if (n <= ISL_BOX_INDEX_LEAF)
+		return node;
+
+	for (t = 0; t < index->dim; ++t) {
+		int pos = (depth + t) % index->dim;
+		int n_mid, n_left, n_right;
+		int r;
+
+		r = try_split(index, &index->node[node], pos, first, n,
+				&n_mid, &n_left, &n_right);
+		if (r < 0)
+			return -1;
+		if (!r)
+			continue;
+
+		index->node[node].pos = pos;
+		index->node[node].n = n_mid;
+		if (n_left > 0) {
+			int left = build(index, first + n_mid, n_left,
+					depth + 1);
+			if (left < 0)
+				return -1;
+			index->node[node].left = left;
+		}
+		if (n_right > 0) {
+			int right = build(index, first + n_mid + n_left,
+					n_right, depth + 1);
+			if (right < 0)
+				return -1;
+			index->node[node].right = right;
+		}
+		break;
+	}
+
+	return node;
+}
+
+/* Construct an index over the bounding boxes of the "n" sets
+ * returned by "get_set", which are assumed to all live in the same space.
+ */
+struct isl_box_index *isl_box_index_alloc(isl_ctx *ctx, int n,
+	isl_set *(*get_set)(int i, void *user), void *user)
+{
+	int i, n_entry;
+	struct isl_box_index *index;
+	isl_mat *box = NULL;
+	isl_int t;
+
+	index = isl_calloc_type(ctx, struct isl_box_index);
+	if (!index)
+		return NULL;
+
+	index->ctx = ctx;
+	index->n = n;
+	if (n > 0) {
+		isl_set *set = get_set(0, user);
+		index->dim = isl_set_dim(set, isl_dim_param) +
+			     isl_set_dim(set, isl_dim_set);
+	}
+	index->set = isl_calloc_array(ctx, isl_set *, n);
+	index->lo = isl_mat_alloc(ctx, n, index->dim);
+	index->hi = isl_mat_alloc(ctx, n, index->dim);
+	index->has_lo = isl_calloc_array(ctx, char, n * index->dim);
+	index->has_hi = isl_calloc_array(ctx, char, n * index->dim);
+	index->empty = isl_calloc_array(ctx, char, n);
+	index->node = isl_alloc_array(ctx, struct isl_box_index_node,
+					2 * n + 1);
+	index->entry = isl_alloc_array(ctx, int, n);
+	box = isl_mat_alloc(ctx, 2, index->dim);
+	if ((n && (!index->set || !index->empty || !index->entry)) ||
+	    (n && index->dim && (!index->has_lo || !index->has_hi)) ||
+	    !index->lo || !index->hi || !index->node || !box)
+		goto error;
+
+	isl_int_init(t);
+	for (i = 0; i < n; ++i) {
+		isl_set *set = get_set(i, user);
+		index->set[i] = isl_set_copy(set);
+		if (!set || set_box(index, i, set, box, &t) < 0)
+			break;
+	}
+	isl_int_clear(t);
+	isl_mat_free(box);
+	box = NULL;
+	if (i < n)
+		goto error;
+
+	n_entry = 0;
+	for (i = 0; i < n; ++i)
+		if (!index->empty[i])
+			index->entry[n_entry++] = i;
+	if (build(index, 0, n_entry, 0) < 0)
+		goto error;
+
+	return index;
+error:
+	isl_mat_free(box);
+	isl_box_index_free(index);
+	return NULL;
+}
+
+/* Is "index" still a valid index for the "n" sets returned by "get_set"?
+ * Since the index keeps a reference to each of the sets from which
+ * it was constructed, a set object cannot be freed and its address
+ * reused for a different set while the index exists, so that
+ * any replaced set results in a different pointer.
+ * Modifications of a set in place are not detected.
+ * The user of the index is responsible for dropping the index
+ * in such cases.
+ */
+int isl_box_index_is_valid(struct isl_box_index *index, int n,
+	isl_set *(*get_set)(int i, void *user), void *user)
+{
+	int i;
+
+	if (!index)
+		return 0;
+	if (index->n != n)
+		return 0;
+	for (i = 0; i < n; ++i)
+		if (index->set[i] != get_set(i, user))
+			return 0;
+	return 1;
+}
+
+/* Can the box of entry "e" of "index" intersect the box
+ * lo <= x <= hi, where a missing "has_lo" or "has_hi"
+ * means that all bounds are available?
+ */
+static int box_overlaps(struct isl_box_index *index, int e,
+	isl_int *lo, char *has_lo, isl_int *hi, char *has_hi)
+{
+	int k;
+	int dim = index->dim;
+
+	for (k = 0; k < dim; ++k) {
+		if (index->has_hi[e * dim + k] && (!has_lo || has_lo[k]) &&
+		    isl_int_lt(index->hi->row[e][k], lo[k]))
+			return 0;
+		if (index->has_lo[e * dim + k] && (!has_hi || has_hi[k]) &&
+		    isl_int_gt(index->lo->row[e][k], hi[k]))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Collect the entries in the subtree rooted at "node" that may
+ * intersect the box lo <= x <= hi in "cand", updating "n".
+ */
+static void query(struct isl_box_index *index, int node,
+	isl_int *lo, char *has_lo, isl_int *hi, char *has_hi, int *cand, int *n)
+{
+	int i;
+	struct isl_box_index_node *nd = &index->node[node];
+	int pos = nd->pos;
+
+	for (i = 0; i < nd->n; ++i) {
+		int e = index->entry[nd->first + i];
+		if (box_overlaps(index, e, lo, has_lo, hi, has_hi))
+			cand[(*n)++] = e;
+	}
+
+	if (pos < 0)
+		return;
+	if (nd->left >= 0 &&
+	    ((has_lo && !has_lo[pos]) || isl_int_lt(lo[pos], nd->split)))
+		query(index, nd->left, lo, has_lo, hi, has_hi, cand, n);
+	if (nd->right >= 0 &&
+	    ((has_hi && !has_hi[pos]) || isl_int_ge(hi[pos], nd->split)))
+		query(index, nd->right, lo, has_lo, hi, has_hi, cand, n);
+}
+
+static int cmp_int(const void *p1, const void *p2)
+{
+	return *(const int *) p1 - *(const int *) p2;
+}
+
+/* Collect the entries of "index" whose box may intersect
+ * the box lo <= x <= hi in "cand", in increasing order,
+ * and return the number of such entries.
+ */
+static int find(struct isl_box_index *index,
+	isl_int *lo, char *has_lo, isl_int *hi, char *has_hi, int *cand)
+{
+	int n = 0;
+
+	query(index, 0, lo, has_lo, hi, has_hi, cand, &n);
+	qsort(cand, n, sizeof(int), &cmp_int);
+
+	return n;
+}
+
+/* Collect the entries of "index" that may intersect entry "j" of "other"
+ * in "cand", in increasing order, and return the number of such entries.
+ * That is, the other entries of "index" are known not to intersect
+ * entry "j" of "other".
+ * "cand" is assumed to have room for as many entries as "index".
+ */
+int isl_box_index_find_overlap(struct isl_box_index *index,
+	struct isl_box_index *other, int j, int *cand)
+{
+	int dim;
+
+	if (!index || !other)
+		return -1;
+	dim = other->dim;
+	if (other->empty[j] || index->n == 0)
+		return 0;
+	if (index->dim != dim)
+		isl_die(index->ctx, isl_error_internal,
+			"dimension mismatch", return -1);
+	return find(index, other->lo->row[j], other->has_lo + j * dim,
+			other->hi->row[j], other->has_hi + j * dim, cand);
+}
+
+/* Collect the entries of "index" that may contain "pnt"
+ * in "cand", in increasing order, and return the number of such entries.
+ * "cand" is assumed to have room for as many entries as "index".
+ */
+int isl_box_index_find_point(struct isl_box_index *index,
+	__isl_keep isl_point *pnt, int *cand)
+{
+	if (!index || !pnt)
+		return -1;
+	if (isl_point_is_void(pnt) || index->n == 0)
+		return 0;
+	if (pnt->vec->size != 1 + index->dim)
+		isl_die(index->ctx, isl_error_internal,
+			"dimension mismatch", return -1);
+	return find(index, pnt->vec->el + 1, NULL, pnt->vec->el + 1, NULL,
+			cand);
+}
@@ -0,0 +1,32 @@
+#ifndef ISL_BOX_INDEX_H
+#define ISL_BOX_INDEX_H
+
+#include <isl/ctx.h>
+#include <isl/set.h>
+#include <isl/point.h>
+
+/* An index over the bounding boxes of a sequence of sets
+ * that all live in the same space.
+ * The index can be used to quickly find the sets that may
+ * intersect a given set or that may contain a given point.
+ */
+struct isl_box_index;
+
+/* The minimal number of sets for which it pays off to construct
+ * an index for looking up a single point.
+ */
+#define ISL_BOX_INDEX_MIN_POINT_SETS	8
+
+struct isl_box_index *isl_box_index_alloc(isl_ctx *ctx, int n,
+	isl_set *(*get_set)(int i, void *user), void *user);
+void isl_box_index_free(struct isl_box_index *index);
+
+int isl_box_index_is_valid(struct isl_box_index *index, int n,
+	isl_set *(*get_set)(int i, void *user), void *user);
+
+int isl_box_index_find_overlap(struct isl_box_index *index,
+	struct isl_box_index *other, int j, int *cand);
+int isl_box_index_find_point(struct isl_box_index *index,
+	__isl_keep isl_point *pnt, int *cand);
+
+#endif
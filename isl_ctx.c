@@ -9,6 +9,8 @@
 
 #include <isl_ctx_private.h>
 #include <isl/vec.h>
+#include <isl/vertices.h>
+#include <isl/polynomial.h>
 #include <isl_options_private.h>
 
 #define __isl_calloc(type,size)		((type *)calloc(1, size))
@@ -158,6 +160,8 @@ void isl_ctx_free(struct isl_ctx *ctx)
 {
 	if (!ctx)
 		return;
+	isl_ctx_clear_vertices_cache(ctx);
+	isl_ctx_clear_qpolynomial_div_cache(ctx);
 	if (ctx->ref != 0)
 		isl_die(ctx, isl_error_invalid,
 			"isl_ctx freed, but some objects still reference it",
@@ -200,6 +204,23 @@ void isl_ctx_set_error(isl_ctx *ctx, enum isl_error error)
 		ctx->error = error;
 }
 
+/* Return the statistics that have been collected on "ctx".
+ */
+const struct isl_stats *isl_ctx_get_stats(isl_ctx *ctx)
+{
+	if (!ctx)
+		return NULL;
+	return ctx->stats;
+}
+
+/* Reset the statistics that have been collected on "ctx".
+ */
+void isl_ctx_reset_stats(isl_ctx *ctx)
+{
+	if (ctx)
+		memset(ctx->stats, 0, sizeof(*ctx->stats));
+}
+
 void isl_ctx_abort(isl_ctx *ctx)
 {
 	if (ctx)
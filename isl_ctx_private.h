@@ -23,6 +23,18 @@ struct isl_ctx {
 	struct isl_blk		cache[ISL_BLK_CACHE_SIZE];
 	struct isl_hash_table	id_table;
 
+	char			*(*schedule_cache_lookup)(const char *key,
+					void *user);
+	int			(*schedule_cache_store)(const char *key,
+					const char *value, void *user);
+	void			*schedule_cache_user;
+
+	struct isl_ast_arena	*ast_arena;
+
+	struct isl_vertices_cache	*vertices_cache;
+	struct isl_qpolynomial_div_cache	*qpolynomial_div_cache;
+	struct isl_closure_workers	*closure_workers;
+
 	enum isl_error		error;
 
 	int			abort;
@@ -14,10 +14,17 @@
  * ZAC des vignes, 4 rue Jacques Monod, 91893 Orsay, France 
  */
 
+#include <isl_ctx_private.h>
+#include <isl_map_private.h>
+#include <isl_space_private.h>
+#include <isl/hash.h>
 #include <isl/set.h>
 #include <isl/map.h>
+#include <isl/constraint.h>
 #include <isl/flow.h>
+#include <isl/union_map.h>
 #include <isl_sort.h>
+#include <isl_thread.h>
 
 enum isl_restriction_type {
 	isl_restriction_type_empty,
@@ -1165,6 +1172,37 @@ error:
 	return NULL;
 }
 
+/* A source access, along with a flag indicating whether
+ * it is a must-source and the information about its schedule.
+ * The schedule information is only computed
+ * when the source access is first needed.
+ */
+struct isl_flow_source {
+	isl_map *map;
+	int must;
+	struct isl_sched_info *info;
+};
+
+/* A group of source accesses that access the array with space "space".
+ * "pos" contains the positions of the "n" source accesses
+ * in the list of source accesses.
+ */
+struct isl_flow_array {
+	isl_space *space;
+	int n;
+	int size;
+	int *pos;
+};
+
+/* Internal data structure for isl_union_map_compute_flow.
+ *
+ * "source" contains the "n_source" source accesses,
+ * with the must-sources preceding the may-sources.
+ * "array" contains the "n_array" groups of source accesses
+ * that access the same array and "array_table" maps the space
+ * of an accessed array to the corresponding group.
+ * "must" is set while the must-sources are being collected.
+ */
 struct isl_compute_flow_data {
 	isl_union_map *must_source;
 	isl_union_map *may_source;
@@ -1173,66 +1211,121 @@ struct isl_compute_flow_data {
 	isl_union_map *must_no_source;
 	isl_union_map *may_no_source;
 
-	int count;
 	int must;
-	isl_space *dim;
-	struct isl_sched_info *sink_info;
-	struct isl_sched_info **source_info;
-	isl_access_info *accesses;
+	int n_source;
+	int size_source;
+	struct isl_flow_source *source;
+	int n_array;
+	int size_array;
+	struct isl_flow_array **array;
+	struct isl_hash_table *array_table;
 };
 
-static int count_matching_array(__isl_take isl_map *map, void *user)
+static int has_array_space(const void *entry, const void *val)
 {
-	int eq;
-	isl_space *dim;
-	struct isl_compute_flow_data *data;
+	struct isl_flow_array *array = (struct isl_flow_array *)entry;
+	isl_space *space = (isl_space *)val;
 
-	data = (struct isl_compute_flow_data *)user;
+	return isl_space_is_equal(array->space, space);
+}
 
-	dim = isl_space_range(isl_map_get_space(map));
+/* Return the group of source accesses in "data" that access the array
+ * with space "space".
+ * If there is no such group, then a new group is created
+ * if "reserve" is set.  Otherwise, NULL is returned.
+ */
+static struct isl_flow_array *find_array(struct isl_compute_flow_data *data,
+	__isl_keep isl_space *space, int reserve)
+{
+	isl_ctx *ctx;
+	uint32_t hash;
+	struct isl_hash_table_entry *entry;
+	struct isl_flow_array *array;
 
-	eq = isl_space_is_equal(dim, data->dim);
+	if (!space)
+		return NULL;
 
-	isl_space_free(dim);
-	isl_map_free(map);
+	ctx = isl_space_get_ctx(space);
+	hash = isl_space_get_hash(space);
+	entry = isl_hash_table_find(ctx, data->array_table, hash,
+				    &has_array_space, space, reserve);
+	if (!entry)
+		return NULL;
+	if (entry->data)
+		return entry->data;
 
-	if (eq < 0)
-		return -1;
-	if (eq)
-		data->count++;
+	if (data->n_array >= data->size_array) {
+		int size = 3 * (data->size_array + 4) / 2;
+		struct isl_flow_array **list;
 
-	return 0;
+		list = isl_realloc_array(ctx, data->array,
+					struct isl_flow_array *, size);
+		if (!list)
+			goto error;
+		data->array = list;
+		data->size_array = size;
+	}
+
+	array = isl_calloc_type(ctx, struct isl_flow_array);
+	if (!array)
+		goto error;
+	array->space = isl_space_copy(space);
+	data->array[data->n_array++] = array;
+	entry->data = array;
+
+	return array;
+error:
+	isl_hash_table_remove(ctx, data->array_table, entry);
+	return NULL;
 }
 
-static int collect_matching_array(__isl_take isl_map *map, void *user)
+/* Add "map" to the list of source accesses in "user" and
+ * to the group of source accesses that access the same array.
+ */
+static int add_source(__isl_take isl_map *map, void *user)
 {
-	int eq;
-	isl_space *dim;
-	struct isl_sched_info *info;
-	struct isl_compute_flow_data *data;
-
-	data = (struct isl_compute_flow_data *)user;
+	struct isl_compute_flow_data *data = user;
+	struct isl_flow_source *source;
+	struct isl_flow_array *array;
+	isl_space *space;
+	isl_ctx *ctx;
 
-	dim = isl_space_range(isl_map_get_space(map));
+	if (!map)
+		return -1;
 
-	eq = isl_space_is_equal(dim, data->dim);
+	ctx = isl_map_get_ctx(map);
+	space = isl_space_range(isl_map_get_space(map));
+	array = find_array(data, space, 1);
+	isl_space_free(space);
+	if (!array)
+		goto error;
 
-	isl_space_free(dim);
+	if (data->n_source >= data->size_source) {
+		int size = 3 * (data->size_source + 4) / 2;
 
-	if (eq < 0)
-		goto error;
-	if (!eq) {
-		isl_map_free(map);
-		return 0;
+		source = isl_realloc_array(ctx, data->source,
+					struct isl_flow_source, size);
+		if (!source)
+			goto error;
+		data->source = source;
+		data->size_source = size;
 	}
+	if (array->n >= array->size) {
+		int size = 3 * (array->size + 4) / 2;
+		int *pos;
 
-	info = sched_info_alloc(map);
-	data->source_info[data->count] = info;
-
-	data->accesses = isl_access_info_add_source(data->accesses,
-						    map, data->must, info);
+		pos = isl_realloc_array(ctx, array->pos, int, size);
+		if (!pos)
+			goto error;
+		array->pos = pos;
+		array->size = size;
+	}
 
-	data->count++;
+	array->pos[array->n++] = data->n_source;
+	source = &data->source[data->n_source++];
+	source->map = map;
+	source->must = data->must;
+	source->info = NULL;
 
 	return 0;
 error:
@@ -1240,6 +1333,79 @@ error:
 	return -1;
 }
 
+/* Collect the must-sources and may-sources of "data" in a single list
+ * and group them by the array they access, such that the source
+ * accesses that access the same array as a given sink access
+ * can be found without considering all source accesses.
+ */
+static int collect_sources(struct isl_compute_flow_data *data)
+{
+	isl_ctx *ctx;
+	int n;
+
+	data->n_source = data->size_source = 0;
+	data->source = NULL;
+	data->n_array = data->size_array = 0;
+	data->array = NULL;
+	data->array_table = NULL;
+
+	if (!data->must_source || !data->may_source)
+		return -1;
+
+	ctx = isl_union_map_get_ctx(data->must_source);
+	n = isl_union_map_n_map(data->must_source) +
+	    isl_union_map_n_map(data->may_source);
+	data->array_table = isl_hash_table_alloc(ctx, n);
+	if (!data->array_table)
+		return -1;
+
+	data->must = 1;
+	if (isl_union_map_foreach_map(data->must_source,
+				    &add_source, data) < 0)
+		return -1;
+	data->must = 0;
+	if (isl_union_map_foreach_map(data->may_source,
+				    &add_source, data) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* Free the source accesses collected by collect_sources.
+ */
+static void free_sources(struct isl_compute_flow_data *data)
+{
+	int i;
+
+	for (i = 0; i < data->n_source; ++i) {
+		isl_map_free(data->source[i].map);
+		sched_info_free(data->source[i].info);
+	}
+	free(data->source);
+	for (i = 0; i < data->n_array; ++i) {
+		isl_space_free(data->array[i]->space);
+		free(data->array[i]->pos);
+		free(data->array[i]);
+	}
+	free(data->array);
+	if (data->array_table)
+		isl_hash_table_free(isl_union_map_get_ctx(data->must_source),
+				    data->array_table);
+}
+
+/* Return the schedule information of the source access
+ * at position "pos" in "data", computing it if needed.
+ */
+static struct isl_sched_info *get_source_info(
+	struct isl_compute_flow_data *data, int pos)
+{
+	struct isl_flow_source *source = &data->source[pos];
+
+	if (!source->info)
+		source->info = sched_info_alloc(source->map);
+	return source->info;
+}
+
 /* Determine the shared nesting level and the "textual order" of
  * the given accesses.
  *
@@ -1288,51 +1454,44 @@ static int before(void *first, void *second)
 /* Given a sink access, look for all the source accesses that access
  * the same array and perform dataflow analysis on them using
  * isl_access_info_compute_flow.
+ * The source accesses have already been grouped by the array
+ * they access in collect_sources.
  */
 static int compute_flow(__isl_take isl_map *map, void *user)
 {
-	int i;
-	isl_ctx *ctx;
+	int i, n;
+	isl_space *space;
 	struct isl_compute_flow_data *data;
+	struct isl_flow_array *array;
+	struct isl_sched_info *sink_info;
+	isl_access_info *acc;
 	isl_flow *flow;
 
 	data = (struct isl_compute_flow_data *)user;
 
-	ctx = isl_map_get_ctx(map);
-
-	data->accesses = NULL;
-	data->sink_info = NULL;
-	data->source_info = NULL;
-	data->count = 0;
-	data->dim = isl_space_range(isl_map_get_space(map));
+	space = isl_space_range(isl_map_get_space(map));
+	array = find_array(data, space, 0);
+	isl_space_free(space);
+	n = array ? array->n : 0;
 
-	if (isl_union_map_foreach_map(data->must_source,
-					&count_matching_array, data) < 0)
-		goto error;
-	if (isl_union_map_foreach_map(data->may_source,
-					&count_matching_array, data) < 0)
+	sink_info = sched_info_alloc(map);
+	acc = isl_access_info_alloc(isl_map_copy(map), sink_info, &before, n);
+	if (!sink_info || !acc)
 		goto error;
 
-	data->sink_info = sched_info_alloc(map);
-	data->source_info = isl_calloc_array(ctx, struct isl_sched_info *,
-					     data->count);
+	for (i = 0; i < n; ++i) {
+		struct isl_flow_source *source = &data->source[array->pos[i]];
+		struct isl_sched_info *info;
 
-	data->accesses = isl_access_info_alloc(isl_map_copy(map),
-				data->sink_info, &before, data->count);
-	if (!data->sink_info || !data->source_info || !data->accesses)
-		goto error;
-	data->count = 0;
-	data->must = 1;
-	if (isl_union_map_foreach_map(data->must_source,
-					&collect_matching_array, data) < 0)
-		goto error;
-	data->must = 0;
-	if (isl_union_map_foreach_map(data->may_source,
-					&collect_matching_array, data) < 0)
-		goto error;
+		info = get_source_info(data, array->pos[i]);
+		if (!info)
+			goto error;
+		acc = isl_access_info_add_source(acc,
+				isl_map_copy(source->map), source->must, info);
+	}
 
-	flow = isl_access_info_compute_flow(data->accesses);
-	data->accesses = NULL;
+	flow = isl_access_info_compute_flow(acc);
+	acc = NULL;
 
 	if (!flow)
 		goto error;
@@ -1353,30 +1512,380 @@ static int compute_flow(__isl_take isl_map *map, void *user)
 
 	isl_flow_free(flow);
 
-	sched_info_free(data->sink_info);
-	if (data->source_info) {
-		for (i = 0; i < data->count; ++i)
-			sched_info_free(data->source_info[i]);
-		free(data->source_info);
-	}
-	isl_space_free(data->dim);
+	sched_info_free(sink_info);
 	isl_map_free(map);
 
 	return 0;
 error:
-	isl_access_info_free(data->accesses);
-	sched_info_free(data->sink_info);
-	if (data->source_info) {
-		for (i = 0; i < data->count; ++i)
-			sched_info_free(data->source_info[i]);
-		free(data->source_info);
-	}
-	isl_space_free(data->dim);
+	isl_access_info_free(acc);
+	sched_info_free(sink_info);
 	isl_map_free(map);
 
 	return -1;
 }
 
+/* A dataflow problem for a single sink access, handled by a worker
+ * of compute_flow_parallel.
+ *
+ * "sink" is the sink access in the main context and "array"
+ * is the group of source accesses that access the same array,
+ * or NULL if there are no such source accesses.
+ * The remaining fields are set by the worker and live in the context
+ * of the worker.  "must_no_source" and "may_no_source" are the no-source
+ * relations and "dep" contains the "n_dep" dependence relations,
+ * with "dep_must" indicating which of them are must-dependences.
+ */
+struct isl_flow_task {
+	isl_map *sink;
+	struct isl_flow_array *array;
+
+	isl_map *must_no_source;
+	isl_map *may_no_source;
+	int n_dep;
+	isl_map **dep;
+	int *dep_must;
+};
+
+/* Internal data structure for compute_flow_parallel.
+ *
+ * "data" contains the source accesses in the main context.
+ * "task" is the list of "n_task" sink accesses.
+ * "next" is the index of the next task that has not been taken
+ * by any worker yet.
+ * "stop" is set as soon as any worker failed.
+ * "lock" protects "next" and "stop".
+ */
+struct isl_flow_parallel_data {
+	struct isl_compute_flow_data *data;
+
+	int n_task;
+	int size;
+	struct isl_flow_task *task;
+
+	int next;
+	int stop;
+	struct isl_mutex lock;
+};
+
+/* A worker of compute_flow_parallel.
+ * "ctx" is the context in which the worker operates and
+ * "r" is negative if the worker failed.
+ * "source" contains the copies in "ctx" of the source accesses
+ * that have been needed by the worker so far and "info"
+ * the corresponding schedule information.
+ */
+struct isl_flow_worker {
+	struct isl_flow_parallel_data *par;
+	isl_ctx *ctx;
+	int r;
+	isl_map **source;
+	struct isl_sched_info **info;
+};
+
+/* Add "sink" to the list of tasks in "user", along with the group
+ * of source accesses that access the same array.
+ */
+static int add_flow_task(__isl_take isl_map *sink, void *user)
+{
+	struct isl_flow_parallel_data *par = user;
+	struct isl_flow_task *task;
+	isl_space *space;
+	isl_ctx *ctx;
+
+	if (!sink)
+		return -1;
+
+	ctx = isl_map_get_ctx(sink);
+	if (par->n_task >= par->size) {
+		int size = 3 * (par->size + 4) / 2;
+		task = isl_realloc_array(ctx, par->task,
+					struct isl_flow_task, size);
+		if (!task) {
+			isl_map_free(sink);
+			return -1;
+		}
+		par->task = task;
+		par->size = size;
+	}
+
+	task = &par->task[par->n_task++];
+	memset(task, 0, sizeof(*task));
+	task->sink = sink;
+	space = isl_space_range(isl_map_get_space(sink));
+	if (!space)
+		return -1;
+	task->array = find_array(par->data, space, 0);
+	isl_space_free(space);
+
+	return 0;
+}
+
+/* Return the copy in the context of "worker" of the source access
+ * at position "pos", constructing it along with its schedule information
+ * if it has not been needed before.
+ * The schedule information is stored in "info".
+ */
+static __isl_keep isl_map *worker_source(struct isl_flow_worker *worker,
+	int pos, struct isl_sched_info **info)
+{
+	if (!worker->source[pos]) {
+		isl_map *source = worker->par->data->source[pos].map;
+		worker->source[pos] = isl_map_transfer(worker->ctx, source);
+		worker->info[pos] = sched_info_alloc(worker->source[pos]);
+	}
+	*info = worker->info[pos];
+	return worker->source[pos];
+}
+
+/* Perform dataflow analysis on the sink access of "task"
+ * in the context of "worker" and keep track of the results in "task".
+ * This performs the same computation as compute_flow,
+ * but on copies of the accesses in the context of the worker.
+ */
+static int compute_task_flow(struct isl_flow_worker *worker,
+	struct isl_flow_task *task)
+{
+	int i, n;
+	isl_ctx *ctx = worker->ctx;
+	struct isl_compute_flow_data *data = worker->par->data;
+	isl_map *sink;
+	isl_access_info *acc;
+	struct isl_sched_info *sink_info;
+	isl_flow *flow;
+
+	n = task->array ? task->array->n : 0;
+	sink = isl_map_transfer(ctx, task->sink);
+	sink_info = sched_info_alloc(sink);
+	acc = isl_access_info_alloc(sink, sink_info, &before, n);
+	if (!sink_info || !acc)
+		goto error;
+
+	for (i = 0; i < n; ++i) {
+		int pos = task->array->pos[i];
+		struct isl_sched_info *info;
+		isl_map *source;
+
+		source = worker_source(worker, pos, &info);
+		if (!info)
+			goto error;
+		acc = isl_access_info_add_source(acc, isl_map_copy(source),
+						data->source[pos].must, info);
+	}
+
+	flow = isl_access_info_compute_flow(acc);
+	if (!flow)
+		goto error_info;
+
+	task->must_no_source = isl_flow_get_no_source(flow, 1);
+	task->may_no_source = isl_flow_get_no_source(flow, 0);
+	task->dep = isl_calloc_array(ctx, isl_map *, flow->n_source);
+	task->dep_must = isl_alloc_array(ctx, int, flow->n_source);
+	if (flow->n_source && (!task->dep || !task->dep_must)) {
+		isl_flow_free(flow);
+		goto error_info;
+	}
+	task->n_dep = flow->n_source;
+	for (i = 0; i < flow->n_source; ++i) {
+		task->dep[i] = isl_map_copy(flow->dep[i].map);
+		task->dep_must[i] = flow->dep[i].must;
+	}
+	isl_flow_free(flow);
+
+	sched_info_free(sink_info);
+
+	if (!task->must_no_source || !task->may_no_source)
+		return -1;
+	return 0;
+error:
+	isl_access_info_free(acc);
+error_info:
+	sched_info_free(sink_info);
+	return -1;
+}
+
+/* Repeatedly take the next sink access from the shared list and
+ * perform dataflow analysis on that sink in the context of the worker.
+ *
+ * Since the objects in the main context cannot be used
+ * from the worker, the worker constructs copies of the sink and
+ * of the sources in its own context.  Each source is only copied
+ * the first time it is needed by the worker.
+ * The results are kept in the worker context and are only transferred
+ * to the main context after all workers have finished.
+ */
+static void *flow_worker(void *user)
+{
+	struct isl_flow_worker *worker = user;
+	struct isl_flow_parallel_data *par = worker->par;
+	int r = 0, t;
+
+	while (r >= 0) {
+		isl_mutex_lock(&par->lock);
+		t = par->stop || par->next >= par->n_task ? -1 : par->next++;
+		isl_mutex_unlock(&par->lock);
+		if (t < 0)
+			break;
+
+		r = compute_task_flow(worker, &par->task[t]);
+	}
+
+	isl_mutex_lock(&par->lock);
+	if (r < 0)
+		par->stop = 1;
+	isl_mutex_unlock(&par->lock);
+	worker->r = r;
+
+	return NULL;
+}
+
+/* Free all tasks in "par".
+ * The results of the tasks are freed as well, so this function
+ * needs to be called before the worker contexts are freed.
+ */
+static void free_flow_parallel_data(struct isl_flow_parallel_data *par)
+{
+	int i, j;
+
+	for (i = 0; i < par->n_task; ++i) {
+		struct isl_flow_task *task = &par->task[i];
+
+		isl_map_free(task->sink);
+		isl_map_free(task->must_no_source);
+		isl_map_free(task->may_no_source);
+		for (j = 0; j < task->n_dep; ++j)
+			isl_map_free(task->dep[j]);
+		free(task->dep);
+		free(task->dep_must);
+	}
+	free(par->task);
+}
+
+/* Free the copies of the source accesses in the context of "worker",
+ * but not the context itself.
+ */
+static void free_flow_worker_sources(struct isl_flow_worker *worker)
+{
+	int i;
+
+	if (worker->source)
+		for (i = 0; i < worker->par->data->n_source; ++i)
+			isl_map_free(worker->source[i]);
+	if (worker->info)
+		for (i = 0; i < worker->par->data->n_source; ++i)
+			sched_info_free(worker->info[i]);
+	free(worker->source);
+	free(worker->info);
+}
+
+/* Add the results computed by a worker for the sink access of "task"
+ * to "data", in the same way as in compute_flow.
+ */
+static void add_flow_task_result(isl_ctx *ctx,
+	struct isl_compute_flow_data *data, struct isl_flow_task *task)
+{
+	int i;
+
+	data->must_no_source = isl_union_map_union(data->must_no_source,
+		isl_union_map_from_map(isl_map_transfer(ctx,
+						task->must_no_source)));
+	data->may_no_source = isl_union_map_union(data->may_no_source,
+		isl_union_map_from_map(isl_map_transfer(ctx,
+						task->may_no_source)));
+
+	for (i = 0; i < task->n_dep; ++i) {
+		isl_union_map *dep;
+		dep = isl_union_map_from_map(isl_map_transfer(ctx,
+								task->dep[i]));
+		if (task->dep_must[i])
+			data->must_dep = isl_union_map_union(data->must_dep, dep);
+		else
+			data->may_dep = isl_union_map_union(data->may_dep, dep);
+	}
+}
+
+/* Perform dataflow analysis on each of the sink accesses in "sink"
+ * using (at most) "n_thread" threads and add the results to "data".
+ *
+ * The dataflow problems of the different sink accesses
+ * are independent of each other, so each worker repeatedly takes
+ * the next sink access and performs the analysis on that sink
+ * in its own isl_ctx, as in bernstein_coefficients_parallel.
+ * The source accesses accessing the same array as a given sink
+ * are determined in the main thread.
+ * After all workers have finished, the results are transferred
+ * to the main context and combined in the same order as
+ * in the sequential computation, such that the final result
+ * does not depend on the number of threads.
+ */
+static int compute_flow_parallel(__isl_keep isl_union_map *sink,
+	struct isl_compute_flow_data *data, int n_thread)
+{
+	int i, r;
+	isl_ctx *ctx;
+	struct isl_flow_parallel_data par;
+	struct isl_flow_worker *worker = NULL;
+
+	ctx = isl_union_map_get_ctx(sink);
+	memset(&par, 0, sizeof(par));
+	par.data = data;
+	if (isl_union_map_foreach_map(sink, &add_flow_task, &par) < 0)
+		goto error;
+	if (n_thread > par.n_task)
+		n_thread = par.n_task;
+
+	worker = isl_calloc_array(ctx, struct isl_flow_worker, n_thread);
+	if (n_thread && !worker)
+		goto error;
+	for (i = 0; i < n_thread; ++i) {
+		worker[i].par = &par;
+		worker[i].ctx = isl_thread_ctx_alloc(ctx);
+		if (!worker[i].ctx)
+			goto error;
+		worker[i].source = isl_calloc_array(worker[i].ctx,
+						isl_map *, data->n_source);
+		worker[i].info = isl_calloc_array(worker[i].ctx,
+				struct isl_sched_info *, data->n_source);
+		if (data->n_source && (!worker[i].source || !worker[i].info))
+			goto error;
+	}
+
+	if (isl_mutex_init(ctx, &par.lock) < 0)
+		goto error;
+	r = isl_thread_run(ctx, n_thread, &flow_worker, worker,
+			    sizeof(*worker));
+	isl_mutex_destroy(&par.lock);
+	if (r < 0)
+		goto error;
+
+	for (i = 0; i < n_thread; ++i) {
+		if (worker[i].r < 0 && r == 0) {
+			isl_thread_report_error(ctx, worker[i].ctx,
+				"dataflow analysis failed in worker");
+			r = -1;
+		}
+	}
+
+	for (i = 0; r == 0 && i < par.n_task; ++i)
+		add_flow_task_result(ctx, data, &par.task[i]);
+
+	free_flow_parallel_data(&par);
+	for (i = 0; i < n_thread; ++i) {
+		free_flow_worker_sources(&worker[i]);
+		isl_ctx_free(worker[i].ctx);
+	}
+	free(worker);
+	return r;
+error:
+	free_flow_parallel_data(&par);
+	if (worker)
+		for (i = 0; i < n_thread; ++i) {
+			free_flow_worker_sources(&worker[i]);
+			isl_ctx_free(worker[i].ctx);
+		}
+	free(worker);
+	return -1;
+}
+
 /* Given a collection of "sink" and "source" accesses,
  * compute for each iteration of a sink access
  * and for each element accessed by that iteration,
@@ -1391,7 +1900,10 @@ error:
  *
  * We first prepend the schedule dimensions to the domain
  * of the accesses so that we can easily compare their relative order.
- * Then we consider each sink access individually in compute_flow.
+ * Then we group the source accesses by the array they access
+ * and consider each sink access individually in compute_flow.
+ * If more than one thread may be used and if there are several
+ * sink accesses, then the sink accesses are handled in parallel.
  */
 int isl_union_map_compute_flow(__isl_take isl_union_map *sink,
 	__isl_take isl_union_map *must_source,
@@ -1404,6 +1916,8 @@ int isl_union_map_compute_flow(__isl_take isl_union_map *sink,
 	isl_space *dim;
 	isl_union_map *range_map = NULL;
 	struct isl_compute_flow_data data;
+	int n_thread;
+	int r;
 
 	sink = isl_union_map_align_params(sink,
 					    isl_union_map_get_space(must_source));
@@ -1436,7 +1950,15 @@ int isl_union_map_compute_flow(__isl_take isl_union_map *sink,
 
 	isl_space_free(dim);
 
-	if (isl_union_map_foreach_map(sink, &compute_flow, &data) < 0)
+	n_thread = sink ? isl_thread_n_thread(isl_union_map_get_ctx(sink)) : 1;
+	if (collect_sources(&data) < 0)
+		r = -1;
+	else if (n_thread > 1 && isl_union_map_n_map(sink) > 1)
+		r = compute_flow_parallel(sink, &data, n_thread);
+	else
+		r = isl_union_map_foreach_map(sink, &compute_flow, &data);
+	free_sources(&data);
+	if (r < 0)
 		goto error;
 
 	isl_union_map_free(sink);
@@ -1491,3 +2013,974 @@ error:
 		*may_no_source = NULL;
 	return -1;
 }
+
+/* Return a relation between time-stamped statement instances
+ * in a space of the form
+ *
+ *	[[O1 -> N1] -> S1] -> [[O2 -> N2] -> S2]
+ *
+ * with O1 starting at position "in_pos" and O2 starting at position
+ * "out_pos", where the first "level" dimensions of the input and
+ * the output are equal.  If "lt" is set, then the next input dimension
+ * is moreover smaller than the next output dimension.
+ * If "gt" is set, then it is greater instead.
+ */
+static __isl_give isl_basic_map *order_at(__isl_take isl_space *space,
+	int in_pos, int out_pos, int level, int lt, int gt)
+{
+	int i;
+	isl_local_space *ls;
+	isl_basic_map *bmap;
+	isl_constraint *c;
+
+	ls = isl_local_space_from_space(isl_space_copy(space));
+	bmap = isl_basic_map_universe(space);
+	for (i = 0; i < level; ++i) {
+		c = isl_equality_alloc(isl_local_space_copy(ls));
+		c = isl_constraint_set_coefficient_si(c, isl_dim_in,
+							in_pos + i, 1);
+		c = isl_constraint_set_coefficient_si(c, isl_dim_out,
+							out_pos + i, -1);
+		bmap = isl_basic_map_add_constraint(bmap, c);
+	}
+	if (lt || gt) {
+		int sign = lt ? 1 : -1;
+		c = isl_inequality_alloc(isl_local_space_copy(ls));
+		c = isl_constraint_set_coefficient_si(c, isl_dim_in,
+							in_pos + level, -sign);
+		c = isl_constraint_set_coefficient_si(c, isl_dim_out,
+							out_pos + level, sign);
+		c = isl_constraint_set_constant_si(c, -1);
+		bmap = isl_basic_map_add_constraint(bmap, c);
+	}
+	isl_local_space_free(ls);
+
+	return bmap;
+}
+
+/* Extract the number of old and new schedule dimensions
+ * from a time-stamped space [O -> N] -> S.
+ */
+static int stamp_dims(__isl_take isl_space *space, int *n_old, int *n_new)
+{
+	space = isl_space_unwrap(space);
+	space = isl_space_unwrap(isl_space_domain(space));
+	if (!space)
+		return -1;
+	*n_old = isl_space_dim(space, isl_dim_in);
+	*n_new = isl_space_dim(space, isl_dim_out);
+	isl_space_free(space);
+	return 0;
+}
+
+/* Internal data structure for isl_union_map_schedule_is_legal.
+ *
+ * "reads" and "writes" are the time-stamped read and write accesses.
+ * "stamp" maps time-stamped statement instances to the statement
+ * instances.
+ * "source" is the write access that is currently being considered and
+ * "read" is set if it is being paired with the read accesses.
+ * "legal" is cleared as soon as a violated dependence has been found.
+ * "error" is set if an error occurred, including while constructing
+ * a witness after a violated dependence has been found.
+ * "witness" is set to a violated dependence if it is not NULL.
+ */
+struct isl_legality_data {
+	isl_union_map *reads;
+	isl_union_map *writes;
+	isl_union_map *stamp;
+
+	isl_map *source;
+	int read;
+
+	int legal;
+	int error;
+	isl_map **witness;
+};
+
+/* Store a single pair of statement instances in "viol",
+ * a relation between time-stamped statement instances,
+ * in data->witness.
+ */
+static int set_witness(struct isl_legality_data *data,
+	__isl_take isl_map *viol)
+{
+	isl_union_map *witness;
+
+	witness = isl_union_map_from_map(
+			isl_map_from_basic_map(isl_map_sample(viol)));
+	witness = isl_union_map_apply_domain(witness,
+					isl_union_map_copy(data->stamp));
+	witness = isl_union_map_apply_range(witness,
+					isl_union_map_copy(data->stamp));
+	*data->witness = isl_map_from_union_map(witness);
+
+	return *data->witness ? 0 : -1;
+}
+
+/* Check if any element accessed by both "source" and "sink"
+ * is accessed by an instance of "sink" after it is accessed
+ * by an instance of "source" according to the old schedule,
+ * while the instance of "sink" is not scheduled after
+ * the instance of "source" by the new schedule.
+ * If so, clear data->legal and store a witness if requested.
+ *
+ * The accesses have time-stamped domains of the form [[O -> N] -> S],
+ * with O the old schedule and N the new schedule.
+ * The old dependences are considered one level at a time,
+ * in the same way as in compute_val_based_dependences, and
+ * each of them is compared against the new schedule,
+ * again one level at a time, so that the check can stop
+ * as soon as a violation is found without constructing
+ * the complete dependence relation.
+ * Schedules with different numbers of dimensions are compared
+ * on their common prefix.
+ */
+static int check_pair(struct isl_legality_data *data,
+	__isl_keep isl_map *source, __isl_keep isl_map *sink)
+{
+	int i, j;
+	int n_old1, n_new1, n_old2, n_new2, n_old, n_new;
+	int r = 0;
+	isl_map *same;
+	isl_space *space;
+
+	if (stamp_dims(isl_space_domain(isl_map_get_space(source)),
+			&n_old1, &n_new1) < 0 ||
+	    stamp_dims(isl_space_domain(isl_map_get_space(sink)),
+			&n_old2, &n_new2) < 0)
+		return -1;
+	n_old = n_old1 < n_old2 ? n_old1 : n_old2;
+	n_new = n_new1 < n_new2 ? n_new1 : n_new2;
+
+	same = isl_map_apply_range(isl_map_copy(source),
+				    isl_map_reverse(isl_map_copy(sink)));
+	space = isl_map_get_space(same);
+	if (!space)
+		r = -1;
+
+	for (i = 0; r == 0 && data->legal && i < n_old; ++i) {
+		isl_map *dep;
+		int empty;
+
+		dep = isl_map_intersect(isl_map_copy(same),
+			isl_map_from_basic_map(order_at(isl_space_copy(space),
+							0, 0, i, 1, 0)));
+		empty = isl_map_is_empty(dep);
+		if (empty < 0)
+			r = -1;
+
+		for (j = 0; !empty && r == 0 && data->legal && j <= n_new; ++j) {
+			isl_map *viol;
+			int no_viol;
+
+			viol = isl_map_intersect(isl_map_copy(dep),
+				isl_map_from_basic_map(order_at(
+					isl_space_copy(space), n_old1, n_old2,
+					j, 0, j < n_new)));
+			no_viol = isl_map_is_empty(viol);
+			if (no_viol < 0)
+				r = -1;
+			if (no_viol) {
+				isl_map_free(viol);
+				continue;
+			}
+			data->legal = 0;
+			if (r == 0 && data->witness)
+				r = set_witness(data, viol);
+			else
+				isl_map_free(viol);
+		}
+		isl_map_free(dep);
+	}
+
+	isl_space_free(space);
+	isl_map_free(same);
+	return r;
+}
+
+/* Check the pairs formed by data->source and the access "map"
+ * if they access the same array.
+ * If "map" is a read (data->read is set), then both orders are checked.
+ * Otherwise, only the pair with data->source as first access
+ * is checked since the other order is handled when "map" itself
+ * is considered as data->source.
+ * Return -1 to interrupt the enumeration as soon as a violated
+ * dependence has been found.  Errors are recorded in data->error
+ * to distinguish them from such an interruption.
+ */
+static int check_pairs_with(__isl_take isl_map *map, void *user)
+{
+	struct isl_legality_data *data = user;
+	int match;
+
+	match = isl_space_tuple_match(data->source->dim, isl_dim_out,
+					map->dim, isl_dim_out);
+	if (match < 0)
+		goto error;
+	if (match && check_pair(data, data->source, map) < 0)
+		goto error;
+	if (match && data->legal && data->read &&
+	    check_pair(data, map, data->source) < 0)
+		goto error;
+
+	isl_map_free(map);
+	return data->legal ? 0 : -1;
+error:
+	data->error = 1;
+	isl_map_free(map);
+	return -1;
+}
+
+/* Check that "schedule" assigns a schedule time to every statement
+ * instance that performs any of the accesses in "reads" or "writes".
+ * Return 0 if so and -1 (with an error) otherwise.
+ */
+static int check_schedule_covers_accesses(__isl_keep isl_union_map *reads,
+	__isl_keep isl_union_map *writes, __isl_keep isl_union_map *schedule)
+{
+	isl_union_set *accessing, *scheduled;
+	int covered;
+
+	accessing = isl_union_set_union(
+			isl_union_map_domain(isl_union_map_copy(reads)),
+			isl_union_map_domain(isl_union_map_copy(writes)));
+	scheduled = isl_union_map_domain(isl_union_map_copy(schedule));
+	covered = isl_union_set_is_subset(accessing, scheduled);
+	isl_union_set_free(accessing);
+	isl_union_set_free(scheduled);
+
+	if (covered < 0)
+		return -1;
+	if (!covered)
+		isl_die(isl_union_map_get_ctx(schedule), isl_error_invalid,
+			"schedule does not cover all accesses", return -1);
+	return 0;
+}
+
+/* Check all pairs of accesses to the same array that involve
+ * the write access "map" as first access, or as second access
+ * in case the other access is a read.
+ */
+static int check_write(__isl_take isl_map *map, void *user)
+{
+	struct isl_legality_data *data = user;
+	int r;
+
+	data->source = map;
+	data->read = 0;
+	r = isl_union_map_foreach_map(data->writes, &check_pairs_with, data);
+	if (r >= 0) {
+		data->read = 1;
+		r = isl_union_map_foreach_map(data->reads,
+						&check_pairs_with, data);
+	}
+	data->source = NULL;
+	isl_map_free(map);
+
+	return r;
+}
+
+/* Check whether the schedule "new_schedule" respects all
+ * memory-based dependences between the accesses in "reads" and
+ * "writes" under the schedule "old_schedule".
+ * That is, check that whenever two instances access the same
+ * array element, at least one of them writes to it and
+ * the first is scheduled before the second by "old_schedule",
+ * then the second is also scheduled after the first by "new_schedule".
+ * Return 1 if this is the case, 0 if not and -1 on error.
+ * In particular, it is an error if either schedule does not cover
+ * all accessing statement instances, since the accesses of
+ * the instances that are not covered would otherwise silently
+ * be ignored.
+ * If "witness" is not NULL and a violated dependence is found, then
+ * *witness is set to a map containing a single pair of instances
+ * (for specific values of the parameters) that is violated.
+ * Otherwise, *witness is set to NULL.
+ *
+ * As in isl_union_map_compute_flow, the accesses are first
+ * time-stamped, here with both schedules, resulting in accesses
+ * of the form [[O -> N] -> S] -> A.
+ * Each pair of accesses is then considered separately in check_pair
+ * and the computation stops as soon as a violation has been found.
+ * The dependences themselves are never computed.
+ */
+int isl_union_map_schedule_is_legal(__isl_keep isl_union_map *reads,
+	__isl_keep isl_union_map *writes, __isl_keep isl_union_map *old_schedule,
+	__isl_keep isl_union_map *new_schedule, __isl_give isl_map **witness)
+{
+	isl_space *space;
+	isl_union_map *schedule, *stamp;
+	struct isl_legality_data data;
+	int r;
+
+	if (witness)
+		*witness = NULL;
+	if (!reads || !writes || !old_schedule || !new_schedule)
+		return -1;
+	if (check_schedule_covers_accesses(reads, writes, old_schedule) < 0 ||
+	    check_schedule_covers_accesses(reads, writes, new_schedule) < 0)
+		return -1;
+
+	space = isl_union_map_get_space(reads);
+	space = isl_space_align_params(space, isl_union_map_get_space(writes));
+	space = isl_space_align_params(space,
+				isl_union_map_get_space(old_schedule));
+	space = isl_space_align_params(space,
+				isl_union_map_get_space(new_schedule));
+	schedule = isl_union_map_range_product(
+		isl_union_map_align_params(isl_union_map_copy(old_schedule),
+					    isl_space_copy(space)),
+		isl_union_map_align_params(isl_union_map_copy(new_schedule),
+					    isl_space_copy(space)));
+	stamp = isl_union_map_range_map(isl_union_map_reverse(schedule));
+	schedule = isl_union_map_reverse(isl_union_map_copy(stamp));
+
+	data.reads = isl_union_map_align_params(isl_union_map_copy(reads),
+						isl_space_copy(space));
+	data.reads = isl_union_map_apply_domain(data.reads,
+						isl_union_map_copy(schedule));
+	data.writes = isl_union_map_align_params(isl_union_map_copy(writes),
+						space);
+	data.writes = isl_union_map_apply_domain(data.writes, schedule);
+	data.stamp = stamp;
+	data.source = NULL;
+	data.read = 0;
+	data.legal = 1;
+	data.error = 0;
+	data.witness = witness;
+
+	r = isl_union_map_foreach_map(data.writes, &check_write, &data);
+
+	isl_union_map_free(data.reads);
+	isl_union_map_free(data.writes);
+	isl_union_map_free(data.stamp);
+
+	if (data.error || (r < 0 && data.legal)) {
+		if (witness)
+			*witness = isl_map_free(*witness);
+		return -1;
+	}
+	return data.legal;
+}
+
+/* The accesses to a single array, as used in the last computation
+ * of an isl_incremental_flow, along with the dataflow results
+ * for the sink accesses to that array.
+ * "space" is the space of the array.
+ */
+struct isl_incremental_flow_array {
+	isl_space *space;
+
+	isl_union_map *sink;
+	isl_union_map *must_source;
+	isl_union_map *may_source;
+
+	isl_union_map *must_dep;
+	isl_union_map *may_dep;
+	isl_union_map *must_no_source;
+	isl_union_map *may_no_source;
+};
+
+/* The result of a dataflow analysis that can be updated incrementally.
+ *
+ * "schedule" is the schedule used in the last computation.
+ * "array" contains the accesses and the corresponding dataflow results
+ * for each of the "n_array" accessed arrays and "table" maps
+ * the space of an array to the corresponding element of "array".
+ * "must_dep", "may_dep", "must_no_source" and "may_no_source"
+ * are the combined results over all arrays.
+ */
+struct isl_incremental_flow {
+	isl_ctx *ctx;
+
+	isl_union_map *schedule;
+
+	int n_array;
+	int size;
+	struct isl_incremental_flow_array **array;
+	struct isl_hash_table *table;
+
+	isl_union_map *must_dep;
+	isl_union_map *may_dep;
+	isl_union_map *must_no_source;
+	isl_union_map *may_no_source;
+};
+
+static void incremental_flow_array_free(
+	struct isl_incremental_flow_array *array)
+{
+	if (!array)
+		return;
+	isl_space_free(array->space);
+	isl_union_map_free(array->sink);
+	isl_union_map_free(array->must_source);
+	isl_union_map_free(array->may_source);
+	isl_union_map_free(array->must_dep);
+	isl_union_map_free(array->may_dep);
+	isl_union_map_free(array->must_no_source);
+	isl_union_map_free(array->may_no_source);
+	free(array);
+}
+
+static void incremental_flow_array_list_free(isl_ctx *ctx, int n,
+	struct isl_incremental_flow_array **array,
+	struct isl_hash_table *table)
+{
+	int i;
+
+	for (i = 0; i < n; ++i)
+		incremental_flow_array_free(array[i]);
+	free(array);
+	if (table)
+		isl_hash_table_free(ctx, table);
+}
+
+/* Allocate an isl_incremental_flow that has not been used
+ * in any computation yet.
+ */
+__isl_give isl_incremental_flow *isl_incremental_flow_alloc(isl_ctx *ctx)
+{
+	isl_incremental_flow *flow;
+
+	if (!ctx)
+		return NULL;
+
+	flow = isl_calloc_type(ctx, struct isl_incremental_flow);
+	if (!flow)
+		return NULL;
+	flow->ctx = ctx;
+	isl_ctx_ref(ctx);
+
+	return flow;
+}
+
+void *isl_incremental_flow_free(__isl_take isl_incremental_flow *flow)
+{
+	if (!flow)
+		return NULL;
+
+	incremental_flow_array_list_free(flow->ctx, flow->n_array,
+					flow->array, flow->table);
+	isl_union_map_free(flow->schedule);
+	isl_union_map_free(flow->must_dep);
+	isl_union_map_free(flow->may_dep);
+	isl_union_map_free(flow->must_no_source);
+	isl_union_map_free(flow->may_no_source);
+	isl_ctx_deref(flow->ctx);
+	free(flow);
+
+	return NULL;
+}
+
+isl_ctx *isl_incremental_flow_get_ctx(__isl_keep isl_incremental_flow *flow)
+{
+	return flow ? flow->ctx : NULL;
+}
+
+static int has_incremental_array_space(const void *entry, const void *val)
+{
+	struct isl_incremental_flow_array *array;
+	isl_space *space = (isl_space *)val;
+
+	array = (struct isl_incremental_flow_array *)entry;
+	return isl_space_is_equal(array->space, space);
+}
+
+/* Internal data structure for isl_incremental_flow_compute.
+ *
+ * "params" is the parameter space of the accesses.
+ * "array" collects the "n_array" arrays that are accessed by the accesses
+ * and "table" maps the space of an array to the corresponding element.
+ * "type" determines whether the accesses that are being collected
+ * are sinks (0), must-sources (1) or may-sources (2).
+ */
+struct isl_incremental_flow_data {
+	isl_space *params;
+
+	int n_array;
+	int size;
+	struct isl_incremental_flow_array **array;
+	struct isl_hash_table *table;
+
+	int type;
+};
+
+/* Return the element of data->array that corresponds to the array
+ * with space "space", creating it if needed.
+ */
+static struct isl_incremental_flow_array *incremental_flow_get_array(
+	struct isl_incremental_flow_data *data, __isl_keep isl_space *space)
+{
+	isl_ctx *ctx;
+	uint32_t hash;
+	struct isl_hash_table_entry *entry;
+	struct isl_incremental_flow_array *array;
+
+	ctx = isl_space_get_ctx(space);
+	hash = isl_space_get_hash(space);
+	entry = isl_hash_table_find(ctx, data->table, hash,
+				    &has_incremental_array_space, space, 1);
+	if (!entry)
+		return NULL;
+	if (entry->data)
+		return entry->data;
+
+	if (data->n_array >= data->size) {
+		int size = 3 * (data->size + 4) / 2;
+		struct isl_incremental_flow_array **list;
+
+		list = isl_realloc_array(ctx, data->array,
+				struct isl_incremental_flow_array *, size);
+		if (!list)
+			goto error;
+		data->array = list;
+		data->size = size;
+	}
+
+	array = isl_calloc_type(ctx, struct isl_incremental_flow_array);
+	if (!array)
+		goto error;
+	data->array[data->n_array++] = array;
+	entry->data = array;
+	array->space = isl_space_copy(space);
+	array->sink = isl_union_map_empty(isl_space_copy(data->params));
+	array->must_source = isl_union_map_empty(isl_space_copy(data->params));
+	array->may_source = isl_union_map_empty(isl_space_copy(data->params));
+	if (!array->sink || !array->must_source || !array->may_source)
+		return NULL;
+
+	return array;
+error:
+	isl_hash_table_remove(ctx, data->table, entry);
+	return NULL;
+}
+
+/* Add the access "map" to the accesses of type data->type
+ * of the array accessed by "map".
+ */
+static int incremental_flow_add_access(__isl_take isl_map *map, void *user)
+{
+	struct isl_incremental_flow_data *data = user;
+	struct isl_incremental_flow_array *array;
+	isl_space *space;
+
+	space = isl_space_range(isl_map_get_space(map));
+	if (!space)
+		goto error;
+	array = incremental_flow_get_array(data, space);
+	isl_space_free(space);
+	if (!array)
+		goto error;
+
+	if (data->type == 0)
+		array->sink = isl_union_map_add_map(array->sink, map);
+	else if (data->type == 1)
+		array->must_source = isl_union_map_add_map(array->must_source,
+							    map);
+	else
+		array->may_source = isl_union_map_add_map(array->may_source,
+							    map);
+
+	return 0;
+error:
+	isl_map_free(map);
+	return -1;
+}
+
+/* Is "map" obviously equal to the map with the same space in "user"?
+ * Return -1 (without error) if it is not, such that the enumeration
+ * in union_map_plain_is_equal is interrupted.
+ */
+static int map_plain_is_element(__isl_take isl_map *map, void *user)
+{
+	isl_union_map *umap = user;
+	isl_map *map2;
+	int equal;
+
+	map2 = isl_union_map_extract_map(umap, isl_map_get_space(map));
+	equal = isl_map_plain_is_equal(map, map2);
+	isl_map_free(map);
+	isl_map_free(map2);
+
+	return equal == 1 ? 0 : -1;
+}
+
+/* Are "umap1" and "umap2" obviously equal?
+ * That is, do they contain the same number of maps and
+ * is each map in "umap1" obviously equal to the map with
+ * the same space in "umap2"?
+ */
+static int union_map_plain_is_equal(__isl_keep isl_union_map *umap1,
+	__isl_keep isl_union_map *umap2)
+{
+	if (!umap1 || !umap2)
+		return -1;
+	if (isl_union_map_n_map(umap1) != isl_union_map_n_map(umap2))
+		return 0;
+	return isl_union_map_foreach_map(umap1, &map_plain_is_element,
+					umap2) == 0;
+}
+
+/* Internal data structure for collecting the statements
+ * with a modified schedule.
+ * "schedule" is the schedule that is being compared against and
+ * "changed" collects the universes of the iteration domains
+ * of the statements with a modified schedule.
+ */
+struct isl_incremental_flow_schedule_data {
+	isl_union_map *schedule;
+	isl_union_set *changed;
+};
+
+/* Add the universe of the domain of "map" to data->changed
+ * if "map" is not obviously equal to the map with the same space
+ * in data->schedule.
+ */
+static int collect_changed_schedule(__isl_take isl_map *map, void *user)
+{
+	struct isl_incremental_flow_schedule_data *data = user;
+	isl_map *map2;
+	int equal;
+
+	map2 = isl_union_map_extract_map(data->schedule,
+					isl_map_get_space(map));
+	equal = isl_map_plain_is_equal(map, map2);
+	isl_map_free(map2);
+	if (equal < 0)
+		goto error;
+	if (equal) {
+		isl_map_free(map);
+		return 0;
+	}
+
+	data->changed = isl_union_set_add_set(data->changed,
+				isl_set_universe(isl_space_domain(
+					isl_map_get_space(map))));
+	isl_map_free(map);
+
+	return data->changed ? 0 : -1;
+error:
+	isl_map_free(map);
+	return -1;
+}
+
+/* Return the universes of the iteration domains of the statements
+ * that have a different schedule in "old" and "new".
+ */
+static __isl_give isl_union_set *changed_statements(
+	__isl_keep isl_union_map *old, __isl_keep isl_union_map *new)
+{
+	struct isl_incremental_flow_schedule_data data;
+
+	data.changed = isl_union_set_empty(isl_union_map_get_space(new));
+	data.schedule = old;
+	if (isl_union_map_foreach_map(new, &collect_changed_schedule,
+					&data) < 0)
+		return isl_union_set_free(data.changed);
+	data.schedule = new;
+	if (isl_union_map_foreach_map(old, &collect_changed_schedule,
+					&data) < 0)
+		return isl_union_set_free(data.changed);
+
+	return data.changed;
+}
+
+/* Does the iteration domain of "map" appear in "user"?
+ * Return -1 (without error) if it does, such that the enumeration
+ * in accesses_changed_statement is interrupted.
+ */
+static int domain_not_in(__isl_take isl_map *map, void *user)
+{
+	isl_union_set *changed = user;
+	isl_space *space;
+	int found;
+
+	space = isl_space_domain(isl_map_get_space(map));
+	found = isl_union_set_contains(changed, space);
+	isl_space_free(space);
+	isl_map_free(map);
+
+	return found == 0 ? 0 : -1;
+}
+
+/* Is any of the accesses to "array" performed by a statement
+ * in "changed"?
+ */
+static int accesses_changed_statement(
+	struct isl_incremental_flow_array *array,
+	__isl_keep isl_union_set *changed)
+{
+	if (isl_union_map_foreach_map(array->sink, &domain_not_in,
+					changed) < 0)
+		return 1;
+	if (isl_union_map_foreach_map(array->must_source, &domain_not_in,
+					changed) < 0)
+		return 1;
+	if (isl_union_map_foreach_map(array->may_source, &domain_not_in,
+					changed) < 0)
+		return 1;
+	return 0;
+}
+
+/* Can the dataflow results for the accesses to "array" be taken
+ * from "old"?  That is, are the accesses to the array the same
+ * as in "old" and are none of them performed by a statement
+ * in "changed"?
+ */
+static int incremental_flow_array_can_reuse(
+	struct isl_incremental_flow_array *array,
+	struct isl_incremental_flow_array *old,
+	__isl_keep isl_union_set *changed)
+{
+	int equal;
+
+	equal = union_map_plain_is_equal(array->sink, old->sink);
+	if (equal > 0)
+		equal = union_map_plain_is_equal(array->must_source,
+						old->must_source);
+	if (equal > 0)
+		equal = union_map_plain_is_equal(array->may_source,
+						old->may_source);
+	if (equal <= 0)
+		return equal;
+	return !accesses_changed_statement(array, changed);
+}
+
+/* Move the dataflow results from "old" to "array".
+ */
+static void incremental_flow_array_reuse(
+	struct isl_incremental_flow_array *array,
+	struct isl_incremental_flow_array *old)
+{
+	array->must_dep = old->must_dep;
+	array->may_dep = old->may_dep;
+	array->must_no_source = old->must_no_source;
+	array->may_no_source = old->may_no_source;
+	old->must_dep = NULL;
+	old->may_dep = NULL;
+	old->must_no_source = NULL;
+	old->may_no_source = NULL;
+}
+
+/* Perform dataflow analysis on the accesses to "array",
+ * with the relative order of the accesses determined by "schedule".
+ * Only the part of the schedule that applies to statements
+ * that access the array is passed to isl_union_map_compute_flow.
+ */
+static int incremental_flow_array_compute(
+	struct isl_incremental_flow_array *array,
+	__isl_keep isl_union_map *schedule)
+{
+	isl_union_map *access;
+	isl_union_set *domain;
+
+	access = isl_union_map_union(isl_union_map_copy(array->sink),
+				isl_union_map_copy(array->must_source));
+	access = isl_union_map_union(access,
+				isl_union_map_copy(array->may_source));
+	domain = isl_union_set_universe(isl_union_map_domain(access));
+	schedule = isl_union_map_intersect_domain(
+				isl_union_map_copy(schedule), domain);
+
+	return isl_union_map_compute_flow(isl_union_map_copy(array->sink),
+				isl_union_map_copy(array->must_source),
+				isl_union_map_copy(array->may_source), schedule,
+				&array->must_dep, &array->may_dep,
+				&array->must_no_source, &array->may_no_source);
+}
+
+/* Perform dataflow analysis on the given accesses and schedule,
+ * as in isl_union_map_compute_flow, and store the results in "flow".
+ *
+ * The results of the previous computation in "flow", if any,
+ * are reused for those arrays for which the accesses have not changed
+ * and for which none of the accessing statements has a different schedule.
+ * Since the dataflow problems of different arrays are independent
+ * of each other, only the arrays that are affected by a change
+ * in the accesses or the schedule need to be analyzed again.
+ * Changes are detected by comparing the accesses and the schedules
+ * of the statements using isl_map_plain_is_equal,
+ * so an access relation or a schedule that has been reconstructed
+ * in a different way may be considered to have changed.
+ */
+__isl_give isl_incremental_flow *isl_incremental_flow_compute(
+	__isl_take isl_incremental_flow *flow, __isl_take isl_union_map *sink,
+	__isl_take isl_union_map *must_source,
+	__isl_take isl_union_map *may_source,
+	__isl_take isl_union_map *schedule)
+{
+	int i;
+	isl_ctx *ctx;
+	isl_space *space;
+	isl_union_set *changed = NULL;
+	struct isl_incremental_flow_data data;
+
+	data.params = NULL;
+	data.n_array = data.size = 0;
+	data.array = NULL;
+	data.table = NULL;
+
+	if (!flow)
+		goto error;
+
+	sink = isl_union_map_align_params(sink,
+					    isl_union_map_get_space(must_source));
+	sink = isl_union_map_align_params(sink,
+					    isl_union_map_get_space(may_source));
+	sink = isl_union_map_align_params(sink,
+					    isl_union_map_get_space(schedule));
+	space = isl_union_map_get_space(sink);
+	must_source = isl_union_map_align_params(must_source,
+						isl_space_copy(space));
+	may_source = isl_union_map_align_params(may_source,
+						isl_space_copy(space));
+	schedule = isl_union_map_align_params(schedule, space);
+	if (!sink || !must_source || !may_source || !schedule)
+		goto error;
+
+	ctx = flow->ctx;
+	data.params = isl_union_map_get_space(sink);
+	data.table = isl_hash_table_alloc(ctx, isl_union_map_n_map(sink));
+	if (!data.table)
+		goto error;
+	data.type = 0;
+	if (isl_union_map_foreach_map(sink,
+				&incremental_flow_add_access, &data) < 0)
+		goto error;
+	data.type = 1;
+	if (isl_union_map_foreach_map(must_source,
+				&incremental_flow_add_access, &data) < 0)
+		goto error;
+	data.type = 2;
+	if (isl_union_map_foreach_map(may_source,
+				&incremental_flow_add_access, &data) < 0)
+		goto error;
+
+	if (flow->schedule) {
+		changed = changed_statements(flow->schedule, schedule);
+		if (!changed)
+			goto error;
+	}
+
+	for (i = 0; i < data.n_array; ++i) {
+		struct isl_incremental_flow_array *array = data.array[i];
+		struct isl_hash_table_entry *entry = NULL;
+		int reuse = 0;
+
+		if (flow->table)
+			entry = isl_hash_table_find(ctx, flow->table,
+					isl_space_get_hash(array->space),
+					&has_incremental_array_space,
+					array->space, 0);
+		if (entry)
+			reuse = incremental_flow_array_can_reuse(array,
+							entry->data, changed);
+		if (reuse < 0)
+			goto error;
+		if (reuse) {
+			incremental_flow_array_reuse(array, entry->data);
+			ctx->stats->flow_n_array_reused++;
+		} else {
+			if (incremental_flow_array_compute(array, schedule) < 0)
+				goto error;
+			ctx->stats->flow_n_array_computed++;
+		}
+	}
+
+	incremental_flow_array_list_free(ctx, flow->n_array,
+					flow->array, flow->table);
+	isl_union_map_free(flow->schedule);
+	isl_union_map_free(flow->must_dep);
+	isl_union_map_free(flow->may_dep);
+	isl_union_map_free(flow->must_no_source);
+	isl_union_map_free(flow->may_no_source);
+	flow->n_array = data.n_array;
+	flow->size = data.size;
+	flow->array = data.array;
+	flow->table = data.table;
+	flow->schedule = schedule;
+
+	flow->must_dep = isl_union_map_empty(isl_space_copy(data.params));
+	flow->may_dep = isl_union_map_empty(isl_space_copy(data.params));
+	flow->must_no_source = isl_union_map_empty(isl_space_copy(data.params));
+	flow->may_no_source = isl_union_map_empty(data.params);
+	for (i = 0; i < flow->n_array; ++i) {
+		struct isl_incremental_flow_array *array = flow->array[i];
+
+		flow->must_dep = isl_union_map_union(flow->must_dep,
+					isl_union_map_copy(array->must_dep));
+		flow->may_dep = isl_union_map_union(flow->may_dep,
+					isl_union_map_copy(array->may_dep));
+		flow->must_no_source = isl_union_map_union(flow->must_no_source,
+				isl_union_map_copy(array->must_no_source));
+		flow->may_no_source = isl_union_map_union(flow->may_no_source,
+				isl_union_map_copy(array->may_no_source));
+	}
+
+	isl_union_set_free(changed);
+	isl_union_map_free(sink);
+	isl_union_map_free(must_source);
+	isl_union_map_free(may_source);
+
+	if (!flow->must_dep || !flow->may_dep ||
+	    !flow->must_no_source || !flow->may_no_source)
+		return isl_incremental_flow_free(flow);
+	return flow;
+error:
+	isl_space_free(data.params);
+	if (flow)
+		incremental_flow_array_list_free(flow->ctx, data.n_array,
+						data.array, data.table);
+	isl_union_set_free(changed);
+	isl_union_map_free(sink);
+	isl_union_map_free(must_source);
+	isl_union_map_free(may_source);
+	isl_union_map_free(schedule);
+	isl_incremental_flow_free(flow);
+	return NULL;
+}
+
+__isl_give isl_union_map *isl_incremental_flow_get_must_dependence(
+	__isl_keep isl_incremental_flow *flow)
+{
+	if (!flow)
+		return NULL;
+	if (!flow->must_dep)
+		isl_die(flow->ctx, isl_error_invalid,
+			"no dataflow computed yet", return NULL);
+	return isl_union_map_copy(flow->must_dep);
+}
+
+__isl_give isl_union_map *isl_incremental_flow_get_may_dependence(
+	__isl_keep isl_incremental_flow *flow)
+{
+	if (!flow)
+		return NULL;
+	if (!flow->may_dep)
+		isl_die(flow->ctx, isl_error_invalid,
+			"no dataflow computed yet", return NULL);
+	return isl_union_map_copy(flow->may_dep);
+}
+
+__isl_give isl_union_map *isl_incremental_flow_get_must_no_source(
+	__isl_keep isl_incremental_flow *flow)
+{
+	if (!flow)
+		return NULL;
+	if (!flow->must_no_source)
+		isl_die(flow->ctx, isl_error_invalid,
+			"no dataflow computed yet", return NULL);
+	return isl_union_map_copy(flow->must_no_source);
+}
+
+__isl_give isl_union_map *isl_incremental_flow_get_may_no_source(
+	__isl_keep isl_incremental_flow *flow)
+{
+	if (!flow)
+		return NULL;
+	if (!flow->may_no_source)
+		isl_die(flow->ctx, isl_error_invalid,
+			"no dataflow computed yet", return NULL);
+	return isl_union_map_copy(flow->may_no_source);
+}
@@ -810,13 +810,23 @@ error:
 	return NULL;
 }
 
+/* Fold "pw1" and "pw2" on their shared domain, keeping the original
+ * folds on the parts of the domains where only one of them is defined.
+ *
+ * The piece indices of "pw1" and "pw2" are used to only consider
+ * pairs of pieces with overlapping bounding boxes.  Pieces
+ * with disjoint bounding boxes do not need to be subtracted
+ * from each other either.
+ */
 __isl_give isl_pw_qpolynomial_fold *isl_pw_qpolynomial_fold_fold(
 	__isl_take isl_pw_qpolynomial_fold *pw1,
 	__isl_take isl_pw_qpolynomial_fold *pw2)
 {
-	int i, j, n;
-	struct isl_pw_qpolynomial_fold *res;
+	int i, j, k, n, n_cand;
+	struct isl_pw_qpolynomial_fold *res = NULL;
 	isl_set *set;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pw1 || !pw2)
 		goto error;
@@ -837,15 +847,26 @@ __isl_give isl_pw_qpolynomial_fold *isl_pw_qpolynomial_fold_fold(
 		isl_die(pw1->dim->ctx, isl_error_invalid,
 			"fold types don't match", goto error);
 
+	index1 = isl_pw_qpolynomial_fold_get_index(pw1);
+	index2 = isl_pw_qpolynomial_fold_get_index(pw2);
+	n = pw1->n > pw2->n ? pw1->n : pw2->n;
+	cand = isl_alloc_array(pw1->dim->ctx, int, n);
+	if (!index1 || !index2 || !cand)
+		goto error;
+
 	n = (pw1->n + 1) * (pw2->n + 1);
 	res = isl_pw_qpolynomial_fold_alloc_size(isl_space_copy(pw1->dim),
 						pw1->type, n);
 
 	for (i = 0; i < pw1->n; ++i) {
 		set = isl_set_copy(pw1->p[i].set);
-		for (j = 0; j < pw2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k) {
 			struct isl_set *common;
 			isl_qpolynomial_fold *sum;
+			j = cand[k];
 			set = isl_set_subtract(set,
 					isl_set_copy(pw2->p[j].set));
 			common = isl_set_intersect(isl_set_copy(pw1->p[i].set),
@@ -867,20 +888,26 @@ __isl_give isl_pw_qpolynomial_fold *isl_pw_qpolynomial_fold_fold(
 
 	for (j = 0; j < pw2->n; ++j) {
 		set = isl_set_copy(pw2->p[j].set);
-		for (i = 0; i < pw1->n; ++i)
-			set = isl_set_subtract(set, isl_set_copy(pw1->p[i].set));
+		n_cand = isl_box_index_find_overlap(index1, index2, j, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k)
+			set = isl_set_subtract(set,
+					isl_set_copy(pw1->p[cand[k]].set));
 		res = isl_pw_qpolynomial_fold_add_piece(res, set,
 				    isl_qpolynomial_fold_copy(pw2->p[j].fold));
 	}
 
+	free(cand);
 	isl_pw_qpolynomial_fold_free(pw1);
 	isl_pw_qpolynomial_fold_free(pw2);
 
 	return res;
 error:
+	free(cand);
 	isl_pw_qpolynomial_fold_free(pw1);
 	isl_pw_qpolynomial_fold_free(pw2);
-	return NULL;
+	return isl_pw_qpolynomial_fold_free(res);
 }
 
 __isl_give isl_union_pw_qpolynomial_fold *isl_union_pw_qpolynomial_fold_fold_pw_qpolynomial_fold(
@@ -127,6 +127,19 @@ __isl_give isl_id *isl_id_copy(isl_id *id)
 	return id;
 }
 
+/* Construct a copy of "id" in "ctx".
+ * The copy has the same name and user pointer as "id", such that
+ * transferring it back to the context of "id" yields "id" itself.
+ * The isl_id_none identifier is not associated to any context
+ * and is therefore returned as is.
+ */
+__isl_give isl_id *isl_id_transfer(isl_ctx *ctx, __isl_keep isl_id *id)
+{
+	if (!id || id == &isl_id_none)
+		return id;
+	return isl_id_alloc(ctx, id->name, id->user);
+}
+
 static int isl_id_eq(const void *entry, const void *name)
 {
 	return entry == name;
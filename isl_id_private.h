@@ -34,6 +34,7 @@ struct isl_id {
 #include <isl_list_templ.h>
 
 uint32_t isl_hash_id(uint32_t hash, __isl_keep isl_id *id);
+__isl_give isl_id *isl_id_transfer(isl_ctx *ctx, __isl_keep isl_id *id);
 
 extern isl_id isl_id_none;
 
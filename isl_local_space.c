@@ -91,6 +91,19 @@ __isl_give isl_local_space *isl_local_space_dup(__isl_keep isl_local_space *ls)
 
 }
 
+/* Construct a copy of "ls" in "ctx", which may be different
+ * from the context of "ls".  "ls" itself is only read.
+ */
+__isl_give isl_local_space *isl_local_space_transfer(isl_ctx *ctx,
+	__isl_keep isl_local_space *ls)
+{
+	if (!ls)
+		return NULL;
+
+	return isl_local_space_alloc_div(isl_space_transfer(ctx, ls->dim),
+					 isl_mat_transfer(ctx, ls->div));
+}
+
 __isl_give isl_local_space *isl_local_space_cow(__isl_take isl_local_space *ls)
 {
 	if (!ls)
@@ -16,6 +16,8 @@ __isl_give isl_local_space *isl_local_space_alloc(__isl_take isl_space *dim,
 	unsigned n_div);
 __isl_give isl_local_space *isl_local_space_alloc_div(__isl_take isl_space *dim,
 	__isl_take isl_mat *div);
+__isl_give isl_local_space *isl_local_space_transfer(isl_ctx *ctx,
+	__isl_keep isl_local_space *ls);
 
 __isl_give isl_local_space *isl_local_space_swap_div(
 	__isl_take isl_local_space *ls, int a, int b);
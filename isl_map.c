@@ -5215,6 +5215,111 @@ struct isl_map *isl_map_dup(struct isl_map *map)
 	return dup;
 }
 
+/* Construct a basic map in "space" with the same integer divisions,
+ * constraints and flags as "src".
+ *
+ * "space" may live in a different context than "src",
+ * but this function only reads "src".
+ */
+static __isl_give isl_basic_map *basic_map_transfer(__isl_take isl_space *space,
+	__isl_keep isl_basic_map *src)
+{
+	int i, k;
+	unsigned total;
+	isl_basic_map *bmap;
+
+	if (!space || !src)
+		goto error;
+
+	total = isl_basic_map_total_dim(src);
+	bmap = isl_basic_map_alloc_space(space, src->n_div,
+					src->n_eq, src->n_ineq);
+	if (!bmap)
+		return NULL;
+
+	for (i = 0; i < src->n_div; ++i) {
+		k = isl_basic_map_alloc_div(bmap);
+		if (k < 0)
+			goto error_bmap;
+		isl_seq_cpy(bmap->div[k], src->div[i], 1 + 1 + total);
+	}
+	for (i = 0; i < src->n_eq; ++i) {
+		k = isl_basic_map_alloc_equality(bmap);
+		if (k < 0)
+			goto error_bmap;
+		isl_seq_cpy(bmap->eq[k], src->eq[i], 1 + total);
+	}
+	for (i = 0; i < src->n_ineq; ++i) {
+		k = isl_basic_map_alloc_inequality(bmap);
+		if (k < 0)
+			goto error_bmap;
+		isl_seq_cpy(bmap->ineq[k], src->ineq[i], 1 + total);
+	}
+	bmap->flags = src->flags;
+
+	return bmap;
+error_bmap:
+	isl_basic_map_free(bmap);
+	return NULL;
+error:
+	isl_space_free(space);
+	return NULL;
+}
+
+/* Construct a copy of "bmap" in "ctx".
+ * This function only reads "bmap".
+ */
+__isl_give isl_basic_map *isl_basic_map_transfer(isl_ctx *ctx,
+	__isl_keep isl_basic_map *bmap)
+{
+	if (!bmap)
+		return NULL;
+	return basic_map_transfer(isl_space_transfer(ctx, bmap->dim), bmap);
+}
+
+__isl_give isl_basic_set *isl_basic_set_transfer(isl_ctx *ctx,
+	__isl_keep isl_basic_set *bset)
+{
+	return (isl_basic_set *)
+		isl_basic_map_transfer(ctx, (isl_basic_map *) bset);
+}
+
+/* Construct a copy of "map" in "ctx", with the same basic maps
+ * in the same order.
+ *
+ * "ctx" may be different from the context of "map", possibly
+ * used by a different thread.  This function only reads "map"
+ * and does not modify any reference counts in the context of "map".
+ */
+__isl_give isl_map *isl_map_transfer(isl_ctx *ctx, __isl_keep isl_map *map)
+{
+	int i;
+	isl_space *space;
+	isl_map *res;
+
+	if (!map)
+		return NULL;
+
+	space = isl_space_transfer(ctx, map->dim);
+	res = isl_map_alloc_space(space, map->n, map->flags);
+	if (!res)
+		return NULL;
+	for (i = 0; i < map->n; ++i) {
+		res->p[i] = basic_map_transfer(isl_space_transfer(ctx,
+						map->p[i]->dim), map->p[i]);
+		if (!res->p[i])
+			return isl_map_free(res);
+		res->n++;
+	}
+
+	return res;
+}
+
+__isl_give isl_set *isl_set_transfer(isl_ctx *ctx, __isl_keep isl_set *set)
+{
+	return (isl_set *) isl_map_transfer(ctx, (isl_map *) set);
+}
+
 __isl_give isl_map *isl_map_add_basic_map(__isl_take isl_map *map,
 						__isl_take isl_basic_map *bmap)
 {
@@ -8927,6 +9032,44 @@ int isl_set_fast_is_equal(__isl_keep isl_set *set1, __isl_keep isl_set *set2)
 	return isl_set_plain_is_equal(set1, set2);
 }
 
+/* Are "map1" and "map2" represented in exactly the same way?
+ * That is, do they consist of the same basic maps in the same order,
+ * with the same constraints in the same order?
+ *
+ * In contrast to isl_map_plain_is_equal, the inputs are not normalized,
+ * meaning that their representations are not modified.
+ */
+int isl_map_plain_is_identical(__isl_keep isl_map *map1,
+	__isl_keep isl_map *map2)
+{
+	int i;
+	int equal;
+
+	if (!map1 || !map2)
+		return -1;
+
+	if (map1 == map2)
+		return 1;
+	if (map1->n != map2->n)
+		return 0;
+	equal = isl_space_is_equal(map1->dim, map2->dim);
+	if (equal < 0 || !equal)
+		return equal;
+	for (i = 0; i < map1->n; ++i) {
+		equal = isl_basic_map_plain_is_equal(map1->p[i], map2->p[i]);
+		if (equal < 0 || !equal)
+			return equal;
+	}
+
+	return 1;
+}
+
+int isl_set_plain_is_identical(__isl_keep isl_set *set1,
+	__isl_keep isl_set *set2)
+{
+	return isl_map_plain_is_identical(set1, set2);
+}
+
 /* Return an interval that ranges from min to max (inclusive)
  */
 struct isl_basic_set *isl_basic_set_interval(struct isl_ctx *ctx,
@@ -161,6 +161,12 @@ __isl_give isl_basic_map *isl_basic_map_alloc_space(__isl_take isl_space *dim,
 		unsigned extra, unsigned n_eq, unsigned n_ineq);
 __isl_give isl_map *isl_map_alloc_space(__isl_take isl_space *dim, int n,
 	unsigned flags);
+__isl_give isl_basic_map *isl_basic_map_transfer(isl_ctx *ctx,
+	__isl_keep isl_basic_map *bmap);
+__isl_give isl_basic_set *isl_basic_set_transfer(isl_ctx *ctx,
+	__isl_keep isl_basic_set *bset);
+__isl_give isl_map *isl_map_transfer(isl_ctx *ctx, __isl_keep isl_map *map);
+__isl_give isl_set *isl_set_transfer(isl_ctx *ctx, __isl_keep isl_set *set);
 
 unsigned isl_basic_map_total_dim(const struct isl_basic_map *bmap);
 
@@ -219,10 +225,18 @@ __isl_give isl_basic_set *isl_basic_set_sort_constraints(
 	__isl_take isl_basic_set *bset);
 int isl_basic_map_plain_cmp(const __isl_keep isl_basic_map *bmap1,
 	const __isl_keep isl_basic_map *bmap2);
+int isl_map_plain_is_identical(__isl_keep isl_map *map1,
+	__isl_keep isl_map *map2);
+int isl_set_plain_is_identical(__isl_keep isl_set *set1,
+	__isl_keep isl_set *set2);
 int isl_basic_set_plain_is_equal(__isl_keep isl_basic_set *bset1,
 	__isl_keep isl_basic_set *bset2);
 int isl_basic_map_plain_is_equal(__isl_keep isl_basic_map *bmap1,
 	__isl_keep isl_basic_map *bmap2);
+struct isl_basic_map *isl_basic_map_normalize(struct isl_basic_map *bmap);
+struct isl_basic_set *isl_basic_set_normalize(struct isl_basic_set *bset);
+uint32_t isl_basic_map_get_hash(__isl_keep isl_basic_map *bmap);
+uint32_t isl_basic_set_get_hash(__isl_keep isl_basic_set *bset);
 struct isl_basic_map *isl_basic_map_normalize_constraints(
 	struct isl_basic_map *bmap);
 struct isl_basic_set *isl_basic_set_normalize_constraints(
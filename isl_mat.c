@@ -193,6 +193,24 @@ struct isl_mat *isl_mat_dup(struct isl_mat *mat)
 	return mat2;
 }
 
+/* Construct a copy of "mat" in "ctx", which may be different
+ * from the context of "mat".  "mat" itself is only read.
+ */
+__isl_give isl_mat *isl_mat_transfer(isl_ctx *ctx, __isl_keep isl_mat *mat)
+{
+	int i;
+	isl_mat *res;
+
+	if (!mat)
+		return NULL;
+	res = isl_mat_alloc(ctx, mat->n_row, mat->n_col);
+	if (!res)
+		return NULL;
+	for (i = 0; i < mat->n_row; ++i)
+		isl_seq_cpy(res->row[i], mat->row[i], mat->n_col);
+	return res;
+}
+
 struct isl_mat *isl_mat_cow(struct isl_mat *mat)
 {
 	struct isl_mat *mat2;
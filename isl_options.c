@@ -16,6 +16,7 @@
 #include <isl/ast_build.h>
 #include <isl/schedule.h>
 #include <isl/version.h>
+#include <isl/vertices.h>
 
 struct isl_arg_choice isl_pip_context_choice[] = {
 	{"gbr",		ISL_CONTEXT_GBR},
@@ -105,11 +106,22 @@ ISL_ARG_CHOICE(struct isl_options, bound, 0, "bound", bound,
 	ISL_BOUND_BERNSTEIN, "algorithm to use for computing bounds")
 ISL_ARG_CHOICE(struct isl_options, on_error, 0, "on-error", on_error,
 	ISL_ON_ERROR_WARN, "how to react if an error is detected")
+ISL_ARG_INT(struct isl_options, n_thread, 0, "threads", "n", 1,
+	"maximal number of threads to use in operations "
+	"that can be performed in parallel")
 ISL_ARG_FLAGS(struct isl_options, bernstein_recurse, 0,
 	"bernstein-recurse", bernstein_recurse, ISL_BERNSTEIN_FACTORS, NULL)
 ISL_ARG_BOOL(struct isl_options, bernstein_triangulate, 0,
 	"bernstein-triangulate", 1,
 	"triangulate domains during Bernstein expansion")
+ISL_ARG_INT(struct isl_options, vertices_cache_size, 0,
+	"vertices-cache-size", "n", 0,
+	"maximal number of parametric vertex decompositions to keep "
+	"in a cache for reuse by later computations over the same domain")
+ISL_ARG_INT(struct isl_options, qpolynomial_div_cache_size, 0,
+	"qpolynomial-div-cache-size", "n", 0,
+	"maximal number of integer division lists and merges of such lists "
+	"of quasipolynomials to keep in a cache for reuse")
 ISL_ARG_BOOL(struct isl_options, pip_symmetry, 0, "pip-symmetry", 1,
 	"detect simple symmetries in PIP input")
 ISL_ARG_CHOICE(struct isl_options, convex, 0, "convex-hull", \
@@ -144,6 +156,9 @@ ISL_ARG_CHOICE(struct isl_options, schedule_algorithm, 0,
 	ISL_SCHEDULE_ALGORITHM_ISL, "scheduling algorithm to use")
 ISL_ARG_CHOICE(struct isl_options, schedule_fuse, 0, "schedule-fuse", fuse,
 	ISL_SCHEDULE_FUSE_MAX, "level of fusion during scheduling")
+ISL_ARG_STR(struct isl_options, schedule_cache_dir, 0,
+	"schedule-cache-dir", "dir", NULL,
+	"directory for caching computed schedules")
 ISL_ARG_BOOL(struct isl_options, tile_scale_tile_loops, 0,
 	"tile-scale-tile-loops", 1, "scale tile loops")
 ISL_ARG_BOOL(struct isl_options, tile_shift_point_loops, 0,
@@ -151,6 +166,9 @@ ISL_ARG_BOOL(struct isl_options, tile_shift_point_loops, 0,
 ISL_ARG_STR(struct isl_options, ast_iterator_type, 0,
 	"ast-iterator-type", "type", "int",
 	"type used for iterators during printing of AST")
+ISL_ARG_BOOL(struct isl_options, ast_print_omp_pragmas, 0,
+	"ast-print-omp-pragmas", 0,
+	"print OpenMP pragmas for parallel and vectorizable loops")
 ISL_ARG_BOOL(struct isl_options, ast_build_atomic_upper_bound, 0,
 	"ast-build-atomic-upper-bound", 1, "generate atomic upper bounds")
 ISL_ARG_BOOL(struct isl_options, ast_build_prefer_pdiv, 0,
@@ -172,6 +190,21 @@ ISL_ARG_BOOL(struct isl_options, ast_build_allow_else, 0,
 	"ast-build-allow-else", 1, "generate if statements with else branches")
 ISL_ARG_BOOL(struct isl_options, ast_build_allow_or, 0,
 	"ast-build-allow-or", 1, "generate if conditions with disjunctions")
+ISL_ARG_BOOL(struct isl_options, ast_build_lazy_unroll, 0,
+	"ast-build-lazy-unroll", 0,
+	"represent unrolled loops by a single for node")
+ISL_ARG_BOOL(struct isl_options, ast_build_arena, 0,
+	"ast-build-arena", 0,
+	"allocate the nodes of a generated AST from a single arena")
+ISL_ARG_BOOL(struct isl_options, ast_build_hoist_invariants, 0,
+	"ast-build-hoist-invariants", 0,
+	"hoist loop invariant minima, maxima and divisions out of loops")
+ISL_ARG_BOOL(struct isl_options, ast_build_gist_cache, 0,
+	"ast-build-gist-cache", 1,
+	"reuse the results of recent simplifications during AST generation")
+ISL_ARG_BOOL(struct isl_options, ast_build_parallel_components, 0,
+	"ast-build-parallel-components", 0,
+	"generate code for independent components in parallel")
 ISL_ARG_VERSION(print_version)
 ISL_ARGS_END
 
@@ -187,6 +220,21 @@ ISL_CTX_SET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
 ISL_CTX_GET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
 	on_error)
 
+ISL_CTX_SET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	n_thread)
+ISL_CTX_GET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	n_thread)
+
+ISL_CTX_SET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	vertices_cache_size)
+ISL_CTX_GET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	vertices_cache_size)
+
+ISL_CTX_SET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	qpolynomial_div_cache_size)
+ISL_CTX_GET_INT_DEF(isl_options, struct isl_options, isl_options_args,
+	qpolynomial_div_cache_size)
+
 ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
 	coalesce_bounded_wrapping)
 ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
@@ -237,6 +285,11 @@ ISL_CTX_SET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
 ISL_CTX_GET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
 	schedule_fuse)
 
+ISL_CTX_SET_STR_DEF(isl_options, struct isl_options, isl_options_args,
+	schedule_cache_dir)
+ISL_CTX_GET_STR_DEF(isl_options, struct isl_options, isl_options_args,
+	schedule_cache_dir)
+
 ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
 	tile_scale_tile_loops)
 ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
@@ -272,6 +325,11 @@ ISL_CTX_SET_STR_DEF(isl_options, struct isl_options, isl_options_args,
 ISL_CTX_GET_STR_DEF(isl_options, struct isl_options, isl_options_args,
 	ast_iterator_type)
 
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_print_omp_pragmas)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_print_omp_pragmas)
+
 ISL_CTX_SET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
 	ast_build_separation_bounds)
 ISL_CTX_GET_CHOICE_DEF(isl_options, struct isl_options, isl_options_args,
@@ -291,3 +349,28 @@ ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
 	ast_build_allow_or)
 ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
 	ast_build_allow_or)
+
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_lazy_unroll)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_lazy_unroll)
+
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_arena)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_arena)
+
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_hoist_invariants)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_hoist_invariants)
+
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_gist_cache)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_gist_cache)
+
+ISL_CTX_SET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_parallel_components)
+ISL_CTX_GET_BOOL_DEF(isl_options, struct isl_options, isl_options_args,
+	ast_build_parallel_components)
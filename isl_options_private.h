@@ -21,12 +21,18 @@ struct isl_options {
 	int			bound;
 	unsigned		on_error;
 
+	int			n_thread;
+
 	#define			ISL_BERNSTEIN_FACTORS	1
 	#define			ISL_BERNSTEIN_INTERVALS	2
 	int			bernstein_recurse;
 
 	int			bernstein_triangulate;
 
+	int			vertices_cache_size;
+
+	int			qpolynomial_div_cache_size;
+
 	int			pip_symmetry;
 
 	#define			ISL_CONVEX_HULL_WRAP	0
@@ -44,11 +50,13 @@ struct isl_options {
 	int			schedule_separate_components;
 	unsigned		schedule_algorithm;
 	int			schedule_fuse;
+	char			*schedule_cache_dir;
 
 	int			tile_scale_tile_loops;
 	int			tile_shift_point_loops;
 
 	char			*ast_iterator_type;
+	int			ast_print_omp_pragmas;
 
 	int			ast_build_atomic_upper_bound;
 	int			ast_build_prefer_pdiv;
@@ -58,6 +66,11 @@ struct isl_options {
 	int			ast_build_scale_strides;
 	int			ast_build_allow_else;
 	int			ast_build_allow_or;
+	int			ast_build_lazy_unroll;
+	int			ast_build_arena;
+	int			ast_build_hoist_invariants;
+	int			ast_build_gist_cache;
+	int			ast_build_parallel_components;
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include <isl_scan.h>
 #include <isl_seq.h>
 #include <isl_space_private.h>
+#include <isl_thread.h>
 #include <isl_val_private.h>
 #include <isl_vec_private.h>
 #include <isl/deprecated/point_int.h>
@@ -213,6 +214,9 @@ __isl_give isl_point *isl_point_set_coordinate_val(__isl_take isl_point *pnt,
 		isl_die(isl_point_get_ctx(pnt), isl_error_invalid,
 			"expecting rational value", goto error);
 
+	if (type == isl_dim_set)
+		pos += isl_space_dim(pnt->dim, isl_dim_param);
+
 	if (isl_int_eq(pnt->vec->el[1 + pos], v->n) &&
 	    isl_int_eq(pnt->vec->el[0], v->d)) {
 		isl_val_free(v);
@@ -348,6 +352,348 @@ error:
 	return -1;
 }
 
+/* Internal data structure for isl_set_foreach_point_batch.
+ *
+ * "space" is the space of the set being enumerated and
+ * "n_coord" is the number of parameters and set variables in this space.
+ * "buf" is a buffer with room for "max" rows of "n_coord" coordinates,
+ * the first "n" of which have been filled in.
+ * "tmp" is a temporary value.
+ */
+struct isl_foreach_point_batch {
+	struct isl_scan_callback callback;
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user);
+	int (*fallback)(__isl_take isl_point *pnt, void *user);
+	void *user;
+	isl_space *space;
+	int n_coord;
+	int max;
+	int n;
+	int64_t *buf;
+	isl_int tmp;
+};
+
+/* Pass the rows in the buffer to the user callback and empty the buffer.
+ */
+static int batch_flush(struct isl_foreach_point_batch *fp)
+{
+	int n = fp->n;
+
+	if (n == 0)
+		return 0;
+	fp->n = 0;
+	return fp->fn(n, fp->n_coord, fp->buf, fp->user);
+}
+
+/* Does "sample" fit in a row of 64-bit integers?
+ * We only consider the parameters and set variables, skipping
+ * the leading constant and any trailing existentially quantified variables.
+ */
+static int sample_fits(struct isl_foreach_point_batch *fp,
+	__isl_keep isl_vec *sample)
+{
+	int i;
+
+	for (i = 0; i < fp->n_coord; ++i)
+		if (!isl_int_fits_slong(sample->el[1 + i]))
+			return 0;
+	return 1;
+}
+
+/* Add "sample" to the buffer if it fits and
+ * pass it to the fallback callback otherwise.
+ * Before calling the fallback callback, the buffer is flushed
+ * so that the points are seen in the order in which they were found.
+ */
+static int batch_add(struct isl_scan_callback *cb, __isl_take isl_vec *sample)
+{
+	struct isl_foreach_point_batch *fp;
+	isl_point *pnt;
+	int64_t *row;
+	int i;
+
+	fp = (struct isl_foreach_point_batch *) cb;
+	if (!sample)
+		return -1;
+	if (sample_fits(fp, sample)) {
+		row = fp->buf + fp->n * fp->n_coord;
+		for (i = 0; i < fp->n_coord; ++i)
+			row[i] = isl_int_get_si(sample->el[1 + i]);
+		isl_vec_free(sample);
+		if (++fp->n < fp->max)
+			return 0;
+		return batch_flush(fp);
+	}
+
+	if (batch_flush(fp) < 0)
+		goto error;
+	if (!fp->fallback)
+		isl_die(isl_vec_get_ctx(sample), isl_error_unsupported,
+			"coordinate does not fit in 64 bits", goto error);
+	pnt = isl_point_alloc(isl_space_copy(fp->space), sample);
+	return fp->fallback(pnt, fp->user);
+error:
+	isl_vec_free(sample);
+	return -1;
+}
+
+/* Add the "n" points "first" + k "step", with 0 <= k < n,
+ * to the buffer.
+ * If all coordinates of the first and the last of these points
+ * fit in 64 bits, then so do those of the points in between and
+ * we can compute the rows directly from the previous row.
+ * Otherwise, we handle the points one by one.
+ */
+static int batch_add_line(struct isl_scan_callback *cb,
+	__isl_take isl_vec *first, __isl_keep isl_vec *step, isl_int n)
+{
+	struct isl_foreach_point_batch *fp;
+	isl_vec *last;
+	int64_t *row, *d;
+	long k, count;
+	int i, fits;
+
+	fp = (struct isl_foreach_point_batch *) cb;
+	if (!first || !step)
+		goto error;
+
+	isl_int_sub_ui(fp->tmp, n, 1);
+	last = isl_vec_copy(first);
+	last = isl_vec_cow(last);
+	if (!last)
+		goto error;
+	for (i = 0; i < fp->n_coord; ++i)
+		isl_int_addmul(last->el[1 + i], fp->tmp, step->el[1 + i]);
+	fits = isl_int_fits_slong(n) && sample_fits(fp, first) &&
+		sample_fits(fp, last);
+	isl_vec_free(last);
+
+	if (!fits) {
+		for (k = 0; isl_int_cmp_si(n, k) > 0; ++k) {
+			isl_vec *sample = isl_vec_copy(first);
+			sample = isl_vec_cow(sample);
+			if (!sample)
+				goto error;
+			isl_int_set_si(fp->tmp, k);
+			for (i = 0; i < fp->n_coord; ++i)
+				isl_int_addmul(sample->el[1 + i], fp->tmp,
+						step->el[1 + i]);
+			if (batch_add(cb, sample) < 0)
+				goto error;
+		}
+		isl_vec_free(first);
+		return 0;
+	}
+
+	d = fp->buf + fp->max * fp->n_coord;
+	for (i = 0; i < fp->n_coord; ++i)
+		d[i] = isl_int_get_si(step->el[1 + i]);
+	if (batch_add(cb, first) < 0)
+		return -1;
+	count = isl_int_get_si(n);
+	for (k = 1; k < count; ++k) {
+		if (fp->n == 0) {
+			row = fp->buf + (fp->max - 1) * fp->n_coord;
+			for (i = 0; i < fp->n_coord; ++i)
+				fp->buf[i] = row[i] + d[i];
+		} else {
+			row = fp->buf + fp->n * fp->n_coord;
+			for (i = 0; i < fp->n_coord; ++i)
+				row[i] = row[i - fp->n_coord] + d[i];
+		}
+		if (++fp->n == fp->max && batch_flush(fp) < 0)
+			return -1;
+	}
+
+	return 0;
+error:
+	isl_vec_free(first);
+	return -1;
+}
+
+/* Initialize "fp" for collecting batches of at most "max_batch" points
+ * with "n_coord" coordinates in the context "ctx".
+ * "space" is the space of the points passed to "fallback".
+ * It may be NULL if "fallback" is NULL.
+ *
+ * The buffer contains an extra row that holds the difference
+ * between consecutive points on a line, as computed by batch_add_line.
+ * Since the last row of the buffer is not overwritten by batch_flush,
+ * batch_add_line can continue from this last row after a flush.
+ */
+static int batch_init_n_coord(struct isl_foreach_point_batch *fp,
+	isl_ctx *ctx, int max_batch, __isl_take isl_space *space, int n_coord,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	int (*fallback)(__isl_take isl_point *pnt, void *user), void *user)
+{
+	if (max_batch < 1)
+		isl_die(ctx, isl_error_invalid,
+			"batch size should be positive", goto error);
+
+	fp->callback.add = &batch_add;
+	fp->callback.add_line = &batch_add_line;
+	fp->fn = fn;
+	fp->fallback = fallback;
+	fp->user = user;
+	fp->space = space;
+	fp->n_coord = n_coord;
+	fp->max = max_batch;
+	fp->n = 0;
+	fp->buf = isl_alloc_array(ctx, int64_t,
+				(max_batch + 1) * (n_coord ? n_coord : 1));
+	if (!fp->buf)
+		goto error;
+	isl_int_init(fp->tmp);
+
+	return 0;
+error:
+	isl_space_free(space);
+	return -1;
+}
+
+/* Initialize "fp" for collecting batches of at most "max_batch" points
+ * in "space" in the context "ctx".
+ */
+static int batch_init(struct isl_foreach_point_batch *fp, isl_ctx *ctx,
+	int max_batch, __isl_take isl_space *space,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	int (*fallback)(__isl_take isl_point *pnt, void *user), void *user)
+{
+	if (!space)
+		return -1;
+	return batch_init_n_coord(fp, ctx, max_batch, space,
+			isl_space_dim(space, isl_dim_all), fn, fallback, user);
+}
+
+/* Free the memory allocated by batch_init.
+ */
+static void batch_clear(struct isl_foreach_point_batch *fp)
+{
+	isl_int_clear(fp->tmp);
+	free(fp->buf);
+	isl_space_free(fp->space);
+}
+
+/* Call "fn" on batches of at most "max_batch" integer points in "set".
+ * Each batch is passed as an array of "n" rows of "n_coord" 64-bit
+ * integers, with "n_coord" the number of parameters and set variables
+ * of "set".  The parameters come first.  The array is only valid
+ * during the call to "fn".
+ * The points are passed in the same order as by isl_set_foreach_point.
+ * Points with a coordinate that does not fit in 64 bits
+ * are passed to "fallback" instead.  If "fallback" is NULL,
+ * then such points result in an error.
+ */
+int isl_set_foreach_point_batch(__isl_keep isl_set *set, int max_batch,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	int (*fallback)(__isl_take isl_point *pnt, void *user), void *user)
+{
+	struct isl_foreach_point_batch fp;
+	int r;
+
+	if (!set || !fn)
+		return -1;
+
+	if (batch_init(&fp, isl_set_get_ctx(set), max_batch,
+			isl_set_get_space(set), fn, fallback, user) < 0)
+		return -1;
+
+	r = isl_set_scan(isl_set_copy(set), &fp.callback);
+	if (r >= 0)
+		r = batch_flush(&fp);
+
+	batch_clear(&fp);
+
+	return r;
+}
+
+/* Internal data structure for isl_set_foreach_point_batch_parallel.
+ * "n_coord" is the number of parameters and set variables of the set.
+ */
+struct isl_foreach_point_batch_parallel {
+	int max;
+	int n_coord;
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user);
+	void *user;
+};
+
+/* Create a batching callback for a worker of isl_set_scan_parallel
+ * in the context "ctx" of the worker.
+ * Since the points found by the worker do not live in the space
+ * of the original set, the callback does not have a space and
+ * a fallback can therefore not be supported.
+ */
+static struct isl_scan_callback *batch_parallel_alloc(isl_ctx *ctx,
+	void *user)
+{
+	struct isl_foreach_point_batch_parallel *data = user;
+	struct isl_foreach_point_batch *fp;
+
+	fp = isl_alloc_type(ctx, struct isl_foreach_point_batch);
+	if (!fp)
+		return NULL;
+	if (batch_init_n_coord(fp, ctx, data->max, NULL, data->n_coord,
+				data->fn, NULL, data->user) < 0) {
+		free(fp);
+		return NULL;
+	}
+
+	return &fp->callback;
+}
+
+/* Pass the remaining points of a worker to the user and
+ * free the batching callback.
+ */
+static int batch_parallel_free(struct isl_scan_callback *cb, int r,
+	void *user)
+{
+	struct isl_foreach_point_batch *fp;
+
+	fp = (struct isl_foreach_point_batch *) cb;
+	if (r >= 0)
+		r = batch_flush(fp);
+	batch_clear(fp);
+	free(fp);
+
+	return r;
+}
+
+/* Call "fn" on batches of at most "max_batch" integer points in "set",
+ * as in isl_set_foreach_point_batch, but using as many threads
+ * as specified by the "n_thread" option.
+ * "fn" may therefore be called concurrently from different threads
+ * and the batches are passed in no particular order.
+ * Points with a coordinate that does not fit in 64 bits
+ * result in an error.
+ */
+int isl_set_foreach_point_batch_parallel(__isl_keep isl_set *set,
+	int max_batch,
+	int (*fn)(int n, int n_coord, const int64_t *coord, void *user),
+	void *user)
+{
+	struct isl_foreach_point_batch_parallel data;
+	struct isl_scan_parallel par = { &batch_parallel_alloc,
+					 &batch_parallel_free, &data };
+	isl_ctx *ctx;
+
+	if (!set || !fn)
+		return -1;
+
+	ctx = isl_set_get_ctx(set);
+	if (max_batch < 1)
+		isl_die(ctx, isl_error_invalid,
+			"batch size should be positive", return -1);
+
+	data.max = max_batch;
+	data.n_coord = isl_set_dim(set, isl_dim_param) +
+			isl_set_dim(set, isl_dim_set);
+	data.fn = fn;
+	data.user = user;
+
+	return isl_set_scan_parallel(isl_set_copy(set),
+					isl_thread_n_thread(ctx), &par);
+}
+
 /* Return 1 if "bmap" contains the point "point".
  * "bmap" is assumed to have known divs.
  * The point is first extended with the divs and then passed
@@ -9,6 +9,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #define ISL_DIM_H
 #include <isl_ctx_private.h>
 #include <isl_map_private.h>
@@ -26,6 +27,7 @@
 #include <isl_local_space_private.h>
 #include <isl_aff_private.h>
 #include <isl_val_private.h>
+#include <isl_options_private.h>
 #include <isl_config.h>
 #include <isl/deprecated/polynomial_int.h>
 
@@ -1003,15 +1005,18 @@ __isl_give struct isl_upoly *isl_upoly_mul(__isl_take struct isl_upoly *up1,
 	if (isl_upoly_is_cst(up1))
 		return isl_upoly_mul_cst(up1, up2);
 
-	return isl_upoly_mul_rec(up1, up2);
+	return isl_upoly_mul_sparse(up1, up2, &isl_upoly_mul_rec);
 error:
 	isl_upoly_free(up1);
 	isl_upoly_free(up2);
 	return NULL;
 }
 
-__isl_give struct isl_upoly *isl_upoly_pow(__isl_take struct isl_upoly *up,
-	unsigned power)
+/* Return "up" raised to the power "power", computed
+ * in the recursive representation.
+ */
+static __isl_give struct isl_upoly *upoly_pow_rec(
+	__isl_take struct isl_upoly *up, unsigned power)
 {
 	struct isl_upoly *res;
 
@@ -1035,6 +1040,12 @@ __isl_give struct isl_upoly *isl_upoly_pow(__isl_take struct isl_upoly *up,
 	return res;
 }
 
+__isl_give struct isl_upoly *isl_upoly_pow(__isl_take struct isl_upoly *up,
+	unsigned power)
+{
+	return isl_upoly_pow_sparse(up, power, &upoly_pow_rec);
+}
+
 __isl_give isl_qpolynomial *isl_qpolynomial_alloc(__isl_take isl_space *dim,
 	unsigned n_div, __isl_take struct isl_upoly *up)
 {
@@ -1193,6 +1204,8 @@ static int compatible_divs(__isl_keep isl_mat *div1, __isl_keep isl_mat *div2)
 	int n_row, n_col;
 	int equal;
 
+	if (div1 == div2)
+		return 1;
 	isl_assert(div1->ctx, div1->n_row >= div2->n_row &&
 				div1->n_col >= div2->n_col, return -1);
 
@@ -1212,6 +1225,267 @@ static int compatible_divs(__isl_keep isl_mat *div1, __isl_keep isl_mat *div2)
 	return equal;
 }
 
+/* A canonical copy "div" of a list of integer divisions
+ * with hash value "hash".
+ */
+struct isl_qpolynomial_div_entry {
+	uint32_t hash;
+	isl_mat *div;
+};
+
+/* The result of merging the lists of integer divisions "div1" and "div2"
+ * into "div", with "exp1" and "exp2" the expansions computed
+ * by isl_merge_divs.
+ * The entry keeps a reference to "div1" and "div2" such that
+ * they cannot be freed and their addresses cannot be reused while
+ * the entry is in the cache.  The integer division matrices
+ * of quasipolynomials are only modified in place if they are
+ * not shared, so the contents of "div1" and "div2" do not change either.
+ */
+struct isl_qpolynomial_merge_entry {
+	isl_mat *div1;
+	isl_mat *div2;
+	isl_mat *div;
+	int *exp1;
+	int *exp2;
+};
+
+/* A cache of the "n_div" most recently used canonical lists of
+ * integer divisions and of the "n_merge" most recently computed merges
+ * of such lists, ordered from most recently to least recently used.
+ * "size" is the number of entries for which room has been allocated
+ * in each of the two arrays.
+ */
+struct isl_qpolynomial_div_cache {
+	int size;
+	int n_div;
+	struct isl_qpolynomial_div_entry *div;
+	int n_merge;
+	struct isl_qpolynomial_merge_entry *merge;
+};
+
+static void free_merge_entry(struct isl_qpolynomial_merge_entry *entry)
+{
+	isl_mat_free(entry->div1);
+	isl_mat_free(entry->div2);
+	isl_mat_free(entry->div);
+	free(entry->exp1);
+	free(entry->exp2);
+}
+
+/* Remove all entries from the cache of integer division lists
+ * of quasipolynomials of "ctx".
+ */
+void isl_ctx_clear_qpolynomial_div_cache(isl_ctx *ctx)
+{
+	int i;
+	struct isl_qpolynomial_div_cache *cache;
+
+	if (!ctx || !ctx->qpolynomial_div_cache)
+		return;
+
+	cache = ctx->qpolynomial_div_cache;
+	ctx->qpolynomial_div_cache = NULL;
+	for (i = 0; i < cache->n_div; ++i)
+		isl_mat_free(cache->div[i].div);
+	for (i = 0; i < cache->n_merge; ++i)
+		free_merge_entry(&cache->merge[i]);
+	free(cache->div);
+	free(cache->merge);
+	free(cache);
+}
+
+/* Return the cache of integer division lists of "ctx", with room for
+ * "size" entries of each kind, evicting the least recently used
+ * entries that do not fit.
+ */
+static struct isl_qpolynomial_div_cache *get_div_cache(isl_ctx *ctx,
+	int size)
+{
+	struct isl_qpolynomial_div_cache *cache = ctx->qpolynomial_div_cache;
+	struct isl_qpolynomial_div_entry *div;
+	struct isl_qpolynomial_merge_entry *merge;
+
+	if (!cache) {
+		cache = isl_calloc_type(ctx, struct isl_qpolynomial_div_cache);
+		if (!cache)
+			return NULL;
+		ctx->qpolynomial_div_cache = cache;
+	}
+	if (cache->size == size)
+		return cache;
+
+	while (cache->n_div > size)
+		isl_mat_free(cache->div[--cache->n_div].div);
+	while (cache->n_merge > size)
+		free_merge_entry(&cache->merge[--cache->n_merge]);
+	div = isl_realloc_array(ctx, cache->div,
+				struct isl_qpolynomial_div_entry, size);
+	if (div)
+		cache->div = div;
+	merge = isl_realloc_array(ctx, cache->merge,
+				struct isl_qpolynomial_merge_entry, size);
+	if (merge)
+		cache->merge = merge;
+	if (!div || !merge) {
+		isl_ctx_clear_qpolynomial_div_cache(ctx);
+		return NULL;
+	}
+	cache->size = size;
+
+	return cache;
+}
+
+/* Return a hash value for the list of integer divisions "div".
+ */
+static uint32_t div_get_hash(__isl_keep isl_mat *div)
+{
+	int i;
+	uint32_t hash = isl_hash_init();
+
+	isl_hash_byte(hash, div->n_row & 0xFF);
+	isl_hash_byte(hash, div->n_col & 0xFF);
+	for (i = 0; i < div->n_row; ++i) {
+		uint32_t c_hash;
+		c_hash = isl_seq_get_hash(div->row[i], div->n_col);
+		isl_hash_hash(hash, c_hash);
+	}
+
+	return hash;
+}
+
+/* Return a canonical copy of the list of integer divisions "div".
+ *
+ * If the qpolynomial_div_cache_size option is positive, then
+ * the most recently used lists of integer divisions are kept in a cache
+ * on the isl_ctx and all quasipolynomials with the same (sorted)
+ * list of integer divisions share the same isl_mat.
+ * This allows compatible_divs to detect identical lists
+ * without comparing them and allows the merges in with_merged_divs
+ * to be looked up by address.
+ * A list only needs to be compared to the entries with the same
+ * hash value.
+ */
+static __isl_give isl_mat *canonical_divs(__isl_take isl_mat *div)
+{
+	int i, size;
+	uint32_t hash;
+	isl_ctx *ctx;
+	struct isl_qpolynomial_div_cache *cache;
+	struct isl_qpolynomial_div_entry entry;
+
+	if (!div || div->n_row == 0)
+		return div;
+	ctx = isl_mat_get_ctx(div);
+	size = ctx->opt->qpolynomial_div_cache_size;
+	if (size <= 0)
+		return div;
+	cache = get_div_cache(ctx, size);
+	if (!cache)
+		return isl_mat_free(div);
+
+	hash = div_get_hash(div);
+	for (i = 0; i < cache->n_div; ++i) {
+		int equal;
+
+		if (cache->div[i].hash != hash)
+			continue;
+		if (cache->div[i].div == div)
+			break;
+		equal = isl_mat_is_equal(cache->div[i].div, div);
+		if (equal < 0)
+			return isl_mat_free(div);
+		if (equal)
+			break;
+	}
+
+	if (i < cache->n_div) {
+		entry = cache->div[i];
+		isl_mat_free(div);
+		div = isl_mat_copy(entry.div);
+	} else {
+		if (cache->n_div >= size)
+			isl_mat_free(cache->div[--cache->n_div].div);
+		i = cache->n_div++;
+		entry.hash = hash;
+		entry.div = isl_mat_copy(div);
+	}
+	memmove(cache->div + 1, cache->div,
+		i * sizeof(struct isl_qpolynomial_div_entry));
+	cache->div[0] = entry;
+
+	return div;
+}
+
+/* Look for the result of merging "div1" and "div2" in the cache of "ctx".
+ * If it is found, then the entry is moved to the front of the cache,
+ * the expansions are copied to "exp1" and "exp2" and
+ * a copy of the merged list is returned.
+ * Otherwise, NULL is returned.
+ */
+static __isl_give isl_mat *cache_find_merge(isl_ctx *ctx,
+	__isl_keep isl_mat *div1, __isl_keep isl_mat *div2,
+	int *exp1, int *exp2)
+{
+	int i;
+	struct isl_qpolynomial_div_cache *cache = ctx->qpolynomial_div_cache;
+	struct isl_qpolynomial_merge_entry entry;
+
+	for (i = 0; cache && i < cache->n_merge; ++i)
+		if (cache->merge[i].div1 == div1 && cache->merge[i].div2 == div2)
+			break;
+	if (!cache || i >= cache->n_merge)
+		return NULL;
+
+	entry = cache->merge[i];
+	memmove(cache->merge + 1, cache->merge,
+		i * sizeof(struct isl_qpolynomial_merge_entry));
+	cache->merge[0] = entry;
+
+	memcpy(exp1, entry.exp1, div1->n_row * sizeof(int));
+	memcpy(exp2, entry.exp2, div2->n_row * sizeof(int));
+	return isl_mat_copy(entry.div);
+}
+
+/* Add the result "div" of merging "div1" and "div2", with expansions
+ * "exp1" and "exp2", to the front of the cache of "ctx", which
+ * has room for "size" entries, evicting the least recently used entry
+ * if the cache is full.
+ */
+static int cache_insert_merge(isl_ctx *ctx, int size,
+	__isl_keep isl_mat *div1, __isl_keep isl_mat *div2,
+	__isl_keep isl_mat *div, int *exp1, int *exp2)
+{
+	struct isl_qpolynomial_div_cache *cache;
+	struct isl_qpolynomial_merge_entry entry;
+
+	cache = get_div_cache(ctx, size);
+	if (!cache)
+		return -1;
+
+	entry.exp1 = isl_alloc_array(ctx, int, div1->n_row);
+	entry.exp2 = isl_alloc_array(ctx, int, div2->n_row);
+	if ((div1->n_row && !entry.exp1) || (div2->n_row && !entry.exp2)) {
+		free(entry.exp1);
+		free(entry.exp2);
+		return -1;
+	}
+	memcpy(entry.exp1, exp1, div1->n_row * sizeof(int));
+	memcpy(entry.exp2, exp2, div2->n_row * sizeof(int));
+	entry.div1 = isl_mat_copy(div1);
+	entry.div2 = isl_mat_copy(div2);
+	entry.div = isl_mat_copy(div);
+
+	if (cache->n_merge >= size)
+		free_merge_entry(&cache->merge[--cache->n_merge]);
+	memmove(cache->merge + 1, cache->merge,
+		cache->n_merge * sizeof(struct isl_qpolynomial_merge_entry));
+	cache->merge[0] = entry;
+	cache->n_merge++;
+
+	return 0;
+}
+
 static int cmp_row(__isl_keep isl_mat *div, int i, int j)
 {
 	int li, lj;
@@ -1240,6 +1514,8 @@ static int div_sort_cmp(const void *p1, const void *p2)
 }
 
 /* Sort divs and remove duplicates.
+ * The sorted list of divs is replaced by its canonical copy
+ * (see canonical_divs).
  */
 static __isl_give isl_qpolynomial *sort_divs(__isl_take isl_qpolynomial *qp)
 {
@@ -1253,8 +1529,16 @@ static __isl_give isl_qpolynomial *sort_divs(__isl_take isl_qpolynomial *qp)
 
 	if (!qp)
 		return NULL;
-	if (qp->div->n_row <= 1)
+	if (qp->div->n_row <= 1) {
+		qp->div = canonical_divs(qp->div);
+		if (!qp->div)
+			return isl_qpolynomial_free(qp);
 		return qp;
+	}
+
+	qp->div = isl_mat_cow(qp->div);
+	if (!qp->div)
+		goto error;
 
 	div_pos = isl_space_dim(qp->dim, isl_dim_all);
 
@@ -1306,6 +1590,7 @@ static __isl_give isl_qpolynomial *sort_divs(__isl_take isl_qpolynomial *qp)
 	}
 
 	qp->upoly = reorder(qp->upoly, reordering);
+	qp->div = canonical_divs(qp->div);
 
 	if (!qp->upoly || !qp->div)
 		goto error;
@@ -1362,6 +1647,45 @@ error:
 	return NULL;
 }
 
+/* Merge the lists of integer divisions of "qp1" and "qp2" and
+ * return the result in "exp1" and "exp2".
+ *
+ * If the qpolynomial_div_cache_size option is positive, then
+ * the most recent merges are kept in a cache on the isl_ctx.
+ * Since quasipolynomials with the same list of integer divisions
+ * then share the same isl_mat, such a merge can be looked up
+ * by the addresses of the two lists.  The merged list is itself
+ * replaced by its canonical copy such that the result can in turn
+ * be found in the cache when it is combined with other quasipolynomials.
+ */
+static __isl_give isl_mat *merge_divs(__isl_keep isl_qpolynomial *qp1,
+	__isl_keep isl_qpolynomial *qp2, int *exp1, int *exp2)
+{
+	int size;
+	isl_ctx *ctx;
+	isl_mat *div;
+
+	ctx = isl_mat_get_ctx(qp1->div);
+	size = ctx->opt->qpolynomial_div_cache_size;
+	if (size <= 0)
+		return isl_merge_divs(qp1->div, qp2->div, exp1, exp2);
+
+	div = cache_find_merge(ctx, qp1->div, qp2->div, exp1, exp2);
+	if (div) {
+		ctx->stats->qpolynomial_n_div_merge_hit++;
+		return div;
+	}
+
+	ctx->stats->qpolynomial_n_div_merge_miss++;
+	div = isl_merge_divs(qp1->div, qp2->div, exp1, exp2);
+	div = canonical_divs(div);
+	if (div && cache_insert_merge(ctx, size, qp1->div, qp2->div,
+					div, exp1, exp2) < 0)
+		return isl_mat_free(div);
+
+	return div;
+}
+
 static __isl_give isl_qpolynomial *with_merged_divs(
 	__isl_give isl_qpolynomial *(*fn)(__isl_take isl_qpolynomial *qp1,
 					  __isl_take isl_qpolynomial *qp2),
@@ -1385,7 +1709,7 @@ static __isl_give isl_qpolynomial *with_merged_divs(
 	if (!exp1 || !exp2)
 		goto error;
 
-	div = isl_merge_divs(qp1->div, qp2->div, exp1, exp2);
+	div = merge_divs(qp1, qp2, exp1, exp2);
 	if (!div)
 		goto error;
 
@@ -2096,6 +2420,10 @@ static __isl_give isl_qpolynomial *substitute_non_divs(
 	if (!qp)
 		return NULL;
 
+	qp->div = isl_mat_cow(qp->div);
+	if (!qp->div)
+		return isl_qpolynomial_free(qp);
+
 	total = isl_space_dim(qp->dim, isl_dim_all);
 	for (i = 0; qp && i < qp->div->n_row; ++i) {
 		if (!isl_int_is_one(qp->div->row[i][0]))
@@ -2223,6 +2551,10 @@ static __isl_give isl_qpolynomial *reduce_divs(__isl_take isl_qpolynomial *qp)
 	if (!qp)
 		return NULL;
 
+	qp->div = isl_mat_cow(qp->div);
+	if (!qp->div)
+		goto error;
+
 	aff = isl_vec_alloc(qp->div->ctx, qp->div->n_col - 1);
 	aff = isl_vec_clr(aff);
 	if (!aff)
@@ -2805,12 +3137,18 @@ __isl_give isl_pw_qpolynomial *isl_pw_qpolynomial_add(
 	return isl_pw_qpolynomial_union_add_(pwqp1, pwqp2);
 }
 
+/* Multiply "pwqp1" and "pwqp2" on their shared domain.
+ * The piece indices of the arguments are used to only consider
+ * pairs of pieces with overlapping bounding boxes.
+ */
 __isl_give isl_pw_qpolynomial *isl_pw_qpolynomial_mul(
 	__isl_take isl_pw_qpolynomial *pwqp1,
 	__isl_take isl_pw_qpolynomial *pwqp2)
 {
-	int i, j, n;
-	struct isl_pw_qpolynomial *res;
+	int i, j, k, n, n_cand;
+	struct isl_pw_qpolynomial *res = NULL;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pwqp1 || !pwqp2)
 		goto error;
@@ -2838,13 +3176,27 @@ __isl_give isl_pw_qpolynomial *isl_pw_qpolynomial_mul(
 		return pwqp1;
 	}
 
+	index1 = isl_pw_qpolynomial_get_index(pwqp1);
+	index2 = isl_pw_qpolynomial_get_index(pwqp2);
+	if (!index1 || !index2)
+		goto error;
+	if (pwqp2->n > 0) {
+		cand = isl_alloc_array(pwqp1->dim->ctx, int, pwqp2->n);
+		if (!cand)
+			goto error;
+	}
+
 	n = pwqp1->n * pwqp2->n;
 	res = isl_pw_qpolynomial_alloc_size(isl_space_copy(pwqp1->dim), n);
 
 	for (i = 0; i < pwqp1->n; ++i) {
-		for (j = 0; j < pwqp2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			goto error;
+		for (k = 0; k < n_cand; ++k) {
 			struct isl_set *common;
 			struct isl_qpolynomial *prod;
+			j = cand[k];
 			common = isl_set_intersect(isl_set_copy(pwqp1->p[i].set),
 						isl_set_copy(pwqp2->p[j].set));
 			if (isl_set_plain_is_empty(common)) {
@@ -2860,14 +3212,16 @@ __isl_give isl_pw_qpolynomial *isl_pw_qpolynomial_mul(
 		}
 	}
 
+	free(cand);
 	isl_pw_qpolynomial_free(pwqp1);
 	isl_pw_qpolynomial_free(pwqp2);
 
 	return res;
 error:
+	free(cand);
 	isl_pw_qpolynomial_free(pwqp1);
 	isl_pw_qpolynomial_free(pwqp2);
-	return NULL;
+	return isl_pw_qpolynomial_free(res);
 }
 
 __isl_give isl_val *isl_upoly_eval(__isl_take struct isl_upoly *up,
@@ -4224,8 +4578,12 @@ static int set_div(__isl_take isl_set *set,
 	slice = set_div_slice(isl_set_get_space(set), qp, div, v);
 	set = isl_set_intersect(set, slice);
 
+	qp = isl_qpolynomial_cow(qp);
 	if (!qp)
 		goto error;
+	qp->div = isl_mat_cow(qp->div);
+	if (!qp->div)
+		goto error;
 
 	total = isl_space_dim(qp->dim, isl_dim_all);
 
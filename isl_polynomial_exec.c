@@ -0,0 +1,900 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <stdlib.h>
+#include <isl_ctx_private.h>
+#include <isl_map_private.h>
+#include <isl_mat_private.h>
+#include <isl_polynomial_private.h>
+#include <isl_point_private.h>
+#include <isl_val_private.h>
+#include <isl_vec_private.h>
+#include <isl/set.h>
+
+/* The operations of the bytecode into which the polynomials are compiled.
+ *
+ * The bytecode operates on a stack of 64-bit integers.
+ * isl_qpolynomial_exec_op_const pushes the constant in the next code word.
+ * isl_qpolynomial_exec_op_mul_var multiplies the top of the stack
+ * by the variable with the index in the next code word.
+ * isl_qpolynomial_exec_op_add pops two elements and pushes their sum.
+ * isl_qpolynomial_exec_op_ret terminates the evaluation of a polynomial.
+ *
+ * A polynomial is compiled in Horner form, such that each
+ * multiplication by a variable only involves the top of the stack.
+ */
+enum isl_qpolynomial_exec_op {
+	isl_qpolynomial_exec_op_ret,
+	isl_qpolynomial_exec_op_const,
+	isl_qpolynomial_exec_op_mul_var,
+	isl_qpolynomial_exec_op_add
+};
+
+/* A compiled basic set.
+ *
+ * "n_div" integer divisions are stored at offset "div" in the "aff" array
+ * of the isl_pw_qpolynomial_exec, each as a row of length
+ * 2 + n_coord + n_div containing the denominator followed by
+ * the numerator.
+ * The "n_eq" equality constraints and the "n_ineq" inequality constraints
+ * are stored at offsets "eq" and "ineq", each as a row of length
+ * 1 + n_coord + n_div.
+ */
+struct isl_pw_qpolynomial_exec_bset {
+	int n_div;
+	int div;
+	int n_eq;
+	int eq;
+	int n_ineq;
+	int ineq;
+};
+
+/* A compiled quasipolynomial.
+ *
+ * "n_div" integer divisions are stored at offset "div" in the "aff" array
+ * of the isl_pw_qpolynomial_exec in the same way as those of
+ * an isl_pw_qpolynomial_exec_bset.
+ * "code" is the offset of the bytecode that evaluates the polynomial
+ * multiplied by "den".
+ */
+struct isl_pw_qpolynomial_exec_qp {
+	int n_div;
+	int div;
+	int code;
+	int64_t den;
+};
+
+/* A compiled piece.
+ *
+ * The domain of the piece is the union of the "n_bset" compiled basic sets
+ * starting at position "bset".
+ * The value of the piece is the compiled quasipolynomial at position "qp"
+ * or, for a fold, the minimum or maximum of the "n_qp" compiled
+ * quasipolynomials starting at position "qp".
+ * "exact" is set if (part of) the piece could not be compiled,
+ * in which case any point that reaches this piece is evaluated exactly.
+ */
+struct isl_pw_qpolynomial_exec_piece {
+	int bset;
+	int n_bset;
+	int qp;
+	int n_qp;
+	int exact;
+};
+
+/* A piecewise quasipolynomial or a piecewise quasipolynomial fold
+ * compiled for evaluation by isl_pw_qpolynomial_exec_eval.
+ *
+ * "n_coord" is the number of coordinates (parameters followed by
+ * set variables) of each point.
+ * "pwqp" or "pwf" is the original object, kept for evaluating
+ * points that cannot be evaluated in 64-bit arithmetic.
+ * "type" is the type of the fold.
+ *
+ * "aff" contains the rows of all integer divisions and constraints and
+ * "code" contains the bytecode of all polynomials,
+ * each terminated by isl_qpolynomial_exec_op_ret.
+ *
+ * "var" is a buffer of size "max_var" holding the coordinates
+ * of the current point, followed by the values of the integer divisions.
+ * "stack" is the evaluation stack, of size "max_depth".
+ */
+struct isl_pw_qpolynomial_exec {
+	isl_ctx *ctx;
+
+	int n_coord;
+	isl_pw_qpolynomial *pwqp;
+	isl_pw_qpolynomial_fold *pwf;
+	enum isl_fold type;
+
+	int n_piece;
+	struct isl_pw_qpolynomial_exec_piece *piece;
+
+	int n_bset;
+	int size_bset;
+	struct isl_pw_qpolynomial_exec_bset *bset;
+
+	int n_qp;
+	int size_qp;
+	struct isl_pw_qpolynomial_exec_qp *qp;
+
+	int n_aff;
+	int size_aff;
+	int64_t *aff;
+
+	int n_code;
+	int size_code;
+	int64_t *code;
+
+	int max_var;
+	int64_t *var;
+	int max_depth;
+	int64_t *stack;
+};
+
+isl_ctx *isl_pw_qpolynomial_exec_get_ctx(
+	__isl_keep isl_pw_qpolynomial_exec *exec)
+{
+	return exec ? exec->ctx : NULL;
+}
+
+void *isl_pw_qpolynomial_exec_free(__isl_take isl_pw_qpolynomial_exec *exec)
+{
+	if (!exec)
+		return NULL;
+
+	isl_pw_qpolynomial_free(exec->pwqp);
+	isl_pw_qpolynomial_fold_free(exec->pwf);
+	free(exec->piece);
+	free(exec->bset);
+	free(exec->qp);
+	free(exec->aff);
+	free(exec->code);
+	free(exec->var);
+	free(exec->stack);
+	isl_ctx_deref(exec->ctx);
+	free(exec);
+
+	return NULL;
+}
+
+/* Make sure the array "list" of elements of size "el_size",
+ * with "n_list" elements in use and "size" elements allocated,
+ * has room for at least "n" more elements.
+ */
+static int reserve(isl_ctx *ctx, void **list, int n_list, int *size,
+	size_t el_size, int n)
+{
+	void *res;
+	int new_size;
+
+	if (n_list + n <= *size)
+		return 0;
+	new_size = 2 * (n_list + n) + 16;
+	res = isl_realloc(ctx, *list, char, new_size * el_size);
+	if (!res)
+		return -1;
+	*list = res;
+	*size = new_size;
+	return 0;
+}
+
+/* Append "word" to the code of "exec".
+ */
+static int add_code(isl_pw_qpolynomial_exec *exec, int64_t word)
+{
+	if (reserve(exec->ctx, (void **) &exec->code, exec->n_code,
+		    &exec->size_code, sizeof(int64_t), 1) < 0)
+		return -1;
+	exec->code[exec->n_code++] = word;
+	return 0;
+}
+
+/* Does "v" fit in an int64_t?
+ */
+static int int_fits(isl_int v)
+{
+	return isl_int_fits_slong(v) &&
+		(sizeof(long) <= sizeof(int64_t) ||
+		 (isl_int_get_si(v) >= INT64_MIN &&
+		  isl_int_get_si(v) <= INT64_MAX));
+}
+
+/* Append the "n_row" rows "row", each of length "len",
+ * to the "aff" array of "exec".
+ * Return the offset of the first row, -2 if some coefficient
+ * does not fit in an int64_t or -1 on error.
+ */
+static int add_rows(isl_pw_qpolynomial_exec *exec, isl_int **row, int n_row,
+	int len)
+{
+	int i, j, pos;
+
+	if (reserve(exec->ctx, (void **) &exec->aff, exec->n_aff,
+		    &exec->size_aff, sizeof(int64_t), n_row * len) < 0)
+		return -1;
+	pos = exec->n_aff;
+	for (i = 0; i < n_row; ++i) {
+		for (j = 0; j < len; ++j) {
+			if (!int_fits(row[i][j]))
+				return -2;
+			exec->aff[pos + i * len + j] = isl_int_get_si(row[i][j]);
+		}
+	}
+	exec->n_aff += n_row * len;
+	return pos;
+}
+
+/* Make sure the "var" buffer of "exec" can hold the coordinates
+ * of a point along with "n_div" integer divisions.
+ */
+static void update_max_var(isl_pw_qpolynomial_exec *exec, int n_div)
+{
+	if (exec->n_coord + n_div > exec->max_var)
+		exec->max_var = exec->n_coord + n_div;
+}
+
+/* Compile "bset" and append the result to the compiled basic sets
+ * of "exec".
+ * Return 1 if "bset" could not be compiled because it has
+ * an integer division without explicit representation or
+ * because some coefficient does not fit in an int64_t.
+ */
+static int compile_bset(isl_pw_qpolynomial_exec *exec,
+	__isl_keep isl_basic_set *bset)
+{
+	struct isl_pw_qpolynomial_exec_bset *cb;
+	int i, total;
+
+	for (i = 0; i < bset->n_div; ++i)
+		if (isl_int_is_zero(bset->div[i][0]))
+			return 1;
+
+	if (reserve(exec->ctx, (void **) &exec->bset, exec->n_bset,
+		    &exec->size_bset, sizeof(*exec->bset), 1) < 0)
+		return -1;
+	cb = &exec->bset[exec->n_bset];
+	total = isl_basic_set_total_dim(bset);
+	cb->n_div = bset->n_div;
+	cb->div = add_rows(exec, bset->div, bset->n_div, 2 + total);
+	if (cb->div < 0)
+		return cb->div == -2 ? 1 : -1;
+	cb->n_eq = bset->n_eq;
+	cb->eq = add_rows(exec, bset->eq, bset->n_eq, 1 + total);
+	if (cb->eq < 0)
+		return cb->eq == -2 ? 1 : -1;
+	cb->n_ineq = bset->n_ineq;
+	cb->ineq = add_rows(exec, bset->ineq, bset->n_ineq, 1 + total);
+	if (cb->ineq < 0)
+		return cb->ineq == -2 ? 1 : -1;
+	update_max_var(exec, bset->n_div);
+	exec->n_bset++;
+
+	return 0;
+}
+
+/* Compile the domain "set" of a piece into "piece".
+ * The integer divisions of "set" are first made explicit.
+ */
+static int compile_domain(isl_pw_qpolynomial_exec *exec,
+	struct isl_pw_qpolynomial_exec_piece *piece, __isl_keep isl_set *set)
+{
+	int i;
+	int r = 0;
+
+	set = isl_set_compute_divs(isl_set_copy(set));
+	if (!set)
+		return -1;
+
+	piece->bset = exec->n_bset;
+	for (i = 0; i < set->n; ++i) {
+		r = compile_bset(exec, set->p[i]);
+		if (r)
+			break;
+	}
+	piece->n_bset = exec->n_bset - piece->bset;
+	isl_set_free(set);
+
+	if (r < 0)
+		return -1;
+	if (r)
+		piece->exact = 1;
+	return 0;
+}
+
+/* Compute the least common multiple of the denominators of
+ * the coefficients of "up" in "d".
+ * Return 1 if "up" has an infinite or NaN coefficient.
+ */
+static int upoly_lcm_den(__isl_keep struct isl_upoly *up, isl_int *d)
+{
+	int i;
+	struct isl_upoly_rec *rec;
+
+	if (isl_upoly_is_cst(up)) {
+		struct isl_upoly_cst *cst = isl_upoly_as_cst(up);
+		if (isl_int_is_zero(cst->d))
+			return 1;
+		isl_int_lcm(*d, *d, cst->d);
+		return 0;
+	}
+
+	rec = isl_upoly_as_rec(up);
+	for (i = 0; i < rec->n; ++i)
+		if (upoly_lcm_den(rec->p[i], d))
+			return 1;
+	return 0;
+}
+
+/* Append bytecode to "exec" that pushes the value of "up"
+ * multiplied by "d" on the stack.
+ * "depth" is the size of the evaluation stack before evaluating "up".
+ * Return 1 if some coefficient does not fit in an int64_t.
+ *
+ * A polynomial p_0 + x (p_1 + x (p_2 + ... + x p_n))
+ * is evaluated by evaluating p_n, multiplying by x and adding p_{n-1},
+ * multiplying by x and so on.
+ */
+static int compile_upoly(isl_pw_qpolynomial_exec *exec,
+	__isl_keep struct isl_upoly *up, isl_int d, int depth)
+{
+	int i, r;
+	struct isl_upoly_rec *rec;
+
+	if (depth + 1 > exec->max_depth)
+		exec->max_depth = depth + 1;
+
+	if (isl_upoly_is_cst(up)) {
+		struct isl_upoly_cst *cst = isl_upoly_as_cst(up);
+		isl_int v;
+
+		isl_int_init(v);
+		isl_int_divexact(v, d, cst->d);
+		isl_int_mul(v, v, cst->n);
+		r = int_fits(v);
+		if (r && (add_code(exec, isl_qpolynomial_exec_op_const) < 0 ||
+			  add_code(exec, isl_int_get_si(v)) < 0))
+			r = -1;
+		isl_int_clear(v);
+		return r < 0 ? -1 : !r;
+	}
+
+	rec = isl_upoly_as_rec(up);
+	r = compile_upoly(exec, rec->p[rec->n - 1], d, depth);
+	for (i = rec->n - 2; !r && i >= 0; --i) {
+		if (add_code(exec, isl_qpolynomial_exec_op_mul_var) < 0 ||
+		    add_code(exec, up->var) < 0)
+			return -1;
+		if (isl_upoly_is_zero(rec->p[i]))
+			continue;
+		r = compile_upoly(exec, rec->p[i], d, depth + 1);
+		if (!r && add_code(exec, isl_qpolynomial_exec_op_add) < 0)
+			return -1;
+	}
+
+	return r;
+}
+
+/* Compile "qp" and append the result to the compiled quasipolynomials
+ * of "exec".
+ * Return 1 if "qp" could not be compiled.
+ *
+ * The polynomial is multiplied by the least common multiple
+ * of the denominators of its coefficients such that it
+ * can be evaluated in integer arithmetic.
+ */
+static int compile_qp(isl_pw_qpolynomial_exec *exec,
+	__isl_keep isl_qpolynomial *qp)
+{
+	struct isl_pw_qpolynomial_exec_qp *cqp;
+	int r, total;
+	isl_int d;
+
+	if (reserve(exec->ctx, (void **) &exec->qp, exec->n_qp,
+		    &exec->size_qp, sizeof(*exec->qp), 1) < 0)
+		return -1;
+	cqp = &exec->qp[exec->n_qp];
+
+	for (r = 0; r < qp->div->n_row; ++r)
+		if (isl_int_is_zero(qp->div->row[r][0]))
+			return 1;
+	total = qp->div->n_col;
+	cqp->n_div = qp->div->n_row;
+	cqp->div = add_rows(exec, qp->div->row, qp->div->n_row, total);
+	if (cqp->div < 0)
+		return cqp->div == -2 ? 1 : -1;
+
+	isl_int_init(d);
+	isl_int_set_si(d, 1);
+	r = upoly_lcm_den(qp->upoly, &d);
+	if (!r && !int_fits(d))
+		r = 1;
+	cqp->den = isl_int_get_si(d);
+	cqp->code = exec->n_code;
+	if (!r)
+		r = compile_upoly(exec, qp->upoly, d, 0);
+	isl_int_clear(d);
+	if (r)
+		return r;
+	if (add_code(exec, isl_qpolynomial_exec_op_ret) < 0)
+		return -1;
+
+	update_max_var(exec, cqp->n_div);
+	exec->n_qp++;
+	return 0;
+}
+
+/* Compile the "n" quasipolynomials "qp" of a piece into "piece".
+ */
+static int compile_qps(isl_pw_qpolynomial_exec *exec,
+	struct isl_pw_qpolynomial_exec_piece *piece,
+	isl_qpolynomial **qp, int n)
+{
+	int i, r = 0;
+
+	piece->qp = exec->n_qp;
+	for (i = 0; i < n; ++i) {
+		r = compile_qp(exec, qp[i]);
+		if (r)
+			break;
+	}
+	piece->n_qp = exec->n_qp - piece->qp;
+	if (r < 0)
+		return -1;
+	if (r)
+		piece->exact = 1;
+	return 0;
+}
+
+/* Allocate an isl_pw_qpolynomial_exec with "n_piece" pieces
+ * of an object with space "space".
+ */
+static __isl_give isl_pw_qpolynomial_exec *exec_alloc(
+	__isl_keep isl_space *space, int n_piece)
+{
+	isl_ctx *ctx;
+	isl_pw_qpolynomial_exec *exec;
+
+	if (!space)
+		return NULL;
+
+	ctx = isl_space_get_ctx(space);
+	exec = isl_calloc_type(ctx, isl_pw_qpolynomial_exec);
+	if (!exec)
+		return NULL;
+
+	exec->ctx = ctx;
+	isl_ctx_ref(ctx);
+	exec->n_coord = isl_space_dim(space, isl_dim_param) +
+			isl_space_dim(space, isl_dim_in);
+	exec->max_var = exec->n_coord;
+	exec->n_piece = n_piece;
+	exec->piece = isl_calloc_array(ctx,
+			struct isl_pw_qpolynomial_exec_piece, n_piece);
+	if (n_piece && !exec->piece)
+		return isl_pw_qpolynomial_exec_free(exec);
+
+	return exec;
+}
+
+/* Allocate the evaluation buffers of "exec".
+ */
+static __isl_give isl_pw_qpolynomial_exec *exec_finalize(
+	__isl_take isl_pw_qpolynomial_exec *exec)
+{
+	if (!exec)
+		return NULL;
+
+	exec->var = isl_alloc_array(exec->ctx, int64_t, exec->max_var);
+	exec->stack = isl_alloc_array(exec->ctx, int64_t, exec->max_depth);
+	if ((exec->max_var && !exec->var) ||
+	    (exec->max_depth && !exec->stack))
+		return isl_pw_qpolynomial_exec_free(exec);
+
+	return exec;
+}
+
+/* Compile "pwqp" into a form that can be evaluated efficiently
+ * on a batch of integer points.
+ *
+ * Pieces that cannot be compiled because they involve coefficients
+ * that do not fit in 64-bit integers are marked "exact".
+ */
+__isl_give isl_pw_qpolynomial_exec *isl_pw_qpolynomial_compile(
+	__isl_keep isl_pw_qpolynomial *pwqp)
+{
+	int i;
+	isl_pw_qpolynomial_exec *exec;
+
+	if (!pwqp)
+		return NULL;
+
+	exec = exec_alloc(pwqp->dim, pwqp->n);
+	if (!exec)
+		return NULL;
+
+	exec->pwqp = isl_pw_qpolynomial_copy(pwqp);
+	for (i = 0; i < pwqp->n; ++i) {
+		struct isl_pw_qpolynomial_exec_piece *piece = &exec->piece[i];
+
+		if (compile_domain(exec, piece, pwqp->p[i].set) < 0)
+			return isl_pw_qpolynomial_exec_free(exec);
+		if (!piece->exact &&
+		    compile_qps(exec, piece, &pwqp->p[i].qp, 1) < 0)
+			return isl_pw_qpolynomial_exec_free(exec);
+	}
+
+	return exec_finalize(exec);
+}
+
+/* Compile "pwf" into a form that can be evaluated efficiently
+ * on a batch of integer points.
+ */
+__isl_give isl_pw_qpolynomial_exec *isl_pw_qpolynomial_fold_compile(
+	__isl_keep isl_pw_qpolynomial_fold *pwf)
+{
+	int i;
+	isl_pw_qpolynomial_exec *exec;
+
+	if (!pwf)
+		return NULL;
+	if (pwf->type == isl_fold_list)
+		isl_die(isl_pw_qpolynomial_fold_get_ctx(pwf),
+			isl_error_invalid, "cannot evaluate list", return NULL);
+
+	exec = exec_alloc(pwf->dim, pwf->n);
+	if (!exec)
+		return NULL;
+
+	exec->pwf = isl_pw_qpolynomial_fold_copy(pwf);
+	exec->type = pwf->type;
+	for (i = 0; i < pwf->n; ++i) {
+		struct isl_pw_qpolynomial_exec_piece *piece = &exec->piece[i];
+		isl_qpolynomial_fold *fold = pwf->p[i].fold;
+
+		if (compile_domain(exec, piece, pwf->p[i].set) < 0)
+			return isl_pw_qpolynomial_exec_free(exec);
+		if (!piece->exact &&
+		    compile_qps(exec, piece, fold->qp, fold->n) < 0)
+			return isl_pw_qpolynomial_exec_free(exec);
+	}
+
+	return exec_finalize(exec);
+}
+
+/* Set "*r" to "a + b".
+ * Return -1 if the result does not fit in an int64_t.
+ */
+static int add_check(int64_t a, int64_t b, int64_t *r)
+{
+	if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+		return -1;
+	*r = a + b;
+	return 0;
+}
+
+/* Set "*r" to "a * b".
+ * Return -1 if the result does not fit in an int64_t.
+ */
+static int mul_check(int64_t a, int64_t b, int64_t *r)
+{
+	if (a > 0) {
+		if (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+			return -1;
+	} else if (a < 0) {
+		if (b > 0 ? a < INT64_MIN / b : b < INT64_MAX / a)
+			return -1;
+	}
+	*r = a * b;
+	return 0;
+}
+
+/* Return the floor of "a / b", with b > 0.
+ */
+static int64_t fdiv_q(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+
+	if (a % b < 0)
+		--q;
+	return q;
+}
+
+/* Set "*r" to the value of the affine expression "row"
+ * of length 1 + "n" at "var".
+ * Return -1 on overflow.
+ */
+static int eval_aff(const int64_t *row, int n, const int64_t *var, int64_t *r)
+{
+	int i;
+	int64_t v = row[0], t;
+
+	for (i = 0; i < n; ++i) {
+		if (!row[1 + i])
+			continue;
+		if (mul_check(row[1 + i], var[i], &t) < 0 ||
+		    add_check(v, t, &v) < 0)
+			return -1;
+	}
+	*r = v;
+	return 0;
+}
+
+/* Compute the values of the "n_div" integer divisions stored
+ * at offset "div" in the "aff" array of "exec" and
+ * store them in the "var" buffer after the coordinates.
+ * Return -1 on overflow.
+ */
+static int eval_divs(isl_pw_qpolynomial_exec *exec, int n_div, int div)
+{
+	int i;
+	int len = 2 + exec->n_coord + n_div;
+	int64_t v;
+
+	for (i = 0; i < n_div; ++i) {
+		const int64_t *row = exec->aff + div + i * len;
+		if (eval_aff(row + 1, exec->n_coord + i, exec->var, &v) < 0)
+			return -1;
+		exec->var[exec->n_coord + i] = fdiv_q(v, row[0]);
+	}
+	return 0;
+}
+
+/* Is the point in the "var" buffer of "exec" an element of "bset"?
+ * Return -1 on overflow.
+ */
+static int bset_contains(isl_pw_qpolynomial_exec *exec,
+	struct isl_pw_qpolynomial_exec_bset *bset)
+{
+	int i;
+	int n = exec->n_coord + bset->n_div;
+	int64_t v;
+
+	if (eval_divs(exec, bset->n_div, bset->div) < 0)
+		return -1;
+	for (i = 0; i < bset->n_eq; ++i) {
+		if (eval_aff(exec->aff + bset->eq + i * (1 + n), n,
+				exec->var, &v) < 0)
+			return -1;
+		if (v != 0)
+			return 0;
+	}
+	for (i = 0; i < bset->n_ineq; ++i) {
+		if (eval_aff(exec->aff + bset->ineq + i * (1 + n), n,
+				exec->var, &v) < 0)
+			return -1;
+		if (v < 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Evaluate the bytecode at offset "pc" in the code of "exec"
+ * and store the result in "r".
+ * Return -1 on overflow.
+ */
+static int eval_code(isl_pw_qpolynomial_exec *exec, int pc, int64_t *r)
+{
+	int64_t *sp = exec->stack;
+	const int64_t *code = exec->code;
+
+	for (;;) {
+		switch (code[pc++]) {
+		case isl_qpolynomial_exec_op_ret:
+			*r = sp[-1];
+			return 0;
+		case isl_qpolynomial_exec_op_const:
+			*sp++ = code[pc++];
+			break;
+		case isl_qpolynomial_exec_op_mul_var:
+			if (mul_check(sp[-1], exec->var[code[pc++]],
+					&sp[-1]) < 0)
+				return -1;
+			break;
+		case isl_qpolynomial_exec_op_add:
+			--sp;
+			if (add_check(sp[-1], sp[0], &sp[-1]) < 0)
+				return -1;
+			break;
+		}
+	}
+}
+
+/* Evaluate "qp" at the point in the "var" buffer of "exec" and
+ * store the result as the fraction "num" / "den".
+ * Return -1 on overflow.
+ */
+static int eval_qp(isl_pw_qpolynomial_exec *exec,
+	struct isl_pw_qpolynomial_exec_qp *qp, int64_t *num, int64_t *den)
+{
+	if (eval_divs(exec, qp->n_div, qp->div) < 0)
+		return -1;
+	if (eval_code(exec, qp->code, num) < 0)
+		return -1;
+	*den = qp->den;
+	return 0;
+}
+
+/* Is "num1" / "den1" smaller than "num2" / "den2"?
+ * The denominators are positive.
+ * Return -1 on overflow.
+ */
+static int lt(int64_t num1, int64_t den1, int64_t num2, int64_t den2)
+{
+	int64_t a, b;
+
+	if (mul_check(num1, den2, &a) < 0 || mul_check(num2, den1, &b) < 0)
+		return -1;
+	return a < b;
+}
+
+/* Evaluate the fold consisting of the "n" compiled quasipolynomials
+ * starting at "qp" at the point in the "var" buffer of "exec" and
+ * store the result as the fraction "num" / "den".
+ * Return -1 on overflow.
+ */
+static int eval_fold(isl_pw_qpolynomial_exec *exec,
+	struct isl_pw_qpolynomial_exec_qp *qp, int n, int64_t *num,
+	int64_t *den)
+{
+	int i, better;
+	int64_t n_i, d_i;
+
+	*num = 0;
+	*den = 1;
+	for (i = 0; i < n; ++i) {
+		if (eval_qp(exec, &qp[i], &n_i, &d_i) < 0)
+			return -1;
+		if (i == 0) {
+			better = 1;
+		} else if (exec->type == isl_fold_max) {
+			better = lt(*num, *den, n_i, d_i);
+		} else {
+			better = lt(n_i, d_i, *num, *den);
+		}
+		if (better < 0)
+			return -1;
+		if (better) {
+			*num = n_i;
+			*den = d_i;
+		}
+	}
+	return 0;
+}
+
+/* Return the greatest common divisor of the non-negative "a" and "b".
+ */
+static int64_t gcd(int64_t a, int64_t b)
+{
+	while (b) {
+		int64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Evaluate "exec" at the point with coordinates "point" in 64-bit
+ * arithmetic and store the result as the reduced fraction "num" / "den".
+ * Return 0 on success and 1 if the point needs to be evaluated exactly,
+ * either because it lies in a piece that could not be compiled or
+ * because some intermediate result does not fit in an int64_t.
+ *
+ * The value at a point outside all pieces is zero.
+ */
+static int eval_fast(isl_pw_qpolynomial_exec *exec, const int64_t *point,
+	int64_t *num, int64_t *den)
+{
+	int i, j, in;
+	int64_t g;
+
+	for (i = 0; i < exec->n_coord; ++i)
+		exec->var[i] = point[i];
+
+	*num = 0;
+	*den = 1;
+	for (i = 0; i < exec->n_piece; ++i) {
+		struct isl_pw_qpolynomial_exec_piece *piece = &exec->piece[i];
+
+		if (piece->exact)
+			return 1;
+		in = 0;
+		for (j = 0; !in && j < piece->n_bset; ++j) {
+			in = bset_contains(exec, &exec->bset[piece->bset + j]);
+			if (in < 0)
+				return 1;
+		}
+		if (!in)
+			continue;
+		if (exec->pwqp &&
+		    eval_qp(exec, &exec->qp[piece->qp], num, den) < 0)
+			return 1;
+		if (exec->pwf && eval_fold(exec, &exec->qp[piece->qp],
+					    piece->n_qp, num, den) < 0)
+			return 1;
+		break;
+	}
+
+	if (*num == INT64_MIN)
+		return 1;
+	g = gcd(*num < 0 ? -*num : *num, *den);
+	*num /= g;
+	*den /= g;
+	return 0;
+}
+
+/* Evaluate the original object of "exec" at the point with
+ * coordinates "point" in exact arithmetic and store the result
+ * as the reduced fraction "num" / "den".
+ */
+static int eval_exact(isl_pw_qpolynomial_exec *exec, const int64_t *point,
+	int64_t *num, int64_t *den)
+{
+	int i;
+	isl_space *space;
+	isl_point *pnt;
+	isl_val *v;
+
+	if (exec->pwqp)
+		space = isl_pw_qpolynomial_get_domain_space(exec->pwqp);
+	else
+		space = isl_pw_qpolynomial_fold_get_domain_space(exec->pwf);
+	pnt = isl_point_zero(space);
+	if (!pnt)
+		return -1;
+	for (i = 0; i < exec->n_coord; ++i)
+		isl_int_set_si(pnt->vec->el[1 + i], point[i]);
+
+	if (exec->pwqp)
+		v = isl_pw_qpolynomial_eval(
+				isl_pw_qpolynomial_copy(exec->pwqp), pnt);
+	else
+		v = isl_pw_qpolynomial_fold_eval(
+			isl_pw_qpolynomial_fold_copy(exec->pwf), pnt);
+	if (!v)
+		return -1;
+	if (!isl_val_is_rat(v) || !int_fits(v->n) || !int_fits(v->d)) {
+		isl_val_free(v);
+		isl_die(exec->ctx, isl_error_unsupported,
+			"value does not fit in 64 bits", return -1);
+	}
+	*num = isl_int_get_si(v->n);
+	*den = isl_int_get_si(v->d);
+	isl_val_free(v);
+
+	return 0;
+}
+
+/* Evaluate "exec" at the "n" points stored consecutively in "point",
+ * each with as coordinates the values of the parameters followed by
+ * those of the set variables, and store the results as the reduced
+ * fractions "num[i]" / "den[i]".
+ *
+ * Each point is first evaluated in 64-bit arithmetic.
+ * If this fails, then it is evaluated exactly instead.
+ */
+int isl_pw_qpolynomial_exec_eval(__isl_keep isl_pw_qpolynomial_exec *exec,
+	int n, const int64_t *point, int64_t *num, int64_t *den)
+{
+	int i;
+
+	if (!exec)
+		return -1;
+
+	for (i = 0; i < n; ++i) {
+		const int64_t *p = point + i * exec->n_coord;
+
+		if (!eval_fast(exec, p, &num[i], &den[i]))
+			continue;
+		if (eval_exact(exec, p, &num[i], &den[i]) < 0)
+			return -1;
+	}
+
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include <isl_morph.h>
 #include <isl/polynomial.h>
 #include <isl_reordering.h>
+#include <isl_box_index.h>
 
 struct isl_upoly {
 	int ref;
@@ -60,6 +61,7 @@ struct isl_pw_qpolynomial {
 	isl_space *dim;
 
 	int n;
+	struct isl_box_index *index;
 
 	size_t size;
 	struct isl_pw_qpolynomial_piece p[1];
@@ -91,6 +93,7 @@ struct isl_pw_qpolynomial_fold {
 	isl_space *dim;
 
 	int n;
+	struct isl_box_index *index;
 
 	size_t size;
 	struct isl_pw_qpolynomial_fold_piece p[1];
@@ -99,12 +102,24 @@ struct isl_pw_qpolynomial_fold {
 void isl_term_get_num(__isl_keep isl_term *term, isl_int *n);
 
 __isl_give struct isl_upoly *isl_upoly_zero(struct isl_ctx *ctx);
+__isl_give struct isl_upoly *isl_upoly_rat_cst(struct isl_ctx *ctx,
+	isl_int n, isl_int d);
+__isl_give struct isl_upoly_rec *isl_upoly_alloc_rec(struct isl_ctx *ctx,
+	int var, int size);
 __isl_give struct isl_upoly *isl_upoly_copy(__isl_keep struct isl_upoly *up);
 __isl_give struct isl_upoly *isl_upoly_cow(__isl_take struct isl_upoly *up);
 __isl_give struct isl_upoly *isl_upoly_dup(__isl_keep struct isl_upoly *up);
 void isl_upoly_free(__isl_take struct isl_upoly *up);
 __isl_give struct isl_upoly *isl_upoly_mul(__isl_take struct isl_upoly *up1,
 	__isl_take struct isl_upoly *up2);
+__isl_give struct isl_upoly *isl_upoly_mul_sparse(
+	__isl_take struct isl_upoly *up1, __isl_take struct isl_upoly *up2,
+	__isl_give struct isl_upoly *(*mul)(__isl_take struct isl_upoly *up1,
+		__isl_take struct isl_upoly *up2));
+__isl_give struct isl_upoly *isl_upoly_pow_sparse(
+	__isl_take struct isl_upoly *up, unsigned power,
+	__isl_give struct isl_upoly *(*pow)(__isl_take struct isl_upoly *up,
+		unsigned power));
 
 int isl_upoly_is_cst(__isl_keep struct isl_upoly *up);
 int isl_upoly_is_zero(__isl_keep struct isl_upoly *up);
@@ -31,6 +31,7 @@ __isl_give PW *FN(PW,alloc_size)(__isl_take isl_space *dim, int n)
 #endif
 	pw->size = n;
 	pw->n = 0;
+	pw->index = NULL;
 	pw->dim = dim;
 	return pw;
 error:
@@ -137,13 +138,29 @@ __isl_give PW *FN(PW,dup)(__isl_keep PW *pw)
 	return dup;
 }
 
+/* Drop the piece index of "pw", if any.
+ * This needs to be called by any function that changes the pieces
+ * of "pw" in place.
+ */
+static void FN(PW,drop_index)(__isl_keep PW *pw)
+{
+	isl_box_index_free(pw->index);
+	pw->index = NULL;
+}
+
+/* Return a copy of "pw" that can be modified in place.
+ * If "pw" itself is returned, then its piece index is dropped
+ * since the caller is about to change the pieces.
+ */
 __isl_give PW *FN(PW,cow)(__isl_take PW *pw)
 {
 	if (!pw)
 		return NULL;
 
-	if (pw->ref == 1)
+	if (pw->ref == 1) {
+		FN(PW,drop_index)(pw);
 		return pw;
+	}
 	pw->ref--;
 	return FN(PW,dup)(pw);
 }
@@ -170,12 +187,49 @@ void *FN(PW,free)(__isl_take PW *pw)
 		isl_set_free(pw->p[i].set);
 		FN(EL,free)(pw->p[i].FIELD);
 	}
+	isl_box_index_free(pw->index);
 	isl_space_free(pw->dim);
 	free(pw);
 
 	return NULL;
 }
 
+static isl_set *FN(PW,get_piece_domain)(int i, void *user)
+{
+	PW *pw = user;
+
+	return pw->p[i].set;
+}
+
+/* Return an index over the bounding boxes of the domains of the pieces
+ * of "pw" that can be used to quickly skip pieces that are disjoint
+ * from some other set or that do not contain some point.
+ * The index is kept in "pw" for use by later operations and
+ * is only (re)constructed if "pw" does not have a valid index yet.
+ * An index is dropped when "pw" is modified in place, either
+ * through FN(PW,cow) or directly by functions such as FN(PW,coalesce)
+ * and FN(PW,normalize) that change the representation of shared objects.
+ * The index also keeps a reference to each of the domains
+ * it was constructed from and is reconstructed if any of them
+ * has been replaced.
+ */
+static struct isl_box_index *FN(PW,get_index)(__isl_keep PW *pw)
+{
+	isl_ctx *ctx;
+
+	if (!pw)
+		return NULL;
+	if (isl_box_index_is_valid(pw->index, pw->n,
+				    &FN(PW,get_piece_domain), pw))
+		return pw->index;
+
+	isl_box_index_free(pw->index);
+	ctx = isl_space_get_ctx(pw->dim);
+	pw->index = isl_box_index_alloc(ctx, pw->n,
+					&FN(PW,get_piece_domain), pw);
+	return pw->index;
+}
+
 const char *FN(PW,get_dim_name)(__isl_keep PW *pw, enum isl_dim_type type,
 	unsigned pos)
 {
@@ -338,13 +392,24 @@ error:
 }
 #endif
 
+/* Compute the sum of "pw1" and "pw2" on their shared domain,
+ * keeping the original values on the parts of the domains
+ * where only one of them is defined.
+ *
+ * The piece indices of "pw1" and "pw2" are used to only consider
+ * pairs of pieces with overlapping bounding boxes.  Other pairs
+ * of pieces have disjoint domains and therefore do not contribute
+ * to the result.
+ */
 static __isl_give PW *FN(PW,union_add_aligned)(__isl_take PW *pw1,
 	__isl_take PW *pw2)
 {
-	int i, j, n;
-	struct PW *res;
+	int i, j, k, n, n_cand;
+	struct PW *res = NULL;
 	isl_ctx *ctx;
 	isl_set *set;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pw1 || !pw2)
 		goto error;
@@ -367,6 +432,12 @@ static __isl_give PW *FN(PW,union_add_aligned)(__isl_take PW *pw1,
 		return pw1;
 	}
 
+	index1 = FN(PW,get_index)(pw1);
+	index2 = FN(PW,get_index)(pw2);
+	cand = isl_alloc_array(ctx, int, pw1->n > pw2->n ? pw1->n : pw2->n);
+	if (!index1 || !index2 || !cand)
+		goto error;
+
 	n = (pw1->n + 1) * (pw2->n + 1);
 #ifdef HAS_TYPE
 	res = FN(PW,alloc_size)(isl_space_copy(pw1->dim), pw1->type, n);
@@ -376,9 +447,13 @@ static __isl_give PW *FN(PW,union_add_aligned)(__isl_take PW *pw1,
 
 	for (i = 0; i < pw1->n; ++i) {
 		set = isl_set_copy(pw1->p[i].set);
-		for (j = 0; j < pw2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k) {
 			struct isl_set *common;
 			EL *sum;
+			j = cand[k];
 			common = isl_set_intersect(isl_set_copy(pw1->p[i].set),
 						isl_set_copy(pw2->p[j].set));
 			if (isl_set_plain_is_empty(common)) {
@@ -399,19 +474,25 @@ static __isl_give PW *FN(PW,union_add_aligned)(__isl_take PW *pw1,
 
 	for (j = 0; j < pw2->n; ++j) {
 		set = isl_set_copy(pw2->p[j].set);
-		for (i = 0; i < pw1->n; ++i)
+		n_cand = isl_box_index_find_overlap(index1, index2, j, cand);
+		if (n_cand < 0)
+			set = isl_set_free(set);
+		for (k = 0; k < n_cand; ++k)
 			set = isl_set_subtract(set,
-					isl_set_copy(pw1->p[i].set));
+					isl_set_copy(pw1->p[cand[k]].set));
 		res = FN(PW,add_piece)(res, set, FN(EL,copy)(pw2->p[j].FIELD));
 	}
 
+	free(cand);
 	FN(PW,free)(pw1);
 	FN(PW,free)(pw2);
 
 	return res;
 error:
+	free(cand);
 	FN(PW,free)(pw1);
 	FN(PW,free)(pw2);
+	FN(PW,free)(res);
 	return NULL;
 }
 
@@ -526,17 +607,30 @@ static __isl_give PW *FN(PW,on_shared_domain_in)(__isl_take PW *pw1,
 
 /* Apply "fn" to pairs of elements from pw1 and pw2 on shared domains.
  * The result of "fn" (and therefore also of this function) lives in "space".
+ * Only pairs of pieces with overlapping bounding boxes are considered.
  */
 static __isl_give PW *FN(PW,on_shared_domain_in)(__isl_take PW *pw1,
 	__isl_take PW *pw2, __isl_take isl_space *space,
 	__isl_give EL *(*fn)(__isl_take EL *el1, __isl_take EL *el2))
 {
-	int i, j, n;
+	int i, j, k, n, n_cand;
 	PW *res = NULL;
+	struct isl_box_index *index1, *index2;
+	int *cand = NULL;
 
 	if (!pw1 || !pw2)
 		goto error;
 
+	index1 = FN(PW,get_index)(pw1);
+	index2 = FN(PW,get_index)(pw2);
+	if (!index1 || !index2)
+		goto error;
+	if (pw2->n > 0) {
+		cand = isl_alloc_array(FN(PW,get_ctx)(pw1), int, pw2->n);
+		if (!cand)
+			goto error;
+	}
+
 	n = pw1->n * pw2->n;
 #ifdef HAS_TYPE
 	res = FN(PW,alloc_size)(isl_space_copy(space), pw1->type, n);
@@ -545,11 +639,16 @@ static __isl_give PW *FN(PW,on_shared_domain_in)(__isl_take PW *pw1,
 #endif
 
 	for (i = 0; i < pw1->n; ++i) {
-		for (j = 0; j < pw2->n; ++j) {
+		n_cand = isl_box_index_find_overlap(index2, index1, i, cand);
+		if (n_cand < 0)
+			goto error;
+		for (k = 0; k < n_cand; ++k) {
 			isl_set *common;
 			EL *res_ij;
 			int empty;
 
+			j = cand[k];
+
 			common = isl_set_intersect(
 					isl_set_copy(pw1->p[i].set),
 					isl_set_copy(pw2->p[j].set));
@@ -569,11 +668,13 @@ static __isl_give PW *FN(PW,on_shared_domain_in)(__isl_take PW *pw1,
 		}
 	}
 
+	free(cand);
 	isl_space_free(space);
 	FN(PW,free)(pw1);
 	FN(PW,free)(pw2);
 	return res;
 error:
+	free(cand);
 	isl_space_free(space);
 	FN(PW,free)(pw1);
 	FN(PW,free)(pw2);
@@ -639,6 +740,53 @@ __isl_give PW *FN(PW,sub)(__isl_take PW *pw1, __isl_take PW *pw2)
 #endif
 
 #ifndef NO_EVAL
+/* Find the first piece of "pw" that contains "pnt".
+ * Return the position of this piece, pw->n if there is no such piece or
+ * -1 on error.
+ *
+ * If "pw" has many pieces, then its piece index is used to only
+ * consider the pieces with a bounding box that contains "pnt".
+ * Since the index is kept in "pw", later evaluations of the same
+ * object only need to traverse the index.
+ */
+static int FN(PW,find_piece)(__isl_keep PW *pw, __isl_keep isl_point *pnt)
+{
+	int i, k, n_cand;
+	int found = 0;
+	struct isl_box_index *index;
+	int *cand;
+
+	if (pw->n < ISL_BOX_INDEX_MIN_POINT_SETS) {
+		for (i = 0; i < pw->n; ++i) {
+			found = isl_set_contains_point(pw->p[i].set, pnt);
+			if (found < 0 || found)
+				return found < 0 ? -1 : i;
+		}
+		return pw->n;
+	}
+
+	index = FN(PW,get_index)(pw);
+	cand = isl_alloc_array(FN(PW,get_ctx)(pw), int, pw->n);
+	if (!index || !cand)
+		goto error;
+	n_cand = isl_box_index_find_point(index, pnt, cand);
+	if (n_cand < 0)
+		goto error;
+	for (k = 0; k < n_cand; ++k) {
+		i = cand[k];
+		found = isl_set_contains_point(pw->p[i].set, pnt);
+		if (found < 0)
+			goto error;
+		if (found)
+			break;
+	}
+	free(cand);
+	return found ? i : pw->n;
+error:
+	free(cand);
+	return -1;
+}
+
 __isl_give isl_val *FN(PW,eval)(__isl_take PW *pw, __isl_take isl_point *pnt)
 {
 	int i;
@@ -654,13 +802,10 @@ __isl_give isl_val *FN(PW,eval)(__isl_take PW *pw, __isl_take isl_point *pnt)
 	isl_assert(ctx, isl_space_is_domain_internal(pnt_dim, pw->dim),
 		    goto error);
 
-	for (i = 0; i < pw->n; ++i) {
-		found = isl_set_contains_point(pw->p[i].set, pnt);
-		if (found < 0)
-			goto error;
-		if (found)
-			break;
-	}
+	i = FN(PW,find_piece)(pw, pnt);
+	if (i < 0)
+		goto error;
+	found = i < pw->n;
 	if (found)
 		v = FN(EL,eval)(FN(EL,copy)(pw->p[i].FIELD),
 					    isl_point_copy(pnt));
@@ -695,6 +840,17 @@ __isl_give isl_set *FN(PW,domain)(__isl_take PW *pw)
 	return dom;
 }
 
+/* Remove piece "i" from "pw", replacing it with the final piece.
+ */
+static void FN(PW,remove_piece)(__isl_keep PW *pw, int i)
+{
+	isl_set_free(pw->p[i].set);
+	FN(EL,free)(pw->p[i].FIELD);
+	if (i != pw->n - 1)
+		pw->p[i] = pw->p[pw->n - 1];
+	pw->n--;
+}
+
 /* Exploit the equalities in the domain of piece "i" of "pw"
  * to simplify the associated function.
  * If the domain of piece "i" is empty, then remove it entirely,
@@ -709,12 +865,7 @@ static int FN(PW,exploit_equalities_and_remove_if_empty)(__isl_keep PW *pw,
 	if (empty < 0)
 		return -1;
 	if (empty) {
-		isl_set_free(pw->p[i].set);
-		FN(EL,free)(pw->p[i].FIELD);
-		if (i != pw->n - 1)
-			pw->p[i] = pw->p[pw->n - 1];
-		pw->n--;
-
+		FN(PW,remove_piece)(pw, i);
 		return 0;
 	}
 
@@ -726,16 +877,64 @@ static int FN(PW,exploit_equalities_and_remove_if_empty)(__isl_keep PW *pw,
 	return 0;
 }
 
+static isl_set *FN(PW,get_single_set)(int i, void *user)
+{
+	return user;
+}
+
+/* Return an array that marks the pieces of "pw" with a bounding box
+ * that overlaps with the bounding box of "set".
+ * The domains of the other pieces are disjoint from "set".
+ */
+static char *FN(PW,mark_overlap)(__isl_keep PW *pw, __isl_keep isl_set *set)
+{
+	int k, n_cand;
+	isl_ctx *ctx;
+	struct isl_box_index *index, *set_index;
+	int *cand;
+	char *overlap;
+
+	ctx = isl_set_get_ctx(set);
+	index = FN(PW,get_index)(pw);
+	set_index = isl_box_index_alloc(ctx, 1, &FN(PW,get_single_set), set);
+	cand = isl_alloc_array(ctx, int, pw->n);
+	overlap = isl_calloc_array(ctx, char, pw->n);
+	if (!index || !set_index || !cand || !overlap)
+		goto error;
+	n_cand = isl_box_index_find_overlap(index, set_index, 0, cand);
+	if (n_cand < 0)
+		goto error;
+	for (k = 0; k < n_cand; ++k)
+		overlap[cand[k]] = 1;
+
+	free(cand);
+	isl_box_index_free(set_index);
+	return overlap;
+error:
+	free(overlap);
+	free(cand);
+	isl_box_index_free(set_index);
+	return NULL;
+}
+
 /* Restrict the domain of "pw" by combining each cell
  * with "set" through a call to "fn", where "fn" may be
  * isl_set_intersect or isl_set_intersect_params.
+ *
+ * If "prune" is set, then "fn" is isl_set_intersect and
+ * the piece index of "pw" is used to remove the pieces with
+ * a domain that is disjoint from "set" without computing
+ * the (empty) intersection.  The pieces are removed in the same way
+ * as empty intersections, such that the order of the remaining pieces
+ * is the same as without pruning.
  */
 static __isl_give PW *FN(PW,intersect_aligned)(__isl_take PW *pw,
 	__isl_take isl_set *set,
 	__isl_give isl_set *(*fn)(__isl_take isl_set *set1,
-				    __isl_take isl_set *set2))
+				    __isl_take isl_set *set2), int prune)
 {
 	int i;
+	char *overlap = NULL;
 
 	if (!pw || !set)
 		goto error;
@@ -745,19 +944,31 @@ static __isl_give PW *FN(PW,intersect_aligned)(__isl_take PW *pw,
 		return pw;
 	}
 
+	if (prune && pw->n > 1) {
+		overlap = FN(PW,mark_overlap)(pw, set);
+		if (!overlap)
+			goto error;
+	}
+
 	pw = FN(PW,cow)(pw);
 	if (!pw)
 		goto error;
 
 	for (i = pw->n - 1; i >= 0; --i) {
+		if (overlap && !overlap[i]) {
+			FN(PW,remove_piece)(pw, i);
+			continue;
+		}
 		pw->p[i].set = fn(pw->p[i].set, isl_set_copy(set));
 		if (FN(PW,exploit_equalities_and_remove_if_empty)(pw, i) < 0)
 			goto error;
 	}
 	
+	free(overlap);
 	isl_set_free(set);
 	return pw;
 error:
+	free(overlap);
 	isl_set_free(set);
 	FN(PW,free)(pw);
 	return NULL;
@@ -766,7 +977,7 @@ error:
 static __isl_give PW *FN(PW,intersect_domain_aligned)(__isl_take PW *pw,
 	__isl_take isl_set *set)
 {
-	return FN(PW,intersect_aligned)(pw, set, &isl_set_intersect);
+	return FN(PW,intersect_aligned)(pw, set, &isl_set_intersect, 1);
 }
 
 __isl_give PW *FN(PW,intersect_domain)(__isl_take PW *pw,
@@ -779,7 +990,7 @@ __isl_give PW *FN(PW,intersect_domain)(__isl_take PW *pw,
 static __isl_give PW *FN(PW,intersect_params_aligned)(__isl_take PW *pw,
 	__isl_take isl_set *set)
 {
-	return FN(PW,intersect_aligned)(pw, set, &isl_set_intersect_params);
+	return FN(PW,intersect_aligned)(pw, set, &isl_set_intersect_params, 0);
 }
 
 /* Intersect the domain of "pw" with the parameter domain "context".
@@ -889,6 +1100,7 @@ __isl_give PW *FN(PW,coalesce)(__isl_take PW *pw)
 	if (pw->n == 0)
 		return pw;
 
+	FN(PW,drop_index)(pw);
 	for (i = pw->n - 1; i >= 0; --i) {
 		for (j = i - 1; j >= 0; --j) {
 			if (!FN(EL,plain_is_equal)(pw->p[i].FIELD,
@@ -1636,6 +1848,7 @@ __isl_give PW *FN(PW,normalize)(__isl_take PW *pw)
 
 	if (!pw)
 		return NULL;
+	FN(PW,drop_index)(pw);
 	for (i = 0; i < pw->n; ++i) {
 		set = isl_set_normalize(isl_set_copy(pw->p[i].set));
 		if (!set)
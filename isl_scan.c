@@ -7,12 +7,17 @@
  * Computerwetenschappen, Celestijnenlaan 200A, B-3001 Leuven, Belgium
  */
 
+#include <isl_config.h>
 #include <isl_ctx_private.h>
 #include <isl_map_private.h>
+#include <isl_options_private.h>
 #include "isl_basis_reduction.h"
+#include <isl_factorization.h>
+#include <isl_morph.h>
 #include "isl_scan.h"
 #include <isl_seq.h>
 #include "isl_tab.h"
+#include <isl_thread.h>
 #include <isl_val_private.h>
 #include <isl_vec_private.h>
 
@@ -65,6 +70,60 @@ static int add_solution(struct isl_tab *tab, struct isl_scan_callback *callback)
 	return callback->add(callback, sample);
 }
 
+/* Return the difference between two consecutive integer points
+ * in the direction of the final row of the basis "B".
+ * Since the points are scanned in the coordinate system defined by "B",
+ * this difference is the final column of the inverse of "B".
+ */
+static __isl_give isl_vec *scan_step(__isl_keep isl_mat *B)
+{
+	int i;
+	isl_mat *inv;
+	isl_vec *step;
+
+	inv = isl_mat_right_inverse(isl_mat_copy(B));
+	if (!inv)
+		return NULL;
+	step = isl_vec_alloc(isl_mat_get_ctx(B), inv->n_row);
+	if (step)
+		for (i = 0; i < inv->n_row; ++i)
+			isl_int_set(step->el[i], inv->row[i][inv->n_col - 1]);
+	isl_mat_free(inv);
+
+	return step;
+}
+
+/* Add an equality to "tab" fixing the value in the direction
+ * of the basis vector at "level" in "B" to "val" and call callback->add_line
+ * with the resulting sample value of "tab", "step" and the number
+ * of points from "val" to "max".
+ */
+static int add_line(struct isl_tab *tab, __isl_keep isl_mat *B, int level,
+	isl_int val, isl_int max, __isl_keep isl_vec *step,
+	struct isl_scan_callback *callback)
+{
+	isl_vec *sample;
+	isl_int n;
+	int r;
+
+	isl_int_neg(B->row[1 + level][0], val);
+	if (isl_tab_add_valid_eq(tab, B->row[1 + level]) < 0)
+		return -1;
+	isl_int_set_si(B->row[1 + level][0], 0);
+
+	sample = isl_tab_get_sample_value(tab);
+	if (!sample)
+		return -1;
+
+	isl_int_init(n);
+	isl_int_sub(n, max, val);
+	isl_int_add_ui(n, n, 1);
+	r = callback->add_line(callback, sample, step, n);
+	isl_int_clear(n);
+
+	return r;
+}
+
 static int scan_0D(struct isl_basic_set *bset,
 	struct isl_scan_callback *callback)
 {
@@ -98,6 +157,10 @@ static int scan_0D(struct isl_basic_set *bset,
  * level and false if we want the next value.
  * Solutions are added in the leaves of the search tree, i.e., after
  * we have fixed a value in each direction of the basis.
+ * If callback->add_line is set, then the values in the final direction
+ * are not fixed one by one.  Instead, the first solution is computed
+ * and the others are obtained by repeatedly adding the difference
+ * between consecutive solutions, which only depends on the basis.
  */
 int isl_basic_set_scan(struct isl_basic_set *bset,
 	struct isl_scan_callback *callback)
@@ -107,6 +170,7 @@ int isl_basic_set_scan(struct isl_basic_set *bset,
 	struct isl_tab *tab = NULL;
 	struct isl_vec *min;
 	struct isl_vec *max;
+	isl_vec *step = NULL;
 	struct isl_tab_undo **snap;
 	int level;
 	int init;
@@ -140,6 +204,11 @@ int isl_basic_set_scan(struct isl_basic_set *bset,
 	B = isl_mat_copy(tab->basis);
 	if (!B)
 		goto error;
+	if (callback->add_line) {
+		step = scan_step(B);
+		if (!step)
+			goto error;
+	}
 
 	level = 0;
 	init = 1;
@@ -176,8 +245,13 @@ int isl_basic_set_scan(struct isl_basic_set *bset,
 					goto error;
 			continue;
 		}
-		if (level == dim - 1 && callback->add == increment_counter) {
-			if (increment_range(callback,
+		if (level == dim - 1 && (callback->add == increment_counter ||
+					 callback->add_line)) {
+			if (callback->add_line) {
+				if (add_line(tab, B, level, min->el[level],
+					    max->el[level], step, callback) < 0)
+					goto error;
+			} else if (increment_range(callback,
 					    min->el[level], max->el[level]))
 				goto error;
 			level--;
@@ -207,6 +281,7 @@ int isl_basic_set_scan(struct isl_basic_set *bset,
 	free(snap);
 	isl_vec_free(min);
 	isl_vec_free(max);
+	isl_vec_free(step);
 	isl_basic_set_free(bset);
 	isl_mat_free(B);
 	return 0;
@@ -215,6 +290,7 @@ error:
 	free(snap);
 	isl_vec_free(min);
 	isl_vec_free(max);
+	isl_vec_free(step);
 	isl_basic_set_free(bset);
 	isl_mat_free(B);
 	return -1;
@@ -245,46 +321,569 @@ error:
 	return -1;
 }
 
-int isl_basic_set_count_upto(__isl_keep isl_basic_set *bset,
-	isl_int max, isl_int *count)
+/* A part of a set that is scanned by a single worker in
+ * isl_set_scan_parallel.
+ * If "dir" is not NULL, then the part consists of the elements x
+ * of "bset" with lo <= dir x <= hi.  Otherwise, it is all of "bset".
+ * "bset" and "dir" are owned by the isl_scan_parallel_data
+ * that contains the task.
+ */
+struct isl_scan_task {
+	isl_basic_set *bset;
+	isl_vec *dir;
+	isl_int lo;
+	isl_int hi;
+};
+
+/* Internal data structure for isl_set_scan_parallel.
+ *
+ * "task" is the list of "n_task" parts of the set.
+ * "next" is the index of the next task that has not been taken
+ * by any worker yet.
+ * "stop" is set as soon as any worker failed to scan a part.
+ * "lock" protects "next", "stop" and the calls to par->free.
+ */
+struct isl_scan_parallel_data {
+	struct isl_scan_parallel *par;
+
+	int n_task;
+	int size;
+	struct isl_scan_task *task;
+
+	int next;
+	int stop;
+	struct isl_mutex lock;
+};
+
+static void scan_lock(struct isl_scan_parallel_data *data)
 {
-	struct isl_counter cnt = { { &increment_counter } };
+	isl_mutex_lock(&data->lock);
+}
+
+static void scan_unlock(struct isl_scan_parallel_data *data)
+{
+	isl_mutex_unlock(&data->lock);
+}
+
+/* Append a task to "data" for scanning the elements x of "bset"
+ * with lo <= dir x <= hi, or all elements of "bset" if "dir" is NULL.
+ */
+static int add_task(struct isl_scan_parallel_data *data, isl_ctx *ctx,
+	__isl_keep isl_basic_set *bset, __isl_keep isl_vec *dir,
+	isl_int lo, isl_int hi)
+{
+	struct isl_scan_task *task;
+
+	if (data->n_task >= data->size) {
+		int size = 3 * (data->size + 4) / 2;
+		task = isl_realloc_array(ctx, data->task,
+					struct isl_scan_task, size);
+		if (!task)
+			return -1;
+		data->task = task;
+		data->size = size;
+	}
+
+	task = &data->task[data->n_task++];
+	task->bset = isl_basic_set_copy(bset);
+	task->dir = isl_vec_copy(dir);
+	isl_int_init(task->lo);
+	isl_int_init(task->hi);
+	if (dir) {
+		isl_int_set(task->lo, lo);
+		isl_int_set(task->hi, hi);
+	}
+
+	return 0;
+}
+
+/* Is "bset" bounded, treating the parameters and the existentially
+ * quantified variables as set variables, as in isl_basic_set_scan?
+ *
+ * "bset" is bounded if its recession cone is trivial, or if it is empty.
+ */
+static int is_flat_bounded(__isl_keep isl_basic_set *bset)
+{
+	struct isl_tab *tab;
+	int bounded;
+
+	if (isl_basic_set_plain_is_empty(bset))
+		return 1;
+
+	tab = isl_tab_from_recession_cone(bset, 0);
+	bounded = isl_tab_cone_is_bounded(tab);
+	isl_tab_free(tab);
+	if (bounded != 0)
+		return bounded;
+
+	return isl_basic_set_is_empty(bset);
+}
+
+/* Split "bset" into (at most) "n_chunk" parts and add a task
+ * for each of them to "data".
+ *
+ * We compute a reduced basis of "bset", as in isl_basic_set_scan,
+ * and split the range of "bset" in the direction of the first
+ * basis vector into intervals of roughly equal size.
+ * This requires "bset" to be bounded, so we check this first.
+ * If "bset" is empty, then no tasks are added.
+ */
+static int add_tasks(struct isl_scan_parallel_data *data,
+	__isl_keep isl_basic_set *bset, int n_chunk)
+{
+	int i, bounded;
+	unsigned dim;
+	isl_ctx *ctx;
+	struct isl_tab *tab = NULL;
+	isl_vec *dir = NULL;
+	enum isl_lp_result res;
+	isl_int min, max, range, lo, hi;
 
 	if (!bset)
 		return -1;
+	ctx = isl_basic_set_get_ctx(bset);
+	dim = isl_basic_set_total_dim(bset);
+	if (dim == 0)
+		return add_task(data, ctx, bset, NULL, ctx->zero, ctx->zero);
 
-	isl_int_init(cnt.count);
-	isl_int_init(cnt.max);
+	bounded = is_flat_bounded(bset);
+	if (bounded < 0)
+		return -1;
+	if (!bounded)
+		isl_die(ctx, isl_error_invalid, "unbounded set", return -1);
 
-	isl_int_set_si(cnt.count, 0);
-	isl_int_set(cnt.max, max);
-	if (isl_basic_set_scan(isl_basic_set_copy(bset), &cnt.callback) < 0 &&
-	    isl_int_lt(cnt.count, cnt.max))
+	isl_int_init(min);
+	isl_int_init(max);
+	isl_int_init(range);
+	isl_int_init(lo);
+	isl_int_init(hi);
+
+	tab = isl_tab_from_basic_set(bset, 0);
+	if (!tab)
 		goto error;
+	tab->basis = isl_mat_identity(ctx, 1 + dim);
+	tab = isl_tab_compute_reduced_basis(tab);
+	if (!tab)
+		goto error;
+	dir = isl_vec_alloc(ctx, 1 + dim);
+	if (!dir)
+		goto error;
+	isl_seq_cpy(dir->el, tab->basis->row[1], 1 + dim);
 
-	isl_int_set(*count, cnt.count);
-	isl_int_clear(cnt.max);
-	isl_int_clear(cnt.count);
+	res = isl_tab_min(tab, dir->el, ctx->one, &min, NULL, 0);
+	if (res == isl_lp_ok) {
+		isl_seq_neg(dir->el + 1, dir->el + 1, dim);
+		res = isl_tab_min(tab, dir->el, ctx->one, &max, NULL, 0);
+		isl_seq_neg(dir->el + 1, dir->el + 1, dim);
+		isl_int_neg(max, max);
+	}
+	if (res == isl_lp_error || res == isl_lp_unbounded)
+		goto error;
 
+	if (res == isl_lp_ok && isl_int_le(min, max)) {
+		isl_int_sub(range, max, min);
+		isl_int_add_ui(range, range, 1);
+		if (isl_int_cmp_si(range, n_chunk) < 0)
+			n_chunk = isl_int_get_si(range);
+		isl_int_set(lo, min);
+		for (i = 1; i <= n_chunk; ++i) {
+			isl_int_mul_ui(hi, range, i);
+			isl_int_fdiv_q_ui(hi, hi, n_chunk);
+			isl_int_add(hi, hi, min);
+			isl_int_sub_ui(hi, hi, 1);
+			if (add_task(data, ctx, bset, dir, lo, hi) < 0)
+				goto error;
+			isl_int_add_ui(lo, hi, 1);
+		}
+	}
+
+	isl_vec_free(dir);
+	isl_tab_free(tab);
+	isl_int_clear(min);
+	isl_int_clear(max);
+	isl_int_clear(range);
+	isl_int_clear(lo);
+	isl_int_clear(hi);
 	return 0;
 error:
-	isl_int_clear(cnt.count);
+	isl_vec_free(dir);
+	isl_tab_free(tab);
+	isl_int_clear(min);
+	isl_int_clear(max);
+	isl_int_clear(range);
+	isl_int_clear(lo);
+	isl_int_clear(hi);
 	return -1;
 }
 
-int isl_set_count_upto(__isl_keep isl_set *set, isl_int max, isl_int *count)
+/* Construct a basic set in "ctx" with the same constraints as "src",
+ * treating the parameters and the existentially quantified variables
+ * of "src" as set variables, and with room for "extra" more inequalities.
+ * The coordinates of the integer points of the result are therefore
+ * the same as those of the corresponding integer points of "src"
+ * in isl_basic_set_scan.
+ *
+ * "ctx" may be different from the context of "src",
+ * but this function only reads the constraints of "src".
+ */
+static __isl_give isl_basic_set *flat_copy(isl_ctx *ctx,
+	__isl_keep isl_basic_set *src, int extra)
 {
-	struct isl_counter cnt = { { &increment_counter } };
+	int i, k;
+	unsigned total;
+	isl_space *space;
+	isl_basic_set *bset;
+
+	if (!src)
+		return NULL;
+
+	total = isl_basic_set_total_dim(src);
+	space = isl_space_set_alloc(ctx, 0, total);
+	bset = isl_basic_set_alloc_space(space, 0, src->n_eq,
+					src->n_ineq + extra);
+	if (!bset)
+		return NULL;
+
+	for (i = 0; i < src->n_eq; ++i) {
+		k = isl_basic_set_alloc_equality(bset);
+		if (k < 0)
+			goto error;
+		isl_seq_cpy(bset->eq[k], src->eq[i], 1 + total);
+	}
+	for (i = 0; i < src->n_ineq; ++i) {
+		k = isl_basic_set_alloc_inequality(bset);
+		if (k < 0)
+			goto error;
+		isl_seq_cpy(bset->ineq[k], src->ineq[i], 1 + total);
+	}
+
+	return bset;
+error:
+	isl_basic_set_free(bset);
+	return NULL;
+}
+
+/* Construct a basic set in "ctx" that contains the part
+ * of the set described by "task".
+ *
+ * Since the tasks live in a different context,
+ * we cannot simply copy task->bset.  Instead, we construct
+ * a set with the same constraints using flat_copy.
+ *
+ * This function is called from a worker thread,
+ * but it only reads task->bset and task->dir.
+ */
+static __isl_give isl_basic_set *task_basic_set(isl_ctx *ctx,
+	struct isl_scan_task *task)
+{
+	int k;
+	unsigned total;
+	isl_basic_set *bset;
+
+	total = isl_basic_set_total_dim(task->bset);
+	bset = flat_copy(ctx, task->bset, 2);
+	if (!bset)
+		return NULL;
+
+	if (task->dir) {
+		k = isl_basic_set_alloc_inequality(bset);
+		if (k < 0)
+			goto error;
+		isl_seq_cpy(bset->ineq[k] + 1, task->dir->el + 1, total);
+		isl_int_neg(bset->ineq[k][0], task->lo);
+		k = isl_basic_set_alloc_inequality(bset);
+		if (k < 0)
+			goto error;
+		isl_seq_neg(bset->ineq[k] + 1, task->dir->el + 1, total);
+		isl_int_set(bset->ineq[k][0], task->hi);
+	}
+
+	return bset;
+error:
+	isl_basic_set_free(bset);
+	return NULL;
+}
+
+/* A worker of isl_set_scan_parallel.
+ * "ctx" is the context in which the worker operates and
+ * "r" is the result of par->free.
+ */
+struct isl_scan_worker {
+	struct isl_scan_parallel_data *data;
+	isl_ctx *ctx;
+	int r;
+};
+
+/* Repeatedly take the next task from the shared list and scan
+ * the corresponding part of the set using a callback created
+ * by par->alloc in the context of the worker.
+ * If any of the scans fail, then the other workers are told
+ * to stop taking new tasks.
+ */
+static void *scan_worker(void *user)
+{
+	struct isl_scan_worker *worker = user;
+	struct isl_scan_parallel_data *data = worker->data;
+	struct isl_scan_parallel *par = data->par;
+	struct isl_scan_callback *cb;
+	isl_basic_set *bset;
+	int r, t;
+
+	cb = par->alloc(worker->ctx, par->user);
+	if (!cb) {
+		worker->r = -1;
+		scan_lock(data);
+		data->stop = 1;
+		scan_unlock(data);
+		return NULL;
+	}
+
+	r = 0;
+	while (r >= 0) {
+		scan_lock(data);
+		t = data->stop || data->next >= data->n_task ?
+			-1 : data->next++;
+		scan_unlock(data);
+		if (t < 0)
+			break;
+		bset = task_basic_set(worker->ctx, &data->task[t]);
+		r = isl_basic_set_scan(bset, cb);
+	}
+
+	scan_lock(data);
+	if (r < 0)
+		data->stop = 1;
+	worker->r = par->free(cb, r, par->user);
+	scan_unlock(data);
+
+	return NULL;
+}
+
+/* Free all tasks in "data".
+ */
+static void free_tasks(struct isl_scan_parallel_data *data)
+{
+	int i;
 
+	for (i = 0; i < data->n_task; ++i) {
+		isl_basic_set_free(data->task[i].bset);
+		isl_vec_free(data->task[i].dir);
+		isl_int_clear(data->task[i].lo);
+		isl_int_clear(data->task[i].hi);
+	}
+	free(data->task);
+}
+
+/* Look for all integer points in "set", which is assumed to be bounded,
+ * using (at most) "n_thread" threads.
+ *
+ * Each basic set in a disjoint decomposition of "set" is split into
+ * parts by add_tasks and each of these parts is scanned by one
+ * of the workers.  Each worker operates in its own isl_ctx,
+ * which is allocated and freed here, and scans its parts using
+ * a callback obtained from par->alloc.  This callback is passed
+ * to par->free, along with the result of the final scan,
+ * when the worker has finished.  The calls to par->free are serialized.
+ * The return value of par->free determines whether the worker
+ * was successful.
+ * Since the worker contexts do not know about the parameters
+ * and existentially quantified variables of "set",
+ * the samples passed to the callbacks have the parameters
+ * and set variables (and the existentially quantified variables)
+ * of "set" as coordinates.
+ * The parts are scanned in no particular order.
+ *
+ * If threads are not available, then the parts are scanned
+ * one after the other by a single worker.
+ */
+int isl_set_scan_parallel(__isl_take isl_set *set, int n_thread,
+	struct isl_scan_parallel *par)
+{
+	int i, n_chunk, r;
+	isl_ctx *ctx;
+	struct isl_scan_parallel_data data = { par };
+	struct isl_scan_worker *worker = NULL;
+
+	if (!set || !par)
+		goto error;
+
+	ctx = isl_set_get_ctx(set);
+#ifndef ISL_USE_PTHREADS
+	n_thread = 1;
+#endif
+	if (n_thread < 1)
+		n_thread = 1;
+
+	set = isl_set_cow(set);
+	set = isl_set_make_disjoint(set);
+	set = isl_set_compute_divs(set);
 	if (!set)
+		goto error;
+
+	n_chunk = n_thread == 1 ? 1 : 4 * n_thread;
+	for (i = 0; i < set->n; ++i)
+		if (add_tasks(&data, set->p[i], n_chunk) < 0)
+			goto error;
+	if (data.n_task <= 0) {
+		free_tasks(&data);
+		isl_set_free(set);
+		return 0;
+	}
+	if (n_thread > data.n_task)
+		n_thread = data.n_task;
+
+	worker = isl_calloc_array(ctx, struct isl_scan_worker, n_thread);
+	if (!worker)
+		goto error;
+	for (i = 0; i < n_thread; ++i) {
+		worker[i].data = &data;
+		worker[i].ctx = isl_thread_ctx_alloc(ctx);
+		if (!worker[i].ctx)
+			goto error;
+	}
+
+	if (isl_mutex_init(ctx, &data.lock) < 0)
+		goto error;
+	r = isl_thread_run(ctx, n_thread, &scan_worker, worker,
+			    sizeof(*worker));
+	isl_mutex_destroy(&data.lock);
+	if (r < 0)
+		goto error;
+
+	r = 0;
+	for (i = 0; i < n_thread; ++i) {
+		if (worker[i].r < 0 && r == 0) {
+			isl_thread_report_error(ctx, worker[i].ctx,
+						"scan failed in worker");
+			r = -1;
+		}
+		isl_ctx_free(worker[i].ctx);
+	}
+	free(worker);
+	free_tasks(&data);
+	isl_set_free(set);
+	return r;
+error:
+	if (worker)
+		for (i = 0; i < n_thread; ++i)
+			isl_ctx_free(worker[i].ctx);
+	free(worker);
+	free_tasks(&data);
+	isl_set_free(set);
+	return -1;
+}
+
+/* Internal data structure for count_upto_parallel.
+ * "count" is the total number of points found by the workers
+ * that have finished.
+ */
+struct isl_count_parallel_data {
+	isl_int count;
+	isl_int max;
+};
+
+/* Create a counter that counts up to data->max for a worker.
+ */
+static struct isl_scan_callback *count_alloc(isl_ctx *ctx, void *user)
+{
+	struct isl_count_parallel_data *data = user;
+	struct isl_counter *cnt;
+
+	cnt = isl_alloc_type(ctx, struct isl_counter);
+	if (!cnt)
+		return NULL;
+	cnt->callback.add = &increment_counter;
+	cnt->callback.add_line = NULL;
+	isl_int_init(cnt->count);
+	isl_int_init(cnt->max);
+	isl_int_set_si(cnt->count, 0);
+	isl_int_set(cnt->max, data->max);
+
+	return &cnt->callback;
+}
+
+/* Add the number of points found by a worker to data->count
+ * and free the counter.
+ * The scan of a worker is aborted when its counter
+ * reaches data->max, so a failure of the scan is only an error
+ * if this maximum has not been reached.
+ */
+static int count_free(struct isl_scan_callback *cb, int r, void *user)
+{
+	struct isl_count_parallel_data *data = user;
+	struct isl_counter *cnt = (struct isl_counter *) cb;
+
+	if (r < 0 && !isl_int_is_zero(cnt->max) &&
+	    isl_int_ge(cnt->count, cnt->max))
+		r = 0;
+	isl_int_add(data->count, data->count, cnt->count);
+	isl_int_clear(cnt->count);
+	isl_int_clear(cnt->max);
+	free(cnt);
+
+	return r;
+}
+
+/* Count the number of points in "set", up to "max" (if it is non-zero),
+ * using "n_thread" threads.
+ * Since each worker only counts up to "max", the total may exceed "max"
+ * and then needs to be truncated.
+ */
+static int count_upto_parallel(__isl_keep isl_set *set, int n_thread,
+	isl_int max, isl_int *count)
+{
+	struct isl_count_parallel_data data;
+	struct isl_scan_parallel par = { &count_alloc, &count_free, &data };
+	int r;
+
+	isl_int_init(data.count);
+	isl_int_init(data.max);
+	isl_int_set_si(data.count, 0);
+	isl_int_set(data.max, max);
+
+	r = isl_set_scan_parallel(isl_set_copy(set), n_thread, &par);
+	if (r >= 0) {
+		if (!isl_int_is_zero(max) && isl_int_gt(data.count, max))
+			isl_int_set(data.count, max);
+		isl_int_set(*count, data.count);
+	}
+
+	isl_int_clear(data.count);
+	isl_int_clear(data.max);
+
+	return r;
+}
+
+/* Count the number of points in "bset", up to "max" (if it is non-zero),
+ * by enumerating them.
+ * If the user has asked for more than one thread, then we count
+ * in parallel.
+ */
+static int scan_count_upto(__isl_take isl_basic_set *bset, isl_int max,
+	isl_int *count)
+{
+	struct isl_counter cnt = { { &increment_counter } };
+	int n_thread;
+	isl_set *set;
+	int r;
+
+	if (!bset)
 		return -1;
 
+	n_thread = isl_thread_n_thread(bset->ctx);
+	if (n_thread > 1) {
+		set = isl_set_from_basic_set(bset);
+		r = count_upto_parallel(set, n_thread, max, count);
+		isl_set_free(set);
+		return r;
+	}
+
 	isl_int_init(cnt.count);
 	isl_int_init(cnt.max);
 
 	isl_int_set_si(cnt.count, 0);
 	isl_int_set(cnt.max, max);
-	if (isl_set_scan(isl_set_copy(set), &cnt.callback) < 0 &&
+	if (isl_basic_set_scan(bset, &cnt.callback) < 0 &&
 	    isl_int_lt(cnt.count, cnt.max))
 		goto error;
 
@@ -294,10 +893,337 @@ int isl_set_count_upto(__isl_keep isl_set *set, isl_int max, isl_int *count)
 
 	return 0;
 error:
+	isl_int_clear(cnt.max);
 	isl_int_clear(cnt.count);
 	return -1;
 }
 
+/* Count the number of integer points in the one-dimensional
+ * basic set "bset", without any parameters or existentially
+ * quantified variables, and store the result in "count".
+ * The number of points is the difference between the smallest
+ * upper bound and the largest lower bound, plus one,
+ * if this difference is non-negative and zero otherwise.
+ */
+static int count_1d(__isl_keep isl_basic_set *bset, isl_int *count)
+{
+	int i;
+	int has_lower = 0, has_upper = 0, empty = 0;
+	isl_int lower, upper, v;
+
+	isl_int_init(lower);
+	isl_int_init(upper);
+	isl_int_init(v);
+
+	for (i = 0; !empty && i < bset->n_eq; ++i) {
+		isl_int *eq = bset->eq[i];
+
+		if (isl_int_is_zero(eq[1])) {
+			empty = !isl_int_is_zero(eq[0]);
+			continue;
+		}
+		if (!isl_int_is_divisible_by(eq[0], eq[1])) {
+			empty = 1;
+			continue;
+		}
+		isl_int_divexact(v, eq[0], eq[1]);
+		isl_int_neg(v, v);
+		if (!has_lower || isl_int_gt(v, lower))
+			isl_int_set(lower, v);
+		if (!has_upper || isl_int_lt(v, upper))
+			isl_int_set(upper, v);
+		has_lower = has_upper = 1;
+	}
+	for (i = 0; !empty && i < bset->n_ineq; ++i) {
+		isl_int *ineq = bset->ineq[i];
+
+		if (isl_int_is_zero(ineq[1])) {
+			empty = isl_int_is_neg(ineq[0]);
+			continue;
+		}
+		if (isl_int_is_pos(ineq[1])) {
+			isl_int_neg(v, ineq[0]);
+			isl_int_cdiv_q(v, v, ineq[1]);
+			if (!has_lower || isl_int_gt(v, lower))
+				isl_int_set(lower, v);
+			has_lower = 1;
+		} else {
+			isl_int_neg(v, ineq[1]);
+			isl_int_fdiv_q(v, ineq[0], v);
+			if (!has_upper || isl_int_lt(v, upper))
+				isl_int_set(upper, v);
+			has_upper = 1;
+		}
+	}
+
+	if (!empty && (!has_lower || !has_upper)) {
+		isl_int_clear(lower);
+		isl_int_clear(upper);
+		isl_int_clear(v);
+		isl_die(bset->ctx, isl_error_invalid,
+			"cannot count points in unbounded set", return -1);
+	}
+
+	if (empty || isl_int_gt(lower, upper))
+		isl_int_set_si(*count, 0);
+	else {
+		isl_int_sub(*count, upper, lower);
+		isl_int_add_ui(*count, *count, 1);
+	}
+
+	isl_int_clear(lower);
+	isl_int_clear(upper);
+	isl_int_clear(v);
+
+	return 0;
+}
+
+/* Extract the factors of "bset", as determined by the factorizer "f",
+ * and return them as an array of basic sets.
+ * The factors are stored in the order in which they are to be counted
+ * by count_flat_upto: first those that can be counted
+ * in closed form and then the others.
+ * If "bset" has no factors, then the array only contains "bset".
+ */
+static __isl_give isl_basic_set **extract_factors(
+	__isl_take isl_basic_set *bset, __isl_keep isl_factorizer *f,
+	int *n_factor)
+{
+	int i, n, pos;
+	unsigned nvar;
+	isl_ctx *ctx;
+	isl_basic_set **factor;
+	isl_basic_set *bset_i;
+
+	ctx = isl_basic_set_get_ctx(bset);
+	*n_factor = f->n_group == 0 ? 1 : f->n_group;
+	factor = isl_calloc_array(ctx, isl_basic_set *, *n_factor);
+	if (!factor)
+		goto error;
+
+	if (f->n_group == 0) {
+		factor[0] = bset;
+		return factor;
+	}
+
+	nvar = isl_basic_set_dim(bset, isl_dim_set);
+	bset = isl_morph_basic_set(isl_morph_copy(f->morph), bset);
+
+	pos = 0;
+	for (i = 0, n = 0; i < f->n_group; ++i) {
+		bset_i = isl_basic_set_copy(bset);
+		bset_i = isl_basic_set_drop_constraints_involving(bset_i,
+			    n + f->len[i], nvar - n - f->len[i]);
+		bset_i = isl_basic_set_drop_constraints_involving(bset_i,
+			    0, n);
+		bset_i = isl_basic_set_drop(bset_i, isl_dim_set,
+			    n + f->len[i], nvar - n - f->len[i]);
+		bset_i = isl_basic_set_drop(bset_i, isl_dim_set, 0, n);
+		if (!bset_i)
+			goto error;
+		if (f->len[i] == 1) {
+			memmove(factor + 1, factor, pos * sizeof(*factor));
+			factor[0] = bset_i;
+		} else
+			factor[pos] = bset_i;
+		pos++;
+		n += f->len[i];
+	}
+
+	isl_basic_set_free(bset);
+	return factor;
+error:
+	if (factor)
+		for (i = 0; i < *n_factor; ++i)
+			isl_basic_set_free(factor[i]);
+	free(factor);
+	isl_basic_set_free(bset);
+	return NULL;
+}
+
+/* Count the number of points in the factors "factor" and
+ * return their product, up to "max" (if it is non-zero), in "count".
+ *
+ * One-dimensional factors are counted in closed form by count_1d.
+ * The other factors need to be enumerated.
+ * If "max" is non-zero, then the enumeration of a factor can be
+ * stopped as soon as the product of its number of points with
+ * the product of the counts of the previous factors reaches "max".
+ * This is only valid if none of the other factors is empty,
+ * so we first check that this is the case.
+ */
+static int count_factors_upto(isl_basic_set **factor, int n_factor,
+	isl_int max, isl_int *count)
+{
+	int i, empty;
+	isl_int c, m;
+
+	if (!isl_int_is_zero(max)) {
+		for (i = 0; i < n_factor; ++i) {
+			empty = isl_basic_set_is_empty(factor[i]);
+			if (empty < 0)
+				return -1;
+			if (empty) {
+				isl_int_set_si(*count, 0);
+				return 0;
+			}
+		}
+	}
+
+	isl_int_init(c);
+	isl_int_init(m);
+	isl_int_set_si(*count, 1);
+	for (i = 0; i < n_factor; ++i) {
+		if (isl_basic_set_dim(factor[i], isl_dim_set) == 1) {
+			if (count_1d(factor[i], &c) < 0)
+				goto error;
+		} else {
+			isl_int_set_si(m, 0);
+			if (!isl_int_is_zero(max))
+				isl_int_cdiv_q(m, max, *count);
+			if (scan_count_upto(isl_basic_set_copy(factor[i]),
+					    m, &c) < 0)
+				goto error;
+		}
+		isl_int_mul(*count, *count, c);
+		if (isl_int_is_zero(*count))
+			break;
+		if (!isl_int_is_zero(max) && isl_int_ge(*count, max)) {
+			isl_int_set(*count, max);
+			break;
+		}
+	}
+	isl_int_clear(c);
+	isl_int_clear(m);
+
+	return 0;
+error:
+	isl_int_clear(c);
+	isl_int_clear(m);
+	return -1;
+}
+
+/* Count the number of points in "bset", up to "max" (if it is non-zero),
+ * where "bset" has no parameters or existentially quantified variables.
+ *
+ * We first remove all equalities by compressing "bset".
+ * Since the compression is a bijection between the integer points
+ * of "bset" and those of the compressed set, this does not affect
+ * the number of points.
+ * We then split the result into independent factors, again
+ * by means of a bijection on the integer points, count the number of
+ * points in each of these factors and return their product.
+ */
+static int count_flat_upto(__isl_take isl_basic_set *bset, isl_int max,
+	isl_int *count)
+{
+	int i, n_factor, r;
+	isl_morph *morph;
+	isl_factorizer *f;
+	isl_basic_set **factor;
+
+	if (!bset)
+		return -1;
+
+	if (isl_basic_set_plain_is_empty(bset)) {
+		isl_basic_set_free(bset);
+		isl_int_set_si(*count, 0);
+		return 0;
+	}
+	if (bset->n_eq > 0 && isl_basic_set_dim(bset, isl_dim_set) > 1) {
+		morph = isl_basic_set_full_compression(bset);
+		bset = isl_morph_basic_set(morph, bset);
+		if (!bset)
+			return -1;
+		if (isl_basic_set_plain_is_empty(bset)) {
+			isl_basic_set_free(bset);
+			isl_int_set_si(*count, 0);
+			return 0;
+		}
+	}
+	if (isl_basic_set_dim(bset, isl_dim_set) == 0) {
+		isl_basic_set_free(bset);
+		isl_int_set_si(*count, 1);
+		return 0;
+	}
+
+	f = isl_basic_set_factorizer(bset);
+	if (!f) {
+		isl_basic_set_free(bset);
+		return -1;
+	}
+	factor = extract_factors(bset, f, &n_factor);
+	isl_factorizer_free(f);
+	if (!factor)
+		return -1;
+
+	r = count_factors_upto(factor, n_factor, max, count);
+
+	for (i = 0; i < n_factor; ++i)
+		isl_basic_set_free(factor[i]);
+	free(factor);
+
+	return r;
+}
+
+/* Count the number of points in "bset", up to "max" (if it is non-zero).
+ *
+ * The parameters and existentially quantified variables are treated
+ * as set variables, just like in isl_basic_set_scan.
+ * The actual counting is performed by count_flat_upto, which avoids
+ * enumerating the points whenever possible.
+ */
+int isl_basic_set_count_upto(__isl_keep isl_basic_set *bset,
+	isl_int max, isl_int *count)
+{
+	if (!bset)
+		return -1;
+
+	return count_flat_upto(flat_copy(bset->ctx, bset, 0), max, count);
+}
+
+/* Count the number of points in "set", up to "max" (if it is non-zero).
+ *
+ * We count the points in each of the basic sets of a disjoint
+ * decomposition of "set" and add up the results.
+ */
+int isl_set_count_upto(__isl_keep isl_set *set, isl_int max, isl_int *count)
+{
+	int i, r = 0;
+	isl_int c, m;
+
+	if (!set)
+		return -1;
+
+	set = isl_set_copy(set);
+	set = isl_set_make_disjoint(set);
+	set = isl_set_compute_divs(set);
+	if (!set)
+		return -1;
+
+	isl_int_init(c);
+	isl_int_init(m);
+	isl_int_set_si(*count, 0);
+	for (i = 0; i < set->n; ++i) {
+		isl_int_set_si(m, 0);
+		if (!isl_int_is_zero(max))
+			isl_int_sub(m, max, *count);
+		r = isl_basic_set_count_upto(set->p[i], m, &c);
+		if (r < 0)
+			break;
+		isl_int_add(*count, *count, c);
+		if (!isl_int_is_zero(max) && isl_int_ge(*count, max)) {
+			isl_int_set(*count, max);
+			break;
+		}
+	}
+	isl_int_clear(c);
+	isl_int_clear(m);
+	isl_set_free(set);
+
+	return r;
+}
+
 int isl_set_count(__isl_keep isl_set *set, isl_int *count)
 {
 	if (!set)
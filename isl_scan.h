@@ -13,12 +13,35 @@
 #include <isl/set.h>
 #include <isl/vec.h>
 
+/* "add" is called on each integer point found by the scan.
+ * If "add_line" is not NULL, then it is called instead on
+ * each sequence of "n" integer points of the form "first" + k "step",
+ * with 0 <= k < n, that is found in the innermost direction of the scan.
+ */
 struct isl_scan_callback {
 	int (*add)(struct isl_scan_callback *cb, __isl_take isl_vec *sample);
+	int (*add_line)(struct isl_scan_callback *cb,
+		__isl_take isl_vec *first, __isl_keep isl_vec *step, isl_int n);
 };
 
 int isl_basic_set_scan(struct isl_basic_set *bset,
 	struct isl_scan_callback *callback);
 int isl_set_scan(__isl_take isl_set *set, struct isl_scan_callback *callback);
 
+/* "alloc" is called by each worker of isl_set_scan_parallel
+ * to create a callback in the context "ctx" of the worker.
+ * "free" is called by the same worker when it has finished,
+ * with "r" the result of the final call to isl_basic_set_scan.
+ * It should free the callback and return a negative value on error.
+ * The calls to "free" are serialized.
+ */
+struct isl_scan_parallel {
+	struct isl_scan_callback *(*alloc)(isl_ctx *ctx, void *user);
+	int (*free)(struct isl_scan_callback *cb, int r, void *user);
+	void *user;
+};
+
+int isl_set_scan_parallel(__isl_take isl_set *set, int n_thread,
+	struct isl_scan_parallel *par);
+
 #endif
@@ -2896,6 +2896,10 @@ static int compute_schedule(isl_ctx *ctx, struct isl_sched_graph *graph)
  * If Feautrier's scheduling algorithm is used, the proximity dependence
  * distances are only minimized during the extension to a full-dimensional
  * schedule.
+ *
+ * If schedule caching is enabled, then we first check if a schedule
+ * has already been computed for the same inputs and options and,
+ * if not, we store the computed schedule in the cache.
  */
 __isl_give isl_schedule *isl_union_set_compute_schedule(
 	__isl_take isl_union_set *domain,
@@ -2907,6 +2911,7 @@ __isl_give isl_schedule *isl_union_set_compute_schedule(
 	struct isl_sched_graph graph = { 0 };
 	isl_schedule *sched;
 	struct isl_extract_edge_data data;
+	char *key = NULL;
 
 	domain = isl_union_set_align_params(domain,
 					    isl_union_map_get_space(validity));
@@ -2922,6 +2927,20 @@ __isl_give isl_schedule *isl_union_set_compute_schedule(
 	graph.n = isl_union_set_n_set(domain);
 	if (graph.n == 0)
 		goto empty;
+	if (isl_schedule_cache_is_enabled(ctx)) {
+		key = isl_schedule_cache_key(domain, validity, proximity);
+		if (!key)
+			goto error;
+		sched = isl_schedule_cache_lookup(ctx, key,
+					isl_union_set_get_space(domain));
+		if (sched) {
+			free(key);
+			isl_union_set_free(domain);
+			isl_union_map_free(validity);
+			isl_union_map_free(proximity);
+			return sched;
+		}
+	}
 	if (graph_alloc(ctx, &graph, graph.n,
 	    isl_union_map_n_map(validity) + isl_union_map_n_map(proximity)) < 0)
 		goto error;
@@ -2951,7 +2970,10 @@ __isl_give isl_schedule *isl_union_set_compute_schedule(
 
 empty:
 	sched = extract_schedule(&graph, isl_union_set_get_space(domain));
+	if (key && isl_schedule_cache_store(ctx, key, sched) < 0)
+		sched = isl_schedule_free(sched);
 
+	free(key);
 	graph_free(ctx, &graph);
 	isl_union_set_free(domain);
 	isl_union_map_free(validity);
@@ -2959,6 +2981,7 @@ empty:
 
 	return sched;
 error:
+	free(key);
 	graph_free(ctx, &graph);
 	isl_union_set_free(domain);
 	isl_union_map_free(validity);
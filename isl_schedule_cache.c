@@ -0,0 +1,710 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <isl_config.h>
+#ifdef HAVE_MKSTEMP
+#include <unistd.h>
+#endif
+#include <isl_ctx_private.h>
+#include <isl_options_private.h>
+#include <isl/hash.h>
+#include <isl/aff.h>
+#include <isl/set.h>
+#include <isl/map.h>
+#include <isl/union_set.h>
+#include <isl/union_map.h>
+#include <isl/printer.h>
+#include <isl_schedule_private.h>
+#include <isl_sort.h>
+
+/* Install a user defined backend for caching schedules computed
+ * by isl_union_set_compute_schedule.
+ * "lookup" is called with the key of a scheduling problem and
+ * should return a malloc'ed copy of the string that was previously
+ * stored under this key or NULL if there is no such string.
+ * "store" is called with the key of a scheduling problem and
+ * the string representation of the computed schedule.
+ * Passing NULL for both callbacks removes the user defined backend.
+ */
+int isl_ctx_set_schedule_cache(isl_ctx *ctx,
+	char *(*lookup)(const char *key, void *user),
+	int (*store)(const char *key, const char *value, void *user),
+	void *user)
+{
+	if (!ctx)
+		return -1;
+	if (!lookup != !store)
+		isl_die(ctx, isl_error_invalid,
+			"both callbacks should be set or unset", return -1);
+
+	ctx->schedule_cache_lookup = lookup;
+	ctx->schedule_cache_store = store;
+	ctx->schedule_cache_user = user;
+
+	return 0;
+}
+
+/* Is the cache directory option set to a non-empty string?
+ */
+static int has_cache_dir(isl_ctx *ctx)
+{
+	return ctx->opt->schedule_cache_dir && ctx->opt->schedule_cache_dir[0];
+}
+
+/* Should the results of isl_union_set_compute_schedule be cached?
+ */
+int isl_schedule_cache_is_enabled(isl_ctx *ctx)
+{
+	if (!ctx)
+		return 0;
+	return ctx->schedule_cache_lookup != NULL || has_cache_dir(ctx);
+}
+
+/* Data used in collect_set and collect_map.
+ *
+ * "str" collects the string representations of the elements.
+ * "n" is the number of elements that have been collected so far.
+ */
+struct isl_schedule_cache_collect_data {
+	char **str;
+	int n;
+};
+
+static int collect_set(__isl_take isl_set *set, void *user)
+{
+	struct isl_schedule_cache_collect_data *data = user;
+	isl_printer *p;
+
+	p = isl_printer_to_str(isl_set_get_ctx(set));
+	p = isl_printer_print_set(p, set);
+	data->str[data->n] = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_set_free(set);
+
+	if (!data->str[data->n])
+		return -1;
+	data->n++;
+	return 0;
+}
+
+static int collect_map(__isl_take isl_map *map, void *user)
+{
+	struct isl_schedule_cache_collect_data *data = user;
+	isl_printer *p;
+
+	p = isl_printer_to_str(isl_map_get_ctx(map));
+	p = isl_printer_print_map(p, map);
+	data->str[data->n] = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_map_free(map);
+
+	if (!data->str[data->n])
+		return -1;
+	data->n++;
+	return 0;
+}
+
+static int cmp_str(const void *a, const void *b, void *user)
+{
+	const char * const *s1 = a;
+	const char * const *s2 = b;
+
+	return strcmp(*s1, *s2);
+}
+
+/* Print the "n" strings in "str" to "p", one per line, in sorted order,
+ * and free them.
+ */
+static __isl_give isl_printer *print_sorted(__isl_take isl_printer *p,
+	char **str, int n, int ok)
+{
+	int i;
+
+	if (ok && isl_sort(str, n, sizeof(char *), &cmp_str, NULL) < 0)
+		ok = 0;
+	for (i = 0; i < n; ++i) {
+		if (ok) {
+			p = isl_printer_print_str(p, str[i]);
+			p = isl_printer_print_str(p, "\n");
+		}
+		free(str[i]);
+	}
+	free(str);
+
+	if (!ok)
+		return isl_printer_free(p);
+	return p;
+}
+
+/* Print a canonical representation of "uset" to "p".
+ * The sets in "uset" are printed in sorted order such that the result
+ * does not depend on the order in which they are stored in "uset".
+ */
+static __isl_give isl_printer *print_canonical_union_set(
+	__isl_take isl_printer *p, __isl_keep isl_union_set *uset)
+{
+	struct isl_schedule_cache_collect_data data;
+	isl_ctx *ctx;
+	int n, ok;
+
+	if (!p || !uset)
+		return isl_printer_free(p);
+
+	ctx = isl_union_set_get_ctx(uset);
+	n = isl_union_set_n_set(uset);
+	data.n = 0;
+	data.str = isl_calloc_array(ctx, char *, n);
+	if (n && !data.str)
+		return isl_printer_free(p);
+	ok = isl_union_set_foreach_set(uset, &collect_set, &data) >= 0;
+	p = isl_printer_print_int(p, data.n);
+	p = isl_printer_print_str(p, "\n");
+	return print_sorted(p, data.str, data.n, ok);
+}
+
+/* Print a canonical representation of "umap" to "p".
+ * The maps in "umap" are printed in sorted order such that the result
+ * does not depend on the order in which they are stored in "umap".
+ */
+static __isl_give isl_printer *print_canonical_union_map(
+	__isl_take isl_printer *p, __isl_keep isl_union_map *umap)
+{
+	struct isl_schedule_cache_collect_data data;
+	isl_ctx *ctx;
+	int n, ok;
+
+	if (!p || !umap)
+		return isl_printer_free(p);
+
+	ctx = isl_union_map_get_ctx(umap);
+	n = isl_union_map_n_map(umap);
+	data.n = 0;
+	data.str = isl_calloc_array(ctx, char *, n);
+	if (n && !data.str)
+		return isl_printer_free(p);
+	ok = isl_union_map_foreach_map(umap, &collect_map, &data) >= 0;
+	p = isl_printer_print_int(p, data.n);
+	p = isl_printer_print_str(p, "\n");
+	return print_sorted(p, data.str, data.n, ok);
+}
+
+/* The options that are known not to affect the outcome of
+ * isl_union_set_compute_schedule, apart from those that only
+ * affect AST generation (starting with "ast-").
+ */
+static const char *schedule_independent_options[] = {
+	"on-error",
+	"threads",
+	"vertices-cache-size",
+	"qpolynomial-div-cache-size",
+	"schedule-cache-dir",
+};
+
+/* Is the option with long name "name" known not to affect
+ * the outcome of isl_union_set_compute_schedule?
+ */
+static int is_schedule_independent_option(const char *name)
+{
+	int i;
+
+	if (!strncmp(name, "ast-", 4))
+		return 1;
+	for (i = 0; i < sizeof(schedule_independent_options) /
+			sizeof(schedule_independent_options[0]); ++i)
+		if (!strcmp(name, schedule_independent_options[i]))
+			return 1;
+	return 0;
+}
+
+/* Print the value of the option described by "arg" in "opt" to "p",
+ * along with its name.
+ */
+static __isl_give isl_printer *print_option(__isl_take isl_printer *p,
+	struct isl_arg *arg, struct isl_options *opt)
+{
+	char buffer[50];
+	char *field = ((char *) opt) + arg->offset;
+
+	p = isl_printer_print_str(p, arg->long_name);
+	p = isl_printer_print_str(p, " ");
+	switch (arg->type) {
+	case isl_arg_bool:
+	case isl_arg_choice:
+	case isl_arg_flags:
+		snprintf(buffer, sizeof(buffer), "%u", *(unsigned *) field);
+		p = isl_printer_print_str(p, buffer);
+		break;
+	case isl_arg_int:
+		p = isl_printer_print_int(p, *(int *) field);
+		break;
+	case isl_arg_long:
+		snprintf(buffer, sizeof(buffer), "%ld", *(long *) field);
+		p = isl_printer_print_str(p, buffer);
+		break;
+	case isl_arg_ulong:
+		snprintf(buffer, sizeof(buffer), "%lu",
+			*(unsigned long *) field);
+		p = isl_printer_print_str(p, buffer);
+		break;
+	case isl_arg_str:
+		if (*(char **) field)
+			p = isl_printer_print_str(p, *(char **) field);
+		break;
+	default:
+		break;
+	}
+	p = isl_printer_print_str(p, "\n");
+
+	return p;
+}
+
+/* Print the options that may affect the outcome of
+ * isl_union_set_compute_schedule to "p".
+ * Rather than listing the options that are known to affect
+ * the computation (possibly indirectly through the LP solver,
+ * the convex hull computation or the closure computation),
+ * all options are printed, except those that are known not
+ * to have any effect.
+ */
+static __isl_give isl_printer *print_schedule_options(
+	__isl_take isl_printer *p, struct isl_options *opt)
+{
+	struct isl_arg *arg = isl_options_args.args;
+	int i;
+
+	p = isl_printer_print_str(p, "isl-schedule\n");
+	for (i = 0; arg[i].type != isl_arg_end; ++i) {
+		if (arg[i].offset == (size_t) -1 || !arg[i].long_name)
+			continue;
+		switch (arg[i].type) {
+		case isl_arg_bool:
+		case isl_arg_choice:
+		case isl_arg_flags:
+		case isl_arg_int:
+		case isl_arg_long:
+		case isl_arg_ulong:
+		case isl_arg_str:
+			break;
+		default:
+			continue;
+		}
+		if (is_schedule_independent_option(arg[i].long_name))
+			continue;
+		p = print_option(p, &arg[i], opt);
+	}
+
+	return p;
+}
+
+/* Construct a key that identifies the scheduling problem
+ * of computing a schedule for "domain" with respect to
+ * "validity" and "proximity".
+ * The key consists of the scheduling options followed by
+ * canonical representations of the three inputs.
+ * The inputs are assumed to have aligned parameters.
+ */
+char *isl_schedule_cache_key(__isl_keep isl_union_set *domain,
+	__isl_keep isl_union_map *validity, __isl_keep isl_union_map *proximity)
+{
+	isl_ctx *ctx;
+	isl_printer *p;
+	char *key;
+
+	if (!domain || !validity || !proximity)
+		return NULL;
+
+	ctx = isl_union_set_get_ctx(domain);
+	p = isl_printer_to_str(ctx);
+	p = print_schedule_options(p, ctx->opt);
+	p = print_canonical_union_set(p, domain);
+	p = print_canonical_union_map(p, validity);
+	p = print_canonical_union_map(p, proximity);
+	key = isl_printer_get_str(p);
+	isl_printer_free(p);
+
+	return key;
+}
+
+/* Print a textual representation of "schedule" to "p" that
+ * can be read back using read_schedule.
+ * The first line contains the number of nodes, the maximal number
+ * of bands and the number of schedule rows.
+ * Each node is then represented by two lines.
+ * The first contains the number of bands, the end positions and
+ * identifiers of the bands and the zero distance flags of the rows.
+ * The second contains the schedule of the node.
+ */
+static __isl_give isl_printer *print_schedule(__isl_take isl_printer *p,
+	__isl_keep isl_schedule *schedule)
+{
+	int i, j;
+
+	p = isl_printer_print_int(p, schedule->n);
+	p = isl_printer_print_str(p, " ");
+	p = isl_printer_print_int(p, schedule->n_band);
+	p = isl_printer_print_str(p, " ");
+	p = isl_printer_print_int(p, schedule->n_total_row);
+	p = isl_printer_print_str(p, "\n");
+
+	for (i = 0; i < schedule->n; ++i) {
+		struct isl_schedule_node *node = &schedule->node[i];
+		int n_band = node->band_end ? node->n_band : 0;
+
+		p = isl_printer_print_int(p, n_band);
+		for (j = 0; j < n_band; ++j) {
+			p = isl_printer_print_str(p, " ");
+			p = isl_printer_print_int(p, node->band_end[j]);
+			p = isl_printer_print_str(p, " ");
+			p = isl_printer_print_int(p, node->band_id[j]);
+		}
+		for (j = 0; node->zero && j < schedule->n_total_row; ++j) {
+			p = isl_printer_print_str(p, " ");
+			p = isl_printer_print_int(p, node->zero[j]);
+		}
+		p = isl_printer_print_str(p, "\n");
+		p = isl_printer_print_multi_aff(p, node->sched);
+		p = isl_printer_print_str(p, "\n");
+	}
+
+	return p;
+}
+
+/* Read an integer from *s and advance *s past it.
+ * Return -1 if *s does not start with a non-negative integer.
+ */
+static int read_int(const char **s, int *v)
+{
+	char *end;
+	long l;
+
+	l = strtol(*s, &end, 10);
+	if (end == *s || l < 0 || l > 0x7fffffff)
+		return -1;
+	*v = l;
+	*s = end;
+	return 0;
+}
+
+/* Read the rest of the line starting at *s into a newly allocated string
+ * and advance *s to the start of the next line.
+ */
+static char *read_line(isl_ctx *ctx, const char **s)
+{
+	const char *end;
+	char *line;
+
+	end = strchr(*s, '\n');
+	if (!end)
+		return NULL;
+	line = isl_alloc_array(ctx, char, end - *s + 1);
+	if (!line)
+		return NULL;
+	memcpy(line, *s, end - *s);
+	line[end - *s] = '\0';
+	*s = end + 1;
+
+	return line;
+}
+
+/* Read a schedule in the format produced by print_schedule from "str".
+ * Return NULL if "str" does not represent a valid schedule.
+ */
+static __isl_give isl_schedule *read_schedule(__isl_take isl_space *dim,
+	const char *str)
+{
+	int i, j;
+	int n, n_band, n_total_row;
+	isl_ctx *ctx;
+	isl_schedule *sched = NULL;
+
+	if (!dim || !str)
+		goto error;
+
+	ctx = isl_space_get_ctx(dim);
+	if (read_int(&str, &n) < 0 || read_int(&str, &n_band) < 0 ||
+	    read_int(&str, &n_total_row) < 0 || *str++ != '\n' || n < 1)
+		goto error;
+
+	sched = isl_calloc(ctx, struct isl_schedule,
+			   sizeof(struct isl_schedule) +
+			   (n - 1) * sizeof(struct isl_schedule_node));
+	if (!sched)
+		goto error;
+
+	sched->ref = 1;
+	sched->n = n;
+	sched->n_band = n_band;
+	sched->n_total_row = n_total_row;
+
+	for (i = 0; i < n; ++i) {
+		struct isl_schedule_node *node = &sched->node[i];
+		char *line;
+
+		if (read_int(&str, &node->n_band) < 0 ||
+		    node->n_band > n_band)
+			goto error;
+		if (n_band > 0) {
+			node->band_end = isl_alloc_array(ctx, int, n_band);
+			node->band_id = isl_alloc_array(ctx, int, n_band);
+			node->zero = isl_alloc_array(ctx, int, n_total_row);
+			if (!node->band_end || !node->band_id ||
+			    (n_total_row && !node->zero))
+				goto error;
+		}
+		for (j = 0; j < node->n_band; ++j)
+			if (read_int(&str, &node->band_end[j]) < 0 ||
+			    read_int(&str, &node->band_id[j]) < 0)
+				goto error;
+		for (j = 0; n_band > 0 && j < n_total_row; ++j)
+			if (read_int(&str, &node->zero[j]) < 0)
+				goto error;
+		if (*str++ != '\n')
+			goto error;
+		line = read_line(ctx, &str);
+		if (!line)
+			goto error;
+		node->sched = isl_multi_aff_read_from_str(ctx, line);
+		free(line);
+		if (!node->sched)
+			goto error;
+	}
+
+	sched->dim = dim;
+
+	return sched;
+error:
+	isl_space_free(dim);
+	isl_schedule_free(sched);
+	return NULL;
+}
+
+/* Return the name of the file in the cache directory that is used
+ * to store the result for "key".
+ */
+static char *cache_file_name(isl_ctx *ctx, const char *key)
+{
+	const char *dir = ctx->opt->schedule_cache_dir;
+	uint32_t hash;
+	char *name;
+	size_t len;
+
+	hash = isl_hash_string(isl_hash_init(), key);
+	len = strlen(dir) + strlen("/isl-schedule-") + 8 + 1;
+	name = isl_alloc_array(ctx, char, len);
+	if (!name)
+		return NULL;
+	snprintf(name, len, "%s/isl-schedule-%08x", dir, (unsigned) hash);
+
+	return name;
+}
+
+/* Read the entire contents of the file called "name".
+ */
+static char *read_file(isl_ctx *ctx, const char *name)
+{
+	FILE *file;
+	char *buf = NULL;
+	size_t size = 0, len = 0;
+
+	file = fopen(name, "rb");
+	if (!file)
+		return NULL;
+
+	do {
+		char *grown;
+
+		size = 2 * size + 4096;
+		grown = isl_realloc_array(ctx, buf, char, size);
+		if (!grown) {
+			free(buf);
+			fclose(file);
+			return NULL;
+		}
+		buf = grown;
+		len += fread(buf + len, 1, size - 1 - len, file);
+	} while (len == size - 1);
+	buf[len] = '\0';
+
+	fclose(file);
+	return buf;
+}
+
+/* Look up "key" in the cache directory.
+ * Each file in the directory contains the length of the key
+ * on the first line, followed by the key itself and the schedule.
+ * Since different keys may hash to the same file name,
+ * the key stored in the file is compared to "key".
+ */
+static char *dir_lookup(isl_ctx *ctx, const char *key)
+{
+	char *name, *buf, *value;
+	const char *s;
+	int key_len;
+	size_t buf_len;
+
+	name = cache_file_name(ctx, key);
+	if (!name)
+		return NULL;
+	buf = read_file(ctx, name);
+	free(name);
+	if (!buf)
+		return NULL;
+
+	s = buf;
+	buf_len = strlen(buf);
+	if (read_int(&s, &key_len) < 0 || *s++ != '\n' ||
+	    key_len != strlen(key) || key_len > buf_len - (s - buf) ||
+	    memcmp(s, key, key_len)) {
+		free(buf);
+		return NULL;
+	}
+
+	value = strdup(s + key_len);
+	free(buf);
+	return value;
+}
+
+/* Create a new file for writing in the same directory as "name",
+ * with a name that is derived from "name" and that is not used
+ * by any other writer, and store this name in "tmp".
+ * "tmp" has room for "len" characters.
+ *
+ * If mkstemp is available, then it is used to create the file.
+ * Otherwise, the name is made unique within the process
+ * by means of a counter and the address of "ctx".
+ */
+static FILE *open_tmp(isl_ctx *ctx, const char *name, char *tmp, size_t len)
+{
+#ifdef HAVE_MKSTEMP
+	int fd;
+	FILE *file;
+
+	snprintf(tmp, len, "%s.XXXXXX", name);
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return NULL;
+	file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+		remove(tmp);
+	}
+	return file;
+#else
+	static unsigned counter = 0;
+
+	snprintf(tmp, len, "%s.%p.%u", name, (void *) ctx, counter++);
+	return fopen(tmp, "wb");
+#endif
+}
+
+/* Store "value" under "key" in the cache directory.
+ * The file is first written under a unique temporary name
+ * in the same directory and then renamed such that concurrent
+ * readers never see an incomplete entry and such that concurrent
+ * writers do not write to the same file.
+ * Failure to write to the cache directory is not considered an error.
+ */
+static void dir_store(isl_ctx *ctx, const char *key, const char *value)
+{
+	char *name, *tmp;
+	FILE *file;
+	size_t len;
+	int ok;
+
+	name = cache_file_name(ctx, key);
+	if (!name)
+		return;
+	len = strlen(name) + 64;
+	tmp = isl_alloc_array(ctx, char, len);
+	if (!tmp) {
+		free(name);
+		return;
+	}
+
+	file = open_tmp(ctx, name, tmp, len);
+	if (file) {
+		ok = fprintf(file, "%d\n%s%s", (int) strlen(key),
+				key, value) >= 0;
+		ok = fclose(file) == 0 && ok;
+		if (!ok || rename(tmp, name) != 0)
+			remove(tmp);
+	}
+
+	free(tmp);
+	free(name);
+}
+
+/* Look up a previously computed schedule for the scheduling problem
+ * identified by "key".
+ * "dim" describes the parameters of the schedule.
+ * Return NULL if no such schedule is available.
+ * If a user defined backend has been installed, then it is used.
+ * Otherwise, the cache directory is consulted.
+ */
+__isl_give isl_schedule *isl_schedule_cache_lookup(isl_ctx *ctx,
+	const char *key, __isl_take isl_space *dim)
+{
+	char *value;
+	isl_schedule *sched;
+
+	if (!ctx || !key)
+		goto error;
+
+	if (ctx->schedule_cache_lookup)
+		value = ctx->schedule_cache_lookup(key,
+						ctx->schedule_cache_user);
+	else if (has_cache_dir(ctx))
+		value = dir_lookup(ctx, key);
+	else
+		value = NULL;
+	if (!value)
+		goto error;
+
+	sched = read_schedule(dim, value);
+	free(value);
+	if (!sched)
+		isl_ctx_reset_error(ctx);
+
+	return sched;
+error:
+	isl_space_free(dim);
+	return NULL;
+}
+
+/* Store "schedule" in the cache under "key".
+ */
+int isl_schedule_cache_store(isl_ctx *ctx, const char *key,
+	__isl_keep isl_schedule *schedule)
+{
+	isl_printer *p;
+	char *value;
+	int r = 0;
+
+	if (!ctx || !key || !schedule)
+		return -1;
+
+	p = isl_printer_to_str(ctx);
+	p = print_schedule(p, schedule);
+	value = isl_printer_get_str(p);
+	isl_printer_free(p);
+	if (!value)
+		return -1;
+
+	if (ctx->schedule_cache_store)
+		r = ctx->schedule_cache_store(key, value,
+						ctx->schedule_cache_user);
+	else if (has_cache_dir(ctx))
+		dir_store(ctx, key, value);
+
+	free(value);
+	return r;
+}
@@ -42,4 +42,12 @@ struct isl_schedule {
 	struct isl_schedule_node node[1];
 };
 
+int isl_schedule_cache_is_enabled(isl_ctx *ctx);
+char *isl_schedule_cache_key(__isl_keep isl_union_set *domain,
+	__isl_keep isl_union_map *validity, __isl_keep isl_union_map *proximity);
+__isl_give isl_schedule *isl_schedule_cache_lookup(isl_ctx *ctx,
+	const char *key, __isl_take isl_space *dim);
+int isl_schedule_cache_store(isl_ctx *ctx, const char *key,
+	__isl_keep isl_schedule *schedule);
+
 #endif
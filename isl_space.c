@@ -316,6 +316,53 @@ error:
 	return NULL;
 }
 
+/* Construct a copy of "space" in "ctx", including the identifiers
+ * and the nested spaces.
+ *
+ * "ctx" may be different from the context of "space", possibly
+ * used by a different thread.  This function only reads "space"
+ * and does not modify any reference counts in the context of "space".
+ */
+__isl_give isl_space *isl_space_transfer(isl_ctx *ctx,
+	__isl_keep isl_space *space)
+{
+	int i;
+	isl_space *res;
+
+	if (!space)
+		return NULL;
+
+	res = isl_space_alloc(ctx, space->nparam, space->n_in, space->n_out);
+	if (!res)
+		return NULL;
+	for (i = 0; i < 2; ++i) {
+		if (space->tuple_id[i] &&
+		    !(res->tuple_id[i] = isl_id_transfer(ctx,
+							space->tuple_id[i])))
+			goto error;
+		if (space->nested[i] &&
+		    !(res->nested[i] = isl_space_transfer(ctx,
+							space->nested[i])))
+			goto error;
+	}
+	if (space->n_id > 0) {
+		res->ids = isl_calloc_array(ctx, isl_id *, space->n_id);
+		if (!res->ids)
+			goto error;
+		res->n_id = space->n_id;
+	}
+	for (i = 0; i < space->n_id; ++i) {
+		if (space->ids[i] &&
+		    !(res->ids[i] = isl_id_transfer(ctx, space->ids[i])))
+			goto error;
+	}
+
+	return res;
+error:
+	isl_space_free(res);
+	return NULL;
+}
+
 __isl_give isl_space *isl_space_cow(__isl_take isl_space *dim)
 {
 	if (!dim)
@@ -23,6 +23,8 @@ struct isl_space {
 };
 
 __isl_give isl_space *isl_space_cow(__isl_take isl_space *dim);
+__isl_give isl_space *isl_space_transfer(isl_ctx *ctx,
+	__isl_keep isl_space *space);
 
 __isl_give isl_space *isl_space_underlying(__isl_take isl_space *dim,
 	unsigned n_div);
@@ -10,6 +10,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <limits.h>
+#include <isl_config.h>
+#ifdef ISL_USE_PTHREADS
+#include <pthread.h>
+#endif
 #include <isl_ctx_private.h>
 #include <isl_map_private.h>
 #include <isl_aff_private.h>
@@ -23,6 +27,7 @@
 #include <isl_options_private.h>
 #include <isl/vertices.h>
 #include <isl/ast_build.h>
+#include <isl_ast_private.h>
 #include <isl/val.h>
 
 #define ARRAY_SIZE(array) (sizeof(array)/sizeof(*array))
@@ -2161,9 +2166,192 @@ static int test_pwqp(struct isl_ctx *ctx)
 	if (!equal)
 		isl_die(ctx, isl_error_unknown, "unexpected result", return -1);
 
+	str = "{ [x,y] -> x + 1/2 * y - 1 }";
+	pwqp1 = isl_pw_qpolynomial_read_from_str(ctx, str);
+	pwqp1 = isl_pw_qpolynomial_pow(pwqp1, 3);
+	str = "{ [x,y] -> x^3 + 3/2 * x^2 * y + 3/4 * x * y^2 + 1/8 * y^3 - "
+		"3 * x^2 - 3 * x * y - 3/4 * y^2 + 3 * x + 3/2 * y - 1 }";
+	pwqp2 = isl_pw_qpolynomial_read_from_str(ctx, str);
+	equal = isl_pw_qpolynomial_plain_is_equal(pwqp1, pwqp2);
+	isl_pw_qpolynomial_free(pwqp2);
+	pwqp2 = isl_pw_qpolynomial_pow(isl_pw_qpolynomial_copy(pwqp1), 2);
+	pwqp1 = isl_pw_qpolynomial_mul(isl_pw_qpolynomial_copy(pwqp1), pwqp1);
+	if (equal > 0)
+		equal = isl_pw_qpolynomial_plain_is_equal(pwqp1, pwqp2);
+	isl_pw_qpolynomial_free(pwqp1);
+	isl_pw_qpolynomial_free(pwqp2);
+	if (equal < 0)
+		return -1;
+	if (!equal)
+		isl_die(ctx, isl_error_unknown, "unexpected result", return -1);
+
+	return 0;
+}
+
+/* Check that the value "num" / "den" computed by a compiled version
+ * of "pwqp" or "pwf" (the other being NULL) at the point with
+ * coordinates "point" is equal to the value computed by
+ * isl_pw_qpolynomial_eval or isl_pw_qpolynomial_fold_eval.
+ */
+static int check_exec_value(isl_ctx *ctx, __isl_keep isl_pw_qpolynomial *pwqp,
+	__isl_keep isl_pw_qpolynomial_fold *pwf, const int64_t *point,
+	int64_t num, int64_t den)
+{
+	int i, n, nparam, equal;
+	isl_space *space;
+	isl_point *pnt;
+	isl_val *v, *res;
+
+	if (pwqp)
+		space = isl_pw_qpolynomial_get_domain_space(pwqp);
+	else
+		space = isl_pw_qpolynomial_fold_get_domain_space(pwf);
+	nparam = isl_space_dim(space, isl_dim_param);
+	n = isl_space_dim(space, isl_dim_set);
+	pnt = isl_point_zero(space);
+	for (i = 0; i < nparam + n; ++i) {
+		enum isl_dim_type type = i < nparam ? isl_dim_param : isl_dim_set;
+		int pos = i < nparam ? i : i - nparam;
+		v = isl_val_int_from_si(ctx, point[i]);
+		pnt = isl_point_set_coordinate_val(pnt, type, pos, v);
+	}
+	if (pwqp)
+		v = isl_pw_qpolynomial_eval(isl_pw_qpolynomial_copy(pwqp), pnt);
+	else
+		v = isl_pw_qpolynomial_fold_eval(
+				isl_pw_qpolynomial_fold_copy(pwf), pnt);
+	res = isl_val_div(isl_val_int_from_si(ctx, num),
+			    isl_val_int_from_si(ctx, den));
+	equal = isl_val_eq(v, res);
+	isl_val_free(v);
+	isl_val_free(res);
+	if (equal < 0)
+		return -1;
+	if (!equal || den <= 0)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected result of compiled evaluation", return -1);
 	return 0;
 }
 
+/* Compile "pwqp" or "pwf" (the other being NULL), evaluate the result
+ * on all points with coordinates between -4 and 4 in a single batch and
+ * compare the results to those of the exact evaluation.
+ */
+static int test_pwqp_exec_grid(isl_ctx *ctx, __isl_keep isl_pw_qpolynomial *pwqp,
+	__isl_keep isl_pw_qpolynomial_fold *pwf)
+{
+	int i, j, n_coord, n_point, r = 0;
+	int64_t *point, *num, *den;
+	isl_pw_qpolynomial_exec *exec;
+
+	if (pwqp)
+		exec = isl_pw_qpolynomial_compile(pwqp);
+	else
+		exec = isl_pw_qpolynomial_fold_compile(pwf);
+	if (!exec)
+		return -1;
+
+	if (pwqp)
+		n_coord = isl_pw_qpolynomial_dim(pwqp, isl_dim_param) +
+			    isl_pw_qpolynomial_dim(pwqp, isl_dim_in);
+	else
+		n_coord = isl_pw_qpolynomial_fold_dim(pwf, isl_dim_param) +
+			    isl_pw_qpolynomial_fold_dim(pwf, isl_dim_in);
+	n_point = 1;
+	for (i = 0; i < n_coord; ++i)
+		n_point *= 9;
+	point = isl_alloc_array(ctx, int64_t, n_point * n_coord);
+	num = isl_alloc_array(ctx, int64_t, n_point);
+	den = isl_alloc_array(ctx, int64_t, n_point);
+	if (!point || !num || !den)
+		r = -1;
+	for (i = 0; r == 0 && i < n_point; ++i) {
+		int k = i;
+		for (j = 0; j < n_coord; ++j) {
+			point[i * n_coord + j] = k % 9 - 4;
+			k /= 9;
+		}
+	}
+	if (r == 0)
+		r = isl_pw_qpolynomial_exec_eval(exec, n_point, point, num, den);
+	for (i = 0; r == 0 && i < n_point; ++i)
+		r = check_exec_value(ctx, pwqp, pwf, point + i * n_coord,
+					num[i], den[i]);
+
+	free(point);
+	free(num);
+	free(den);
+	isl_pw_qpolynomial_exec_free(exec);
+	return r;
+}
+
+/* Piecewise quasipolynomials on which to test compiled evaluation.
+ * The last one has a constraint with a constant term that does not
+ * fit in 64 bits and is therefore always evaluated exactly.
+ */
+const char *pwqp_exec_tests[] = {
+	"{ [i] -> 1/6 * i^3 - 1/2 * i + 7 }",
+	"[n] -> { [i, j] -> i * j + 1/2 * n * [(i + j)/3] : "
+		"0 <= i <= n and 0 <= j < i; [i, j] -> 3 - 1/7 * j : i < 0 }",
+	"{ [i, j] -> i * [(i - 1)/4] - [j/3] : exists a : i = 2a and j >= -3 }",
+	"[n] -> { [i] -> n^2 - 2 * n * i + i^2 : n >= 0 }",
+	"{ [i] -> i : i <= 18446744073709551616 }",
+};
+
+/* Check that the compiled versions of some piecewise quasipolynomials
+ * and piecewise quasipolynomial folds produce the same results
+ * as exact evaluation.
+ * Also check that points on which the evaluation overflows
+ * are evaluated correctly.
+ */
+static int test_pwqp_exec(isl_ctx *ctx)
+{
+	int i, r;
+	const char *str;
+	isl_pw_qpolynomial *pwqp, *pwqp2;
+	isl_pw_qpolynomial_fold *pwf;
+	isl_pw_qpolynomial_exec *exec;
+	int64_t point[1] = { 3037000500 };
+	int64_t num, den;
+
+	for (i = 0; i < ARRAY_SIZE(pwqp_exec_tests); ++i) {
+		pwqp = isl_pw_qpolynomial_read_from_str(ctx,
+							pwqp_exec_tests[i]);
+		r = test_pwqp_exec_grid(ctx, pwqp, NULL);
+		isl_pw_qpolynomial_free(pwqp);
+		if (r < 0)
+			return -1;
+	}
+
+	str = "[n] -> { [i] -> i^2 - n : -3 <= i <= 3 }";
+	pwqp = isl_pw_qpolynomial_read_from_str(ctx, str);
+	str = "[n] -> { [i] -> 1/2 * n * i + [i/2] : i >= -1 }";
+	pwqp2 = isl_pw_qpolynomial_read_from_str(ctx, str);
+	pwf = isl_pw_qpolynomial_fold_from_pw_qpolynomial(isl_fold_max, pwqp);
+	pwf = isl_pw_qpolynomial_fold_fold(pwf,
+		    isl_pw_qpolynomial_fold_from_pw_qpolynomial(isl_fold_max,
+			    isl_pw_qpolynomial_copy(pwqp2)));
+	r = test_pwqp_exec_grid(ctx, NULL, pwf);
+	isl_pw_qpolynomial_fold_free(pwf);
+	pwf = isl_pw_qpolynomial_fold_from_pw_qpolynomial(isl_fold_min, pwqp2);
+	if (r >= 0)
+		r = test_pwqp_exec_grid(ctx, NULL, pwf);
+	isl_pw_qpolynomial_fold_free(pwf);
+	if (r < 0)
+		return -1;
+
+	str = "{ [i] -> 1/2 * i^2 + 1/2 * i }";
+	pwqp = isl_pw_qpolynomial_read_from_str(ctx, str);
+	exec = isl_pw_qpolynomial_compile(pwqp);
+	r = isl_pw_qpolynomial_exec_eval(exec, 1, point, &num, &den);
+	if (r >= 0)
+		r = check_exec_value(ctx, pwqp, NULL, point, num, den);
+	isl_pw_qpolynomial_exec_free(exec);
+	isl_pw_qpolynomial_free(pwqp);
+
+	return r;
+}
+
 void test_split_periods(isl_ctx *ctx)
 {
 	const char *str;
@@ -2600,6 +2788,184 @@ static int test_padded_schedule(isl_ctx *ctx)
 	return 0;
 }
 
+/* A schedule cache that keeps track of a single entry.
+ */
+struct test_schedule_cache {
+	char *key;
+	char *value;
+	int hits;
+};
+
+static char *test_schedule_cache_lookup(const char *key, void *user)
+{
+	struct test_schedule_cache *cache = user;
+
+	if (!cache->key || strcmp(cache->key, key))
+		return NULL;
+	cache->hits++;
+	return strdup(cache->value);
+}
+
+static int test_schedule_cache_store(const char *key, const char *value,
+	void *user)
+{
+	struct test_schedule_cache *cache = user;
+
+	free(cache->key);
+	free(cache->value);
+	cache->key = strdup(key);
+	cache->value = strdup(value);
+
+	return cache->key && cache->value ? 0 : -1;
+}
+
+/* Add the number of members of "band" and the number of those
+ * members that are zero distance to the counters in "user".
+ */
+static int count_band_members(__isl_keep isl_band *band, void *user)
+{
+	int *count = user;
+	int i, n;
+
+	n = isl_band_n_member(band);
+	count[0] += n;
+	for (i = 0; i < n; ++i)
+		count[1] += isl_band_member_is_zero_distance(band, i);
+
+	return 0;
+}
+
+/* Compute a schedule for the given domain and dependences and
+ * store the schedule map in *map and the band member counts in "count".
+ */
+static int compute_schedule_and_bands(isl_ctx *ctx, const char *domain,
+	const char *dep, __isl_give isl_union_map **map, int *count)
+{
+	isl_union_set *D;
+	isl_union_map *V, *P;
+	isl_schedule *sched;
+	int r;
+
+	D = isl_union_set_read_from_str(ctx, domain);
+	V = isl_union_map_read_from_str(ctx, dep);
+	P = isl_union_map_copy(V);
+	sched = isl_union_set_compute_schedule(D, V, P);
+	*map = isl_schedule_get_map(sched);
+	count[0] = count[1] = 0;
+	r = isl_schedule_foreach_band(sched, &count_band_members, count);
+	isl_schedule_free(sched);
+
+	return !*map ? -1 : r;
+}
+
+/* Compute a schedule for "D" with respect to "V" and check that
+ * no schedule is retrieved from "cache", given that the options
+ * have been changed since the previous computation.
+ */
+static int check_schedule_cache_miss(isl_ctx *ctx, const char *D,
+	const char *V, struct test_schedule_cache *cache)
+{
+	isl_union_map *map;
+	int count[2];
+	int hits = cache->hits;
+
+	if (compute_schedule_and_bands(ctx, D, V, &map, count) < 0)
+		return -1;
+	isl_union_map_free(map);
+	if (cache->hits != hits)
+		isl_die(ctx, isl_error_unknown,
+			"cached schedule used for different options",
+			return -1);
+	return 0;
+}
+
+/* Check that a schedule that is retrieved from a schedule cache
+ * is the same as the one that was originally computed and
+ * that changing the scheduling options, or options that affect
+ * the scheduler indirectly, prevents the cached schedule
+ * from being used.
+ */
+static int test_schedule_cache(isl_ctx *ctx)
+{
+	struct test_schedule_cache cache = { NULL, NULL, 0 };
+	const char *D, *V;
+	isl_union_map *map1, *map2;
+	int count1[2], count2[2];
+	int equal, hits, r;
+	int gbr = ctx->opt->gbr;
+	int context = ctx->opt->context;
+	int n_thread = isl_options_get_n_thread(ctx);
+
+	D = "[N] -> { S1[i] : 1 <= i <= N; S2[i,j] : 1 <= i,j <= N }";
+	V = "{ S1[i] -> S2[i,j]; S2[i,j] -> S2[i,j+1] }";
+	isl_ctx_set_schedule_cache(ctx, &test_schedule_cache_lookup,
+				    &test_schedule_cache_store, &cache);
+	if (compute_schedule_and_bands(ctx, D, V, &map1, count1) < 0)
+		goto error;
+	hits = cache.hits;
+	if (compute_schedule_and_bands(ctx, D, V, &map2, count2) < 0) {
+		isl_union_map_free(map1);
+		goto error;
+	}
+	equal = isl_union_map_is_equal(map1, map2);
+	isl_union_map_free(map1);
+	isl_union_map_free(map2);
+	if (equal < 0)
+		goto error;
+	if (hits != 0 || cache.hits != 1)
+		isl_die(ctx, isl_error_unknown, "unexpected number of hits",
+			goto error);
+	if (!equal || count1[0] != count2[0] || count1[1] != count2[1])
+		isl_die(ctx, isl_error_unknown,
+			"cached schedule not the same as original",
+			goto error);
+
+	ctx->opt->schedule_fuse = ISL_SCHEDULE_FUSE_MIN;
+	r = check_schedule_cache_miss(ctx, D, V, &cache);
+	ctx->opt->schedule_fuse = ISL_SCHEDULE_FUSE_MAX;
+	if (r < 0)
+		goto error;
+	ctx->opt->schedule_outer_zero_distance = 1;
+	r = check_schedule_cache_miss(ctx, D, V, &cache);
+	ctx->opt->schedule_outer_zero_distance = 0;
+	if (r < 0)
+		goto error;
+	ctx->opt->gbr = ISL_GBR_NEVER;
+	r = check_schedule_cache_miss(ctx, D, V, &cache);
+	ctx->opt->gbr = gbr;
+	if (r < 0)
+		goto error;
+	ctx->opt->context = ISL_CONTEXT_LEXMIN;
+	r = check_schedule_cache_miss(ctx, D, V, &cache);
+	ctx->opt->context = context;
+	if (r < 0)
+		goto error;
+	if (compute_schedule_and_bands(ctx, D, V, &map1, count1) < 0)
+		goto error;
+	isl_union_map_free(map1);
+	isl_options_set_n_thread(ctx, 4);
+	hits = cache.hits;
+	r = compute_schedule_and_bands(ctx, D, V, &map1, count1);
+	isl_options_set_n_thread(ctx, n_thread);
+	if (r < 0)
+		goto error;
+	isl_union_map_free(map1);
+	if (cache.hits != hits + 1)
+		isl_die(ctx, isl_error_unknown,
+			"cached schedule not used for irrelevant option",
+			goto error);
+
+	isl_ctx_set_schedule_cache(ctx, NULL, NULL, NULL);
+	free(cache.key);
+	free(cache.value);
+	return 0;
+error:
+	isl_ctx_set_schedule_cache(ctx, NULL, NULL, NULL);
+	free(cache.key);
+	free(cache.value);
+	return -1;
+}
+
 int test_schedule(isl_ctx *ctx)
 {
 	const char *D, *W, *R, *V, *P, *S;
@@ -2863,6 +3229,9 @@ int test_schedule(isl_ctx *ctx)
 	if (test_padded_schedule(ctx) < 0)
 		return -1;
 
+	if (test_schedule_cache(ctx) < 0)
+		return -1;
+
 	/* Check that check for progress is not confused by rational
 	 * solution.
 	 */
@@ -3228,6 +3597,294 @@ int test_vertices(isl_ctx *ctx)
 	return 0;
 }
 
+/* Bound the quasipolynomial described by "str".
+ */
+static __isl_give isl_pw_qpolynomial_fold *bound_str(isl_ctx *ctx,
+	const char *str)
+{
+	isl_pw_qpolynomial *pwqp;
+
+	pwqp = isl_pw_qpolynomial_read_from_str(ctx, str);
+	return isl_pw_qpolynomial_bound(pwqp, isl_fold_max, NULL);
+}
+
+/* Check that bounding several quasipolynomials over the same domain
+ * reuses the cached parametric vertices and that the result
+ * is the same as without the cache.
+ * The cache is allowed to hold only a single entry, so switching to
+ * a different domain evicts the first one.
+ */
+int test_vertices_cache(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"[n, m] -> { [i, j] -> i * j : 0 <= i <= n and 0 <= j <= m and "
+			"i + j <= n + 2 }",
+		"[n, m] -> { [i, j] -> i + 2 * j : 0 <= i <= n and "
+			"0 <= j <= m and i + j <= n + 2 }",
+		"[n, m] -> { [i, j] -> i * j : 0 <= i <= n and 0 <= j <= m and "
+			"i <= j + 3 }",
+		"[n, m] -> { [i, j] -> i - j : 0 <= i <= n and 0 <= j <= m and "
+			"i + j <= n + 2 }",
+	};
+	int i, size;
+	isl_pw_qpolynomial_fold *pwf[ARRAY_SIZE(str)];
+	const struct isl_stats *stats;
+	int equal = 1;
+
+	for (i = 0; i < ARRAY_SIZE(str); ++i)
+		pwf[i] = bound_str(ctx, str[i]);
+
+	size = isl_options_get_vertices_cache_size(ctx);
+	isl_options_set_vertices_cache_size(ctx, 1);
+	isl_ctx_reset_stats(ctx);
+	for (i = 0; equal == 1 && i < ARRAY_SIZE(str); ++i) {
+		isl_pw_qpolynomial_fold *pwf_i;
+
+		pwf_i = bound_str(ctx, str[i]);
+		equal = isl_pw_qpolynomial_fold_plain_is_equal(pwf[i], pwf_i);
+		isl_pw_qpolynomial_fold_free(pwf_i);
+	}
+	stats = isl_ctx_get_stats(ctx);
+	isl_ctx_clear_vertices_cache(ctx);
+	isl_options_set_vertices_cache_size(ctx, size);
+
+	for (i = 0; i < ARRAY_SIZE(str); ++i)
+		isl_pw_qpolynomial_fold_free(pwf[i]);
+
+	if (equal < 0)
+		return -1;
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"cached vertices produce different bound", return -1);
+	if (stats->vertices_n_cache_hit != 1 ||
+	    stats->vertices_n_cache_miss != 3)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected number of vertex cache hits", return -1);
+
+	return 0;
+}
+
+/* Check that the value of "pwqp" at [i] is "expected", for each i
+ * from "lo" up to and including "hi".
+ */
+static int check_pwqp_values(__isl_keep isl_pw_qpolynomial *pwqp,
+	int lo, int hi, int (*expected)(int i))
+{
+	int i;
+	isl_ctx *ctx = isl_pw_qpolynomial_get_ctx(pwqp);
+
+	for (i = lo; i <= hi; ++i) {
+		isl_point *pnt;
+		isl_val *v;
+		int ok;
+
+		pnt = isl_point_zero(isl_pw_qpolynomial_get_domain_space(pwqp));
+		pnt = isl_point_set_coordinate_val(pnt, isl_dim_set, 0,
+						    isl_val_int_from_si(ctx, i));
+		v = isl_pw_qpolynomial_eval(isl_pw_qpolynomial_copy(pwqp), pnt);
+		ok = v ? isl_val_cmp_si(v, expected(i)) == 0 : -1;
+		isl_val_free(v);
+		if (ok < 0)
+			return -1;
+		if (!ok)
+			isl_die(ctx, isl_error_unknown,
+				"unexpected value", return -1);
+	}
+
+	return 0;
+}
+
+static int count_piece(__isl_take isl_set *set,
+	__isl_take isl_qpolynomial *qp, void *user)
+{
+	int *n = user;
+
+	(*n)++;
+	isl_set_free(set);
+	isl_qpolynomial_free(qp);
+	return 0;
+}
+
+static int piece_index_sum(int i)
+{
+	if (i < 0 || i > 99)
+		return 0;
+	return (i < 50 ? i : 2 * i) + i / 10;
+}
+
+static int piece_index_prod(int i)
+{
+	if (i < 0 || i > 99)
+		return 0;
+	return (i < 50 ? i : 2 * i) * (i / 10);
+}
+
+static int piece_index_restricted(int i)
+{
+	if (i < 15 || i > 34)
+		return 0;
+	return i / 10;
+}
+
+static int piece_index_parity(int i)
+{
+	if (i < 0 || i > 99)
+		return 0;
+	return 1 + (i / 10) % 2;
+}
+
+/* Check operations on piecewise quasipolynomials with many pieces
+ * that use the piece index to skip pairs of disjoint pieces.
+ * The results are checked by evaluating them on all points
+ * in and around the domain.  Pieces with a domain that is disjoint
+ * from the set that is intersected with should be removed.
+ * Coalescing merges pieces in place and should not leave
+ * a stale piece index behind.
+ */
+static int test_piece_index(isl_ctx *ctx)
+{
+	const char *str;
+	isl_pw_qpolynomial *pwqp1, *pwqp2, *res;
+	isl_set *dom;
+	int r, n;
+
+	str = "{ [i] -> 0 : 0 <= i <= 9; [i] -> 1 : 10 <= i <= 19; "
+		"[i] -> 2 : 20 <= i <= 29; [i] -> 3 : 30 <= i <= 39; "
+		"[i] -> 4 : 40 <= i <= 49; [i] -> 5 : 50 <= i <= 59; "
+		"[i] -> 6 : 60 <= i <= 69; [i] -> 7 : 70 <= i <= 79; "
+		"[i] -> 8 : 80 <= i <= 89; [i] -> 9 : 90 <= i <= 99 }";
+	pwqp1 = isl_pw_qpolynomial_read_from_str(ctx, str);
+	str = "{ [i] -> i : 0 <= i <= 49; [i] -> 2i : 50 <= i <= 99 }";
+	pwqp2 = isl_pw_qpolynomial_read_from_str(ctx, str);
+
+	res = isl_pw_qpolynomial_add(isl_pw_qpolynomial_copy(pwqp1),
+					isl_pw_qpolynomial_copy(pwqp2));
+	r = res ? check_pwqp_values(res, -5, 105, &piece_index_sum) : -1;
+	isl_pw_qpolynomial_free(res);
+
+	if (r >= 0) {
+		res = isl_pw_qpolynomial_mul(isl_pw_qpolynomial_copy(pwqp1),
+					isl_pw_qpolynomial_copy(pwqp2));
+		r = res ? check_pwqp_values(res, -5, 105,
+					    &piece_index_prod) : -1;
+		isl_pw_qpolynomial_free(res);
+	}
+
+	if (r >= 0) {
+		dom = isl_set_read_from_str(ctx, "{ [i] : 15 <= i <= 34 }");
+		res = isl_pw_qpolynomial_intersect_domain(
+					isl_pw_qpolynomial_copy(pwqp1), dom);
+		r = res ? check_pwqp_values(res, -5, 105,
+					    &piece_index_restricted) : -1;
+		n = 0;
+		if (isl_pw_qpolynomial_foreach_piece(res,
+						&count_piece, &n) < 0)
+			r = -1;
+		isl_pw_qpolynomial_free(res);
+		if (r >= 0 && n != 3)
+			isl_die(ctx, isl_error_unknown,
+				"unexpected number of pieces", r = -1);
+	}
+
+	if (r >= 0) {
+		str = "{ [i] -> 1 : 0 <= i <= 9; [i] -> 2 : 10 <= i <= 19; "
+			"[i] -> 1 : 20 <= i <= 29; [i] -> 2 : 30 <= i <= 39; "
+			"[i] -> 1 : 40 <= i <= 49; [i] -> 2 : 50 <= i <= 59; "
+			"[i] -> 1 : 60 <= i <= 69; [i] -> 2 : 70 <= i <= 79; "
+			"[i] -> 1 : 80 <= i <= 89; [i] -> 2 : 90 <= i <= 99 }";
+		res = isl_pw_qpolynomial_read_from_str(ctx, str);
+		r = res ? check_pwqp_values(res, -5, 105,
+					    &piece_index_parity) : -1;
+		res = isl_pw_qpolynomial_coalesce(res);
+		if (r >= 0)
+			r = res ? check_pwqp_values(res, -5, 105,
+						&piece_index_parity) : -1;
+		isl_pw_qpolynomial_free(res);
+	}
+
+	isl_pw_qpolynomial_free(pwqp1);
+	isl_pw_qpolynomial_free(pwqp2);
+
+	return r;
+}
+
+/* Compute the sum of the pairwise products of the quasi-affine
+ * expressions in "str", each product being added "n" times.
+ */
+static __isl_give isl_qpolynomial *sum_of_products(isl_ctx *ctx,
+	const char **str, int n_str, int n)
+{
+	int i, j, k;
+	isl_qpolynomial *qp[4];
+	isl_qpolynomial *sum;
+
+	for (i = 0; i < n_str; ++i)
+		qp[i] = isl_qpolynomial_from_aff(
+					isl_aff_read_from_str(ctx, str[i]));
+	sum = isl_qpolynomial_zero_on_domain(
+				isl_qpolynomial_get_domain_space(qp[0]));
+	for (k = 0; k < n; ++k)
+		for (i = 0; i < n_str; ++i)
+			for (j = 0; j < n_str; ++j) {
+				isl_qpolynomial *prod;
+				prod = isl_qpolynomial_mul(
+						isl_qpolynomial_copy(qp[i]),
+						isl_qpolynomial_copy(qp[j]));
+				sum = isl_qpolynomial_add(sum, prod);
+			}
+	for (i = 0; i < n_str; ++i)
+		isl_qpolynomial_free(qp[i]);
+
+	return sum;
+}
+
+/* Check that combining quasipolynomials with the same integer divisions
+ * reuses the cached merges of the lists of integer divisions and
+ * that the result is the same as without the cache.
+ * After the first round, all merges should be found in the cache.
+ */
+static int test_qpolynomial_div_cache(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"{ [i, j] -> [(floor(i/3))] }",
+		"{ [i, j] -> [(floor(j/5))] }",
+		"{ [i, j] -> [(floor((i + j)/7))] }",
+		"{ [i, j] -> [(floor((2i + j)/11))] }",
+	};
+	int size, equal;
+	long hit, miss;
+	isl_qpolynomial *qp1, *qp2;
+
+	qp1 = sum_of_products(ctx, str, ARRAY_SIZE(str), 3);
+
+	size = isl_options_get_qpolynomial_div_cache_size(ctx);
+	isl_options_set_qpolynomial_div_cache_size(ctx, 64);
+	isl_ctx_reset_stats(ctx);
+	qp2 = sum_of_products(ctx, str, ARRAY_SIZE(str), 1);
+	qp2 = isl_qpolynomial_free(qp2);
+	isl_ctx_reset_stats(ctx);
+	qp2 = sum_of_products(ctx, str, ARRAY_SIZE(str), 3);
+	hit = isl_ctx_get_stats(ctx)->qpolynomial_n_div_merge_hit;
+	miss = isl_ctx_get_stats(ctx)->qpolynomial_n_div_merge_miss;
+	isl_ctx_clear_qpolynomial_div_cache(ctx);
+	isl_options_set_qpolynomial_div_cache_size(ctx, size);
+
+	equal = isl_qpolynomial_plain_is_equal(qp1, qp2);
+	isl_qpolynomial_free(qp1);
+	isl_qpolynomial_free(qp2);
+
+	if (equal < 0)
+		return -1;
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"cached divs produce different result", return -1);
+	if (hit == 0 || miss != 0)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected number of div merge cache hits", return -1);
+
+	return 0;
+}
+
 int test_union_pw(isl_ctx *ctx)
 {
 	int equal;
@@ -3282,6 +3939,42 @@ int test_output(isl_ctx *ctx)
 	return 0;
 }
 
+/* Check that isl_point_set_coordinate_val sets the coordinate
+ * that isl_point_get_coordinate_val subsequently reads back,
+ * in particular in the presence of parameters.
+ */
+static int test_point(isl_ctx *ctx)
+{
+	isl_set *set;
+	isl_point *pnt;
+	isl_val *v;
+	int ok;
+
+	set = isl_set_read_from_str(ctx, "[n] -> { [i, j] : n = 5 and "
+						"i = 1 and j = 2 }");
+	pnt = isl_set_sample_point(set);
+	pnt = isl_point_set_coordinate_val(pnt, isl_dim_param, 0,
+					    isl_val_int_from_si(ctx, 7));
+	pnt = isl_point_set_coordinate_val(pnt, isl_dim_set, 0,
+					    isl_val_int_from_si(ctx, 3));
+	v = isl_point_get_coordinate_val(pnt, isl_dim_param, 0);
+	ok = isl_val_cmp_si(v, 7) == 0;
+	isl_val_free(v);
+	v = isl_point_get_coordinate_val(pnt, isl_dim_set, 0);
+	ok = ok && isl_val_cmp_si(v, 3) == 0;
+	isl_val_free(v);
+	v = isl_point_get_coordinate_val(pnt, isl_dim_set, 1);
+	ok = ok && isl_val_cmp_si(v, 2) == 0;
+	isl_val_free(v);
+	isl_point_free(pnt);
+
+	if (!ok)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected point coordinates", return -1);
+
+	return 0;
+}
+
 int test_sample(isl_ctx *ctx)
 {
 	const char *str;
@@ -3330,12 +4023,683 @@ int test_sample(isl_ctx *ctx)
 	return 0;
 }
 
-int test_fixed_power(isl_ctx *ctx)
+/* Internal data structure for test_foreach_point_batch.
+ *
+ * "coord" collects the coordinates of the points produced
+ * by isl_set_foreach_point.
+ * "n" is the number of points collected or checked so far.
+ */
+struct foreach_point_batch_data {
+	isl_ctx *ctx;
+	int n_coord;
+	int n;
+	long coord[3 * 256];
+};
+
+/* Append the coordinates (parameters first) of "pnt" to data->coord.
+ */
+static int collect_point(__isl_take isl_point *pnt, void *user)
 {
-	const char *str;
-	isl_map *map;
-	isl_int exp;
-	int equal;
+	struct foreach_point_batch_data *data = user;
+	enum isl_dim_type type[] = { isl_dim_param, isl_dim_set };
+	isl_space *space;
+	isl_val *v;
+	int i, j, n, k = 0;
+
+	if (data->n >= 256)
+		isl_die(data->ctx, isl_error_unknown, "too many points",
+			goto error);
+	space = isl_point_get_space(pnt);
+	for (i = 0; i < 2; ++i) {
+		n = isl_space_dim(space, type[i]);
+		for (j = 0; j < n; ++j) {
+			v = isl_point_get_coordinate_val(pnt, type[i], j);
+			data->coord[data->n * data->n_coord + k++] =
+				isl_val_get_num_si(v);
+			isl_val_free(v);
+		}
+	}
+	isl_space_free(space);
+	data->n++;
+	isl_point_free(pnt);
+	return 0;
+error:
+	isl_point_free(pnt);
+	return -1;
+}
+
+/* Check that the "n" rows in "coord" are equal to the next "n"
+ * points collected by collect_point.
+ */
+static int check_batch(int n, int n_coord, const int64_t *coord, void *user)
+{
+	struct foreach_point_batch_data *data = user;
+	int i;
+
+	if (n_coord != data->n_coord)
+		isl_die(data->ctx, isl_error_unknown,
+			"unexpected number of coordinates", return -1);
+	for (i = 0; i < n * n_coord; ++i)
+		if (coord[i] != data->coord[data->n * n_coord + i])
+			isl_die(data->ctx, isl_error_unknown,
+				"unexpected point", return -1);
+	data->n += n;
+	return 0;
+}
+
+/* Check that isl_set_foreach_point_batch produces the same points
+ * in the same order as isl_set_foreach_point, for several batch sizes.
+ */
+int test_foreach_point_batch(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"{ [i, j] : 0 <= i < 10 and 0 <= j <= i }",
+		"[n] -> { [i, j] : n = 7 and 0 <= i <= n and "
+			"i <= 3j <= 2i + 5 }",
+		"{ [i, j] : 0 <= i, j < 6 and (i = 2 or j = 5 or j < 2) }",
+		"{ [i] : exists a : i = 3a and -20 <= i <= 20 }",
+	};
+	int batch[] = { 1, 3, 64 };
+	struct foreach_point_batch_data data;
+	int i, j, n, r;
+	isl_set *set;
+
+	data.ctx = ctx;
+	for (i = 0; i < ARRAY_SIZE(str); ++i) {
+		set = isl_set_read_from_str(ctx, str[i]);
+		data.n_coord = isl_set_dim(set, isl_dim_param) +
+				isl_set_dim(set, isl_dim_set);
+		data.n = 0;
+		r = isl_set_foreach_point(set, &collect_point, &data);
+		n = data.n;
+		for (j = 0; r >= 0 && j < ARRAY_SIZE(batch); ++j) {
+			data.n = 0;
+			r = isl_set_foreach_point_batch(set, batch[j],
+					&check_batch, NULL, &data);
+			if (r >= 0 && data.n != n)
+				isl_die(ctx, isl_error_unknown,
+					"unexpected number of points", r = -1);
+		}
+		isl_set_free(set);
+		if (r < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+struct {
+	const char *set;
+	const char *count;
+} count_tests[] = {
+	{ "{ [i, j, k] : 0 <= i, j, k < 1000000 }", "1000000000000000000" },
+	{ "{ [i, j, k] : 0 <= i < 10 and 0 <= j <= i and -3 <= k <= 3 }",
+	  "385" },
+	{ "{ [i, j, k] : 0 <= i < 10 and 0 <= j < 7 and 2k = i + j }", "35" },
+	{ "[n] -> { [i, j] : 0 <= n <= 5 and 0 <= i < n and 0 <= j < 2n }",
+	  "110" },
+	{ "{ [i, j] : exists a : i = 3a and 0 <= i < 30 and 0 <= j < 4 }",
+	  "40" },
+	{ "{ [i, j, k] : 3i + 5j = 7 and 0 <= i < 20 and -20 <= j < 20 and "
+		"0 <= k < 3 }", "12" },
+	{ "{ [i, j] : 2i = 1 and 0 <= j < 4 }", "0" },
+	{ "{ [i, j] : 0 <= i < 10 and 0 <= j < 7; "
+		"[i, j] : 5 <= i < 15 and 3 <= j < 9 }", "110" },
+};
+
+/* Check that isl_set_count_val produces the expected results,
+ * including on sets that are too large to be enumerated,
+ * and that isl_set_count_upto stops at the given maximum.
+ */
+int test_count(isl_ctx *ctx)
+{
+	int i;
+	isl_set *set;
+	isl_val *count, *expected;
+	isl_int max, n;
+	int equal;
+
+	for (i = 0; i < ARRAY_SIZE(count_tests); ++i) {
+		set = isl_set_read_from_str(ctx, count_tests[i].set);
+		count = isl_set_count_val(set);
+		isl_set_free(set);
+		expected = isl_val_read_from_str(ctx, count_tests[i].count);
+		equal = isl_val_eq(count, expected);
+		isl_val_free(count);
+		isl_val_free(expected);
+		if (equal < 0)
+			return -1;
+		if (!equal)
+			isl_die(ctx, isl_error_unknown, "unexpected count",
+				return -1);
+	}
+
+	isl_int_init(max);
+	isl_int_init(n);
+	isl_int_set_si(max, 50);
+	set = isl_set_read_from_str(ctx,
+		"{ [i, j, k] : 0 <= i < 10 and 0 <= j <= i and -3 <= k <= 3 }");
+	if (isl_set_count_upto(set, max, &n) < 0)
+		equal = -1;
+	else
+		equal = isl_int_eq(n, max);
+	isl_set_free(set);
+	isl_int_clear(max);
+	isl_int_clear(n);
+	if (equal < 0)
+		return -1;
+	if (!equal)
+		isl_die(ctx, isl_error_unknown, "unexpected count", return -1);
+
+	return 0;
+}
+
+/* Internal data structure for test_parallel_scan.
+ * "n" and "sum" are the number of points and the sum of
+ * their coordinates found by isl_set_foreach_point_batch_parallel.
+ */
+struct parallel_scan_data {
+	long n;
+	long sum;
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_t lock;
+#endif
+};
+
+/* Add the "n" points in "coord" to the totals in "user".
+ */
+static int add_batch(int n, int n_coord, const int64_t *coord, void *user)
+{
+	struct parallel_scan_data *data = user;
+	long sum = 0;
+	int i;
+
+	for (i = 0; i < n * n_coord; ++i)
+		sum += coord[i];
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_lock(&data->lock);
+#endif
+	data->n += n;
+	data->sum += sum;
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_unlock(&data->lock);
+#endif
+	return 0;
+}
+
+/* Check that counting and enumerating the points of a set
+ * using several threads produces the same results
+ * as doing so using a single thread.
+ * Also check that unbounded sets are rejected when using several threads.
+ */
+int test_parallel_scan(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"[n] -> { [i, j] : n = 100 and 0 <= i < n and 0 <= j <= i }",
+		"{ [i, j, k] : 0 <= i, j, k < 20 and i + j + k <= 30 and "
+			"(i = 3 or j >= 2k) }",
+		"{ [i, j] : exists a : i = 3a and -200 <= i <= 200 and "
+			"0 <= j < 3 }",
+		"{ [i] : 0 <= i < 3 }",
+		"{ [i] : 0 <= i < 0 }",
+	};
+	struct parallel_scan_data data;
+	int i, n_thread;
+	isl_val *count1, *count2;
+	isl_set *set;
+	int equal, on_error, r = 0;
+
+	n_thread = isl_options_get_n_thread(ctx);
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_init(&data.lock, NULL);
+#endif
+	for (i = 0; r == 0 && i < ARRAY_SIZE(str); ++i) {
+		long n, sum;
+
+		set = isl_set_read_from_str(ctx, str[i]);
+		isl_options_set_n_thread(ctx, 1);
+		count1 = isl_set_count_val(set);
+		data.n = data.sum = 0;
+		if (isl_set_foreach_point_batch(set, 16, &add_batch, NULL,
+						&data) < 0)
+			r = -1;
+		n = data.n;
+		sum = data.sum;
+		isl_options_set_n_thread(ctx, 4);
+		count2 = isl_set_count_val(set);
+		data.n = data.sum = 0;
+		if (isl_set_foreach_point_batch_parallel(set, 16, &add_batch,
+						&data) < 0)
+			r = -1;
+		equal = isl_val_eq(count1, count2);
+		if (r == 0 && equal < 0)
+			r = -1;
+		if (r == 0 && (!equal || data.n != n || data.sum != sum ||
+		    isl_val_get_num_si(count1) != n))
+			isl_die(ctx, isl_error_unknown,
+				"parallel scan produces different result",
+				r = -1);
+		isl_val_free(count1);
+		isl_val_free(count2);
+		isl_set_free(set);
+	}
+	if (r == 0) {
+		set = isl_set_read_from_str(ctx,
+			"{ [i, j] : i >= 0 and j >= 0 and i + j >= 3 }");
+		isl_options_set_n_thread(ctx, 4);
+		on_error = isl_options_get_on_error(ctx);
+		isl_options_set_on_error(ctx, ISL_ON_ERROR_CONTINUE);
+		count2 = isl_set_count_val(set);
+		if (isl_set_foreach_point_batch_parallel(set, 16, &add_batch,
+							&data) >= 0 || count2)
+			r = -1;
+		isl_options_set_on_error(ctx, on_error);
+		isl_val_free(count2);
+		isl_set_free(set);
+		if (r < 0)
+			isl_die(ctx, isl_error_unknown,
+				"unbounded set not rejected", r = -1);
+	}
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_destroy(&data.lock);
+#endif
+	isl_options_set_n_thread(ctx, n_thread);
+
+	return r;
+}
+
+/* Check that computing a Bernstein bound using several threads
+ * produces the same result as computing it using a single thread
+ * and that every chamber is accounted for in the statistics.
+ */
+int test_parallel_bernstein(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"[a, b, c] -> { [i, j] -> i * j : 0 <= i <= a and i <= b and "
+			"0 <= j <= c and j <= i + b }",
+		"[n, m] -> { [i, j] -> i * i - j : 0 <= i <= n and "
+			"0 <= j <= m and i + j <= n + m - 2 }",
+		"[n] -> { [i] -> i : 0 <= i <= n }",
+	};
+	int i, n_thread;
+	int equal, r = 0;
+
+	n_thread = isl_options_get_n_thread(ctx);
+	for (i = 0; r == 0 && i < ARRAY_SIZE(str); ++i) {
+		isl_pw_qpolynomial *pwqp;
+		isl_pw_qpolynomial_fold *pwf1, *pwf2;
+		const struct isl_stats *stats;
+		long n_chamber;
+
+		pwqp = isl_pw_qpolynomial_read_from_str(ctx, str[i]);
+		isl_options_set_n_thread(ctx, 1);
+		isl_ctx_reset_stats(ctx);
+		pwf1 = isl_pw_qpolynomial_bound(isl_pw_qpolynomial_copy(pwqp),
+						isl_fold_max, NULL);
+		n_chamber = isl_ctx_get_stats(ctx)->bernstein_n_chamber;
+		isl_options_set_n_thread(ctx, 4);
+		isl_ctx_reset_stats(ctx);
+		pwf2 = isl_pw_qpolynomial_bound(pwqp, isl_fold_max, NULL);
+		stats = isl_ctx_get_stats(ctx);
+		equal = isl_pw_qpolynomial_fold_plain_is_equal(pwf1, pwf2);
+		if (equal < 0)
+			r = -1;
+		if (r == 0 && (!equal || n_chamber < 1 ||
+		    stats->bernstein_n_chamber != n_chamber ||
+		    stats->bernstein_chamber_time <
+					stats->bernstein_chamber_time_max))
+			isl_die(ctx, isl_error_unknown,
+				"parallel Bernstein produces different result",
+				r = -1);
+		isl_pw_qpolynomial_fold_free(pwf1);
+		isl_pw_qpolynomial_fold_free(pwf2);
+	}
+	isl_options_set_n_thread(ctx, n_thread);
+
+	return r;
+}
+
+/* Compute the dataflow for the given sink, must-source and
+ * may-source accesses and schedule, using "n_thread" threads.
+ * "res" collects the must-dependences, may-dependences,
+ * must-no-source and may-no-source relations.
+ */
+static int compute_flow_n_thread(isl_ctx *ctx, const char *sink,
+	const char *must_source, const char *may_source, const char *schedule,
+	int n_thread, isl_union_map *res[4])
+{
+	isl_options_set_n_thread(ctx, n_thread);
+	return isl_union_map_compute_flow(
+			isl_union_map_read_from_str(ctx, sink),
+			isl_union_map_read_from_str(ctx, must_source),
+			isl_union_map_read_from_str(ctx, may_source),
+			isl_union_map_read_from_str(ctx, schedule),
+			&res[0], &res[1], &res[2], &res[3]);
+}
+
+/* Check that performing dataflow analysis on several sinks
+ * using several threads produces the same result as
+ * performing the analysis using a single thread,
+ * for the current options of "ctx".
+ */
+static int test_parallel_flow_options(isl_ctx *ctx)
+{
+	const char *sink = "[n] -> { S1[i] -> A[i - 1] : 1 <= i < n; "
+		"S2[i] -> A[i] : 0 <= i < n; S2[i] -> B[i] : 0 <= i < n; "
+		"S3[i, j] -> B[j] : 0 <= i, j < n; S3[i, j] -> C[i, j] : "
+		"0 <= i, j < n; S4[i] -> A[i + 1] : 0 <= i < n - 1 }";
+	const char *must_source = "[n] -> { S1[i] -> A[i] : 0 <= i < n; "
+		"S2[i] -> B[i] : 0 <= i < n; S4[i] -> A[i] : 0 <= i < n }";
+	const char *may_source = "[n] -> { S3[i, j] -> C[i, j] : "
+		"0 <= i, j < n and j <= i; S3[i, j] -> B[i] : 0 <= i, j < n }";
+	const char *schedule = "{ S1[i] -> [0, i, 0, 0]; S2[i] -> [0, i, 1, 0]; "
+		"S3[i, j] -> [1, i, j, 0]; S4[i] -> [2, i, 0, 0] }";
+	isl_union_map *res1[4] = { NULL }, *res2[4] = { NULL };
+	int i, n_thread, r = 0;
+
+	n_thread = isl_options_get_n_thread(ctx);
+	if (compute_flow_n_thread(ctx, sink, must_source, may_source,
+				    schedule, 1, res1) < 0 ||
+	    compute_flow_n_thread(ctx, sink, must_source, may_source,
+				    schedule, 4, res2) < 0)
+		r = -1;
+	isl_options_set_n_thread(ctx, n_thread);
+
+	for (i = 0; r == 0 && i < 4; ++i) {
+		int equal = isl_union_map_is_equal(res1[i], res2[i]);
+		if (equal < 0)
+			r = -1;
+		else if (!equal)
+			isl_die(ctx, isl_error_unknown,
+				"parallel dataflow produces different result",
+				r = -1);
+	}
+	for (i = 0; i < 4; ++i) {
+		isl_union_map_free(res1[i]);
+		isl_union_map_free(res2[i]);
+	}
+
+	return r;
+}
+
+/* Check that parallel dataflow analysis produces the same result
+ * as sequential dataflow analysis, both for the default options and
+ * for non-default choices of the context, the use of generalized
+ * basis reduction and the convex hull algorithm, which should
+ * also be used by the worker threads.
+ */
+int test_parallel_flow(isl_ctx *ctx)
+{
+	int context = ctx->opt->context;
+	int gbr = ctx->opt->gbr;
+	int convex = ctx->opt->convex;
+	int r;
+
+	r = test_parallel_flow_options(ctx);
+	if (r == 0) {
+		ctx->opt->context = ISL_CONTEXT_LEXMIN;
+		r = test_parallel_flow_options(ctx);
+		ctx->opt->context = context;
+	}
+	if (r == 0) {
+		ctx->opt->gbr = ISL_GBR_NEVER;
+		r = test_parallel_flow_options(ctx);
+		ctx->opt->gbr = gbr;
+	}
+	if (r == 0) {
+		ctx->opt->convex = ISL_CONVEX_HULL_FM;
+		r = test_parallel_flow_options(ctx);
+		ctx->opt->convex = convex;
+	}
+
+	return r;
+}
+
+/* Check that computing the transitive closure of a relation
+ * with several strongly connected components using several threads
+ * produces the same result as computing it using a single thread.
+ */
+int test_parallel_closure(isl_ctx *ctx)
+{
+	const char *str[] = {
+		"[N] -> { S0[i] -> S1[i] : 0 <= i < N; S1[i] -> S2[i] : "
+			"0 <= i < N; S2[i] -> S3[i] : 0 <= i < N; "
+			"S3[i] -> S4[i] : 0 <= i < N; S4[i] -> S0[i + 1] : "
+			"0 <= i < N; S1[i] -> S3[i + 1] : 0 <= i < N }",
+		"{ [0, i] -> [1, i] : 0 <= i <= 10; [1, i] -> [2, i] : "
+			"0 <= i <= 10; [2, i] -> [0, i + 1] : 0 <= i <= 10; "
+			"[1, i] -> [0, i + 2] : 0 <= i <= 10 }",
+	};
+	int i, n_thread;
+	int equal, r = 0;
+
+	n_thread = isl_options_get_n_thread(ctx);
+	for (i = 0; r == 0 && i < ARRAY_SIZE(str); ++i) {
+		isl_union_map *umap, *tc1, *tc2;
+		int exact1, exact2;
+
+		umap = isl_union_map_read_from_str(ctx, str[i]);
+		isl_options_set_n_thread(ctx, 1);
+		tc1 = isl_union_map_transitive_closure(isl_union_map_copy(umap),
+							&exact1);
+		isl_options_set_n_thread(ctx, 4);
+		tc2 = isl_union_map_transitive_closure(umap, &exact2);
+		equal = isl_union_map_is_equal(tc1, tc2);
+		if (equal < 0)
+			r = -1;
+		if (r == 0 && (!equal || exact1 != exact2))
+			isl_die(ctx, isl_error_unknown,
+				"parallel transitive closure produces "
+				"different result", r = -1);
+		isl_union_map_free(tc1);
+		isl_union_map_free(tc2);
+	}
+	isl_options_set_n_thread(ctx, n_thread);
+
+	return r;
+}
+
+/* Update "flow" to the given accesses and schedule and check that
+ * the result is the same as that of isl_union_map_compute_flow and
+ * that the dataflow has been recomputed for "n_computed" arrays
+ * and reused for "n_reused" arrays.
+ */
+static __isl_give isl_incremental_flow *check_incremental_flow(
+	__isl_take isl_incremental_flow *flow, const char *sink,
+	const char *must_source, const char *may_source, const char *schedule,
+	int n_computed, int n_reused)
+{
+	isl_ctx *ctx = isl_incremental_flow_get_ctx(flow);
+	isl_union_map *res1[4] = { NULL }, *res2[4];
+	const struct isl_stats *stats;
+	int i, r = 0;
+
+	if (!flow)
+		return NULL;
+
+	isl_ctx_reset_stats(ctx);
+	flow = isl_incremental_flow_compute(flow,
+			isl_union_map_read_from_str(ctx, sink),
+			isl_union_map_read_from_str(ctx, must_source),
+			isl_union_map_read_from_str(ctx, may_source),
+			isl_union_map_read_from_str(ctx, schedule));
+	stats = isl_ctx_get_stats(ctx);
+	if (!flow || compute_flow_n_thread(ctx, sink, must_source, may_source,
+				    schedule, 1, res1) < 0)
+		r = -1;
+	res2[0] = isl_incremental_flow_get_must_dependence(flow);
+	res2[1] = isl_incremental_flow_get_may_dependence(flow);
+	res2[2] = isl_incremental_flow_get_must_no_source(flow);
+	res2[3] = isl_incremental_flow_get_may_no_source(flow);
+
+	for (i = 0; r == 0 && i < 4; ++i) {
+		int equal = isl_union_map_is_equal(res1[i], res2[i]);
+		if (equal < 0)
+			r = -1;
+		else if (!equal)
+			isl_die(ctx, isl_error_unknown,
+				"incremental dataflow produces different result",
+				r = -1);
+	}
+	if (r == 0 && (stats->flow_n_array_computed != n_computed ||
+			stats->flow_n_array_reused != n_reused))
+		isl_die(ctx, isl_error_unknown,
+			"unexpected number of recomputed arrays", r = -1);
+	for (i = 0; i < 4; ++i) {
+		isl_union_map_free(res1[i]);
+		isl_union_map_free(res2[i]);
+	}
+
+	if (r < 0)
+		return isl_incremental_flow_free(flow);
+	return flow;
+}
+
+/* Check that isl_incremental_flow_compute produces the same results
+ * as isl_union_map_compute_flow and that it only recomputes
+ * the dataflow for arrays that are affected by a change.
+ */
+int test_incremental_flow(isl_ctx *ctx)
+{
+	const char *sink = "[n] -> { S1[i] -> A[i - 1] : 1 <= i < n; "
+		"S2[i] -> B[i] : 0 <= i < n; S3[i, j] -> B[j] : 0 <= i, j < n; "
+		"S3[i, j] -> C[i, j] : 0 <= i, j < n; "
+		"S4[i] -> A[i + 1] : 0 <= i < n - 1 }";
+	const char *must_source = "[n] -> { S1[i] -> A[i] : 0 <= i < n; "
+		"S2[i] -> B[i] : 0 <= i < n; S4[i] -> A[i] : 0 <= i < n }";
+	const char *must_source2 = "[n] -> { S1[i] -> A[i] : 0 <= i < n; "
+		"S2[i] -> B[i] : 0 <= i < n; S4[i] -> A[i] : 0 <= i < n - 1 }";
+	const char *may_source = "[n] -> { S3[i, j] -> C[i, j] : "
+		"0 <= i, j < n and j <= i }";
+	const char *schedule = "{ S1[i] -> [0, i, 0]; S2[i] -> [0, i, 1]; "
+		"S3[i, j] -> [1, i, j]; S4[i] -> [2, i, 0] }";
+	const char *schedule2 = "{ S1[i] -> [0, i, 0]; S2[i] -> [0, i, 1]; "
+		"S3[i, j] -> [1, i, j]; S4[i] -> [-1, i, 0] }";
+	const char *schedule3 = "{ S1[i] -> [0, i, 0]; S2[i] -> [0, i, 1]; "
+		"S3[i, j] -> [1, j, i]; S4[i] -> [-1, i, 0] }";
+	isl_incremental_flow *flow;
+	int r;
+
+	flow = isl_incremental_flow_alloc(ctx);
+	flow = check_incremental_flow(flow, sink, must_source, may_source,
+					schedule, 3, 0);
+	flow = check_incremental_flow(flow, sink, must_source, may_source,
+					schedule, 0, 3);
+	flow = check_incremental_flow(flow, sink, must_source, may_source,
+					schedule2, 1, 2);
+	flow = check_incremental_flow(flow, sink, must_source2, may_source,
+					schedule2, 1, 2);
+	flow = check_incremental_flow(flow, sink, must_source2, may_source,
+					schedule3, 2, 1);
+	r = flow ? 0 : -1;
+	isl_incremental_flow_free(flow);
+
+	return r;
+}
+
+struct {
+	const char *schedule;
+	int legal;
+	const char *dep;
+} legality_tests[] = {
+	{ "{ S[i] -> [0, i]; T[i] -> [1, i]; U[i] -> [2, i] }", 1 },
+	{ "{ S[i] -> [i, 0]; T[i] -> [i, 1]; U[i] -> [-1, i] }", 1 },
+	{ "{ S[i] -> [i, 1]; T[i] -> [i, 0]; U[i] -> [-1, i] }", 1 },
+	{ "{ S[i] -> [1, i]; T[i] -> [0, i]; U[i] -> [2, i] }", 0,
+	  "[n] -> { S[i] -> T[i + 1] }" },
+	{ "{ S[i] -> [0, i]; T[i] -> [1, i]; U[i] -> [2, -i] }", 0,
+	  "[n] -> { U[i] -> U[j] : j > i }" },
+	{ "{ S[i] -> [0, i]; T[i] -> [1, i]; U[i] -> [2] }", 0,
+	  "[n] -> { U[i] -> U[j] : j > i }" },
+};
+
+/* Check that isl_union_map_schedule_is_legal correctly determines
+ * whether the schedules in legality_tests respect the memory-based
+ * dependences of the original schedule and that any witness
+ * is a single violated dependence.
+ * Also check that a schedule that does not cover all accessing
+ * statement instances is rejected.
+ */
+int test_schedule_legality(isl_ctx *ctx)
+{
+	const char *reads_str = "[n] -> { T[i] -> A[i - 1] : 1 <= i < n; "
+		"U[i] -> B[0] : 0 <= i < n }";
+	const char *writes_str = "[n] -> { S[i] -> A[i] : 0 <= i < n; "
+		"U[i] -> B[0] : 0 <= i < n }";
+	const char *old_str = "{ S[i] -> [0, i]; T[i] -> [1, i]; "
+		"U[i] -> [2, i] }";
+	isl_union_map *reads, *writes, *old_schedule;
+	int i, r = 0;
+
+	reads = isl_union_map_read_from_str(ctx, reads_str);
+	writes = isl_union_map_read_from_str(ctx, writes_str);
+	old_schedule = isl_union_map_read_from_str(ctx, old_str);
+
+	for (i = 0; r == 0 && i < ARRAY_SIZE(legality_tests); ++i) {
+		isl_union_map *new_schedule;
+		isl_map *witness, *dep;
+		int legal, subset;
+
+		new_schedule = isl_union_map_read_from_str(ctx,
+						legality_tests[i].schedule);
+		legal = isl_union_map_schedule_is_legal(reads, writes,
+					old_schedule, new_schedule, &witness);
+		isl_union_map_free(new_schedule);
+		if (legal < 0) {
+			r = -1;
+			break;
+		}
+		if (legal != legality_tests[i].legal)
+			isl_die(ctx, isl_error_unknown,
+				"unexpected legality", r = -1);
+		if (r == 0 && legal && witness)
+			isl_die(ctx, isl_error_unknown,
+				"unexpected witness", r = -1);
+		if (r == 0 && !legal) {
+			dep = isl_map_read_from_str(ctx, legality_tests[i].dep);
+			subset = isl_map_is_subset(witness, dep);
+			if (subset < 0)
+				r = -1;
+			else if (!subset || isl_map_plain_is_empty(witness))
+				isl_die(ctx, isl_error_unknown,
+					"invalid witness", r = -1);
+			isl_map_free(dep);
+		}
+		isl_map_free(witness);
+	}
+
+	if (r == 0) {
+		isl_union_map *new_schedule;
+		isl_map *witness;
+		int legal, on_error;
+
+		new_schedule = isl_union_map_read_from_str(ctx,
+					"{ S[i] -> [0, i]; T[i] -> [1, i] }");
+		on_error = isl_options_get_on_error(ctx);
+		isl_options_set_on_error(ctx, ISL_ON_ERROR_CONTINUE);
+		legal = isl_union_map_schedule_is_legal(reads, writes,
+					old_schedule, new_schedule, &witness);
+		isl_options_set_on_error(ctx, on_error);
+		isl_union_map_free(new_schedule);
+		if (legal >= 0 || witness)
+			isl_die(ctx, isl_error_unknown,
+				"incomplete schedule not rejected", r = -1);
+		isl_map_free(witness);
+	}
+
+	isl_union_map_free(reads);
+	isl_union_map_free(writes);
+	isl_union_map_free(old_schedule);
+
+	return r;
+}
+
+int test_fixed_power(isl_ctx *ctx)
+{
+	const char *str;
+	isl_map *map;
+	isl_int exp;
+	int equal;
 
 	isl_int_init(exp);
 	str = "{ [i] -> [i + 1] }";
@@ -4202,6 +5566,605 @@ static int test_ast_gen5(isl_ctx *ctx)
 	return 0;
 }
 
+/* Increment the number of outermost nodes pointed to by "user"
+ * and check that "node" is a for node.
+ */
+static int count_outer_for(__isl_take isl_ast_node *node, void *user)
+{
+	int *n = user;
+	isl_ctx *ctx = isl_ast_node_get_ctx(node);
+	int type;
+
+	type = isl_ast_node_get_type(node);
+	isl_ast_node_free(node);
+	if (type != isl_ast_node_for)
+		isl_die(ctx, isl_error_unknown,
+			"expecting for node", return -1);
+	++*n;
+
+	return 0;
+}
+
+/* Check that isl_ast_build_foreach_ast_from_schedule passes
+ * the two outermost loops of a schedule with two independent
+ * components to the callback separately.
+ */
+static int test_ast_gen6(isl_ctx *ctx)
+{
+	const char *str;
+	isl_set *set;
+	isl_union_map *schedule;
+	isl_ast_build *build;
+	int n = 0;
+	int r;
+
+	str = "[N] -> { A[i] -> [0, i] : 0 <= i < N; B[i] -> [1, i] : 0 <= i < N }";
+	schedule = isl_union_map_read_from_str(ctx, str);
+	set = isl_set_universe(isl_space_params_alloc(ctx, 0));
+	build = isl_ast_build_from_context(set);
+	r = isl_ast_build_foreach_ast_from_schedule(build, schedule,
+						&count_outer_for, &n);
+	isl_ast_build_free(build);
+	if (r < 0)
+		return -1;
+	if (n != 2)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected number of outermost nodes", return -1);
+
+	return 0;
+}
+
+/* Print the AST generated for "schedule" with unroll options "options"
+ * to a string, with the ast_build_lazy_unroll option set to "lazy".
+ * If "lazy" is set, then check that the body of the outer loop
+ * is an unrolled for node.
+ */
+static char *print_unrolled(isl_ctx *ctx, const char *schedule,
+	const char *options, int lazy)
+{
+	isl_union_map *umap;
+	isl_ast_build *build;
+	isl_ast_node *tree, *body;
+	isl_printer *p;
+	char *s;
+	int unrolled;
+
+	isl_options_set_ast_build_lazy_unroll(ctx, lazy);
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx, "{:}"));
+	umap = isl_union_map_read_from_str(ctx, options);
+	build = isl_ast_build_set_options(build, umap);
+	umap = isl_union_map_read_from_str(ctx, schedule);
+	tree = isl_ast_build_ast_from_schedule(build, umap);
+	isl_ast_build_free(build);
+	isl_options_set_ast_build_lazy_unroll(ctx, 0);
+	if (!tree)
+		return NULL;
+
+	if (lazy) {
+		body = isl_ast_node_for_get_body(tree);
+		unrolled = isl_ast_node_get_type(body) == isl_ast_node_for &&
+			    isl_ast_node_for_is_unrolled(body) == 1 &&
+			    isl_ast_node_for_get_n_unrolled(body) == 4;
+		isl_ast_node_free(body);
+		if (!unrolled) {
+			isl_ast_node_free(tree);
+			isl_die(ctx, isl_error_unknown,
+				"expecting unrolled for node", return NULL);
+		}
+	}
+
+	p = isl_printer_to_str(ctx);
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, tree);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_ast_node_free(tree);
+
+	return s;
+}
+
+/* Check that lazy unrolling produces the same output as
+ * ordinary unrolling when printed in C format.
+ */
+static int test_ast_gen7(isl_ctx *ctx)
+{
+	const char *schedule, *options;
+	char *s1, *s2;
+	int equal;
+
+	schedule = "{ S[i, j] -> [i, 2j + 1] : 0 <= i < 10 and 0 <= j < 4 }";
+	options = "{ [i, j] -> unroll[1] }";
+	s1 = print_unrolled(ctx, schedule, options, 0);
+	s2 = print_unrolled(ctx, schedule, options, 1);
+	equal = s1 && s2 && !strcmp(s1, s2);
+	free(s1);
+	free(s2);
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"lazy unrolling produces different result", return -1);
+
+	return 0;
+}
+
+/* Print the AST generated for "schedule" to a string,
+ * with the ast_build_arena option set to "arena".
+ * If "keep" is set, then a reference to the body of the outer loop
+ * is kept while the AST is freed by isl_ast_node_free_tree.
+ */
+static char *print_arena(isl_ctx *ctx, const char *schedule, int arena,
+	int keep)
+{
+	isl_union_map *umap;
+	isl_ast_build *build;
+	isl_ast_node *tree, *body = NULL;
+	isl_printer *p;
+	char *s;
+
+	isl_options_set_ast_build_arena(ctx, arena);
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx, "{:}"));
+	umap = isl_union_map_read_from_str(ctx, schedule);
+	tree = isl_ast_build_ast_from_schedule(build, umap);
+	isl_ast_build_free(build);
+	isl_options_set_ast_build_arena(ctx, 0);
+	if (!tree)
+		return NULL;
+
+	if (keep)
+		body = isl_ast_node_for_get_body(tree);
+	p = isl_printer_to_str(ctx);
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, tree);
+	isl_ast_node_free_tree(tree);
+	if (keep)
+		p = isl_printer_print_ast_node(p, body);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_ast_node_free_tree(body);
+
+	return s;
+}
+
+/* Check that allocating an AST from an arena does not affect the result
+ * and that isl_ast_node_free_tree leaves subtrees to which
+ * a reference is kept intact.
+ */
+static int test_ast_gen8(isl_ctx *ctx)
+{
+	const char *schedule;
+	char *s1, *s2, *s3;
+	int equal;
+
+	schedule = "[N] -> { S[i, j] -> [i, j] : 0 <= i < N and 0 <= j < i; "
+			    "T[i] -> [i, N] : 0 <= i < N }";
+	s1 = print_arena(ctx, schedule, 0, 1);
+	s2 = print_arena(ctx, schedule, 1, 1);
+	s3 = print_arena(ctx, schedule, 1, 0);
+	equal = s1 && s2 && s3 && !strcmp(s1, s2) &&
+		!strncmp(s1, s3, strlen(s3));
+	free(s1);
+	free(s2);
+	free(s3);
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"arena allocation produces different result", return -1);
+
+	return 0;
+}
+
+/* Check that the loops that do not carry any of the dependences
+ * are marked parallel and printed with OpenMP pragmas.
+ * The outer loop carries the dependences, while the inner loop
+ * is parallel and does not contain any other loops.
+ */
+static int test_ast_gen9(isl_ctx *ctx)
+{
+	const char *str;
+	isl_union_map *schedule, *dep;
+	isl_ast_build *build;
+	isl_ast_node *tree, *body;
+	isl_printer *p;
+	char *s;
+	int ok;
+
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx, "{:}"));
+	str = "{ S[i, j] -> S[i + 1, j] : 0 <= i < 9 and 0 <= j < 10 }";
+	dep = isl_union_map_read_from_str(ctx, str);
+	build = isl_ast_build_set_dependences(build, dep);
+	str = "{ S[i, j] -> [i, j] : 0 <= i, j < 10 }";
+	schedule = isl_union_map_read_from_str(ctx, str);
+	tree = isl_ast_build_ast_from_schedule(build, schedule);
+	isl_ast_build_free(build);
+	if (!tree)
+		return -1;
+
+	body = isl_ast_node_for_get_body(tree);
+	ok = isl_ast_node_for_is_parallel(tree) == 0 &&
+	     isl_ast_node_for_is_parallel(body) == 1 &&
+	     isl_ast_node_for_is_vectorizable(body) == 1;
+	isl_ast_node_free(body);
+
+	isl_options_set_ast_print_omp_pragmas(ctx, 1);
+	p = isl_printer_to_str(ctx);
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, tree);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_options_set_ast_print_omp_pragmas(ctx, 0);
+	isl_ast_node_free(tree);
+
+	str = "for (int c0 = 0; c0 <= 9; c0 += 1) {\n"
+	      "  #pragma omp parallel for simd\n"
+	      "  for (int c1 = 0; c1 <= 9; c1 += 1)\n"
+	      "    S(c0, c1);\n"
+	      "}\n";
+	ok = ok && s && !strcmp(s, str);
+	free(s);
+	if (!ok)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected parallel loop annotations", return -1);
+
+	return 0;
+}
+
+/* Check that the loop invariant bounds of a tiled loop nest
+ * are hoisted out of the loops when the ast_build_hoist_invariants
+ * option is set and that the names of the temporaries do not clash
+ * with that of the parameter.
+ */
+static int test_ast_gen10(isl_ctx *ctx)
+{
+	const char *str;
+	isl_union_map *schedule;
+	isl_ast_build *build;
+	isl_ast_node *tree;
+	isl_printer *p;
+	char *s;
+	int ok;
+
+	isl_options_set_ast_build_hoist_invariants(ctx, 1);
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx,
+							"[t0] -> {:}"));
+	str = "[t0] -> { S[i, j] -> [floor(i/32), i, j] : 0 <= i, j < t0 }";
+	schedule = isl_union_map_read_from_str(ctx, str);
+	tree = isl_ast_build_ast_from_schedule(build, schedule);
+	isl_ast_build_free(build);
+	isl_options_set_ast_build_hoist_invariants(ctx, 0);
+
+	p = isl_printer_to_str(ctx);
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, tree);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_ast_node_free(tree);
+
+	str = "{\n"
+	      "  int t1 = floord(t0 - 1, 32);\n"
+	      "  for (int c0 = 0; c0 <= t1; c0 += 1) {\n"
+	      "    int t2 = min(32 * c0 + 31, t0 - 1);\n"
+	      "    for (int c1 = 32 * c0; c1 <= t2; c1 += 1)\n"
+	      "      for (int c2 = 0; c2 < t0; c2 += 1)\n"
+	      "        S(c1, c2);\n"
+	      "  }\n"
+	      "}\n";
+	ok = s && !strcmp(s, str);
+	free(s);
+	if (!ok)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected hoisting of loop invariants", return -1);
+
+	return 0;
+}
+
+/* Check that each separation class is handled exactly once
+ * and that this is reflected in the statistics of the isl_ctx.
+ * The schedule has two classes, one of which is spread over
+ * two disjuncts.
+ */
+static int test_ast_gen11(isl_ctx *ctx)
+{
+	const char *str;
+	isl_union_map *schedule, *options;
+	isl_ast_build *build;
+	isl_ast_node *tree;
+	const struct isl_stats *stats;
+	int ok;
+
+	isl_ctx_reset_stats(ctx);
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx, "{:}"));
+	str = "{ [i] -> separation_class[[0] -> [0]] : 0 <= i < 4 or "
+				"8 <= i < 12; "
+	      "[i] -> separation_class[[0] -> [1]] : 4 <= i < 8 }";
+	options = isl_union_map_read_from_str(ctx, str);
+	build = isl_ast_build_set_options(build, options);
+	str = "{ S[i] -> [i] : 0 <= i < 16 }";
+	schedule = isl_union_map_read_from_str(ctx, str);
+	tree = isl_ast_build_ast_from_schedule(build, schedule);
+	isl_ast_build_free(build);
+
+	stats = isl_ctx_get_stats(ctx);
+	ok = tree && stats->ast_build_n_class == 2 &&
+	     stats->ast_build_class_time >= stats->ast_build_class_time_max;
+	isl_ast_node_free(tree);
+	if (!ok)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected separation class statistics", return -1);
+
+	return 0;
+}
+
+/* Generate C code for "schedule" with options "options"
+ * in a build with context "context" and return the result.
+ */
+static char *ast_gen_to_str(isl_ctx *ctx, const char *context,
+	const char *schedule, const char *options)
+{
+	isl_ast_build *build;
+	isl_ast_node *tree;
+	isl_printer *p;
+	char *s;
+
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx, context));
+	build = isl_ast_build_set_options(build,
+				isl_union_map_read_from_str(ctx, options));
+	tree = isl_ast_build_ast_from_schedule(build,
+				isl_union_map_read_from_str(ctx, schedule));
+	isl_ast_build_free(build);
+
+	p = isl_printer_to_str(ctx);
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, tree);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_ast_node_free(tree);
+
+	return s;
+}
+
+/* Check that turning off the ast_build_gist_cache option
+ * does not affect the generated code.
+ * The separation and unrolling options cause the build
+ * to be copied and modified in several ways, such that
+ * the cached results need to be correctly invalidated.
+ */
+static int test_ast_gen12(isl_ctx *ctx)
+{
+	const char *context, *schedule, *options;
+	char *s1, *s2;
+	int gist_cache;
+	int equal;
+
+	context = "[N] -> { : N >= 0 }";
+	schedule = "[N] -> { A[i, j] -> [i, j, 0] : 0 <= j <= i < N; "
+		"B[i, j] -> [i, j, 1] : 0 <= i < N and 0 <= j < 10 and "
+		"i mod 3 = 0; C[i] -> [i, 0, 2] : 0 <= i <= N + 5 }";
+	options = "[N] -> { [i, j, k] -> separate[x] : x = 1; "
+		"[i, j, k] -> unroll[x] : x = 2 }";
+
+	gist_cache = isl_options_get_ast_build_gist_cache(ctx);
+	isl_options_set_ast_build_gist_cache(ctx, 1);
+	s1 = ast_gen_to_str(ctx, context, schedule, options);
+	isl_options_set_ast_build_gist_cache(ctx, 0);
+	s2 = ast_gen_to_str(ctx, context, schedule, options);
+	isl_options_set_ast_build_gist_cache(ctx, gist_cache);
+
+	equal = s1 && s2 && !strcmp(s1, s2);
+	free(s1);
+	free(s2);
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"gist cache affects generated code", return -1);
+
+	return 0;
+}
+
+/* Check that generating code for independent components in parallel
+ * produces the same AST as generating code for them one by one and
+ * that the separation classes handled by the worker threads
+ * are included in the statistics.
+ * The schedule has several independent components at the outer level,
+ * one of which has independent components at the next level.
+ * The separation classes only apply to the last component.
+ */
+static int test_ast_gen13(isl_ctx *ctx)
+{
+	const char *context, *schedule, *options;
+	char *s1, *s2;
+	int parallel, n_thread;
+	long n_class1, n_class2;
+	int equal;
+
+	context = "[N] -> { : N >= 0 }";
+	schedule = "[N] -> { A[i] -> [0, i, 0] : 0 <= i < N; "
+		"B[i] -> [0, i, 1] : 0 <= i < N; "
+		"C[i, j] -> [1, i, j] : 0 <= i, j < N; "
+		"D[i] -> [2, 0, i] : 0 <= i < 2N; "
+		"E[i] -> [2, 1, i] : 0 <= i <= N + 5 and i mod 3 = 0; "
+		"F[i] -> [3, i, 0] : 0 <= i < 4 }";
+	options = "[N] -> { [i, j, k] -> separate[x] : x = 1; "
+		"[i, j, k] -> atomic[x] : x = 2; "
+		"[i, j, k] -> separation_class[[1] -> [0]] : i = 3 and j < 2; "
+		"[i, j, k] -> separation_class[[1] -> [1]] : i = 3 and j >= 2 }";
+
+	parallel = isl_options_get_ast_build_parallel_components(ctx);
+	n_thread = isl_options_get_n_thread(ctx);
+	isl_options_set_ast_build_parallel_components(ctx, 0);
+	isl_ctx_reset_stats(ctx);
+	s1 = ast_gen_to_str(ctx, context, schedule, options);
+	n_class1 = isl_ctx_get_stats(ctx)->ast_build_n_class;
+	isl_options_set_ast_build_parallel_components(ctx, 1);
+	isl_options_set_n_thread(ctx, 3);
+	isl_ctx_reset_stats(ctx);
+	s2 = ast_gen_to_str(ctx, context, schedule, options);
+	n_class2 = isl_ctx_get_stats(ctx)->ast_build_n_class;
+	isl_options_set_n_thread(ctx, n_thread);
+	isl_options_set_ast_build_parallel_components(ctx, parallel);
+
+	equal = s1 && s2 && !strcmp(s1, s2);
+	free(s1);
+	free(s2);
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"parallel code generation affects generated code",
+			return -1);
+	if (n_class1 == 0 || n_class1 != n_class2)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected separation class statistics", return -1);
+
+	return 0;
+}
+
+/* Internal data structure for count_instance.
+ * "n" is the number of instances executed so far and
+ * "last" is the schedule time of the last one.
+ * "ordered" is cleared if the instances are not executed
+ * in the order of the schedule.
+ */
+struct isl_test_exec_data {
+	int n;
+	long last[4];
+	int ordered;
+};
+
+/* Update "data" with the instance S(arg[0], arg[1]), scheduled at time
+ * [floor(arg[0]/4), floor(arg[1]/4), arg[0], arg[1]].
+ */
+static int count_instance(__isl_keep isl_ast_node *node, int n_arg,
+	const long *arg, void *user)
+{
+	struct isl_test_exec_data *data = user;
+	long time[4];
+	int k;
+
+	if (n_arg != 2 || arg[0] < 0 || arg[1] < 0)
+		return -1;
+	time[0] = arg[0] / 4;
+	time[1] = arg[1] / 4;
+	time[2] = arg[0];
+	time[3] = arg[1];
+	for (k = 0; k < 4 && data->n > 0; ++k) {
+		if (time[k] > data->last[k])
+			break;
+		if (time[k] < data->last[k] || k == 3)
+			data->ordered = 0;
+	}
+	for (k = 0; k < 4; ++k)
+		data->last[k] = time[k];
+	data->n++;
+
+	return 0;
+}
+
+/* Check that executing the AST generated for a tiled triangular domain
+ * visits each instance exactly once and in the order of the schedule.
+ */
+static int test_ast_exec(isl_ctx *ctx)
+{
+	const char *str;
+	isl_union_map *schedule;
+	isl_ast_build *build;
+	isl_ast_node *tree;
+	isl_ast_exec *exec;
+	struct isl_test_exec_data data = { 0, { 0 }, 1 };
+	int r;
+
+	build = isl_ast_build_from_context(isl_set_read_from_str(ctx,
+							"[N] -> {:}"));
+	str = "[N] -> { S[i, j] -> [floor(i/4), floor(j/4), i, j] : "
+				"0 <= j <= i < N }";
+	schedule = isl_union_map_read_from_str(ctx, str);
+	tree = isl_ast_build_ast_from_schedule(build, schedule);
+	isl_ast_build_free(build);
+
+	exec = isl_ast_node_compile(tree);
+	isl_ast_node_free(tree);
+	exec = isl_ast_exec_set_param(exec, isl_id_alloc(ctx, "N", NULL), 37);
+	r = isl_ast_exec_run(exec, &count_instance, &data);
+	isl_ast_exec_free(exec);
+	if (r < 0)
+		return -1;
+
+	if (data.n != 37 * 38 / 2 || !data.ordered)
+		isl_die(ctx, isl_error_unknown,
+			"unexpected execution of AST", return -1);
+
+	return 0;
+}
+
+/* Add "node" to the list pointed to by "user".
+ */
+static int collect_outer_node(__isl_take isl_ast_node *node, void *user)
+{
+	isl_ast_node_list **list = user;
+
+	*list = isl_ast_node_list_add(*list, node);
+
+	return *list ? 0 : -1;
+}
+
+/* Print "node" to a string in C format.
+ */
+static char *ast_node_to_c_str(__isl_take isl_ast_node *node)
+{
+	isl_printer *p;
+	char *s;
+
+	if (!node)
+		return NULL;
+	p = isl_printer_to_str(isl_ast_node_get_ctx(node));
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_ast_node(p, node);
+	s = isl_printer_get_str(p);
+	isl_printer_free(p);
+	isl_ast_node_free(node);
+
+	return s;
+}
+
+/* Check that the outermost nodes produced by
+ * isl_ast_build_foreach_ast_from_schedule form the same AST as
+ * the one produced by isl_ast_build_ast_from_schedule,
+ * for a schedule with several independent components.
+ */
+static int test_ast_gen14(isl_ctx *ctx)
+{
+	const char *str;
+	isl_set *set;
+	isl_union_map *schedule;
+	isl_ast_build *build;
+	isl_ast_node *tree;
+	isl_ast_node_list *list;
+	char *s1, *s2;
+	int equal;
+
+	str = "[N] -> { A[i] -> [0, i, 0] : 0 <= i < N; "
+		"B[i, j] -> [1, i, j] : 0 <= i, j < N; "
+		"C[i] -> [2, i, 0] : 0 <= i < 10 }";
+	set = isl_set_universe(isl_space_params_alloc(ctx, 0));
+	build = isl_ast_build_from_context(set);
+
+	schedule = isl_union_map_read_from_str(ctx, str);
+	tree = isl_ast_build_ast_from_schedule(build, schedule);
+	s1 = ast_node_to_c_str(tree);
+
+	schedule = isl_union_map_read_from_str(ctx, str);
+	list = isl_ast_node_list_alloc(ctx, 0);
+	if (isl_ast_build_foreach_ast_from_schedule(build, schedule,
+						&collect_outer_node, &list) < 0)
+		list = isl_ast_node_list_free(list);
+	tree = list ? isl_ast_node_from_ast_node_list(list) : NULL;
+	s2 = ast_node_to_c_str(tree);
+	isl_ast_build_free(build);
+
+	equal = s1 && s2 && !strcmp(s1, s2);
+	free(s1);
+	free(s2);
+	if (!equal)
+		isl_die(ctx, isl_error_unknown,
+			"streamed AST differs from complete AST", return -1);
+
+	return 0;
+}
+
 static int test_ast_gen(isl_ctx *ctx)
 {
 	if (test_ast_gen1(ctx) < 0)
@@ -4214,6 +6177,24 @@ static int test_ast_gen(isl_ctx *ctx)
 		return -1;
 	if (test_ast_gen5(ctx) < 0)
 		return -1;
+	if (test_ast_gen6(ctx) < 0)
+		return -1;
+	if (test_ast_gen7(ctx) < 0)
+		return -1;
+	if (test_ast_gen8(ctx) < 0)
+		return -1;
+	if (test_ast_gen9(ctx) < 0)
+		return -1;
+	if (test_ast_gen10(ctx) < 0)
+		return -1;
+	if (test_ast_gen11(ctx) < 0)
+		return -1;
+	if (test_ast_gen12(ctx) < 0)
+		return -1;
+	if (test_ast_gen13(ctx) < 0)
+		return -1;
+	if (test_ast_gen14(ctx) < 0)
+		return -1;
 	return 0;
 }
 
@@ -4343,14 +6324,27 @@ struct {
 	{ "pullback", &test_pullback },
 	{ "AST", &test_ast },
 	{ "AST generation", &test_ast_gen },
+	{ "AST execution", &test_ast_exec },
 	{ "eliminate", &test_eliminate },
 	{ "residue class", &test_residue_class },
 	{ "div", &test_div },
 	{ "slice", &test_slice },
 	{ "fixed power", &test_fixed_power },
+	{ "point", &test_point },
 	{ "sample", &test_sample },
+	{ "batched point enumeration", &test_foreach_point_batch },
+	{ "parallel scan", &test_parallel_scan },
+	{ "parallel Bernstein", &test_parallel_bernstein },
+	{ "parallel dataflow", &test_parallel_flow },
+	{ "parallel transitive closure", &test_parallel_closure },
+	{ "incremental dataflow", &test_incremental_flow },
+	{ "schedule legality", &test_schedule_legality },
+	{ "count", &test_count },
 	{ "output", &test_output },
 	{ "vertices", &test_vertices },
+	{ "vertices cache", &test_vertices_cache },
+	{ "piece index", &test_piece_index },
+	{ "qpolynomial div cache", &test_qpolynomial_div_cache },
 	{ "fixed", &test_fixed },
 	{ "equal", &test_equal },
 	{ "product", &test_product },
@@ -4369,6 +6363,7 @@ struct {
 	{ "lexmin", &test_lexmin },
 	{ "gist", &test_gist },
 	{ "piecewise quasi-polynomials", &test_pwqp },
+	{ "compiled piecewise quasi-polynomials", &test_pwqp_exec },
 };
 
 int main()
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <time.h>
+#include <isl_ctx_private.h>
+#include <isl_options_private.h>
+#include <isl_thread.h>
+
+int isl_mutex_init(isl_ctx *ctx, struct isl_mutex *mutex)
+{
+#ifdef ISL_USE_PTHREADS
+	if (pthread_mutex_init(&mutex->mutex, NULL) != 0)
+		isl_die(ctx, isl_error_unknown, "unable to create mutex",
+			return -1);
+#endif
+	return 0;
+}
+
+void isl_mutex_destroy(struct isl_mutex *mutex)
+{
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_destroy(&mutex->mutex);
+#endif
+}
+
+void isl_mutex_lock(struct isl_mutex *mutex)
+{
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void isl_mutex_unlock(struct isl_mutex *mutex)
+{
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+/* Return the number of threads that operations in "ctx"
+ * that support parallel execution should use.
+ */
+int isl_thread_n_thread(isl_ctx *ctx)
+{
+#ifdef ISL_USE_PTHREADS
+	return ctx->opt->n_thread < 1 ? 1 : ctx->opt->n_thread;
+#else
+	return 1;
+#endif
+}
+
+/* Allocate a context for a worker thread of "ctx".
+ * The worker context gets a complete copy of the options of "ctx",
+ * except that the worker itself does not spawn any further threads.
+ */
+isl_ctx *isl_thread_ctx_alloc(isl_ctx *ctx)
+{
+	struct isl_options *opt;
+
+	if (!ctx)
+		return NULL;
+
+	opt = isl_args_copy(&isl_options_args, ctx->opt);
+	if (!opt)
+		isl_die(ctx, isl_error_unknown, "unable to copy options",
+			return NULL);
+	opt->n_thread = 1;
+
+	return isl_ctx_alloc_with_options(&isl_options_args, opt);
+}
+
+/* Report the failure of a worker thread with context "worker_ctx"
+ * on the parent context "ctx", using the error type
+ * of the last error in "worker_ctx", if any.
+ */
+void isl_thread_report_error(isl_ctx *ctx, isl_ctx *worker_ctx,
+	const char *msg)
+{
+	enum isl_error err = isl_error_unknown;
+
+	if (worker_ctx && isl_ctx_last_error(worker_ctx) != isl_error_none)
+		err = isl_ctx_last_error(worker_ctx);
+	isl_handle_error(ctx, err, msg, __FILE__, __LINE__);
+}
+
+/* Call "fn" on each of the "n" consecutive elements of size "size"
+ * starting at "arg", each in a separate thread, and wait
+ * for all of them to finish.
+ * If a thread cannot be created, or if threads are not available,
+ * then "fn" is called directly instead.
+ */
+int isl_thread_run(isl_ctx *ctx, int n, void *(*fn)(void *arg),
+	void *arg, size_t size)
+{
+	int i;
+#ifdef ISL_USE_PTHREADS
+	pthread_t *thread;
+	int *started;
+
+	thread = isl_alloc_array(ctx, pthread_t, n);
+	started = isl_calloc_array(ctx, int, n);
+	if (n && (!thread || !started)) {
+		free(thread);
+		free(started);
+		return -1;
+	}
+	for (i = 0; i < n; ++i)
+		started[i] = pthread_create(&thread[i], NULL, fn,
+					(char *) arg + i * size) == 0;
+	for (i = 0; i < n; ++i)
+		if (started[i])
+			pthread_join(thread[i], NULL);
+		else
+			fn((char *) arg + i * size);
+	free(started);
+	free(thread);
+#else
+	for (i = 0; i < n; ++i)
+		fn((char *) arg + i * size);
+#endif
+	return 0;
+}
+
+/* Return the CPU time in seconds spent by the current thread
+ * if this can be determined and by the whole process otherwise.
+ */
+double isl_thread_cpu_time(void)
+{
+#if defined(ISL_USE_PTHREADS) && defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+	return (double) clock() / CLOCKS_PER_SEC;
+}
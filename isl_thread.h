@@ -0,0 +1,36 @@
+#ifndef ISL_THREAD_H
+#define ISL_THREAD_H
+
+#include <stdlib.h>
+#include <isl_config.h>
+#include <isl/ctx.h>
+
+#ifdef ISL_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+/* A mutex that does nothing if threads are not available.
+ */
+struct isl_mutex {
+#ifdef ISL_USE_PTHREADS
+	pthread_mutex_t mutex;
+#else
+	int dummy;
+#endif
+};
+
+int isl_mutex_init(isl_ctx *ctx, struct isl_mutex *mutex);
+void isl_mutex_destroy(struct isl_mutex *mutex);
+void isl_mutex_lock(struct isl_mutex *mutex);
+void isl_mutex_unlock(struct isl_mutex *mutex);
+
+int isl_thread_n_thread(isl_ctx *ctx);
+int isl_thread_run(isl_ctx *ctx, int n, void *(*fn)(void *arg),
+	void *arg, size_t size);
+double isl_thread_cpu_time(void);
+
+isl_ctx *isl_thread_ctx_alloc(isl_ctx *ctx);
+void isl_thread_report_error(isl_ctx *ctx, isl_ctx *worker_ctx,
+	const char *msg);
+
+#endif
@@ -19,6 +19,7 @@
 #include <isl_vec_private.h>
 #include <isl_options_private.h>
 #include <isl_tarjan.h>
+#include <isl_thread.h>
 
 int isl_map_is_transitively_closed(__isl_keep isl_map *map)
 {
@@ -1494,6 +1495,332 @@ static int add_length(__isl_keep isl_map *map, isl_map ***grid, int n)
 	return 0;
 }
 
+/* The minimal number of independent updates in a step
+ * of the Floyd-Warshall algorithm for performing them in parallel.
+ * Below this number, the overhead of transferring the relations
+ * to and from the worker contexts outweighs the gain.
+ */
+#define ISL_FLOYD_WARSHALL_MIN_PARALLEL	4
+
+/* The worker contexts used by the parallel Floyd-Warshall updates
+ * in a (possibly nested) transitive closure computation.
+ * "ref" is the number of active closure computations using them and
+ * "ctx" contains the "n" worker contexts that have been allocated so far.
+ * The worker contexts are only allocated when they are first needed and
+ * they are freed when the outermost closure computation finishes.
+ */
+struct isl_closure_workers {
+	int ref;
+	int n;
+	isl_ctx **ctx;
+};
+
+/* Start a closure computation in "ctx", reusing the worker contexts
+ * of any closure computation that is already active.
+ */
+static int closure_workers_enter(isl_ctx *ctx)
+{
+	if (!ctx->closure_workers) {
+		ctx->closure_workers = isl_calloc_type(ctx,
+						struct isl_closure_workers);
+		if (!ctx->closure_workers)
+			return -1;
+	}
+	ctx->closure_workers->ref++;
+	return 0;
+}
+
+/* Finish a closure computation in "ctx" and free the worker contexts
+ * if it was the outermost one.
+ */
+static void closure_workers_leave(isl_ctx *ctx)
+{
+	int i;
+	struct isl_closure_workers *workers = ctx->closure_workers;
+
+	if (!workers || --workers->ref > 0)
+		return;
+
+	for (i = 0; i < workers->n; ++i)
+		isl_ctx_free(workers->ctx[i]);
+	free(workers->ctx);
+	free(workers);
+	ctx->closure_workers = NULL;
+}
+
+/* Return an array of (at least) "n" worker contexts for "ctx",
+ * allocating those that have not been allocated before.
+ * Must be called between closure_workers_enter and closure_workers_leave.
+ */
+static isl_ctx **closure_workers_get(isl_ctx *ctx, int n)
+{
+	struct isl_closure_workers *workers = ctx->closure_workers;
+	isl_ctx **worker_ctx;
+
+	if (!workers)
+		isl_die(ctx, isl_error_internal,
+			"no active closure computation", return NULL);
+	if (n <= workers->n)
+		return workers->ctx;
+
+	worker_ctx = isl_realloc_array(ctx, workers->ctx, isl_ctx *, n);
+	if (!worker_ctx)
+		return NULL;
+	workers->ctx = worker_ctx;
+	for (; workers->n < n; ++workers->n) {
+		workers->ctx[workers->n] = isl_thread_ctx_alloc(ctx);
+		if (!workers->ctx[workers->n])
+			return NULL;
+	}
+
+	return workers->ctx;
+}
+
+/* Update "pq", the relation between vertices p and q, to include
+ * the paths that go from p to r through "pr", possibly stay in r
+ * through "rr" and then go from r to q through "rq".
+ */
+static __isl_give isl_map *floyd_warshall_update(__isl_take isl_map *pq,
+	__isl_keep isl_map *pr, __isl_keep isl_map *rr, __isl_keep isl_map *rq)
+{
+	isl_map *loop;
+
+	loop = isl_map_apply_range(isl_map_copy(pr), isl_map_copy(rq));
+	pq = isl_map_union(pq, loop);
+	loop = isl_map_apply_range(isl_map_copy(pr),
+			isl_map_apply_range(isl_map_copy(rr), isl_map_copy(rq)));
+	pq = isl_map_union(pq, loop);
+	return isl_map_coalesce(pq);
+}
+
+/* An update of element "p", "q" of the grid, handled by a worker
+ * of floyd_warshall_parallel.  "res" is the updated element
+ * in the context of the worker.
+ */
+struct isl_floyd_warshall_task {
+	int p;
+	int q;
+	isl_map *res;
+};
+
+/* Internal data structure for floyd_warshall_parallel.
+ *
+ * "grid" is the n x n grid in the main context and "r" is
+ * the current vertex.
+ * "task" is the list of "n_task" updates.
+ * "next" is the index of the next task that has not been taken
+ * by any worker yet.
+ * "stop" is set as soon as any worker failed.
+ * "lock" protects "next" and "stop".
+ */
+struct isl_floyd_warshall_data {
+	isl_map ***grid;
+	int n;
+	int r;
+
+	int n_task;
+	struct isl_floyd_warshall_task *task;
+
+	int next;
+	int stop;
+	struct isl_mutex lock;
+};
+
+/* A worker of floyd_warshall_parallel.
+ * "ctx" is the context in which the worker operates,
+ * which is owned by the isl_closure_workers of the main context, and
+ * "ok" is cleared if the worker failed.
+ * "row" and "col" contain the copies in "ctx" of the elements
+ * in row r and column r of the grid that have been needed
+ * by the worker so far.  The copy of the diagonal element
+ * is kept in col[r].
+ */
+struct isl_floyd_warshall_worker {
+	struct isl_floyd_warshall_data *data;
+	isl_ctx *ctx;
+	int ok;
+	isl_map **row;
+	isl_map **col;
+};
+
+/* Return the copy in the context of "worker" of element "i"
+ * of "list" (either worker->row or worker->col), where "src" is
+ * the corresponding element in the main context,
+ * constructing it if it has not been needed before.
+ */
+static __isl_keep isl_map *worker_grid_element(
+	struct isl_floyd_warshall_worker *worker, isl_map **list, int i,
+	__isl_keep isl_map *src)
+{
+	if (!list[i])
+		list[i] = isl_map_transfer(worker->ctx, src);
+	return list[i];
+}
+
+/* Repeatedly take the next update from the shared list and
+ * perform it in the context of the worker.
+ * The elements of the grid in the main context are only read.
+ * The elements in row r and column r of the grid are only copied
+ * to the worker context the first time they are needed.
+ */
+static void *floyd_warshall_worker(void *user)
+{
+	struct isl_floyd_warshall_worker *worker = user;
+	struct isl_floyd_warshall_data *data = worker->data;
+	isl_map ***grid = data->grid;
+	int r = data->r;
+	int t;
+
+	while (worker->ok) {
+		struct isl_floyd_warshall_task *task;
+		isl_map *pr, *rr, *rq;
+
+		isl_mutex_lock(&data->lock);
+		t = data->stop || data->next >= data->n_task ?
+			-1 : data->next++;
+		isl_mutex_unlock(&data->lock);
+		if (t < 0)
+			break;
+
+		task = &data->task[t];
+		pr = worker_grid_element(worker, worker->col, task->p,
+					grid[task->p][r]);
+		rr = worker_grid_element(worker, worker->col, r, grid[r][r]);
+		rq = worker_grid_element(worker, worker->row, task->q,
+					grid[r][task->q]);
+		task->res = isl_map_transfer(worker->ctx,
+					grid[task->p][task->q]);
+		task->res = floyd_warshall_update(task->res, pr, rr, rq);
+		if (!task->res)
+			worker->ok = 0;
+	}
+
+	if (!worker->ok) {
+		isl_mutex_lock(&data->lock);
+		data->stop = 1;
+		isl_mutex_unlock(&data->lock);
+	}
+
+	return NULL;
+}
+
+/* Free the copies of grid elements kept by the "n_worker" workers
+ * in "worker", but not their contexts.
+ */
+static void clear_floyd_warshall_workers(int n, int n_worker,
+	struct isl_floyd_warshall_worker *worker)
+{
+	int i, j;
+
+	for (i = 0; i < n_worker; ++i) {
+		for (j = 0; j < n; ++j) {
+			worker[i].row[j] = isl_map_free(worker[i].row[j]);
+			worker[i].col[j] = isl_map_free(worker[i].col[j]);
+		}
+	}
+}
+
+/* Perform the updates in data->task, for vertex data->r,
+ * using the "n_worker" workers in "worker" and store the results
+ * in the grid.
+ *
+ * The updates only read the elements in row r and column r
+ * of the grid and they each write a different element outside
+ * of this row and column, so they can be performed independently.
+ * The results are only stored in the grid after all workers
+ * have finished and they are stored in the same order
+ * as the tasks, such that the result does not depend
+ * on the number of threads.
+ * If anything went wrong, then the updated elements are set to NULL.
+ */
+static void floyd_warshall_parallel(isl_ctx *ctx,
+	struct isl_floyd_warshall_data *data, int n_worker,
+	struct isl_floyd_warshall_worker *worker)
+{
+	int i, r;
+	int ok = 1;
+
+	data->next = 0;
+	data->stop = 0;
+	for (i = 0; i < n_worker; ++i)
+		worker[i].ok = 1;
+
+	r = isl_mutex_init(ctx, &data->lock);
+	if (r >= 0) {
+		r = isl_thread_run(ctx, n_worker, &floyd_warshall_worker,
+				    worker, sizeof(*worker));
+		isl_mutex_destroy(&data->lock);
+	}
+	if (r < 0)
+		ok = 0;
+
+	for (i = 0; ok && i < n_worker; ++i) {
+		if (!worker[i].ok) {
+			isl_thread_report_error(ctx, worker[i].ctx,
+				"transitive closure failed in worker");
+			ok = 0;
+		}
+	}
+
+	for (i = 0; i < data->n_task; ++i) {
+		struct isl_floyd_warshall_task *task = &data->task[i];
+		isl_map **pq = &data->grid[task->p][task->q];
+
+		isl_map_free(*pq);
+		*pq = ok ? isl_map_transfer(ctx, task->res) : NULL;
+		task->res = isl_map_free(task->res);
+	}
+
+	clear_floyd_warshall_workers(data->n, n_worker, worker);
+}
+
+static void floyd_warshall_workers_free(int n_worker,
+	struct isl_floyd_warshall_worker *worker)
+{
+	int i;
+
+	if (!worker)
+		return;
+	for (i = 0; i < n_worker; ++i) {
+		free(worker[i].row);
+		free(worker[i].col);
+	}
+	free(worker);
+}
+
+/* Allocate "n_worker" workers for floyd_warshall_parallel
+ * on an "n" x "n" grid, using the worker contexts of the closure
+ * computation that is active in "ctx".
+ */
+static struct isl_floyd_warshall_worker *floyd_warshall_workers_alloc(
+	isl_ctx *ctx, struct isl_floyd_warshall_data *data, int n_worker)
+{
+	int i;
+	isl_ctx **worker_ctx;
+	struct isl_floyd_warshall_worker *worker;
+
+	worker_ctx = closure_workers_get(ctx, n_worker);
+	if (!worker_ctx)
+		return NULL;
+	worker = isl_calloc_array(ctx, struct isl_floyd_warshall_worker,
+				n_worker);
+	if (!worker)
+		return NULL;
+	for (i = 0; i < n_worker; ++i) {
+		worker[i].data = data;
+		worker[i].ctx = worker_ctx[i];
+		worker[i].row = isl_calloc_array(ctx, isl_map *, data->n);
+		worker[i].col = isl_calloc_array(ctx, isl_map *, data->n);
+		if (!worker[i].row || !worker[i].col)
+			goto error;
+	}
+
+	return worker;
+error:
+	floyd_warshall_workers_free(n_worker, worker);
+	return NULL;
+}
+
 /* The core of the Floyd-Warshall algorithm.
  * Updates the given n x x matrix of relations in place.
  *
@@ -1504,10 +1831,46 @@ static int add_length(__isl_keep isl_map *map, isl_map ***grid, int n)
  * element corresponding to the current vertex is replaced by its
  * transitive closure to account for all indirect paths that stay
  * in the current vertex.
+ *
+ * Only the elements p, q for which there is both a path from p
+ * to the current vertex r and a path from r to q need to be updated,
+ * so the rows p and columns q with a non-empty element in column r
+ * and row r are determined first.
+ * The elements outside of row r and column r are updated first,
+ * since they only depend on the elements in row r and column r
+ * (including the diagonal element), which are only updated afterwards.
+ * The former updates are therefore independent of each other and
+ * they are performed in parallel if more than one thread may be used
+ * and if there are at least ISL_FLOYD_WARSHALL_MIN_PARALLEL of them.
+ * The workers are only set up when they are first needed and
+ * their contexts are shared by all Floyd-Warshall iterations
+ * in the same closure computation.
  */
-static void floyd_warshall_iterate(isl_map ***grid, int n, int *exact)
+static void floyd_warshall_iterate(isl_ctx *ctx, isl_map ***grid, int n,
+	int *exact)
 {
-	int r, p, q;
+	int r, p, q, i, j;
+	int n_row, n_col;
+	int *row = NULL, *col = NULL;
+	int n_worker = 0;
+	struct isl_floyd_warshall_data data;
+	struct isl_floyd_warshall_worker *worker = NULL;
+
+	data.grid = grid;
+	data.n = n;
+	data.task = NULL;
+	if (closure_workers_enter(ctx) < 0)
+		goto error_enter;
+	row = isl_alloc_array(ctx, int, n);
+	col = isl_alloc_array(ctx, int, n);
+	if (!row || !col)
+		goto error;
+
+	n_worker = isl_thread_n_thread(ctx);
+	if ((n - 1) * (n - 1) < ISL_FLOYD_WARSHALL_MIN_PARALLEL)
+		n_worker = 1;
+	if (n_worker > (n - 1) * (n - 1))
+		n_worker = (n - 1) * (n - 1);
 
 	for (r = 0; r < n; ++r) {
 		int r_exact;
@@ -1516,24 +1879,82 @@ static void floyd_warshall_iterate(isl_map ***grid, int n, int *exact)
 		if (exact && *exact && !r_exact)
 			*exact = 0;
 
-		for (p = 0; p < n; ++p)
-			for (q = 0; q < n; ++q) {
-				isl_map *loop;
-				if (p == r && q == r)
-					continue;
-				loop = isl_map_apply_range(
-						isl_map_copy(grid[p][r]),
-						isl_map_copy(grid[r][q]));
-				grid[p][q] = isl_map_union(grid[p][q], loop);
-				loop = isl_map_apply_range(
-						isl_map_copy(grid[p][r]),
-					isl_map_apply_range(
-						isl_map_copy(grid[r][r]),
-						isl_map_copy(grid[r][q])));
-				grid[p][q] = isl_map_union(grid[p][q], loop);
-				grid[p][q] = isl_map_coalesce(grid[p][q]);
-			}
+		n_row = n_col = 0;
+		for (i = 0; i < n; ++i) {
+			if (i != r && isl_map_plain_is_empty(grid[i][r]) != 1)
+				row[n_row++] = i;
+			if (i != r && isl_map_plain_is_empty(grid[r][i]) != 1)
+				col[n_col++] = i;
+		}
+
+		if (n_worker > 1 && !worker &&
+		    n_row * n_col >= ISL_FLOYD_WARSHALL_MIN_PARALLEL) {
+			data.task = isl_alloc_array(ctx,
+					struct isl_floyd_warshall_task,
+					(n - 1) * (n - 1));
+			worker = floyd_warshall_workers_alloc(ctx, &data,
+								n_worker);
+			if (!data.task || !worker)
+				goto error;
+		}
+		if (worker && n_row * n_col >= ISL_FLOYD_WARSHALL_MIN_PARALLEL) {
+			data.r = r;
+			data.n_task = 0;
+			for (i = 0; i < n_row; ++i)
+				for (j = 0; j < n_col; ++j) {
+					data.task[data.n_task].p = row[i];
+					data.task[data.n_task].q = col[j];
+					data.task[data.n_task].res = NULL;
+					data.n_task++;
+				}
+			floyd_warshall_parallel(ctx, &data, n_worker, worker);
+		} else {
+			for (i = 0; i < n_row; ++i)
+				for (j = 0; j < n_col; ++j) {
+					p = row[i];
+					q = col[j];
+					grid[p][q] = floyd_warshall_update(
+						grid[p][q], grid[p][r],
+						grid[r][r], grid[r][q]);
+				}
+		}
+
+		if (isl_map_plain_is_empty(grid[r][r]) == 1)
+			continue;
+		for (j = 0; j < n_col; ++j) {
+			isl_map *rq;
+			q = col[j];
+			rq = isl_map_copy(grid[r][q]);
+			grid[r][q] = floyd_warshall_update(grid[r][q],
+					grid[r][r], grid[r][r], rq);
+			isl_map_free(rq);
+		}
+		for (i = 0; i < n_row; ++i) {
+			isl_map *pr;
+			p = row[i];
+			pr = isl_map_copy(grid[p][r]);
+			grid[p][r] = floyd_warshall_update(grid[p][r],
+					pr, grid[r][r], grid[r][r]);
+			isl_map_free(pr);
+		}
 	}
+
+	floyd_warshall_workers_free(n_worker, worker);
+	free(data.task);
+	free(row);
+	free(col);
+	closure_workers_leave(ctx);
+	return;
+error:
+	floyd_warshall_workers_free(n_worker, worker);
+	free(data.task);
+	free(row);
+	free(col);
+	closure_workers_leave(ctx);
+error_enter:
+	for (p = 0; p < n; ++p)
+		for (q = 0; q < n; ++q)
+			grid[p][q] = isl_map_free(grid[p][q]);
 }
 
 /* Given a partition of the domains and ranges of the basic maps in "map",
@@ -1592,7 +2013,7 @@ static __isl_give isl_map *floyd_warshall_with_groups(__isl_take isl_space *dim,
 	if (!project && add_length(map, grid, n) < 0)
 		goto error;
 
-	floyd_warshall_iterate(grid, n, exact);
+	floyd_warshall_iterate(map->ctx, grid, n, exact);
 
 	app = isl_map_empty(isl_map_get_space(map));
 
@@ -2011,6 +2432,7 @@ error:
  */
 __isl_give isl_map *isl_map_power(__isl_take isl_map *map, int *exact)
 {
+	isl_ctx *ctx;
 	isl_space *target_dim;
 	isl_space *dim;
 	isl_map *diff;
@@ -2038,7 +2460,13 @@ __isl_give isl_map *isl_map_power(__isl_take isl_map *map, int *exact)
 	target_dim = isl_space_add_dims(target_dim, isl_dim_in, 1);
 	target_dim = isl_space_set_dim_name(target_dim, isl_dim_in, 0, "k");
 
+	ctx = isl_map_get_ctx(map);
+	if (closure_workers_enter(ctx) < 0) {
+		isl_space_free(target_dim);
+		return isl_map_free(map);
+	}
 	map = map_power(map, exact, 0);
+	closure_workers_leave(ctx);
 
 	map = isl_map_add_dims(map, isl_dim_param, 1);
 	dim = isl_map_get_space(map);
@@ -2568,6 +2996,7 @@ error:
 __isl_give isl_map *isl_map_transitive_closure(__isl_take isl_map *map,
 	int *exact)
 {
+	isl_ctx *ctx;
 	isl_space *target_dim;
 	int closed;
 
@@ -2588,9 +3017,13 @@ __isl_give isl_map *isl_map_transitive_closure(__isl_take isl_map *map,
 		return map;
 	}
 
+	ctx = isl_map_get_ctx(map);
+	if (closure_workers_enter(ctx) < 0)
+		goto error;
 	target_dim = isl_map_get_space(map);
 	map = map_power(map, exact, 1);
 	map = isl_map_reset_space(map, target_dim);
+	closure_workers_leave(ctx);
 
 	return map;
 error:
@@ -2674,7 +3107,7 @@ static __isl_give isl_union_map *union_floyd_warshall_on_list(isl_ctx *ctx,
 					isl_basic_map_copy(list[k])));
 	}
 	
-	floyd_warshall_iterate(grid, n_group, exact);
+	floyd_warshall_iterate(ctx, grid, n_group, exact);
 
 	app = isl_union_map_empty(isl_map_get_space(grid[0][0]));
 
@@ -2864,6 +3297,7 @@ error:
 __isl_give isl_union_map *isl_union_map_transitive_closure(
 	__isl_take isl_union_map *umap, int *exact)
 {
+	isl_ctx *ctx;
 	int closed;
 
 	if (!umap)
@@ -2879,7 +3313,11 @@ __isl_give isl_union_map *isl_union_map_transitive_closure(
 		goto error;
 	if (closed)
 		return umap;
+	ctx = isl_union_map_get_ctx(umap);
+	if (closure_workers_enter(ctx) < 0)
+		goto error;
 	umap = union_components(umap, exact);
+	closure_workers_leave(ctx);
 	return umap;
 error:
 	isl_union_map_free(umap);
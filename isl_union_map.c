@@ -244,6 +244,51 @@ __isl_give isl_union_set *isl_union_set_copy(__isl_keep isl_union_set *uset)
 	return isl_union_map_copy(uset);
 }
 
+/* Internal data structure for isl_union_map_transfer.
+ *
+ * "ctx" is the context to which the maps are transferred and
+ * "res" collects the transferred maps.
+ */
+struct isl_union_map_transfer_data {
+	isl_ctx *ctx;
+	isl_union_map *res;
+};
+
+/* Add a copy of the map in "entry" in the target context to data->res.
+ */
+static int transfer_entry(void **entry, void *user)
+{
+	struct isl_union_map_transfer_data *data = user;
+	isl_map *map = *entry;
+
+	data->res = isl_union_map_add_map(data->res,
+					isl_map_transfer(data->ctx, map));
+
+	return data->res ? 0 : -1;
+}
+
+/* Construct a copy of "umap" in "ctx", which may be different
+ * from the context of "umap".
+ * Like isl_map_transfer, this function only reads "umap".
+ */
+__isl_give isl_union_map *isl_union_map_transfer(isl_ctx *ctx,
+	__isl_keep isl_union_map *umap)
+{
+	struct isl_union_map_transfer_data data;
+
+	if (!umap)
+		return NULL;
+
+	data.ctx = ctx;
+	data.res = isl_union_map_alloc(isl_space_transfer(ctx, umap->dim),
+					umap->table.n);
+	if (isl_hash_table_foreach(umap->dim->ctx, &umap->table,
+				    &transfer_entry, &data) < 0)
+		return isl_union_map_free(data.res);
+
+	return data.res;
+}
+
 void *isl_union_map_free(__isl_take isl_union_map *umap)
 {
 	if (!umap)
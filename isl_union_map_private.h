@@ -8,3 +8,6 @@ struct isl_union_map {
 
 	struct isl_hash_table	table;
 };
+
+__isl_give isl_union_map *isl_union_map_transfer(isl_ctx *ctx,
+	__isl_keep isl_union_map *umap);
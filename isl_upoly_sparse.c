@@ -0,0 +1,533 @@
+/*
+ * Copyright 2013      Ecole Normale Superieure
+ *
+ * Use of this software is governed by the MIT license
+ *
+ * Written by Sven Verdoolaege,
+ * Ecole Normale Superieure, 45 rue d'Ulm, 75230 Paris, France
+ */
+
+#include <stdlib.h>
+#include <isl_ctx_private.h>
+#include <isl_polynomial_private.h>
+#include <isl_sort.h>
+
+/* Multiplying polynomials in the recursive representation
+ * creates and destroys a reference counted node for every partial
+ * product and every partial sum.  For larger polynomials,
+ * it is more efficient to convert them to a flat representation,
+ * perform the multiplication there and convert the result back.
+ * ISL_UPOLY_SPARSE_MIN_TERMS is the minimal value of the product
+ * of the numbers of terms of the two arguments for which
+ * the flat representation is used.
+ */
+#define ISL_UPOLY_SPARSE_MIN_TERMS	16
+
+/* A sparse representation of the polynomial
+ *
+ *	sum_i num[i] x^exp[i] / den
+ *
+ * in the variables 0 to n_var - 1, where exp[i] refers to the "n_var"
+ * exponents starting at exp + i * n_var.
+ * "size" is the number of terms for which memory has been allocated,
+ * while "n" is the number of terms in the polynomial.
+ * The numerators of all "size" terms are initialized.
+ * All "n" numerators are non-zero and "den" is positive.
+ *
+ * The terms are sorted in the order in which they appear
+ * in a depth first traversal of the recursive representation, i.e.,
+ * lexicographically on the exponents, starting from the last variable.
+ */
+struct isl_upoly_sparse {
+	isl_ctx *ctx;
+	int n_var;
+
+	int n;
+	int size;
+	int *exp;
+	isl_int *num;
+	isl_int den;
+};
+
+static void upoly_sparse_free(struct isl_upoly_sparse *sp)
+{
+	int i;
+
+	if (!sp)
+		return;
+	for (i = 0; i < sp->size; ++i)
+		isl_int_clear(sp->num[i]);
+	isl_int_clear(sp->den);
+	free(sp->num);
+	free(sp->exp);
+	free(sp);
+}
+
+/* Allocate room for a polynomial with "size" terms in "n_var" variables.
+ */
+static struct isl_upoly_sparse *upoly_sparse_alloc(isl_ctx *ctx, int n_var,
+	int size)
+{
+	int i;
+	struct isl_upoly_sparse *sp;
+
+	sp = isl_calloc_type(ctx, struct isl_upoly_sparse);
+	if (!sp)
+		return NULL;
+	sp->ctx = ctx;
+	sp->n_var = n_var;
+	isl_int_init(sp->den);
+	isl_int_set_si(sp->den, 1);
+	sp->exp = isl_alloc_array(ctx, int, size * n_var + 1);
+	sp->num = isl_alloc_array(ctx, isl_int, size + 1);
+	if (!sp->exp || !sp->num)
+		goto error;
+	for (i = 0; i < size; ++i)
+		isl_int_init(sp->num[i]);
+	sp->size = size;
+
+	return sp;
+error:
+	upoly_sparse_free(sp);
+	return NULL;
+}
+
+/* Return the number of non-zero terms in "up" or -1 if "up"
+ * has a coefficient that is not a rational number.
+ */
+static int upoly_n_term(__isl_keep struct isl_upoly *up)
+{
+	int i, n, n_i;
+	struct isl_upoly_rec *rec;
+	struct isl_upoly_cst *cst;
+
+	if (isl_upoly_is_cst(up)) {
+		cst = isl_upoly_as_cst(up);
+		if (isl_int_is_zero(cst->d))
+			return -1;
+		return isl_int_is_zero(cst->n) ? 0 : 1;
+	}
+
+	rec = isl_upoly_as_rec(up);
+	n = 0;
+	for (i = 0; i < rec->n; ++i) {
+		n_i = upoly_n_term(rec->p[i]);
+		if (n_i < 0)
+			return -1;
+		n += n_i;
+	}
+
+	return n;
+}
+
+/* Replace "lcm" by the least common multiple of "lcm"
+ * and the denominators of the coefficients of "up".
+ */
+static void upoly_lcm_den(__isl_keep struct isl_upoly *up, isl_int *lcm)
+{
+	int i;
+	struct isl_upoly_rec *rec;
+	struct isl_upoly_cst *cst;
+
+	if (isl_upoly_is_cst(up)) {
+		cst = isl_upoly_as_cst(up);
+		isl_int_lcm(*lcm, *lcm, cst->d);
+		return;
+	}
+
+	rec = isl_upoly_as_rec(up);
+	for (i = 0; i < rec->n; ++i)
+		upoly_lcm_den(rec->p[i], lcm);
+}
+
+/* Append the non-zero terms of "up" to "sp", where "exp" contains
+ * the exponents of the variables that have already been fixed
+ * in the recursive representation.
+ * The numerators are expressed in terms of sp->den.
+ */
+static void upoly_sparse_add_terms(struct isl_upoly_sparse *sp,
+	__isl_keep struct isl_upoly *up, int *exp)
+{
+	int i;
+	struct isl_upoly_rec *rec;
+	struct isl_upoly_cst *cst;
+
+	if (isl_upoly_is_cst(up)) {
+		cst = isl_upoly_as_cst(up);
+		if (isl_int_is_zero(cst->n))
+			return;
+		for (i = 0; i < sp->n_var; ++i)
+			sp->exp[sp->n * sp->n_var + i] = exp[i];
+		isl_int_divexact(sp->num[sp->n], sp->den, cst->d);
+		isl_int_mul(sp->num[sp->n], sp->num[sp->n], cst->n);
+		sp->n++;
+		return;
+	}
+
+	rec = isl_upoly_as_rec(up);
+	for (i = 0; i < rec->n; ++i) {
+		exp[up->var] = i;
+		upoly_sparse_add_terms(sp, rec->p[i], exp);
+	}
+	exp[up->var] = 0;
+}
+
+/* Convert "up" to a sparse representation in "n_var" variables.
+ * "n_term" is the number of non-zero terms in "up".
+ */
+static struct isl_upoly_sparse *upoly_sparse_from_upoly(
+	__isl_keep struct isl_upoly *up, int n_var, int n_term)
+{
+	int i;
+	int *exp;
+	struct isl_upoly_sparse *sp;
+
+	sp = upoly_sparse_alloc(up->ctx, n_var, n_term);
+	exp = isl_alloc_array(up->ctx, int, n_var + 1);
+	if (!sp || !exp)
+		goto error;
+	for (i = 0; i < n_var; ++i)
+		exp[i] = 0;
+	upoly_lcm_den(up, &sp->den);
+	upoly_sparse_add_terms(sp, up, exp);
+	free(exp);
+
+	return sp;
+error:
+	free(exp);
+	upoly_sparse_free(sp);
+	return NULL;
+}
+
+/* Construct the recursive representation of the terms lo up to hi
+ * of "sp", which all have the same exponents for the variables
+ * after "var".
+ * The terms with the same exponent "e" for "var" form
+ * a consecutive sequence and are combined into
+ * the coefficient of "var" to the power "e".
+ * Since the terms are non-zero, the final coefficient is non-zero.
+ * If all terms have a zero exponent for "var", then "var"
+ * does not appear in the result.
+ */
+static __isl_give struct isl_upoly *upoly_sparse_to_upoly_range(
+	struct isl_upoly_sparse *sp, int lo, int hi, int var)
+{
+	int i, e, next;
+	struct isl_upoly_rec *rec;
+	isl_int n, d, g;
+
+	if (lo >= hi)
+		return isl_upoly_zero(sp->ctx);
+
+	if (var < 0) {
+		struct isl_upoly *up;
+		isl_int_init(n);
+		isl_int_init(d);
+		isl_int_init(g);
+		isl_int_gcd(g, sp->num[lo], sp->den);
+		isl_int_divexact(n, sp->num[lo], g);
+		isl_int_divexact(d, sp->den, g);
+		up = isl_upoly_rat_cst(sp->ctx, n, d);
+		isl_int_clear(n);
+		isl_int_clear(d);
+		isl_int_clear(g);
+		return up;
+	}
+
+	e = sp->exp[(hi - 1) * sp->n_var + var];
+	if (e == 0)
+		return upoly_sparse_to_upoly_range(sp, lo, hi, var - 1);
+
+	rec = isl_upoly_alloc_rec(sp->ctx, var, 1 + e);
+	if (!rec)
+		return NULL;
+	for (i = lo, e = 0; i < hi; i = next, ++e) {
+		int e_i = sp->exp[i * sp->n_var + var];
+
+		for (; e < e_i; ++e) {
+			rec->p[rec->n] = isl_upoly_zero(sp->ctx);
+			if (!rec->p[rec->n++])
+				goto error;
+		}
+		for (next = i + 1; next < hi; ++next)
+			if (sp->exp[next * sp->n_var + var] != e_i)
+				break;
+		rec->p[rec->n] = upoly_sparse_to_upoly_range(sp, i, next,
+								var - 1);
+		if (!rec->p[rec->n++])
+			goto error;
+	}
+
+	return &rec->up;
+error:
+	isl_upoly_free(&rec->up);
+	return NULL;
+}
+
+/* Construct the recursive representation of "sp".
+ */
+static __isl_give struct isl_upoly *upoly_sparse_to_upoly(
+	struct isl_upoly_sparse *sp)
+{
+	if (!sp)
+		return NULL;
+	return upoly_sparse_to_upoly_range(sp, 0, sp->n, sp->n_var - 1);
+}
+
+/* Compare the exponents of the terms "i1" and "i2" in the array
+ * of exponents "arg" of a sparse polynomial, in the order
+ * used by isl_upoly_sparse.  The number of variables is stored
+ * in the first element of "arg".
+ */
+static int cmp_term(const void *p1, const void *p2, void *arg)
+{
+	int *exp = arg;
+	int n_var = exp[0];
+	const int *e1 = exp + 1 + *(const int *) p1 * n_var;
+	const int *e2 = exp + 1 + *(const int *) p2 * n_var;
+	int i;
+
+	for (i = n_var - 1; i >= 0; --i)
+		if (e1[i] != e2[i])
+			return e1[i] - e2[i];
+	return 0;
+}
+
+/* Divide the numerators and the denominator of "sp"
+ * by their greatest common divisor.
+ */
+static void upoly_sparse_normalize(struct isl_upoly_sparse *sp)
+{
+	int i;
+	isl_int g;
+
+	isl_int_init(g);
+	isl_int_set(g, sp->den);
+	for (i = 0; i < sp->n && !isl_int_is_one(g); ++i)
+		isl_int_gcd(g, g, sp->num[i]);
+	if (!isl_int_is_one(g)) {
+		for (i = 0; i < sp->n; ++i)
+			isl_int_divexact(sp->num[i], sp->num[i], g);
+		isl_int_divexact(sp->den, sp->den, g);
+	}
+	isl_int_clear(g);
+}
+
+/* Return the product of "sp1" and "sp2", which have the same
+ * number of variables.
+ *
+ * We first compute the products of all pairs of terms,
+ * with the exponents stored after the number of variables
+ * as required by cmp_term, then sort these products
+ * on their exponents and finally add up the products
+ * with the same exponents, dropping those that cancel out.
+ */
+static struct isl_upoly_sparse *upoly_sparse_mul(
+	struct isl_upoly_sparse *sp1, struct isl_upoly_sparse *sp2)
+{
+	int i, j, k, n, n_var;
+	int *exp = NULL, *perm = NULL;
+	struct isl_upoly_sparse *prod = NULL, *res = NULL;
+
+	if (!sp1 || !sp2)
+		return NULL;
+
+	n_var = sp1->n_var;
+	n = sp1->n * sp2->n;
+	prod = upoly_sparse_alloc(sp1->ctx, n_var, n);
+	exp = isl_alloc_array(sp1->ctx, int, 1 + n * n_var);
+	perm = isl_alloc_array(sp1->ctx, int, n + 1);
+	if (!prod || !exp || !perm)
+		goto error;
+
+	exp[0] = n_var;
+	for (i = 0, k = 0; i < sp1->n; ++i) {
+		int *e1 = sp1->exp + i * n_var;
+		for (j = 0; j < sp2->n; ++j, ++k) {
+			int *e2 = sp2->exp + j * n_var;
+			int l;
+
+			for (l = 0; l < n_var; ++l)
+				exp[1 + k * n_var + l] = e1[l] + e2[l];
+			isl_int_mul(prod->num[k], sp1->num[i], sp2->num[j]);
+			perm[k] = k;
+		}
+	}
+	if (isl_sort(perm, n, sizeof(int), &cmp_term, exp) < 0)
+		goto error;
+
+	res = upoly_sparse_alloc(sp1->ctx, n_var, n);
+	if (!res)
+		goto error;
+	isl_int_mul(res->den, sp1->den, sp2->den);
+	for (i = 0; i < n; i = j) {
+		isl_int_set(res->num[res->n], prod->num[perm[i]]);
+		for (j = i + 1; j < n; ++j) {
+			if (cmp_term(&perm[i], &perm[j], exp) != 0)
+				break;
+			isl_int_add(res->num[res->n], res->num[res->n],
+				    prod->num[perm[j]]);
+		}
+		if (isl_int_is_zero(res->num[res->n]))
+			continue;
+		for (k = 0; k < n_var; ++k)
+			res->exp[res->n * n_var + k] =
+					exp[1 + perm[i] * n_var + k];
+		res->n++;
+	}
+	upoly_sparse_normalize(res);
+
+	free(perm);
+	free(exp);
+	upoly_sparse_free(prod);
+	return res;
+error:
+	free(perm);
+	free(exp);
+	upoly_sparse_free(prod);
+	upoly_sparse_free(res);
+	return NULL;
+}
+
+/* Return the number of variables that need to be represented
+ * in a sparse representation of "up".
+ * Since the variables in the recursive representation
+ * are decreasing towards the leaves, this is the variable
+ * at the root plus one.
+ */
+static int upoly_n_var(__isl_keep struct isl_upoly *up)
+{
+	return isl_upoly_is_cst(up) ? 0 : up->var + 1;
+}
+
+/* Should the product of "up1" and "up2" be computed
+ * using the flat representation?
+ * "n1" and "n2" are set to the numbers of terms of "up1" and "up2"
+ * if the flat representation should be used.
+ *
+ * We only use the flat representation if both polynomials
+ * have at least two terms and if their coefficients are
+ * all rational numbers.
+ */
+static int use_sparse(__isl_keep struct isl_upoly *up1,
+	__isl_keep struct isl_upoly *up2, int *n1, int *n2)
+{
+	if (isl_upoly_is_cst(up1) || isl_upoly_is_cst(up2))
+		return 0;
+	*n1 = upoly_n_term(up1);
+	if (*n1 < 2)
+		return 0;
+	*n2 = upoly_n_term(up2);
+	if (*n2 < 2)
+		return 0;
+	return *n1 * *n2 >= ISL_UPOLY_SPARSE_MIN_TERMS;
+}
+
+/* Return the product of "up1" and "up2", computed in a flat
+ * representation, if this is expected to be more efficient
+ * than a computation in the recursive representation.
+ * Otherwise, return the result of calling "mul" on "up1" and "up2".
+ */
+__isl_give struct isl_upoly *isl_upoly_mul_sparse(
+	__isl_take struct isl_upoly *up1, __isl_take struct isl_upoly *up2,
+	__isl_give struct isl_upoly *(*mul)(__isl_take struct isl_upoly *up1,
+		__isl_take struct isl_upoly *up2))
+{
+	int n1, n2, n_var;
+	struct isl_upoly_sparse *sp1, *sp2, *res;
+	struct isl_upoly *up;
+
+	if (!up1 || !up2)
+		goto error;
+	if (!use_sparse(up1, up2, &n1, &n2))
+		return mul(up1, up2);
+
+	n_var = upoly_n_var(up1);
+	if (upoly_n_var(up2) > n_var)
+		n_var = upoly_n_var(up2);
+	sp1 = upoly_sparse_from_upoly(up1, n_var, n1);
+	sp2 = upoly_sparse_from_upoly(up2, n_var, n2);
+	res = upoly_sparse_mul(sp1, sp2);
+	up = upoly_sparse_to_upoly(res);
+	upoly_sparse_free(sp1);
+	upoly_sparse_free(sp2);
+	upoly_sparse_free(res);
+
+	isl_upoly_free(up1);
+	isl_upoly_free(up2);
+	return up;
+error:
+	isl_upoly_free(up1);
+	isl_upoly_free(up2);
+	return NULL;
+}
+
+/* Return a copy of "sp".
+ */
+static struct isl_upoly_sparse *upoly_sparse_dup(struct isl_upoly_sparse *sp)
+{
+	int i;
+	struct isl_upoly_sparse *dup;
+
+	if (!sp)
+		return NULL;
+	dup = upoly_sparse_alloc(sp->ctx, sp->n_var, sp->n);
+	if (!dup)
+		return NULL;
+	for (i = 0; i < sp->n * sp->n_var; ++i)
+		dup->exp[i] = sp->exp[i];
+	for (i = 0; i < sp->n; ++i)
+		isl_int_set(dup->num[i], sp->num[i]);
+	isl_int_set(dup->den, sp->den);
+	dup->n = sp->n;
+
+	return dup;
+}
+
+/* Return "up" raised to the power "power", with "power" at least 1,
+ * computed in a flat representation, if this is expected to be
+ * more efficient than a computation in the recursive representation.
+ * Otherwise, return the result of calling "pow" on "up" and "power".
+ * In the flat representation, all intermediate results
+ * are kept in flat form.
+ */
+__isl_give struct isl_upoly *isl_upoly_pow_sparse(
+	__isl_take struct isl_upoly *up, unsigned power,
+	__isl_give struct isl_upoly *(*pow)(__isl_take struct isl_upoly *up,
+		unsigned power))
+{
+	int n, n_var;
+	struct isl_upoly_sparse *sp, *res = NULL, *tmp;
+	struct isl_upoly *r;
+
+	if (!up)
+		return NULL;
+	if (power < 2 || !use_sparse(up, up, &n, &n))
+		return pow(up, power);
+
+	n_var = upoly_n_var(up);
+	sp = upoly_sparse_from_upoly(up, n_var, n);
+	while (sp) {
+		if (power % 2) {
+			tmp = res ? upoly_sparse_mul(res, sp) :
+				    upoly_sparse_dup(sp);
+			upoly_sparse_free(res);
+			res = tmp;
+			if (!res)
+				break;
+		}
+		power >>= 1;
+		if (!power)
+			break;
+		tmp = upoly_sparse_mul(sp, sp);
+		upoly_sparse_free(sp);
+		sp = tmp;
+	}
+
+	r = sp ? upoly_sparse_to_upoly(res) : NULL;
+	upoly_sparse_free(sp);
+	upoly_sparse_free(res);
+	isl_upoly_free(up);
+
+	return r;
+}
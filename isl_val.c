@@ -236,6 +236,26 @@ __isl_give isl_val *isl_val_dup(__isl_keep isl_val *val)
 	return dup;
 }
 
+/* Construct a copy of "v" in "ctx", which may be different
+ * from the context of "v".  "v" itself is only read.
+ */
+__isl_give isl_val *isl_val_transfer(isl_ctx *ctx, __isl_keep isl_val *v)
+{
+	isl_val *res;
+
+	if (!v)
+		return NULL;
+
+	res = isl_val_alloc(ctx);
+	if (!res)
+		return NULL;
+
+	isl_int_set(res->n, v->n);
+	isl_int_set(res->d, v->d);
+
+	return res;
+}
+
 /* Return an isl_val that is equal to "val" and that has only
  * a single reference.
  */
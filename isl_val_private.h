@@ -33,6 +33,7 @@ __isl_give isl_val *isl_val_int_from_isl_int(isl_ctx *ctx, isl_int n);
 __isl_give isl_val *isl_val_rat_from_isl_int(isl_ctx *ctx,
 	isl_int n, isl_int d);
 __isl_give isl_val *isl_val_cow(__isl_take isl_val *val);
+__isl_give isl_val *isl_val_transfer(isl_ctx *ctx, __isl_keep isl_val *v);
 
 __isl_give isl_val *isl_val_insert_dims(__isl_take isl_val *v,
 	enum isl_dim_type type, unsigned first, unsigned n);
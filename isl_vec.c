@@ -144,6 +144,22 @@ struct isl_vec *isl_vec_dup(struct isl_vec *vec)
 	return vec2;
 }
 
+/* Construct a copy of "vec" in "ctx", which may be different
+ * from the context of "vec".  "vec" itself is only read.
+ */
+__isl_give isl_vec *isl_vec_transfer(isl_ctx *ctx, __isl_keep isl_vec *vec)
+{
+	isl_vec *res;
+
+	if (!vec)
+		return NULL;
+	res = isl_vec_alloc(ctx, vec->size);
+	if (!res)
+		return NULL;
+	isl_seq_cpy(res->el, vec->el, vec->size);
+	return res;
+}
+
 struct isl_vec *isl_vec_cow(struct isl_vec *vec)
 {
 	struct isl_vec *vec2;
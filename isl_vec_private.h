@@ -16,6 +16,7 @@ struct isl_vec {
 };
 
 __isl_give isl_vec *isl_vec_cow(__isl_take isl_vec *vec);
+__isl_give isl_vec *isl_vec_transfer(isl_ctx *ctx, __isl_keep isl_vec *vec);
 
 void isl_vec_lcm(struct isl_vec *vec, isl_int *lcm);
 int isl_vec_get_element(__isl_keep isl_vec *vec, int pos, isl_int *v);
@@ -8,7 +8,9 @@
  * 91893 Orsay, France 
  */
 
+#include <isl_ctx_private.h>
 #include <isl_map_private.h>
+#include <isl_options_private.h>
 #include <isl/set.h>
 #include <isl_seq.h>
 #include <isl_tab.h>
@@ -22,6 +24,7 @@
 #define DESELECTED	-1
 #define UNSELECTED	0
 
+static __isl_give isl_vertices *compute_vertices(__isl_keep isl_basic_set *bset);
 static __isl_give isl_vertices *compute_chambers(__isl_take isl_basic_set *bset,
 	__isl_take isl_vertices *vertices);
 
@@ -348,7 +351,7 @@ static __isl_give isl_vertices *lower_dim_vertices(
 	morph = isl_basic_set_full_compression(bset);
 	bset = isl_morph_basic_set(isl_morph_copy(morph), bset);
 
-	vertices = isl_basic_set_compute_vertices(bset);
+	vertices = compute_vertices(bset);
 	isl_basic_set_free(bset);
 
 	morph = isl_morph_inverse(morph);
@@ -387,8 +390,7 @@ static __isl_give isl_vertices *lower_dim_vertices(
  * The set variable coefficients of the selected constraints are stored
  * in the facets matrix.
  */
-__isl_give isl_vertices *isl_basic_set_compute_vertices(
-	__isl_keep isl_basic_set *bset)
+static __isl_give isl_vertices *compute_vertices(__isl_keep isl_basic_set *bset)
 {
 	struct isl_tab *tab;
 	int level;
@@ -505,6 +507,200 @@ error:
 	return NULL;
 }
 
+/* An entry in the cache of parametric vertex decompositions.
+ * "vertices" was computed from a basic set with normalized form "bset",
+ * which has hash value "hash".
+ */
+struct isl_vertices_cache_entry {
+	uint32_t hash;
+	isl_basic_set *bset;
+	isl_vertices *vertices;
+};
+
+/* A cache of the "n" most recently computed parametric vertex
+ * decompositions, ordered from most recently to least recently used.
+ * "size" is the number of entries for which room has been allocated.
+ */
+struct isl_vertices_cache {
+	int n;
+	int size;
+	struct isl_vertices_cache_entry *entry;
+};
+
+static void free_cache_entry(struct isl_vertices_cache_entry *entry)
+{
+	isl_basic_set_free(entry->bset);
+	isl_vertices_free(entry->vertices);
+}
+
+/* Remove all entries from the cache of parametric vertex decompositions
+ * of "ctx".
+ */
+void isl_ctx_clear_vertices_cache(isl_ctx *ctx)
+{
+	int i;
+	struct isl_vertices_cache *cache;
+
+	if (!ctx || !ctx->vertices_cache)
+		return;
+
+	cache = ctx->vertices_cache;
+	ctx->vertices_cache = NULL;
+	for (i = 0; i < cache->n; ++i)
+		free_cache_entry(&cache->entry[i]);
+	free(cache->entry);
+	free(cache);
+}
+
+/* Is "entry" a cached decomposition of a basic set with normalized
+ * form "bset", with hash value "hash"?
+ * Since isl_basic_set_plain_is_equal only compares the constraints
+ * (and the rationality), we also need to compare the spaces.
+ */
+static int cache_entry_matches(struct isl_vertices_cache_entry *entry,
+	__isl_keep isl_basic_set *bset, uint32_t hash)
+{
+	int equal;
+
+	if (entry->hash != hash)
+		return 0;
+	equal = isl_space_is_equal(entry->bset->dim, bset->dim);
+	if (equal < 0 || !equal)
+		return equal;
+	return isl_basic_set_plain_is_equal(entry->bset, bset);
+}
+
+/* Look for a cached decomposition of a basic set with normalized form "bset",
+ * with hash value "hash", in the cache of "ctx".
+ * If one is found, then it is moved to the front of the cache
+ * and a copy is returned in "vertices".
+ *
+ * Return 1 if a decomposition was found, 0 if none was found and
+ * -1 on error.
+ */
+static int cache_find(isl_ctx *ctx, __isl_keep isl_basic_set *bset,
+	uint32_t hash, isl_vertices **vertices)
+{
+	int i;
+	struct isl_vertices_cache *cache = ctx->vertices_cache;
+	struct isl_vertices_cache_entry entry;
+
+	for (i = 0; cache && i < cache->n; ++i) {
+		int match = cache_entry_matches(&cache->entry[i], bset, hash);
+		if (match < 0)
+			return -1;
+		if (match)
+			break;
+	}
+	if (!cache || i >= cache->n)
+		return 0;
+
+	entry = cache->entry[i];
+	memmove(cache->entry + 1, cache->entry,
+		i * sizeof(struct isl_vertices_cache_entry));
+	cache->entry[0] = entry;
+
+	*vertices = isl_vertices_copy(entry.vertices);
+	return 1;
+}
+
+/* Add the decomposition "vertices" of a basic set with normalized form
+ * "bset", with hash value "hash", to the front of the cache of "ctx", making room for at most "size"
+ * entries and evicting the least recently used entries that do not fit.
+ */
+static int cache_insert(isl_ctx *ctx, __isl_keep isl_basic_set *bset,
+	uint32_t hash, __isl_keep isl_vertices *vertices, int size)
+{
+	struct isl_vertices_cache *cache = ctx->vertices_cache;
+
+	if (!cache) {
+		cache = isl_calloc_type(ctx, struct isl_vertices_cache);
+		if (!cache)
+			return -1;
+		ctx->vertices_cache = cache;
+	}
+	while (cache->n >= size)
+		free_cache_entry(&cache->entry[--cache->n]);
+	if (cache->size != size) {
+		struct isl_vertices_cache_entry *entry;
+		entry = isl_realloc_array(ctx, cache->entry,
+				    struct isl_vertices_cache_entry, size);
+		if (!entry)
+			return -1;
+		cache->entry = entry;
+		cache->size = size;
+	}
+
+	memmove(cache->entry + 1, cache->entry,
+		cache->n * sizeof(struct isl_vertices_cache_entry));
+	cache->entry[0].hash = hash;
+	cache->entry[0].bset = isl_basic_set_copy(bset);
+	cache->entry[0].vertices = isl_vertices_copy(vertices);
+	cache->n++;
+
+	return 0;
+}
+
+/* Compute the parametric vertices and the chamber decomposition
+ * of the parametric polytope defined using the same constraints
+ * as "bset".
+ *
+ * If the vertices_cache_size option is positive, then the results
+ * of the most recent computations are kept in a cache on the isl_ctx,
+ * keyed on the normalized form of "bset", such that bounding several
+ * quasipolynomials over the same domain only performs
+ * the decomposition once.
+ * The normalization is performed on a duplicate of "bset" because
+ * it may modify its input in place and the decomposition itself
+ * is still computed from "bset" such that the result does not depend
+ * on the presence of the cache.
+ * The cached isl_vertices objects are shared with the callers, which
+ * is safe because they are not modified after they have been computed.
+ */
+__isl_give isl_vertices *isl_basic_set_compute_vertices(
+	__isl_keep isl_basic_set *bset)
+{
+	int size;
+	int found;
+	uint32_t hash;
+	isl_ctx *ctx;
+	isl_basic_set *key;
+	isl_vertices *vertices = NULL;
+
+	if (!bset)
+		return NULL;
+
+	ctx = isl_basic_set_get_ctx(bset);
+	size = ctx->opt->vertices_cache_size;
+	if (size <= 0)
+		return compute_vertices(bset);
+
+	key = isl_basic_set_normalize(isl_basic_set_dup(bset));
+	if (!key)
+		return NULL;
+	hash = isl_basic_set_get_hash(key);
+	found = cache_find(ctx, key, hash, &vertices);
+	if (found < 0)
+		goto error;
+	if (found) {
+		ctx->stats->vertices_n_cache_hit++;
+		isl_basic_set_free(key);
+		return vertices;
+	}
+
+	ctx->stats->vertices_n_cache_miss++;
+	vertices = compute_vertices(bset);
+	if (vertices && cache_insert(ctx, key, hash, vertices, size) < 0)
+		goto error;
+
+	isl_basic_set_free(key);
+	return vertices;
+error:
+	isl_basic_set_free(key);
+	isl_vertices_free(vertices);
+	return NULL;
+}
+
 struct isl_chamber_list {
 	struct isl_chamber c;
 	struct isl_chamber_list *next;
@@ -855,6 +1051,12 @@ static int update_todo(struct isl_facet_todo *first, struct isl_tab *tab)
  * that contain the facet and have a full-dimensional intersection with
  * the other side of the facet.  For each of the interior facets, we
  * again create todo items, taking care to cancel opposite todo items.
+ * Since an activity domain can only contain the facet if it contains
+ * any given point of the facet, we first check whether the activity
+ * domain contains the sample point of the facet.  This check only
+ * requires the evaluation of the constraints of the activity domain
+ * and allows us to skip the more expensive tableau based checks
+ * for most of the vertices when there are many vertices.
  */
 static __isl_give isl_vertices *compute_chambers(__isl_take isl_basic_set *bset,
 	__isl_take isl_vertices *vertices)
@@ -923,7 +1125,18 @@ static __isl_give isl_vertices *compute_chambers(__isl_take isl_basic_set *bset,
 		if (isl_tab_freeze_constraint(tab, tab->n_con - 1) < 0)
 			goto error;
 
+		isl_vec_free(sample);
+		sample = isl_tab_get_sample_value(todo->tab);
+		if (!sample)
+			goto error;
+
 		for (i = 0; i < vertices->n_vertices; ++i) {
+			selection[i] = isl_basic_set_contains(vertices->v[i].dom,
+								sample);
+			if (selection[i] < 0)
+				goto error;
+			if (!selection[i])
+				continue;
 			selection[i] = bset_covers_tab(vertices->v[i].dom,
 							todo->tab);
 			if (selection[i] < 0)
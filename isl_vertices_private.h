@@ -51,6 +51,8 @@ struct isl_external_vertex {
 	int id;
 };
 
+__isl_give isl_vertices *isl_vertices_copy(__isl_keep isl_vertices *vertices);
+
 int isl_vertices_foreach_disjoint_cell(__isl_keep isl_vertices *vertices,
 	int (*fn)(__isl_take isl_cell *cell, void *user), void *user);
 int isl_cell_foreach_simplex(__isl_take isl_cell *cell,
@@ -257,6 +257,7 @@ static void check_solution(isl_basic_set *bset, isl_basic_set *context,
 	isl_int_clear(count);
 
 	sp.callback.add = scan_one;
+	sp.callback.add_line = NULL;
 	sp.bset = bset;
 	sp.sol = sol;
 	sp.empty = empty;
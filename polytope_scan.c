@@ -57,6 +57,7 @@ static struct isl_mat *isl_basic_set_scan_samples(struct isl_basic_set *bset)
 	ctx = isl_basic_set_get_ctx(bset);
 	dim = isl_basic_set_total_dim(bset);
 	ss.callback.add = scan_samples_add_sample;
+	ss.callback.add_line = NULL;
 	ss.samples = isl_mat_alloc(ctx, 0, 1 + dim);
 	if (!ss.samples)
 		goto error;